@@ -0,0 +1,97 @@
+// BenchUtils.h
+#pragma once
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <cstdio>
+#include <iostream>
+#include <fcntl.h>
+#include <ftw.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+// Общие помощники бенчмарков (только Linux)
+namespace bench {
+
+//Синтетический /proc: <root>/<pid>/stat, <root>/<pid>/io и симлинк <root>/<pid>/exe
+inline bool buildFakeProc(const std::string& root, size_t count) {
+    char line[512];
+    for (size_t i = 0; i < count; ++i) {
+        unsigned pid = static_cast<unsigned>(i + 1);
+        std::string dir = root + "/" + std::to_string(pid);
+        if (::mkdir(dir.c_str(), 0755) != 0) {
+            return false;
+        }
+        //Несколько сотен повторяющихся бинарников, как на реальных хостах
+        unsigned binary = pid % 300;
+        int length = std::snprintf(line, sizeof(line),
+            "%u (worker-%u) S %u %u %u 0 -1 4194560 120 0 0 0 12 7 0 0 20 0 1 0 %u "
+            "12345678 300 18446744073709551615 1 1 0 0 0 0 0 0 0 0 0 0 17 0 0 0 0 0 0\n",
+            pid, binary, pid / 2, pid, pid, 1000 + pid);
+        int fd = ::open((dir + "/stat").c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        if (fd < 0 || ::write(fd, line, static_cast<size_t>(length)) != length) {
+            if (fd >= 0) ::close(fd);
+            return false;
+        }
+        ::close(fd);
+        length = std::snprintf(line, sizeof(line),
+            "rchar: %u\nwchar: %u\nsyscr: 10\nsyscw: 5\nread_bytes: %u\nwrite_bytes: %u\ncancelled_write_bytes: 0\n",
+            pid * 100, pid * 50, pid * 4096, pid * 512);
+        fd = ::open((dir + "/io").c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        if (fd < 0 || ::write(fd, line, static_cast<size_t>(length)) != length) {
+            if (fd >= 0) ::close(fd);
+            return false;
+        }
+        ::close(fd);
+        std::string target = "/usr/lib/fake/bin/worker-" + std::to_string(binary);
+        if (::symlink(target.c_str(), (dir + "/exe").c_str()) != 0) {
+            return false;
+        }
+    }
+    return true;
+}
+
+//Удаляет каталог со всем содержимым (как rm -rf, без запуска оболочки): файлы раньше
+//каталогов (FTW_DEPTH), симлинки удаляются сами, без перехода по ним (FTW_PHYS)
+inline bool removeTree(const std::string& root) {
+    auto removeEntry = [](const char* path, const struct stat*, int type, struct FTW*) -> int {
+        int result = type == FTW_DP ? ::rmdir(path) : ::unlink(path);
+        if (result != 0) {
+            std::cerr << "Cannot remove " << path << std::endl;
+        }
+        return result;
+    };
+    return ::nftw(root.c_str(), removeEntry, 16, FTW_DEPTH | FTW_PHYS) == 0;
+}
+
+//Создает синтетический /proc во временном каталоге; пустая строка при ошибке
+inline std::string makeFakeProc(size_t count) {
+    char pattern[] = "/tmp/procbench.XXXXXX";
+    if (!::mkdtemp(pattern)) {
+        return "";
+    }
+    std::string root = pattern;
+    if (!buildFakeProc(root, count)) {
+        removeTree(root);
+        return "";
+    }
+    return root;
+}
+
+//Перцентиль (0..1) по копии выборки
+template<typename T>
+T percentile(std::vector<T> values, double fraction) {
+    if (values.empty()) {
+        return T();
+    }
+    size_t index = static_cast<size_t>(fraction * static_cast<double>(values.size() - 1));
+    std::nth_element(values.begin(), values.begin() + static_cast<long>(index), values.end());
+    return values[index];
+}
+
+template<typename T>
+T median(const std::vector<T>& values) {
+    return percentile(values, 0.5);
+}
+
+} // namespace bench
@@ -0,0 +1,275 @@
+#pragma once
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <memory>
+#include <new>
+#include <thread>
+#include <type_traits>
+#include <utility>
+#include <cstddef>
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_X64) || defined(_M_IX86)
+#include <immintrin.h> //_mm_pause
+#endif
+
+/*
+Ограниченная lock-free MPMC очередь на кольцевом буфере (схема Д. Вьюкова).
+У каждой ячейки есть счетчик sequence, по которому производитель и потребитель
+понимают, свободна ячейка или заполнена, без общего мьютекса.
+- емкость фиксирована (округляется до степени двойки): медленный потребитель не съест всю память
+- позиции записи и чтения разнесены по разным кеш-линиям (нет false sharing)
+- try_push_n/try_pop_n резервируют сразу несколько ячеек одним CAS
+- push/pop сначала немного крутятся, затем засыпают на condition_variable
+- close() будит всех ждущих: производители получают false, потребители
+  дочитывают остаток и тоже получают false
+ThreadSafeQueue остается простым неограниченным вариантом.
+*/
+template<typename T>
+class BoundedQueue {
+    private:
+        static const size_t CACHE_LINE = 64;
+        static const int SPIN_LIMIT = 64;
+
+        struct Cell {
+            std::atomic<size_t> sequence;
+            typename std::aligned_storage<sizeof(T), alignof(T)>::type storage;
+
+            T* value() { return reinterpret_cast<T*>(&storage); }
+        };
+
+        std::unique_ptr<Cell[]> m_buffer;
+        size_t m_mask;
+
+        alignas(CACHE_LINE) std::atomic<size_t> m_enqueuePos{0};
+        alignas(CACHE_LINE) std::atomic<size_t> m_dequeuePos{0};
+        alignas(CACHE_LINE) std::atomic<bool> m_closed{false};
+
+        //Парковка заснувших потоков; уведомляем только если кто-то действительно спит
+        std::atomic<int> m_waitingProducers{0};
+        std::atomic<int> m_waitingConsumers{0};
+        std::mutex m_parkMutex;
+        std::condition_variable m_notFull;
+        std::condition_variable m_notEmpty;
+
+        static size_t roundUpPowerOfTwo(size_t value) {
+            size_t result = 2;
+            while (result < value) {
+                result <<= 1;
+            }
+            return result;
+        }
+
+        static void cpuRelax() {
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_X64) || defined(_M_IX86)
+            _mm_pause();
+#else
+            std::this_thread::yield();
+#endif
+        }
+
+        //Барьер нужен в паре с барьером ждущего: либо он увидит наши данные, либо мы - его счетчик
+        void wakeConsumers() {
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            if (m_waitingConsumers.load(std::memory_order_relaxed) > 0) {
+                std::lock_guard<std::mutex> lock(m_parkMutex);
+                m_notEmpty.notify_all();
+            }
+        }
+
+        void wakeProducers() {
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            if (m_waitingProducers.load(std::memory_order_relaxed) > 0) {
+                std::lock_guard<std::mutex> lock(m_parkMutex);
+                m_notFull.notify_all();
+            }
+        }
+
+        //Резервирует до count подряд идущих ячеек; ready(cell, pos) - ячейка готова для операции
+        template<typename Ready>
+        size_t reserve(std::atomic<size_t>& position, size_t count, size_t& start, Ready ready) {
+            size_t pos = position.load(std::memory_order_relaxed);
+            for (;;) {
+                size_t available = 0;
+                while (available < count && ready(m_buffer[(pos + available) & m_mask], pos + available)) {
+                    ++available;
+                }
+                if (available == 0) {
+                    //Либо очередь полна/пуста, либо другой поток уже сдвинул позицию
+                    size_t current = position.load(std::memory_order_relaxed);
+                    if (current == pos) {
+                        return 0;
+                    }
+                    pos = current;
+                    continue;
+                }
+                if (position.compare_exchange_weak(pos, pos + available, std::memory_order_relaxed)) {
+                    start = pos;
+                    return available;
+                }
+            }
+        }
+
+        //Вставка/извлечение без пробуждения другой стороны
+        template<typename Iterator>
+        size_t pushImpl(Iterator values, size_t count) {
+            if (count == 0 || m_closed.load(std::memory_order_relaxed)) {
+                return 0;
+            }
+            size_t start = 0;
+            size_t reserved = reserve(m_enqueuePos, count, start, [](Cell& cell, size_t pos) {
+                return cell.sequence.load(std::memory_order_acquire) == pos;
+            });
+            for (size_t i = 0; i < reserved; ++i, ++values) {
+                Cell& cell = m_buffer[(start + i) & m_mask];
+                new (cell.value()) T(std::move(*values));
+                cell.sequence.store(start + i + 1, std::memory_order_release);
+            }
+            return reserved;
+        }
+
+        template<typename Iterator>
+        size_t popImpl(Iterator out, size_t count) {
+            if (count == 0) {
+                return 0;
+            }
+            size_t start = 0;
+            size_t reserved = reserve(m_dequeuePos, count, start, [](Cell& cell, size_t pos) {
+                return cell.sequence.load(std::memory_order_acquire) == pos + 1;
+            });
+            for (size_t i = 0; i < reserved; ++i, ++out) {
+                Cell& cell = m_buffer[(start + i) & m_mask];
+                T* value = cell.value();
+                *out = std::move(*value);
+                value->~T();
+                cell.sequence.store(start + i + m_mask + 1, std::memory_order_release);
+            }
+            return reserved;
+        }
+
+    public:
+        explicit BoundedQueue(size_t capacity)
+            : m_buffer(new Cell[roundUpPowerOfTwo(capacity)]), m_mask(roundUpPowerOfTwo(capacity) - 1) {
+            for (size_t i = 0; i <= m_mask; ++i) {
+                m_buffer[i].sequence.store(i, std::memory_order_relaxed);
+            }
+        }
+
+        ~BoundedQueue() {
+            //Разрушаем оставшиеся элементы
+            size_t end = m_enqueuePos.load();
+            for (size_t pos = m_dequeuePos.load(); pos != end; ++pos) {
+                Cell& cell = m_buffer[pos & m_mask];
+                if (cell.sequence.load() == pos + 1) {
+                    cell.value()->~T();
+                }
+            }
+        }
+
+        BoundedQueue(const BoundedQueue&) = delete;
+        BoundedQueue& operator=(const BoundedQueue&) = delete;
+
+        size_t capacity() const { return m_mask + 1; }
+
+        //Неблокирующая вставка до count элементов из values; возвращает сколько вставлено
+        template<typename Iterator>
+        size_t try_push_n(Iterator values, size_t count) {
+            size_t pushed = pushImpl(values, count);
+            if (pushed > 0) {
+                wakeConsumers();
+            }
+            return pushed;
+        }
+
+        //Неблокирующее извлечение до count элементов в out; возвращает сколько извлечено
+        template<typename Iterator>
+        size_t try_pop_n(Iterator out, size_t count) {
+            size_t popped = popImpl(out, count);
+            if (popped > 0) {
+                wakeProducers();
+            }
+            return popped;
+        }
+
+        bool try_push(T value) {
+            return try_push_n(&value, 1) == 1;
+        }
+
+        bool try_pop(T& value) {
+            return try_pop_n(&value, 1) == 1;
+        }
+
+        //Блокирующая вставка; false - очередь закрыта
+        bool push(T value) {
+            for (int spin = 0; spin < SPIN_LIMIT; ++spin) {
+                if (try_push_n(&value, 1) == 1) {
+                    return true;
+                }
+                if (m_closed.load(std::memory_order_relaxed)) {
+                    return false;
+                }
+                cpuRelax();
+            }
+
+            bool pushed = false;
+            {
+                std::unique_lock<std::mutex> lock(m_parkMutex);
+                m_waitingProducers.fetch_add(1);
+                std::atomic_thread_fence(std::memory_order_seq_cst);
+                //Проверка внутри предиката идет после регистрации ожидания - пробуждение не теряется
+                m_notFull.wait(lock, [&]() {
+                    pushed = pushImpl(&value, 1) == 1;
+                    return pushed || m_closed.load();
+                });
+                m_waitingProducers.fetch_sub(1);
+            }
+            if (pushed) {
+                wakeConsumers(); //будим уже без m_parkMutex
+            }
+            return pushed;
+        }
+
+        //Блокирующее извлечение; false - очередь закрыта и пуста
+        bool pop(T& value) {
+            for (int spin = 0; spin < SPIN_LIMIT; ++spin) {
+                if (try_pop_n(&value, 1) == 1) {
+                    return true;
+                }
+                cpuRelax();
+            }
+
+            bool popped = false;
+            {
+                std::unique_lock<std::mutex> lock(m_parkMutex);
+                m_waitingConsumers.fetch_add(1);
+                std::atomic_thread_fence(std::memory_order_seq_cst);
+                m_notEmpty.wait(lock, [&]() {
+                    popped = popImpl(&value, 1) == 1;
+                    return popped || m_closed.load();
+                });
+                m_waitingConsumers.fetch_sub(1);
+            }
+            if (popped) {
+                wakeProducers();
+            }
+            return popped;
+        }
+
+        //Закрытие: новые push отклоняются, все ждущие просыпаются
+        void close() {
+            m_closed.store(true);
+            std::lock_guard<std::mutex> lock(m_parkMutex);
+            m_notFull.notify_all();
+            m_notEmpty.notify_all();
+        }
+
+        bool closed() const { return m_closed.load(); }
+
+        //Приблизительный размер (точен только без конкурентных операций)
+        size_t size_approx() const {
+            size_t enqueue = m_enqueuePos.load(std::memory_order_relaxed);
+            size_t dequeue = m_dequeuePos.load(std::memory_order_relaxed);
+            return enqueue >= dequeue ? enqueue - dequeue : 0;
+        }
+
+        bool empty() const { return size_approx() == 0; }
+};
@@ -0,0 +1,598 @@
+#include "FdInventory.h"
+#include "ProcessTable.h"
+#include "Metrics.h"
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#ifndef _WIN32
+#include "ProcFsReader.h"
+#include <unistd.h>
+#endif
+
+namespace {
+
+//Состояния сокетов как в include/net/tcp_states.h; у unix-сокетов - SS_* из linux/net.h
+const uint8_t TCP_ESTABLISHED = 1;
+const uint8_t TCP_CLOSE = 7;
+const uint8_t TCP_LISTEN = 10;
+const uint64_t UNIX_ACCEPTCON = 0x10000; //флаг слушающего unix-сокета (__SO_ACCEPTCON)
+
+#ifndef _WIN32
+
+MetricHistogram scanDuration("monitor_fd_scan_seconds", "Open file and socket inventory scans");
+MetricHistogram socketTableDuration("monitor_socket_table_seconds", "Parsing of /proc/net socket tables per scan");
+MetricCounter fdDirectoryReads("monitor_fd_rescans_total", "Per-process fd directory reads");
+MetricGauge openDescriptors("monitor_fd_open", "Descriptors in the last inventory scan");
+
+//Следующее поле строки, разделенное пробелами; pos сдвигается за него
+std::string_view nextField(std::string_view line, size_t& pos) {
+    while (pos < line.size() && line[pos] == ' ') {
+        ++pos;
+    }
+    size_t start = pos;
+    while (pos < line.size() && line[pos] != ' ') {
+        ++pos;
+    }
+    return line.substr(start, pos - start);
+}
+
+bool parseHex(std::string_view text, uint64_t& value) {
+    if (text.empty() || text.size() > 16) {
+        return false;
+    }
+    value = 0;
+    for (char c : text) {
+        unsigned digit;
+        if (c >= '0' && c <= '9') {
+            digit = static_cast<unsigned>(c - '0');
+        } else if (c >= 'A' && c <= 'F') {
+            digit = static_cast<unsigned>(c - 'A' + 10);
+        } else if (c >= 'a' && c <= 'f') {
+            digit = static_cast<unsigned>(c - 'a' + 10);
+        } else {
+            return false;
+        }
+        value = value << 4 | digit;
+    }
+    return true;
+}
+
+bool parseDecimal(std::string_view text, uint64_t& value) {
+    if (text.empty() || text.size() > 19) {
+        return false;
+    }
+    value = 0;
+    for (char c : text) {
+        if (c < '0' || c > '9') {
+            return false;
+        }
+        value = value * 10 + static_cast<uint64_t>(c - '0');
+    }
+    return true;
+}
+
+/*
+"0100007F:0CEA": адрес - слова по 32 бита, напечатанные ядром как числа (%08X)
+в его порядке байт, поэтому memcpy слова возвращает сетевой порядок.
+IPv4 - одно слово, IPv6 - четыре; порт - обычное число.
+*/
+bool parseEndpoint(std::string_view text, unsigned char* address, uint16_t& port) {
+    size_t colon = text.find(':');
+    if (colon != 8 && colon != 32) {
+        return false;
+    }
+    for (size_t word = 0; word < colon / 8; ++word) {
+        uint64_t value;
+        if (!parseHex(text.substr(word * 8, 8), value)) {
+            return false;
+        }
+        uint32_t bytes = static_cast<uint32_t>(value);
+        std::memcpy(address + word * 4, &bytes, 4);
+    }
+    uint64_t value;
+    if (!parseHex(text.substr(colon + 1), value) || value > 0xFFFF) {
+        return false;
+    }
+    port = static_cast<uint16_t>(value);
+    return true;
+}
+
+//"socket:[12345]" -> 12345; prefix - длина "socket:["
+uint64_t parseInode(std::string_view target, size_t prefix) {
+    uint64_t inode = 0;
+    size_t end = target.find(']', prefix);
+    if (end == std::string_view::npos || !parseDecimal(target.substr(prefix, end - prefix), inode)) {
+        return 0;
+    }
+    return inode;
+}
+
+#endif
+
+//Группировка подсчетом по плотному ключу: элементы с ключом k - order[first[k]..first[k + 1])
+void groupByKey(const std::vector<uint32_t>& keys, size_t keyCount, std::vector<uint32_t>& first,
+                std::vector<uint32_t>& order) {
+    first.assign(keyCount + 1, 0);
+    for (uint32_t key : keys) {
+        ++first[key + 1];
+    }
+    for (size_t key = 0; key < keyCount; ++key) {
+        first[key + 1] += first[key];
+    }
+    //first[k] служит курсором вставки и после раскладки указывает на начало k + 1
+    order.resize(keys.size());
+    for (size_t item = 0; item < keys.size(); ++item) {
+        order[first[keys[item]]++] = static_cast<uint32_t>(item);
+    }
+    for (size_t key = keyCount; key > 0; --key) {
+        first[key] = first[key - 1];
+    }
+    first[0] = 0;
+}
+
+} // namespace
+
+FdInventory::FdInventory() = default;
+
+FdInventory::~FdInventory() = default;
+
+#ifndef _WIN32
+
+size_t FdInventory::scan(const ProcessTable& table) {
+    if (!m_reader) {
+        m_reader.reset(new ProcFsReader());
+    }
+    return scan(*m_reader, table);
+}
+
+size_t FdInventory::findPrevious(DWORD pid, size_t& cursor) const {
+    if (cursor > 0 && m_previous[cursor - 1].pid >= pid) {
+        //PID пришли не по порядку - бинарный поиск по всему прошлому скану
+        cursor = static_cast<size_t>(std::lower_bound(m_previous.begin(), m_previous.end(), pid,
+            [](const Process& process, DWORD value) { return process.pid < value; }) - m_previous.begin());
+    } else {
+        while (cursor < m_previous.size() && m_previous[cursor].pid < pid) {
+            ++cursor;
+        }
+    }
+    if (cursor == m_previous.size() || m_previous[cursor].pid != pid) {
+        return m_previous.size();
+    }
+    return cursor++;
+}
+
+size_t FdInventory::scan(ProcFsReader& reader, const ProcessTable& table) {
+    MetricTimer timer(scanDuration);
+    ++m_scans;
+    if (!m_countsChecked) {
+        //Свои дескрипторы есть всегда (хотя бы корень reader'а): 0 - ядро не сообщает их число
+        uint32_t own = 0;
+        m_countsSupported = reader.readFdCount(static_cast<DWORD>(::getpid()), own) && own > 0;
+        m_countsChecked = true;
+    }
+
+    m_previous.swap(m_current);
+    m_current.clear();
+    m_rescanned = 0;
+    m_denied = 0;
+    size_t cursor = 0;
+    const std::vector<DWORD>& pids = table.pids();
+    for (size_t row = 0; row < table.size(); ++row) {
+        DWORD pid = pids[row];
+        //Число читается до каталога: изменение между ними заметит следующий скан
+        uint32_t count = 0;
+        if (!reader.readFdCount(pid, count)) {
+            continue; //завершился после скана таблицы
+        }
+        size_t index = findPrevious(pid, cursor);
+        if (index < m_previous.size() && m_previous[index].startTime == table.startTimes()[row]) {
+            m_current.push_back(std::move(m_previous[index]));
+        } else {
+            //Новый процесс или PID переиспользован
+            m_current.emplace_back();
+            m_current.back().pid = pid;
+            m_current.back().startTime = table.startTimes()[row];
+        }
+        Process& process = m_current.back();
+        process.name = table.strings().get(table.nameIds()[row]);
+        bool due = process.scanned == 0 || !m_countsSupported || count != process.fdCount ||
+                   (m_rescanEvery != 0 && m_scans - process.scanned >= m_rescanEvery);
+        process.fdCount = count;
+        if (due) {
+            readFds(reader, process);
+            process.scanned = m_scans;
+            ++m_rescanned;
+        }
+        if (process.denied) {
+            ++m_denied;
+        }
+    }
+    if (!std::is_sorted(m_current.begin(), m_current.end(),
+                        [](const Process& a, const Process& b) { return a.pid < b.pid; })) {
+        std::sort(m_current.begin(), m_current.end(), [](const Process& a, const Process& b) { return a.pid < b.pid; });
+    }
+
+    compactPaths();
+    readSockets(reader);
+    buildIndexes();
+    openDescriptors.set(static_cast<int64_t>(m_holders.size()));
+    return m_holders.size();
+}
+
+void FdInventory::readFds(ProcFsReader& reader, Process& process) {
+    fdDirectoryReads.add();
+    process.fds.clear();
+    //false и у процесса, завершившегося между stat и чтением каталога: следующий скан его уже не увидит
+    process.denied = !reader.forEachFd(process.pid, [this, &process](uint32_t number, std::string_view target) {
+        Fd fd;
+        fd.fd = number;
+        if (target.compare(0, 8, "socket:[") == 0) {
+            fd.kind = Type::Socket;
+            fd.inode = parseInode(target, 8);
+        } else if (target.compare(0, 6, "pipe:[") == 0) {
+            fd.kind = Type::Pipe;
+            fd.inode = parseInode(target, 6);
+        } else {
+            //Удаленный файл остается с суффиксом " (deleted)", как его показывает ядро
+            fd.kind = target[0] == '/' ? Type::File : Type::Other;
+            fd.target = m_paths.intern(target);
+        }
+        process.fds.push_back(fd);
+    });
+    if (!std::is_sorted(process.fds.begin(), process.fds.end(), [](const Fd& a, const Fd& b) { return a.fd < b.fd; })) {
+        std::sort(process.fds.begin(), process.fds.end(), [](const Fd& a, const Fd& b) { return a.fd < b.fd; });
+    }
+}
+
+void FdInventory::readSockets(ProcFsReader& reader) {
+    MetricTimer timer(socketTableDuration);
+    m_sockets.clear();
+    m_socketIndex.clear();
+    static const struct {
+        const char* name;
+        Type type;
+        bool ipv6;
+    } tables[] = {
+        {"net/tcp", Type::Tcp, false},
+        {"net/tcp6", Type::Tcp, true},
+        {"net/udp", Type::Udp, false},
+        {"net/udp6", Type::Udp, true},
+    };
+    //Таблицы отсутствуют, если протокол не собран в ядре (например, без IPv6)
+    for (const auto& table : tables) {
+        if (reader.readFile(table.name, m_buffer)) {
+            parseInet(m_buffer, table.type, table.ipv6);
+        }
+    }
+    if (reader.readFile("net/unix", m_buffer)) {
+        parseUnix(m_buffer);
+    }
+}
+
+void FdInventory::parseInet(std::string_view text, Type type, bool ipv6) {
+/*
+   sl  local_address rem_address   st tx_queue rx_queue tr tm->when retrnsmt   uid  timeout inode
+    0: 0100007F:0CEA 00000000:0000 0A 00000000:00000000 00:00000000 00000000  1000        0 12345 ...
+Первая строка - заголовок.
+*/
+    size_t end = text.find('\n');
+    while (end != std::string_view::npos && end + 1 < text.size()) {
+        size_t start = end + 1;
+        end = text.find('\n', start);
+        std::string_view line = text.substr(start, end == std::string_view::npos ? std::string_view::npos : end - start);
+
+        Socket socket;
+        socket.type = type;
+        socket.ipv6 = ipv6;
+        size_t pos = 0;
+        uint64_t state;
+        uint64_t inode;
+        nextField(line, pos); //sl
+        if (!parseEndpoint(nextField(line, pos), socket.local, socket.localPort) ||
+            !parseEndpoint(nextField(line, pos), socket.remote, socket.remotePort) ||
+            !parseHex(nextField(line, pos), state)) {
+            continue;
+        }
+        //tx_queue:rx_queue, tr:when, retrnsmt, uid, timeout
+        for (int field = 0; field < 5; ++field) {
+            nextField(line, pos);
+        }
+        //inode 0 - у TIME_WAIT и прочих сокетов без дескриптора: держателей нет
+        if (!parseDecimal(nextField(line, pos), inode) || inode == 0) {
+            continue;
+        }
+        socket.inode = inode;
+        socket.state = static_cast<uint8_t>(state);
+        if (m_socketIndex.emplace(inode, static_cast<uint32_t>(m_sockets.size())).second) {
+            m_sockets.push_back(socket);
+        }
+    }
+}
+
+void FdInventory::parseUnix(std::string_view text) {
+/*
+Num       RefCount Protocol Flags    Type St Inode Path
+0000000000000000: 00000002 00000000 00010000 0001 01 23456 /run/daemon.sock
+Путь отсутствует у неименованных сокетов, у абстрактных начинается с '@'.
+*/
+    size_t end = text.find('\n');
+    while (end != std::string_view::npos && end + 1 < text.size()) {
+        size_t start = end + 1;
+        end = text.find('\n', start);
+        std::string_view line = text.substr(start, end == std::string_view::npos ? std::string_view::npos : end - start);
+
+        size_t pos = 0;
+        uint64_t flags;
+        uint64_t state;
+        uint64_t inode;
+        nextField(line, pos); //Num
+        nextField(line, pos); //RefCount
+        nextField(line, pos); //Protocol
+        if (!parseHex(nextField(line, pos), flags)) {
+            continue;
+        }
+        nextField(line, pos); //Type
+        if (!parseHex(nextField(line, pos), state) || !parseDecimal(nextField(line, pos), inode) || inode == 0) {
+            continue;
+        }
+        while (pos < line.size() && line[pos] == ' ') {
+            ++pos;
+        }
+        Socket socket;
+        socket.type = Type::Unix;
+        socket.inode = inode;
+        socket.state = (flags & UNIX_ACCEPTCON) != 0 ? TCP_LISTEN : static_cast<uint8_t>(state);
+        socket.path = m_paths.intern(line.substr(pos));
+        if (m_socketIndex.emplace(inode, static_cast<uint32_t>(m_sockets.size())).second) {
+            m_sockets.push_back(socket);
+        }
+    }
+}
+
+#else
+
+size_t FdInventory::scan(const ProcessTable&) {
+    //Нет /proc: инвентарь пуст
+    m_current.clear();
+    m_sockets.clear();
+    m_socketIndex.clear();
+    buildIndexes();
+    return 0;
+}
+
+#endif
+
+void FdInventory::copyFrom(const FdInventory& other) {
+    //Состояние инкрементального скана (m_previous, счетчики, reader) копии не нужно
+    m_current = other.m_current;
+    m_paths.assign(other.m_paths);
+    m_sockets = other.m_sockets;
+    m_socketIndex = other.m_socketIndex;
+    m_holders = other.m_holders;
+    m_inodeOrder = other.m_inodeOrder;
+    m_byInode = other.m_byInode;
+    m_pathFirst = other.m_pathFirst;
+    m_pathOrder = other.m_pathOrder;
+    m_portFirst = other.m_portFirst;
+    m_portOrder = other.m_portOrder;
+    m_unixFirst = other.m_unixFirst;
+    m_unixOrder = other.m_unixOrder;
+    m_rescanned = other.m_rescanned;
+    m_denied = other.m_denied;
+    m_countsSupported = other.m_countsSupported;
+}
+
+void FdInventory::compactPaths() {
+    //Цели дескрипторов меняются (временные файлы): как в ProcessTable, арену
+    //пересобираем, когда мертвых строк стало много больше живых дескрипторов
+    size_t live = 0;
+    for (const Process& process : m_current) {
+        live += process.fds.size();
+    }
+    if (m_paths.size() <= 4096 || m_paths.size() <= 4 * live) {
+        return;
+    }
+    StringArena fresh;
+    for (Process& process : m_current) {
+        for (Fd& fd : process.fds) {
+            fd.target = fresh.intern(m_paths.get(fd.target));
+        }
+    }
+    //Пути unix-сокетов разбираются заново каждый скан - их переписывать не нужно
+    m_paths = std::move(fresh);
+}
+
+void FdInventory::buildIndexes() {
+    m_holders.clear();
+    for (size_t process = 0; process < m_current.size(); ++process) {
+        for (size_t index = 0; index < m_current[process].fds.size(); ++index) {
+            m_holders.push_back(Holder{static_cast<uint32_t>(process), static_cast<uint32_t>(index)});
+        }
+    }
+
+    //Путь: у сокетов и каналов цели нет (EMPTY) - они уходят в группу 0, которую поиск не спрашивает
+    m_keys.resize(m_holders.size());
+    for (size_t holder = 0; holder < m_holders.size(); ++holder) {
+        m_keys[holder] = fd(m_holders[holder]).target;
+    }
+    groupByKey(m_keys, m_paths.size(), m_pathFirst, m_pathOrder);
+
+    //inode: ключи разреженные - сортировка и хеш-таблица диапазонов
+    m_inodeOrder.clear();
+    for (size_t holder = 0; holder < m_holders.size(); ++holder) {
+        if (fd(m_holders[holder]).inode != 0) {
+            m_inodeOrder.push_back(static_cast<uint32_t>(holder));
+        }
+    }
+    std::sort(m_inodeOrder.begin(), m_inodeOrder.end(), [this](uint32_t a, uint32_t b) {
+        uint64_t inodeA = fd(m_holders[a]).inode;
+        uint64_t inodeB = fd(m_holders[b]).inode;
+        return inodeA != inodeB ? inodeA < inodeB : a < b;
+    });
+    m_byInode.clear();
+    for (size_t first = 0; first < m_inodeOrder.size();) {
+        uint64_t inode = fd(m_holders[m_inodeOrder[first]]).inode;
+        size_t last = first + 1;
+        while (last < m_inodeOrder.size() && fd(m_holders[m_inodeOrder[last]]).inode == inode) {
+            ++last;
+        }
+        m_byInode.emplace(inode, std::make_pair(static_cast<uint32_t>(first), static_cast<uint32_t>(last)));
+        first = last;
+    }
+
+    //Порт: unix-сокеты - в группу 0 (порт 0 поиск не спрашивает)
+    m_keys.resize(m_sockets.size());
+    for (size_t socket = 0; socket < m_sockets.size(); ++socket) {
+        m_keys[socket] = m_sockets[socket].type == Type::Unix ? 0 : m_sockets[socket].localPort;
+    }
+    groupByKey(m_keys, 65536, m_portFirst, m_portOrder);
+
+    for (size_t socket = 0; socket < m_sockets.size(); ++socket) {
+        m_keys[socket] = m_sockets[socket].path;
+    }
+    groupByKey(m_keys, m_paths.size(), m_unixFirst, m_unixOrder);
+}
+
+const FdInventory::Process* FdInventory::findProcess(DWORD pid) const {
+    auto it = std::lower_bound(m_current.begin(), m_current.end(), pid,
+        [](const Process& process, DWORD value) { return process.pid < value; });
+    return it != m_current.end() && it->pid == pid ? &*it : nullptr;
+}
+
+const FdInventory::Socket* FdInventory::findSocket(uint64_t inode) const {
+    auto it = m_socketIndex.find(inode);
+    return it != m_socketIndex.end() ? &m_sockets[it->second] : nullptr;
+}
+
+FdInventory::Type FdInventory::type(const Fd& fd) const {
+    if (fd.kind != Type::Socket) {
+        return fd.kind;
+    }
+    const Socket* socket = findSocket(fd.inode);
+    return socket ? socket->type : Type::Socket;
+}
+
+size_t FdInventory::findByInode(uint64_t inode, std::vector<Holder>& out) const {
+    auto it = m_byInode.find(inode);
+    if (it == m_byInode.end()) {
+        return 0;
+    }
+    for (uint32_t i = it->second.first; i < it->second.second; ++i) {
+        out.push_back(m_holders[m_inodeOrder[i]]);
+    }
+    return it->second.second - it->second.first;
+}
+
+size_t FdInventory::findByPort(uint16_t port, std::vector<Holder>& out) const {
+    if (port == 0 || m_portFirst.empty()) {
+        return 0;
+    }
+    size_t found = 0;
+    for (uint32_t i = m_portFirst[port]; i < m_portFirst[port + 1]; ++i) {
+        found += findByInode(m_sockets[m_portOrder[i]].inode, out);
+    }
+    return found;
+}
+
+size_t FdInventory::findByPath(std::string_view path, std::vector<Holder>& out) const {
+    StringArena::Handle handle = m_paths.find(path);
+    //Строки, интернированные после последнего скана, в индексах еще не участвуют
+    if (handle == StringArena::EMPTY || handle + 1 >= m_pathFirst.size()) {
+        return 0;
+    }
+    size_t found = m_pathFirst[handle + 1] - m_pathFirst[handle];
+    for (uint32_t i = m_pathFirst[handle]; i < m_pathFirst[handle + 1]; ++i) {
+        out.push_back(m_holders[m_pathOrder[i]]);
+    }
+    for (uint32_t i = m_unixFirst[handle]; i < m_unixFirst[handle + 1]; ++i) {
+        found += findByInode(m_sockets[m_unixOrder[i]].inode, out);
+    }
+    return found;
+}
+
+const char* FdInventory::typeName(Type type) {
+    switch (type) {
+    case Type::File: return "file";
+    case Type::Tcp: return "tcp";
+    case Type::Udp: return "udp";
+    case Type::Unix: return "unix";
+    case Type::Socket: return "socket";
+    case Type::Pipe: return "pipe";
+    case Type::Other: return "other";
+    }
+    return "other";
+}
+
+const char* FdInventory::stateName(const Socket& socket) {
+    if (socket.type == Type::Unix) {
+        switch (socket.state) {
+        case 1: return "UNCONNECTED";
+        case 2: return "CONNECTING";
+        case 3: return "CONNECTED";
+        case 4: return "DISCONNECTING";
+        case TCP_LISTEN: return "LISTEN";
+        default: return "UNKNOWN";
+        }
+    }
+    if (socket.type == Type::Udp) {
+        //У UDP только "связан с адресатом" или нет
+        return socket.state == TCP_ESTABLISHED ? "ESTABLISHED" : socket.state == TCP_CLOSE ? "UNCONN" : "UNKNOWN";
+    }
+    static const char* const names[] = {
+        "UNKNOWN", "ESTABLISHED", "SYN_SENT", "SYN_RECV", "FIN_WAIT1", "FIN_WAIT2", "TIME_WAIT",
+        "CLOSE", "CLOSE_WAIT", "LAST_ACK", "LISTEN", "CLOSING", "NEW_SYN_RECV"
+    };
+    return socket.state < sizeof(names) / sizeof(names[0]) ? names[socket.state] : "UNKNOWN";
+}
+
+size_t FdInventory::formatAddress(const Socket& socket, bool remote, char* buffer, size_t size) {
+    const unsigned char* a = remote ? socket.remote : socket.local;
+    unsigned port = remote ? socket.remotePort : socket.localPort;
+    int length;
+    static const unsigned char mapped[12] = {0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0xFF, 0xFF};
+    if (!socket.ipv6) {
+        length = std::snprintf(buffer, size, "%u.%u.%u.%u:%u", a[0], a[1], a[2], a[3], port);
+    } else if (std::memcmp(a, mapped, sizeof(mapped)) == 0) {
+        //Двухстековый сокет: IPv4-адрес в IPv6-таблице
+        length = std::snprintf(buffer, size, "[::ffff:%u.%u.%u.%u]:%u", a[12], a[13], a[14], a[15], port);
+    } else {
+        //RFC 5952: группы без ведущих нулей, самая длинная серия нулевых групп (от двух) - "::"
+        unsigned groups[8];
+        for (size_t i = 0; i < 8; ++i) {
+            groups[i] = static_cast<unsigned>(a[i * 2]) << 8 | a[i * 2 + 1];
+        }
+        size_t bestStart = 8;
+        size_t bestLength = 1;
+        for (size_t i = 0; i < 8;) {
+            size_t j = i;
+            while (j < 8 && groups[j] == 0) {
+                ++j;
+            }
+            if (j - i > bestLength) {
+                bestStart = i;
+                bestLength = j - i;
+            }
+            i = j == i ? i + 1 : j;
+        }
+        char text[48];
+        size_t used = 0;
+        for (size_t i = 0; i < 8; ++i) {
+            if (i == bestStart) {
+                text[used++] = ':';
+                text[used++] = ':';
+                i += bestLength - 1;
+                continue;
+            }
+            if (used > 0 && text[used - 1] != ':') {
+                text[used++] = ':';
+            }
+            used += static_cast<size_t>(std::snprintf(text + used, sizeof(text) - used, "%x", groups[i]));
+        }
+        text[used] = '\0';
+        length = std::snprintf(buffer, size, "[%s]:%u", text, port);
+    }
+    if (length < 0) {
+        return 0;
+    }
+    return std::min(static_cast<size_t>(length), size > 0 ? size - 1 : 0);
+}
@@ -0,0 +1,173 @@
+// FdInventory.h
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+#include "ProcessInfo.h" //DWORD
+#include "StringArena.h"
+
+#ifndef _WIN32
+class ProcFsReader;
+#endif
+
+class ProcessTable;
+
+/*
+Открытые файлы и сокеты процессов - ответ на вопрос "кто держит этот файл или порт"
+без lsof. Скан идет по процессам таблицы:
+- /proc/net/{tcp,tcp6,udp,udp6,unix} разбираются один раз за скан в таблицу
+  сокетов по inode; дескриптор "socket:[N]" соединяется с ней по inode, а не
+  разбором таблиц для каждого процесса
+- каталог /proc/<pid>/fd (readlink каждого дескриптора) перечитывается только у
+  новых процессов и у тех, чье число дескрипторов изменилось. Число берется из
+  st_size каталога fd (ядро 6.2+) - это один stat без чтения каталога. Замена
+  дескриптора без изменения числа видна через rescanEvery сканов; на старых
+  ядрах (st_size = 0) каталоги перечитываются каждый скан
+- после скана строятся обратные индексы: inode -> держатели (хеш-таблица),
+  локальный порт -> сокеты и путь -> держатели (плотные массивы по порту и
+  handle'у арены путей). Поиск - одно обращение к индексу плюс размер ответа
+Таблицы сокетов - из сетевого пространства имен самого монитора: сокеты
+процессов в других пространствах остаются типа Socket без адресов.
+Без CAP_SYS_PTRACE каталоги fd чужих процессов не читаются - такие процессы
+помечаются denied и остаются без дескрипторов.
+Записи процессов хранятся по возрастанию PID и переходят между сканами
+курсором, как в RefreshScheduler. Windows - scan() ничего не находит.
+Объект не потокобезопасен: сканирует один поток, читателям публикуется
+копия (copyFrom), как копия ProcessTable в SnapshotCache.
+*/
+class FdInventory {
+public:
+    enum class Type : uint8_t { File, Tcp, Udp, Unix, Socket, Pipe, Other };
+
+    struct Fd {
+        uint32_t fd = 0;
+        Type kind = Type::Other; //File, Socket, Pipe или Other; протокол сокета - type()
+        uint64_t inode = 0;      //сокеты и каналы
+        StringArena::Handle target = StringArena::EMPTY; //File и Other: цель ссылки
+    };
+
+    struct Process {
+        DWORD pid = 0;
+        uint64_t startTime = 0;
+        std::string name;
+        uint32_t fdCount = 0;   //st_size каталога fd при последнем скане
+        uint64_t scanned = 0;   //номер скана, в котором каталог читался; 0 - еще не читался
+        bool denied = false;
+        std::vector<Fd> fds;    //по возрастанию номера дескриптора
+    };
+
+    struct Socket {
+        uint64_t inode = 0;
+        Type type = Type::Tcp;  //Tcp, Udp или Unix
+        bool ipv6 = false;
+        uint8_t state = 0;      //TCP_* из /proc/net; у слушающих unix-сокетов тоже LISTEN
+        uint16_t localPort = 0;
+        uint16_t remotePort = 0;
+        unsigned char local[16] = {};  //сетевой порядок байт; IPv4 - первые 4
+        unsigned char remote[16] = {};
+        StringArena::Handle path = StringArena::EMPTY; //Unix: путь или "@имя" абстрактного сокета
+    };
+
+    //Дескриптор процесса: processes()[process].fds[index]
+    struct Holder {
+        uint32_t process;
+        uint32_t index;
+    };
+
+    static const uint32_t DEFAULT_RESCAN_EVERY = 30;
+
+    FdInventory();
+    ~FdInventory();
+
+    FdInventory(const FdInventory&) = delete;
+    FdInventory& operator=(const FdInventory&) = delete;
+
+    //Полная проверка каждого процесса раз в rescanEvery сканов (0 - только по изменению числа)
+    void setRescanEvery(uint32_t scans) { m_rescanEvery = scans; }
+
+    //Скан по процессам таблицы (pid, время старта и имя берутся из нее); возвращает число дескрипторов
+    size_t scan(const ProcessTable& table);
+#ifndef _WIN32
+    size_t scan(ProcFsReader& reader, const ProcessTable& table);
+#endif
+
+    //Неизменяемая копия последнего скана (для чтения в других потоках, пока этот объект сканирует дальше)
+    void copyFrom(const FdInventory& other);
+
+    const std::vector<Process>& processes() const { return m_current; }
+    //Процесс по pid (двоичный поиск); nullptr - не найден
+    const Process* findProcess(DWORD pid) const;
+    const Fd& fd(const Holder& holder) const { return m_current[holder.process].fds[holder.index]; }
+    //Сокет по inode из таблиц последнего скана; nullptr - не сокет или чужое пространство имен
+    const Socket* findSocket(uint64_t inode) const;
+    //Тип с учетом протокола сокета
+    Type type(const Fd& fd) const;
+    const std::string& string(StringArena::Handle handle) const { return m_paths.get(handle); }
+
+    //Обратные индексы: держатели дописываются в out, возвращается их число
+    size_t findByInode(uint64_t inode, std::vector<Holder>& out) const;
+    //Сокеты TCP/UDP (IPv4 и IPv6) с этим локальным портом
+    size_t findByPort(uint16_t port, std::vector<Holder>& out) const;
+    //Открытый файл или unix-сокет с этим путем
+    size_t findByPath(std::string_view path, std::vector<Holder>& out) const;
+
+    //Статистика последнего скана
+    size_t fdCount() const { return m_holders.size(); }
+    size_t socketCount() const { return m_sockets.size(); }
+    size_t rescanned() const { return m_rescanned; }
+    size_t denied() const { return m_denied; }
+    //false - ядро не сообщает число дескрипторов (до 6.2), каталоги перечитываются каждый скан
+    bool countsSupported() const { return m_countsSupported; }
+
+    static const char* typeName(Type type);
+    //Имя состояния сокета ("LISTEN", "ESTABLISHED", ...)
+    static const char* stateName(const Socket& socket);
+    //"127.0.0.1:80" или "[::1]:80" в buffer; возвращает длину
+    static size_t formatAddress(const Socket& socket, bool remote, char* buffer, size_t size);
+
+private:
+#ifndef _WIN32
+    size_t findPrevious(DWORD pid, size_t& cursor) const;
+    void readFds(ProcFsReader& reader, Process& process);
+    void readSockets(ProcFsReader& reader);
+    void parseInet(std::string_view text, Type type, bool ipv6);
+    void parseUnix(std::string_view text);
+#endif
+    void compactPaths();
+    void buildIndexes();
+
+    uint32_t m_rescanEvery = DEFAULT_RESCAN_EVERY;
+    uint64_t m_scans = 0;
+    std::vector<Process> m_previous;
+    std::vector<Process> m_current;
+    StringArena m_paths; //цели дескрипторов и пути unix-сокетов
+
+    std::vector<Socket> m_sockets;
+    std::unordered_map<uint64_t, uint32_t> m_socketIndex; //inode -> m_sockets
+
+    //Индексы; *First[key]..*First[key + 1] - диапазон в соответствующем *Order
+    std::vector<Holder> m_holders;     //все дескрипторы скана
+    std::vector<uint32_t> m_inodeOrder; //m_holders с inode, по возрастанию inode
+    std::unordered_map<uint64_t, std::pair<uint32_t, uint32_t>> m_byInode; //inode -> [first, last) в m_inodeOrder
+    std::vector<uint32_t> m_pathFirst;  //по handle'у цели
+    std::vector<uint32_t> m_pathOrder;  //m_holders
+    std::vector<uint32_t> m_portFirst;  //по локальному порту, 65537 элементов
+    std::vector<uint32_t> m_portOrder;  //m_sockets
+    std::vector<uint32_t> m_unixFirst;  //по handle'у пути unix-сокета
+    std::vector<uint32_t> m_unixOrder;  //m_sockets
+    std::vector<uint32_t> m_keys;       //ключи группировки (рабочий буфер)
+
+    size_t m_rescanned = 0;
+    size_t m_denied = 0;
+    bool m_countsChecked = false;
+    bool m_countsSupported = true;
+    std::string m_buffer; //содержимое таблицы сокетов
+
+#ifndef _WIN32
+    std::unique_ptr<ProcFsReader> m_reader; //открывается при первом scan()
+#endif
+};
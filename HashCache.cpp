@@ -0,0 +1,341 @@
+#include "HashCache.h"
+#include <cstring>
+#include <iostream>
+#ifndef _WIN32
+#include <ctime>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+//Формат файла: Header, затем capacity записей Entry
+struct HashCache::Header {
+    char magic[8];
+    uint32_t version;
+    uint32_t entrySize;
+    uint64_t capacity;
+    uint64_t checksum;
+    char reserved[32];
+};
+
+struct HashCache::Entry {
+    uint64_t device;
+    uint64_t inode;
+    uint64_t size;
+    uint64_t mtimeNs;
+    uint64_t ctimeNs;
+    unsigned char digest[DIGEST_SIZE];
+    uint64_t check; //0 - пустой слот, иначе контрольная сумма полей выше
+};
+
+namespace {
+
+const char CACHE_MAGIC[8] = {'P', 'M', 'H', 'A', 'S', 'H', 'C', '1'};
+const uint32_t CACHE_VERSION = 1;
+const size_t PROBE_LIMIT = 16;                      //окно линейного пробирования
+const uint64_t STABLE_AGE_NS = 2ULL * 1000000000ULL; //"только что измененный" файл
+
+uint64_t mix(uint64_t h, uint64_t value) {
+    h ^= value + 0x9e3779b97f4a7c15ULL + (h << 6) + (h >> 2);
+    h ^= h >> 31;
+    h *= 0xbf58476d1ce4e5b9ULL;
+    return h ^ (h >> 29);
+}
+
+uint64_t headerChecksum(uint64_t capacity) {
+    return mix(mix(CACHE_VERSION, capacity), 0x4841534843414348ULL);
+}
+
+uint64_t entryChecksum(const FileIdentity& identity, const unsigned char* digest) {
+    uint64_t h = mix(0, identity.device);
+    h = mix(h, identity.inode);
+    h = mix(h, identity.size);
+    h = mix(h, identity.mtimeNs);
+    h = mix(h, identity.ctimeNs);
+    for (size_t i = 0; i < HashCache::DIGEST_SIZE; i += 8) {
+        uint64_t word;
+        std::memcpy(&word, digest + i, sizeof(word));
+        h = mix(h, word);
+    }
+    return h | 1; //никогда не 0: 0 означает пустой слот
+}
+
+uint64_t nowNs() {
+#ifdef _WIN32
+    FILETIME now;
+    GetSystemTimeAsFileTime(&now);
+    return ((static_cast<uint64_t>(now.dwHighDateTime) << 32) | now.dwLowDateTime) * 100;
+#else
+    timespec now;
+    clock_gettime(CLOCK_REALTIME, &now);
+    return static_cast<uint64_t>(now.tv_sec) * 1000000000ULL + static_cast<uint64_t>(now.tv_nsec);
+#endif
+}
+
+} // namespace
+
+HashCache::~HashCache() {
+    close();
+}
+
+bool HashCache::isOpen() const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_entries != nullptr;
+}
+
+bool HashCache::open(const std::string& path, size_t capacity) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    unmapFile();
+    if (capacity == 0) {
+        return false;
+    }
+
+    size_t bytes = sizeof(Header) + capacity * sizeof(Entry);
+    bool created = false;
+    if (!mapFile(path, bytes, created)) {
+        unmapFile();
+        return false;
+    }
+
+    bool valid = !created
+        && std::memcmp(m_header->magic, CACHE_MAGIC, sizeof(CACHE_MAGIC)) == 0
+        && m_header->version == CACHE_VERSION
+        && m_header->entrySize == sizeof(Entry)
+        && m_header->capacity == capacity
+        && m_header->checksum == headerChecksum(capacity);
+    if (!valid) {
+        //Новый или несовместимый файл - начинаем с пустой таблицы
+        std::memset(static_cast<void*>(m_header), 0, bytes);
+        std::memcpy(m_header->magic, CACHE_MAGIC, sizeof(CACHE_MAGIC));
+        m_header->version = CACHE_VERSION;
+        m_header->entrySize = sizeof(Entry);
+        m_header->capacity = capacity;
+        m_header->checksum = headerChecksum(capacity);
+    }
+
+    m_entries = reinterpret_cast<Entry*>(reinterpret_cast<char*>(m_header) + sizeof(Header));
+    m_capacity = capacity;
+    m_hits.store(0);
+    m_misses.store(0);
+    return true;
+}
+
+void HashCache::close() {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    unmapFile();
+}
+
+HashCache::Entry* HashCache::findSlot(const FileIdentity& identity, bool forInsert) {
+    size_t home = static_cast<size_t>(mix(identity.device, identity.inode) % m_capacity);
+    Entry* empty = nullptr;
+
+    for (size_t probe = 0; probe < PROBE_LIMIT && probe < m_capacity; ++probe) {
+        Entry* entry = &m_entries[(home + probe) % m_capacity];
+        if (entry->check == 0) {
+            if (!empty) {
+                empty = entry;
+            }
+            continue; //слот мог освободиться после оборванной записи - ищем дальше
+        }
+        if (entry->device == identity.device && entry->inode == identity.inode) {
+            return entry; //тот же файл: актуальная или устаревшая запись
+        }
+    }
+    if (!forInsert) {
+        return nullptr;
+    }
+    return empty ? empty : &m_entries[home];
+}
+
+bool HashCache::lookup(const FileIdentity& identity, unsigned char digest[DIGEST_SIZE]) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (!m_entries) {
+        return false;
+    }
+
+    Entry* entry = findSlot(identity, false);
+    if (!entry) {
+        m_misses.fetch_add(1);
+        return false;
+    }
+    FileIdentity cached;
+    cached.device = entry->device;
+    cached.inode = entry->inode;
+    cached.size = entry->size;
+    cached.mtimeNs = entry->mtimeNs;
+    cached.ctimeNs = entry->ctimeNs;
+    //Файл изменился или запись повреждена
+    if (cached != identity || entry->check != entryChecksum(identity, entry->digest)) {
+        m_misses.fetch_add(1);
+        return false;
+    }
+
+    std::memcpy(digest, entry->digest, DIGEST_SIZE);
+    m_hits.fetch_add(1);
+    return true;
+}
+
+void HashCache::store(const FileIdentity& identity, const unsigned char digest[DIGEST_SIZE]) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (!m_entries || !isStable(identity)) {
+        return;
+    }
+
+    Entry* entry = findSlot(identity, true);
+    //Сначала помечаем слот пустым: если процесс упадет посреди записи, мусор не будет прочитан
+    entry->check = 0;
+    entry->device = identity.device;
+    entry->inode = identity.inode;
+    entry->size = identity.size;
+    entry->mtimeNs = identity.mtimeNs;
+    entry->ctimeNs = identity.ctimeNs;
+    std::memcpy(entry->digest, digest, DIGEST_SIZE);
+    entry->check = entryChecksum(identity, digest);
+}
+
+bool HashCache::isStable(const FileIdentity& identity) {
+    uint64_t changed = identity.mtimeNs > identity.ctimeNs ? identity.mtimeNs : identity.ctimeNs;
+    uint64_t now = nowNs();
+    return now > changed && now - changed >= STABLE_AGE_NS;
+}
+
+#ifndef _WIN32
+
+bool HashCache::identityOf(int fd, FileIdentity& identity) {
+    struct stat info;
+    if (::fstat(fd, &info) != 0 || !S_ISREG(info.st_mode)) {
+        return false;
+    }
+    identity.device = static_cast<uint64_t>(info.st_dev);
+    identity.inode = static_cast<uint64_t>(info.st_ino);
+    identity.size = static_cast<uint64_t>(info.st_size);
+    identity.mtimeNs = static_cast<uint64_t>(info.st_mtim.tv_sec) * 1000000000ULL + static_cast<uint64_t>(info.st_mtim.tv_nsec);
+    identity.ctimeNs = static_cast<uint64_t>(info.st_ctim.tv_sec) * 1000000000ULL + static_cast<uint64_t>(info.st_ctim.tv_nsec);
+    return true;
+}
+
+bool HashCache::mapFile(const std::string& path, size_t bytes, bool& created) {
+    m_fd = ::open(path.c_str(), O_RDWR | O_CREAT | O_CLOEXEC, 0600);
+    if (m_fd < 0) {
+        std::cerr << "Cannot open hash cache: " << path << std::endl;
+        return false;
+    }
+    //Один процесс-писатель на файл кеша
+    if (::flock(m_fd, LOCK_EX | LOCK_NB) != 0) {
+        std::cerr << "Hash cache is in use by another process: " << path << std::endl;
+        return false;
+    }
+
+    struct stat info;
+    if (::fstat(m_fd, &info) != 0) {
+        return false;
+    }
+    if (static_cast<size_t>(info.st_size) != bytes) {
+        if (::ftruncate(m_fd, 0) != 0 || ::ftruncate(m_fd, static_cast<off_t>(bytes)) != 0) {
+            std::cerr << "Cannot resize hash cache: " << path << std::endl;
+            return false;
+        }
+        created = true;
+    }
+
+    void* data = ::mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_SHARED, m_fd, 0);
+    if (data == MAP_FAILED) {
+        std::cerr << "Cannot map hash cache: " << path << std::endl;
+        return false;
+    }
+    m_header = static_cast<Header*>(data);
+    m_mappedBytes = bytes;
+    return true;
+}
+
+void HashCache::unmapFile() {
+    if (m_header) {
+        ::munmap(m_header, m_mappedBytes);
+    }
+    if (m_fd >= 0) {
+        ::close(m_fd); //снимает и flock
+    }
+    m_fd = -1;
+    m_header = nullptr;
+    m_entries = nullptr;
+    m_capacity = 0;
+    m_mappedBytes = 0;
+}
+
+#else
+
+bool HashCache::identityOf(HANDLE file, FileIdentity& identity) {
+    BY_HANDLE_FILE_INFORMATION info;
+    FILE_BASIC_INFO basic;
+    if (!GetFileInformationByHandle(file, &info)
+        || !GetFileInformationByHandleEx(file, FileBasicInfo, &basic, sizeof(basic))) {
+        return false;
+    }
+    identity.device = info.dwVolumeSerialNumber;
+    identity.inode = (static_cast<uint64_t>(info.nFileIndexHigh) << 32) | info.nFileIndexLow;
+    identity.size = (static_cast<uint64_t>(info.nFileSizeHigh) << 32) | info.nFileSizeLow;
+    //FILETIME - интервалы по 100 нс
+    identity.mtimeNs = static_cast<uint64_t>(basic.LastWriteTime.QuadPart) * 100;
+    identity.ctimeNs = static_cast<uint64_t>(basic.ChangeTime.QuadPart) * 100;
+    return true;
+}
+
+bool HashCache::mapFile(const std::string& path, size_t bytes, bool& created) {
+    //dwShareMode = 0 - эксклюзивный доступ одного процесса
+    m_file = CreateFileA(path.c_str(), GENERIC_READ | GENERIC_WRITE, 0, NULL,
+                         OPEN_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (m_file == INVALID_HANDLE_VALUE) {
+        std::cerr << "Cannot open hash cache: " << path << std::endl;
+        return false;
+    }
+
+    LARGE_INTEGER size;
+    if (!GetFileSizeEx(m_file, &size)) {
+        return false;
+    }
+    if (static_cast<uint64_t>(size.QuadPart) != bytes) {
+        LARGE_INTEGER target;
+        target.QuadPart = static_cast<LONGLONG>(bytes);
+        if (!SetFilePointerEx(m_file, target, NULL, FILE_BEGIN) || !SetEndOfFile(m_file)) {
+            std::cerr << "Cannot resize hash cache: " << path << std::endl;
+            return false;
+        }
+        created = true;
+    }
+
+    m_mapping = CreateFileMappingA(m_file, NULL, PAGE_READWRITE, 0, 0, NULL);
+    if (!m_mapping) {
+        std::cerr << "Cannot map hash cache: " << path << std::endl;
+        return false;
+    }
+    void* data = MapViewOfFile(m_mapping, FILE_MAP_ALL_ACCESS, 0, 0, bytes);
+    if (!data) {
+        std::cerr << "Cannot map hash cache: " << path << std::endl;
+        return false;
+    }
+    m_header = static_cast<Header*>(data);
+    m_mappedBytes = bytes;
+    return true;
+}
+
+void HashCache::unmapFile() {
+    if (m_header) {
+        UnmapViewOfFile(m_header);
+    }
+    if (m_mapping) {
+        CloseHandle(m_mapping);
+    }
+    if (m_file != INVALID_HANDLE_VALUE) {
+        CloseHandle(m_file);
+    }
+    m_file = INVALID_HANDLE_VALUE;
+    m_mapping = NULL;
+    m_header = nullptr;
+    m_entries = nullptr;
+    m_capacity = 0;
+    m_mappedBytes = 0;
+}
+
+#endif
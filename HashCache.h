@@ -0,0 +1,92 @@
+// HashCache.h
+#pragma once
+#include <string>
+#include <mutex>
+#include <atomic>
+#include <cstdint>
+#include <cstddef>
+#include "Platform.h"
+
+//Идентичность содержимого файла: если она не изменилась, не изменился и хеш
+struct FileIdentity {
+    uint64_t device = 0;
+    uint64_t inode = 0;   //Windows: file index
+    uint64_t size = 0;
+    uint64_t mtimeNs = 0; //время изменения данных
+    uint64_t ctimeNs = 0; //время изменения метаданных (Windows: ChangeTime)
+
+    bool operator==(const FileIdentity& other) const {
+        return device == other.device && inode == other.inode && size == other.size
+            && mtimeNs == other.mtimeNs && ctimeNs == other.ctimeNs;
+    }
+    bool operator!=(const FileIdentity& other) const { return !(*this == other); }
+};
+
+/*
+Постоянный кеш хешей содержимого файлов.
+Ключ - (device, inode, size, mtime_ns, ctime_ns), значение - SHA-256.
+Данные лежат в файле, отображенном в память (mmap / MapViewOfFile), и
+переживают перезапуск. Таблица с открытой адресацией фиксированного размера;
+при переполнении окна поиска вытесняется запись в домашнем слоте.
+
+Защита от неверных попаданий:
+- любое изменение файла меняет mtime/ctime/size, и старая запись не совпадает
+- у каждой записи есть контрольная сумма: запись, оборванная падением процесса, считается пустой
+- файлы, измененные только что (в пределах гранулярности времени ФС), не кешируются
+- заголовок с magic/версией/размером проверяется при открытии, при несовпадении файл пересоздается
+Файл кеша открывается эксклюзивно одним процессом.
+*/
+class HashCache {
+public:
+    static const size_t DIGEST_SIZE = 32;
+    static const size_t DEFAULT_CAPACITY = 1 << 16;
+
+    HashCache() = default;
+    ~HashCache();
+
+    HashCache(const HashCache&) = delete;
+    HashCache& operator=(const HashCache&) = delete;
+
+    bool open(const std::string& path, size_t capacity = DEFAULT_CAPACITY);
+    void close();
+    bool isOpen() const;
+
+    bool lookup(const FileIdentity& identity, unsigned char digest[DIGEST_SIZE]);
+    void store(const FileIdentity& identity, const unsigned char digest[DIGEST_SIZE]);
+
+    //Счетчики читаются без m_mutex (метрики, статистика), поэтому атомарные
+    size_t hits() const { return m_hits.load(); }
+    size_t misses() const { return m_misses.load(); }
+
+    //Идентичность уже открытого файла
+#ifdef _WIN32
+    static bool identityOf(HANDLE file, FileIdentity& identity);
+#else
+    static bool identityOf(int fd, FileIdentity& identity);
+#endif
+    //Можно ли доверять identity: файл не менялся в последние секунды
+    static bool isStable(const FileIdentity& identity);
+
+private:
+    struct Header;
+    struct Entry;
+
+    Entry* findSlot(const FileIdentity& identity, bool forInsert);
+    bool mapFile(const std::string& path, size_t bytes, bool& created);
+    void unmapFile();
+
+    mutable std::mutex m_mutex;
+    Header* m_header = nullptr;
+    Entry* m_entries = nullptr;
+    size_t m_capacity = 0;
+    size_t m_mappedBytes = 0;
+    std::atomic<size_t> m_hits{0};
+    std::atomic<size_t> m_misses{0};
+
+#ifdef _WIN32
+    HANDLE m_file = INVALID_HANDLE_VALUE;
+    HANDLE m_mapping = NULL;
+#else
+    int m_fd = -1;
+#endif
+};
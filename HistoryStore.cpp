@@ -0,0 +1,369 @@
+#include "HistoryStore.h"
+#include <algorithm>
+#include <cmath>
+#include <iostream>
+
+namespace {
+
+const uint32_t EVICTION_PERIOD = 60; //завершившиеся процессы ищутся раз в минуту
+const size_t INDEX_OVERHEAD = 64;    //узел хеш-таблицы и запись m_latest на процесс
+
+const HistoryStore::Tier DEFAULT_TIERS[HistoryStore::TIERS] = {{1, 300}, {60, 360}, {600, 144}};
+
+uint16_t saturate16(uint64_t value) {
+    return static_cast<uint16_t>(std::min<uint64_t>(value, 0xFFFF));
+}
+
+uint32_t saturate32(uint64_t value) {
+    return static_cast<uint32_t>(std::min<uint64_t>(value, 0xFFFFFFFF));
+}
+
+} // namespace
+
+HistoryStore::HistoryStore() {
+    setTiers(DEFAULT_TIERS);
+}
+
+bool HistoryStore::setTiers(const Tier (&tiers)[TIERS]) {
+    for (size_t tier = 0; tier < TIERS; ++tier) {
+        if (tiers[tier].resolution == 0 || tiers[tier].capacity == 0 ||
+            (tier > 0 && tiers[tier].resolution % tiers[tier - 1].resolution != 0) ||
+            (tier > 0 && tiers[tier].resolution <= tiers[tier - 1].resolution)) {
+            std::cerr << "Invalid history tiers" << std::endl;
+            return false;
+        }
+    }
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_pointsPerSeries = 0;
+    for (size_t tier = 0; tier < TIERS; ++tier) {
+        m_tiers[tier] = tiers[tier];
+        m_tierOffset[tier] = m_pointsPerSeries;
+        m_pointsPerSeries += tiers[tier].capacity;
+    }
+    reset();
+    return true;
+}
+
+void HistoryStore::setMemoryBudget(size_t bytes) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_budget = bytes;
+    reset();
+}
+
+void HistoryStore::setRetention(uint32_t seconds) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_retention = seconds;
+}
+
+void HistoryStore::reset() {
+    //Участки выделяются блоками: бюджет округляется вниз до целого блока, но не меньше одного
+    size_t perChunk = (m_pointsPerSeries * sizeof(HistoryPoint) + sizeof(Series) + INDEX_OVERHEAD) * SLOTS_PER_CHUNK;
+    m_maxSeries = std::max<size_t>(1, m_budget / perChunk) * SLOTS_PER_CHUNK;
+    m_chunks.clear();
+    m_series.clear();
+    m_free.clear();
+    m_index.clear();
+    m_latest.clear();
+    m_rejected = 0;
+    m_latestTime = 0;
+    m_lastEviction = 0;
+}
+
+HistoryPoint* HistoryStore::points(uint32_t slot, size_t tier) {
+    return m_chunks[slot / SLOTS_PER_CHUNK].get() + (slot % SLOTS_PER_CHUNK) * m_pointsPerSeries + m_tierOffset[tier];
+}
+
+const HistoryPoint* HistoryStore::points(uint32_t slot, size_t tier) const {
+    return m_chunks[slot / SLOTS_PER_CHUNK].get() + (slot % SLOTS_PER_CHUNK) * m_pointsPerSeries + m_tierOffset[tier];
+}
+
+bool HistoryStore::allocate(uint32_t& slot, uint32_t time) {
+    if (!m_free.empty()) {
+        slot = m_free.back();
+        m_free.pop_back();
+        return true;
+    }
+    if (m_series.size() < m_maxSeries) {
+        if (m_series.size() == m_chunks.size() * SLOTS_PER_CHUNK) {
+            m_chunks.emplace_back(new HistoryPoint[SLOTS_PER_CHUNK * m_pointsPerSeries]);
+        }
+        slot = static_cast<uint32_t>(m_series.size());
+        m_series.emplace_back();
+        return true;
+    }
+    //Бюджет исчерпан: вытесняем процесс, завершившийся раньше всех
+    uint32_t victim = 0;
+    bool found = false;
+    for (uint32_t candidate = 0; candidate < m_series.size(); ++candidate) {
+        const Series& series = m_series[candidate];
+        if (series.used && series.lastSeen < time && (!found || series.lastSeen < m_series[victim].lastSeen)) {
+            victim = candidate;
+            found = true;
+        }
+    }
+    if (!found) {
+        return false;
+    }
+    release(victim);
+    m_free.pop_back();
+    slot = victim;
+    return true;
+}
+
+void HistoryStore::release(uint32_t slot) {
+    Series& series = m_series[slot];
+    m_index.erase(Key{series.pid, series.startTime});
+    auto latest = m_latest.find(series.pid);
+    if (latest != m_latest.end() && latest->second == slot) {
+        m_latest.erase(latest);
+    }
+    series = Series();
+    m_free.push_back(slot);
+}
+
+void HistoryStore::evictExpired(uint32_t time) {
+    for (uint32_t slot = 0; slot < m_series.size(); ++slot) {
+        const Series& series = m_series[slot];
+        if (series.used && series.lastSeen + m_retention < time) {
+            release(slot);
+        }
+    }
+}
+
+void HistoryStore::accumulate(Accumulator& accumulator, const HistoryPoint& point) {
+    ++accumulator.count;
+    accumulator.cpu += point.cpu;
+    accumulator.threads += point.threads;
+    accumulator.rssKb = std::max(accumulator.rssKb, point.rssKb);
+    accumulator.readRate += decodeRate(point.readRate);
+    accumulator.writeRate += decodeRate(point.writeRate);
+}
+
+HistoryPoint HistoryStore::average(const Accumulator& accumulator) {
+    HistoryPoint point;
+    uint32_t count = std::max<uint32_t>(accumulator.count, 1);
+    point.time = accumulator.bucket;
+    point.cpu = saturate16((accumulator.cpu + count / 2) / count);
+    point.threads = saturate16((accumulator.threads + count / 2) / count);
+    point.rssKb = accumulator.rssKb;
+    point.readRate = encodeRate(accumulator.readRate / count);
+    point.writeRate = encodeRate(accumulator.writeRate / count);
+    return point;
+}
+
+void HistoryStore::push(Series& series, uint32_t slot, size_t tier, const HistoryPoint& point) {
+    const Tier& layout = m_tiers[tier];
+    HistoryPoint* ring = points(slot, tier);
+    uint32_t last = (series.head[tier] + layout.capacity - 1) % layout.capacity;
+    if (series.count[tier] > 0 && ring[last].time >= point.time) {
+        ring[last] = point; //чаще разрешения уровня: остается последний сэмпл интервала
+    } else {
+        ring[series.head[tier]] = point;
+        series.head[tier] = (series.head[tier] + 1) % layout.capacity;
+        series.count[tier] = std::min(series.count[tier] + 1, layout.capacity);
+    }
+    if (tier + 1 == TIERS) {
+        return;
+    }
+
+    //Интервал следующего уровня закончился - сворачиваем его и начинаем новый
+    Accumulator& pending = series.pending[tier];
+    uint32_t bucket = point.time - point.time % m_tiers[tier + 1].resolution;
+    if (pending.count > 0 && pending.bucket != bucket) {
+        HistoryPoint rolled = average(pending);
+        pending = Accumulator();
+        push(series, slot, tier + 1, rolled);
+    }
+    pending.bucket = bucket;
+    accumulate(pending, point);
+}
+
+void HistoryStore::record(uint32_t time, const std::vector<HistoryInput>& inputs) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_latestTime = std::max(m_latestTime, time);
+    uint32_t stamp = time - time % m_tiers[0].resolution;
+    for (const HistoryInput& input : inputs) {
+        Key key{input.pid, input.startTime};
+        auto found = m_index.find(key);
+        uint32_t slot;
+        if (found != m_index.end()) {
+            slot = found->second;
+        } else {
+            if (!allocate(slot, time)) {
+                ++m_rejected;
+                continue;
+            }
+            Series& series = m_series[slot];
+            series.pid = input.pid;
+            series.startTime = input.startTime;
+            series.used = true;
+            m_index.emplace(key, slot);
+            m_latest[input.pid] = slot;
+        }
+
+        Series& series = m_series[slot];
+        series.lastSeen = time;
+        HistoryPoint point;
+        point.time = stamp;
+        point.cpu = saturate16(static_cast<uint64_t>(std::llround(std::max(input.cpuPercent, 0.0) * 10.0)));
+        point.threads = saturate16(input.threads);
+        point.rssKb = saturate32((input.rssBytes + 1023) / 1024);
+        point.readRate = encodeRate(input.readBytesPerSec);
+        point.writeRate = encodeRate(input.writeBytesPerSec);
+        push(series, slot, 0, point);
+    }
+
+    if (time >= m_lastEviction + EVICTION_PERIOD) {
+        m_lastEviction = time;
+        evictExpired(time);
+    }
+}
+
+bool HistoryStore::query(DWORD pid, uint64_t startTime, uint32_t from, uint32_t to, uint32_t resolution,
+                         HistoryResult& out) const {
+    out.samples.clear();
+    std::lock_guard<std::mutex> lock(m_mutex);
+    uint32_t slot;
+    if (startTime != 0) {
+        auto found = m_index.find(Key{pid, startTime});
+        if (found == m_index.end()) {
+            return false;
+        }
+        slot = found->second;
+    } else {
+        auto found = m_latest.find(pid);
+        if (found == m_latest.end()) {
+            return false;
+        }
+        slot = found->second;
+    }
+    const Series& series = m_series[slot];
+
+    size_t tier = TIERS - 1;
+    for (size_t candidate = 0; candidate < TIERS; ++candidate) {
+        const Tier& layout = m_tiers[candidate];
+        if (resolution != 0) {
+            if (layout.resolution >= resolution) {
+                tier = candidate;
+                break;
+            }
+            continue;
+        }
+        //Кольцо не заполнено - в нем вся жизнь процесса; заполнено - начало не позже from
+        uint32_t count = series.count[candidate];
+        const HistoryPoint* ring = points(slot, candidate);
+        if (count < layout.capacity || ring[series.head[candidate]].time <= from) {
+            tier = candidate;
+            break;
+        }
+    }
+
+    const Tier& layout = m_tiers[tier];
+    const HistoryPoint* ring = points(slot, tier);
+    out.pid = series.pid;
+    out.startTime = series.startTime;
+    out.resolution = layout.resolution;
+    out.alive = series.lastSeen == m_latestTime;
+    uint32_t count = series.count[tier];
+    uint32_t index = (series.head[tier] + layout.capacity - count) % layout.capacity;
+    auto append = [&out, from, to](const HistoryPoint& point) {
+        if (point.time < from || point.time > to) {
+            return;
+        }
+        out.samples.push_back(decode(point));
+    };
+    out.samples.reserve(count + 1);
+    for (uint32_t i = 0; i < count; ++i) {
+        append(ring[index]);
+        index = index + 1 == layout.capacity ? 0 : index + 1;
+    }
+    //Незавершенный интервал уровня - последней точкой
+    if (tier > 0 && series.pending[tier - 1].count > 0) {
+        append(average(series.pending[tier - 1]));
+    }
+    return true;
+}
+
+void HistoryStore::latestSamples(const std::vector<DWORD>& pids, const std::vector<uint64_t>& startTimes,
+                                 std::vector<HistorySample>& out) const {
+    out.assign(pids.size(), HistorySample());
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (m_index.empty()) {
+        return;
+    }
+    const Tier& layout = m_tiers[0];
+    for (size_t i = 0; i < pids.size(); ++i) {
+        auto found = m_index.find(Key{pids[i], startTimes[i]});
+        if (found == m_index.end()) {
+            continue;
+        }
+        const Series& series = m_series[found->second];
+        if (series.count[0] == 0) {
+            continue;
+        }
+        out[i] = decode(points(found->second, 0)[(series.head[0] + layout.capacity - 1) % layout.capacity]);
+    }
+}
+
+HistorySample HistoryStore::decode(const HistoryPoint& point) {
+    HistorySample sample;
+    sample.time = point.time;
+    sample.cpuPercent = point.cpu / 10.0;
+    sample.rssBytes = static_cast<uint64_t>(point.rssKb) * 1024;
+    sample.threads = point.threads;
+    sample.readBytesPerSec = decodeRate(point.readRate);
+    sample.writeBytesPerSec = decodeRate(point.writeRate);
+    return sample;
+}
+
+size_t HistoryStore::processes() const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_index.size();
+}
+
+size_t HistoryStore::rejected() const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_rejected;
+}
+
+uint32_t HistoryStore::latestTime() const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_latestTime;
+}
+
+size_t HistoryStore::memoryBytes() const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_chunks.size() * SLOTS_PER_CHUNK * m_pointsPerSeries * sizeof(HistoryPoint) +
+           m_series.capacity() * sizeof(Series) + m_index.size() * INDEX_OVERHEAD;
+}
+
+size_t HistoryStore::bytesPerProcess() const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_pointsPerSeries * sizeof(HistoryPoint) + sizeof(Series) + INDEX_OVERHEAD;
+}
+
+uint16_t HistoryStore::encodeRate(double bytesPerSec) {
+    const uint64_t maxValue = 2047ull << 31;
+    if (!(bytesPerSec > 0)) {
+        return 0;
+    }
+    uint64_t value = bytesPerSec >= static_cast<double>(maxValue) ? maxValue : static_cast<uint64_t>(std::llround(bytesPerSec));
+    uint32_t shift = 0;
+    while ((value >> shift) > 2047) {
+        ++shift;
+    }
+    //Округление к ближайшему; перенос в 2048 - еще один сдвиг
+    uint64_t mantissa = shift > 0 ? (value + (1ull << (shift - 1))) >> shift : value;
+    if (mantissa > 2047) {
+        mantissa >>= 1;
+        ++shift;
+    }
+    if (shift > 31) {
+        return 0xFFFF;
+    }
+    return static_cast<uint16_t>((shift << 11) | mantissa);
+}
+
+double HistoryStore::decodeRate(uint16_t code) {
+    return static_cast<double>(static_cast<uint64_t>(code & 2047) << (code >> 11));
+}
@@ -0,0 +1,168 @@
+// HistoryStore.h
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+#include "ProcessInfo.h"
+
+//Сэмпл одного процесса на входе record()
+struct HistoryInput {
+    DWORD pid = 0;
+    uint64_t startTime = 0;
+    double cpuPercent = 0;
+    uint64_t rssBytes = 0;
+    uint32_t threads = 0;
+    double readBytesPerSec = 0;
+    double writeBytesPerSec = 0;
+};
+
+//Хранимая точка: фиксированная точка, 16 байт
+struct HistoryPoint {
+    uint32_t time;       //unix-время начала интервала, с
+    uint16_t cpu;        //десятые доли процента одного ядра (до 6553.5%)
+    uint16_t threads;
+    uint32_t rssKb;      //КиБ (до 4 ТиБ)
+    uint16_t readRate;   //байт/с, см. HistoryStore::encodeRate
+    uint16_t writeRate;
+};
+static_assert(sizeof(HistoryPoint) == 16, "HistoryPoint must stay 16 bytes");
+
+//Точка ответа в обычных единицах
+struct HistorySample {
+    uint32_t time = 0;
+    double cpuPercent = 0;
+    uint64_t rssBytes = 0;
+    uint32_t threads = 0;
+    double readBytesPerSec = 0;
+    double writeBytesPerSec = 0;
+};
+
+struct HistoryResult {
+    DWORD pid = 0;
+    uint64_t startTime = 0;
+    uint32_t resolution = 0; //секунд на точку
+    bool alive = false;      //процесс был в последнем сэмпле
+    std::vector<HistorySample> samples;
+};
+
+/*
+История ресурсов процессов в памяти с жестким бюджетом.
+У каждого процесса (пара PID + время старта) кольцевые буферы трех уровней:
+по умолчанию 1 с x 300 (5 минут), 1 мин x 360 (6 часов), 10 мин x 144 (сутки).
+Точки уровня сворачиваются в следующий, когда интервал следующего закончился:
+CPU, потоки и io - среднее, RSS - максимум (пик памяти не должен сглаживаться).
+
+Память: буферы всех уровней процесса - один участок в блоках по 64 процесса,
+выделяется при первом появлении процесса и не растет. Бюджет ограничивает
+число участков; новому процессу без места отдается участок давно
+завершившегося, а если таких нет - процесс не записывается (rejected()).
+Завершившиеся процессы хранятся retention секунд (по умолчанию 15 минут).
+
+Все методы потокобезопасны: record() вызывает сэмплер, query() - сервер.
+*/
+class HistoryStore {
+public:
+    static constexpr size_t TIERS = 3;
+    struct Tier {
+        uint32_t resolution; //секунд на точку; каждый следующий - кратен предыдущему
+        uint32_t capacity;   //точек в кольце
+    };
+
+    HistoryStore();
+
+    HistoryStore(const HistoryStore&) = delete;
+    HistoryStore& operator=(const HistoryStore&) = delete;
+
+    //Смена уровней сбрасывает накопленную историю
+    bool setTiers(const Tier (&tiers)[TIERS]);
+    void setMemoryBudget(size_t bytes);
+    void setRetention(uint32_t seconds);
+
+    //Все процессы одного сэмпла; time - unix-время, с
+    void record(uint32_t time, const std::vector<HistoryInput>& inputs);
+
+    //История процесса за [from, to]. startTime = 0 - последний процесс с этим PID;
+    //resolution = 0 - самый подробный уровень, который покрывает from целиком,
+    //иначе уровень с этим (или ближайшим более грубым) шагом
+    bool query(DWORD pid, uint64_t startTime, uint32_t from, uint32_t to, uint32_t resolution, HistoryResult& out) const;
+    //Последний сэмпл каждого процесса (колонки pid и время старта снимка) под одной блокировкой;
+    //out[i].time = 0 - истории у процесса нет
+    void latestSamples(const std::vector<DWORD>& pids, const std::vector<uint64_t>& startTimes,
+                       std::vector<HistorySample>& out) const;
+
+    size_t processes() const;
+    size_t rejected() const;
+    uint32_t latestTime() const;
+    //Выделено сейчас и сколько стоит один процесс
+    size_t memoryBytes() const;
+    size_t bytesPerProcess() const;
+
+    //Скорость в u16: 11 бит мантиссы и 5 бит сдвига, относительная ошибка < 0.1%
+    static uint16_t encodeRate(double bytesPerSec);
+    static double decodeRate(uint16_t code);
+
+private:
+    static constexpr size_t SLOTS_PER_CHUNK = 64;
+
+    //Свертка точек уровня в интервал следующего уровня
+    struct Accumulator {
+        uint32_t bucket = 0;
+        uint32_t count = 0;
+        uint64_t cpu = 0;
+        uint64_t threads = 0;
+        uint32_t rssKb = 0;
+        double readRate = 0;
+        double writeRate = 0;
+    };
+    struct Series {
+        DWORD pid = 0;
+        uint64_t startTime = 0;
+        uint32_t lastSeen = 0;
+        bool used = false;
+        uint32_t head[TIERS] = {};  //куда писать следующую точку
+        uint32_t count[TIERS] = {};
+        Accumulator pending[TIERS - 1];
+    };
+    struct Key {
+        DWORD pid;
+        uint64_t startTime;
+        bool operator==(const Key& other) const { return pid == other.pid && startTime == other.startTime; }
+    };
+    struct KeyHash {
+        size_t operator()(const Key& key) const {
+            return static_cast<size_t>((key.startTime * 0x9E3779B97F4A7C15ull) ^ key.pid);
+        }
+    };
+
+    //Под m_mutex
+    void reset();
+    HistoryPoint* points(uint32_t slot, size_t tier);
+    const HistoryPoint* points(uint32_t slot, size_t tier) const;
+    bool allocate(uint32_t& slot, uint32_t time);
+    void release(uint32_t slot);
+    void evictExpired(uint32_t time);
+    void push(Series& series, uint32_t slot, size_t tier, const HistoryPoint& point);
+    static void accumulate(Accumulator& accumulator, const HistoryPoint& point);
+    static HistoryPoint average(const Accumulator& accumulator);
+    static HistorySample decode(const HistoryPoint& point);
+
+    mutable std::mutex m_mutex;
+    Tier m_tiers[TIERS];
+    size_t m_tierOffset[TIERS];
+    size_t m_pointsPerSeries = 0;
+    size_t m_budget = 320u << 20; //~25k процессов при уровнях по умолчанию
+    uint32_t m_retention = 900;
+    size_t m_maxSeries = 0;
+
+    std::vector<std::unique_ptr<HistoryPoint[]>> m_chunks;
+    std::vector<Series> m_series;
+    std::vector<uint32_t> m_free;
+    std::unordered_map<Key, uint32_t, KeyHash> m_index;
+    std::unordered_map<DWORD, uint32_t> m_latest; //PID -> последний процесс с ним
+    size_t m_rejected = 0;
+    uint32_t m_latestTime = 0;
+    uint32_t m_lastEviction = 0;
+};
@@ -0,0 +1,591 @@
+#include "IntegrityManifest.h"
+#include "Metrics.h"
+#include "RefreshScheduler.h"
+#include "SecurityUtils.h"
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#ifdef _WIN32
+#include <sstream>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+struct IntegrityManifest::Header {
+    char magic[8];
+    uint32_t version;
+    uint32_t slotSize;
+    uint64_t seed;
+    uint64_t entries;
+    uint64_t buckets;
+    uint64_t stringsSize;
+    uint64_t checksum; //полей выше
+};
+
+struct IntegrityManifest::Slot {
+    uint64_t keyHash;
+    uint32_t pathOffset;
+    uint32_t pathLength;
+    unsigned char digest[DIGEST_SIZE];
+};
+
+namespace {
+
+const char MANIFEST_MAGIC[8] = {'P', 'M', 'M', 'A', 'N', 'I', 'F', '1'};
+const uint32_t MANIFEST_VERSION = 1;
+const uint64_t KEYS_PER_BUCKET = 4;
+const int MAX_SEEDS = 16;
+
+MetricCounter matchedImages("monitor_integrity_checks_total", "Process images checked against the manifest", "result", "match");
+MetricCounter mismatchedImages("monitor_integrity_checks_total", "Process images checked against the manifest", "result", "mismatch");
+MetricCounter unknownImages("monitor_integrity_checks_total", "Process images checked against the manifest", "result", "unknown");
+MetricCounter unreadableImages("monitor_integrity_checks_total", "Process images checked against the manifest", "result", "unreadable");
+MetricHistogram verifyDuration("monitor_integrity_verify_seconds", "Whole verifyProcesses batch");
+
+//Путь образа для поиска в манифесте: замененный файл ядро показывает с суффиксом " (deleted)"
+std::string_view imagePath(std::string_view path) {
+    const std::string_view deleted = " (deleted)";
+    if (path.size() > deleted.size() && path.substr(path.size() - deleted.size()) == deleted) {
+        path.remove_suffix(deleted.size());
+    }
+    return path;
+}
+
+void countVerdict(IntegrityManifest::Verdict verdict) {
+    switch (verdict) {
+    case IntegrityManifest::Verdict::Match: matchedImages.add(); break;
+    case IntegrityManifest::Verdict::Mismatch: mismatchedImages.add(); break;
+    case IntegrityManifest::Verdict::Unknown: unknownImages.add(); break;
+    case IntegrityManifest::Verdict::Unreadable: unreadableImages.add(); break;
+    }
+}
+
+uint64_t mix64(uint64_t x) {
+    x ^= x >> 30;
+    x *= 0xbf58476d1ce4e5b9ULL;
+    x ^= x >> 27;
+    x *= 0x94d049bb133111ebULL;
+    return x ^ (x >> 31);
+}
+
+uint64_t pilotMix(uint32_t pilot, uint64_t seed) {
+    return mix64(static_cast<uint64_t>(pilot) * 0x9e3779b97f4a7c15ULL ^ seed);
+}
+
+//Корзина по старшим 32 битам хеша (умножение вместо деления)
+uint64_t bucketOf(uint64_t hash, uint64_t buckets) {
+    return ((hash >> 32) * buckets) >> 32;
+}
+
+uint64_t headerChecksum(const char* header, size_t size) {
+    uint64_t h = 0x4d414e4946455354ULL;
+    for (size_t offset = 0; offset + 8 <= size; offset += 8) {
+        uint64_t word;
+        std::memcpy(&word, header + offset, 8);
+        h = mix64(h ^ word);
+    }
+    return h;
+}
+
+size_t alignTo8(size_t value) {
+    return (value + 7) & ~static_cast<size_t>(7);
+}
+
+int hexValue(char c) {
+    if (c >= '0' && c <= '9') {
+        return c - '0';
+    }
+    if (c >= 'a' && c <= 'f') {
+        return c - 'a' + 10;
+    }
+    if (c >= 'A' && c <= 'F') {
+        return c - 'A' + 10;
+    }
+    return -1;
+}
+
+bool parseDigest(std::string_view hex, unsigned char* digest) {
+    if (hex.size() != IntegrityManifest::DIGEST_SIZE * 2) {
+        return false;
+    }
+    for (size_t i = 0; i < IntegrityManifest::DIGEST_SIZE; ++i) {
+        int high = hexValue(hex[2 * i]);
+        int low = hexValue(hex[2 * i + 1]);
+        if (high < 0 || low < 0) {
+            return false;
+        }
+        digest[i] = static_cast<unsigned char>(high << 4 | low);
+    }
+    return true;
+}
+
+} // namespace
+
+uint64_t IntegrityManifest::hashPath(std::string_view path, uint64_t seed) {
+    uint64_t h = seed ^ (static_cast<uint64_t>(path.size()) * 0x9e3779b97f4a7c15ULL);
+    const char* p = path.data();
+    size_t left = path.size();
+    while (left >= 8) {
+        uint64_t chunk;
+        std::memcpy(&chunk, p, 8);
+        h = mix64(h ^ chunk);
+        p += 8;
+        left -= 8;
+    }
+    uint64_t tail = 0;
+    std::memcpy(&tail, p, left);
+    return mix64(h ^ tail ^ (static_cast<uint64_t>(left) << 59));
+}
+
+IntegrityManifest::~IntegrityManifest() {
+    close();
+}
+
+void IntegrityManifest::close() {
+#ifndef _WIN32
+    if (m_data) {
+        ::munmap(const_cast<unsigned char*>(m_data), m_size);
+    }
+#else
+    m_content.clear();
+#endif
+    m_data = nullptr;
+    m_size = 0;
+    m_seed = 0;
+    m_entries = 0;
+    m_buckets = 0;
+    m_pilots = nullptr;
+    m_slots = nullptr;
+    m_strings = nullptr;
+    m_stringsSize = 0;
+}
+
+bool IntegrityManifest::map(const std::string& path) {
+#ifndef _WIN32
+    int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        return false;
+    }
+    struct stat info;
+    void* data = MAP_FAILED;
+    if (::fstat(fd, &info) == 0 && info.st_size > 0) {
+        data = ::mmap(nullptr, static_cast<size_t>(info.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+    }
+    ::close(fd); //отображение держит файл само
+    if (data == MAP_FAILED) {
+        return false;
+    }
+    m_data = static_cast<const unsigned char*>(data);
+    m_size = static_cast<size_t>(info.st_size);
+#else
+    std::ifstream file(path, std::ios::binary);
+    if (!file) {
+        return false;
+    }
+    std::ostringstream content;
+    content << file.rdbuf();
+    m_content = content.str();
+    if (m_content.empty()) {
+        return false;
+    }
+    m_data = reinterpret_cast<const unsigned char*>(m_content.data());
+    m_size = m_content.size();
+#endif
+    return true;
+}
+
+bool IntegrityManifest::open(const std::string& path) {
+    close();
+    if (!map(path)) {
+        std::cerr << "Cannot open integrity manifest " << path << std::endl;
+        return false;
+    }
+    Header header;
+    bool valid = m_size >= sizeof(Header);
+    if (valid) {
+        std::memcpy(&header, m_data, sizeof(Header));
+        valid = std::memcmp(header.magic, MANIFEST_MAGIC, sizeof(MANIFEST_MAGIC)) == 0
+            && header.version == MANIFEST_VERSION
+            && header.slotSize == sizeof(Slot)
+            && header.checksum == headerChecksum(reinterpret_cast<const char*>(&header), offsetof(Header, checksum))
+            && header.entries <= 0xFFFFFFFFu && header.buckets <= 0xFFFFFFFFu
+            && (header.entries == 0) == (header.buckets == 0);
+    }
+    size_t pilotsOffset = sizeof(Header);
+    size_t slotsOffset = 0;
+    size_t stringsOffset = 0;
+    if (valid) {
+        slotsOffset = alignTo8(pilotsOffset + static_cast<size_t>(header.buckets) * sizeof(uint32_t));
+        stringsOffset = slotsOffset + static_cast<size_t>(header.entries) * sizeof(Slot);
+        valid = stringsOffset + header.stringsSize == m_size;
+    }
+    if (!valid) {
+        std::cerr << "Not an integrity manifest or damaged: " << path << std::endl;
+        close();
+        return false;
+    }
+    m_seed = header.seed;
+    m_entries = header.entries;
+    m_buckets = header.buckets;
+    m_pilots = reinterpret_cast<const uint32_t*>(m_data + pilotsOffset);
+    m_slots = reinterpret_cast<const Slot*>(m_data + slotsOffset);
+    m_strings = reinterpret_cast<const char*>(m_data + stringsOffset);
+    m_stringsSize = header.stringsSize;
+    return true;
+}
+
+const unsigned char* IntegrityManifest::find(std::string_view path) const {
+    if (m_entries == 0) {
+        return nullptr;
+    }
+    uint64_t hash = hashPath(path, m_seed);
+    uint32_t pilot = m_pilots[bucketOf(hash, m_buckets)];
+    const Slot& slot = m_slots[(hash ^ pilotMix(pilot, m_seed)) % m_entries];
+    if (slot.keyHash != hash || slot.pathLength != path.size()
+        || static_cast<uint64_t>(slot.pathOffset) + slot.pathLength > m_stringsSize
+        || std::memcmp(m_strings + slot.pathOffset, path.data(), path.size()) != 0) {
+        return nullptr;
+    }
+    return slot.digest;
+}
+
+IntegrityManifest::Verdict IntegrityManifest::check(std::string_view path, std::string_view hexDigest) const {
+    const unsigned char* expected = find(path);
+    if (!expected) {
+        return Verdict::Unknown;
+    }
+    unsigned char actual[DIGEST_SIZE];
+    if (!parseDigest(hexDigest, actual)) {
+        return Verdict::Unreadable;
+    }
+    return std::memcmp(expected, actual, DIGEST_SIZE) == 0 ? Verdict::Match : Verdict::Mismatch;
+}
+
+const char* IntegrityManifest::verdictName(Verdict verdict) {
+    switch (verdict) {
+    case Verdict::Match: return "match";
+    case Verdict::Mismatch: return "mismatch";
+    case Verdict::Unknown: return "unknown";
+    case Verdict::Unreadable: return "unreadable";
+    }
+    return "unknown";
+}
+
+void IntegrityManifest::verifyProcesses(const ProcessTable& table, std::vector<ProcessResult>& out, size_t threads) const {
+    MetricTimer timer(verifyDuration);
+    out.clear();
+
+    //Одна проверка на уникальный путь: handle арены -> номер группы
+    const std::vector<StringArena::Handle>& pathIds = table.pathIds();
+    std::vector<uint32_t> groupOf(table.strings().size(), UINT32_MAX);
+    std::vector<uint32_t> groupRows;       //первая строка группы - ее образ и хешируется
+    std::vector<std::string_view> groupPaths;
+    for (size_t row = 0; row < table.size(); ++row) {
+        StringArena::Handle handle = pathIds[row];
+        if (handle == StringArena::EMPTY) {
+            continue; //потоки ядра
+        }
+        if (groupOf[handle] == UINT32_MAX) {
+            std::string_view path = imagePath(table.strings().get(handle));
+            groupOf[handle] = static_cast<uint32_t>(groupRows.size());
+            groupRows.push_back(static_cast<uint32_t>(row));
+            groupPaths.push_back(path);
+        }
+    }
+
+    //Хешируются только пути из манифеста
+    std::vector<Verdict> verdicts(groupRows.size(), Verdict::Unknown);
+    std::vector<uint32_t> hashed;
+    std::vector<std::string> files;
+    for (uint32_t group = 0; group < groupRows.size(); ++group) {
+        if (find(groupPaths[group])) {
+            hashed.push_back(group);
+#ifndef _WIN32
+            files.push_back("/proc/" + std::to_string(table.pids()[groupRows[group]]) + "/exe");
+#else
+            files.push_back(std::string(groupPaths[group]));
+#endif
+        }
+    }
+    std::vector<std::string> hashes = SecurityUtils::hashFiles(files, threads);
+#ifndef _WIN32
+    //Образ не читается (нет прав на чужой процесс) - файл по пути
+    std::vector<size_t> retry;
+    files.clear();
+    for (size_t i = 0; i < hashed.size(); ++i) {
+        if (hashes[i].empty()) {
+            retry.push_back(i);
+            files.push_back(std::string(groupPaths[hashed[i]]));
+        }
+    }
+    std::vector<std::string> retried = SecurityUtils::hashFiles(files, threads);
+    for (size_t i = 0; i < retry.size(); ++i) {
+        hashes[retry[i]] = std::move(retried[i]);
+    }
+#endif
+    for (size_t i = 0; i < hashed.size(); ++i) {
+        verdicts[hashed[i]] = check(groupPaths[hashed[i]], hashes[i]);
+    }
+
+    for (size_t row = 0; row < table.size(); ++row) {
+        StringArena::Handle handle = pathIds[row];
+        if (handle == StringArena::EMPTY) {
+            continue;
+        }
+        Verdict verdict = verdicts[groupOf[handle]];
+        out.push_back(ProcessResult{static_cast<uint32_t>(row), verdict});
+        countVerdict(verdict);
+    }
+}
+
+void IntegrityManifest::verifyProcesses(const ProcessTable& table, RefreshScheduler& scheduler,
+                                        std::vector<ProcessResult>& out) const {
+    bool sameCycle = scheduler.entries().size() == table.size();
+    for (size_t row = 0; sameCycle && row < table.size(); ++row) {
+        sameCycle = scheduler.entries()[row].pid == table.pids()[row];
+    }
+    if (!sameCycle) {
+        //Таблица не из этого цикла расписания (или Windows, где оно не применяется) - целиком
+        verifyProcesses(table, out);
+        return;
+    }
+    MetricTimer timer(verifyDuration);
+    out.clear();
+
+    //Хешируются только пути из манифеста; одинаковые образы повторно берутся из кеша хешей
+    std::vector<bool> checked(table.size(), false);
+    scheduler.plan(RefreshScheduler::mask(RefreshScheduler::Attribute::Hash));
+    RefreshScheduler::Task task;
+    while (scheduler.next(task)) {
+        const RefreshScheduler::Entry& entry = scheduler.entries()[task.index];
+        std::string_view path = imagePath(entry.path);
+        if (path.empty() || !find(path)) {
+            scheduler.markRefreshed(task.index, task.attribute);
+            continue;
+        }
+#ifndef _WIN32
+        //Запущенный образ; без прав на чужой процесс - файл по пути
+        std::string hash = SecurityUtils::calculateFileHash("/proc/" + std::to_string(entry.pid) + "/exe");
+        if (hash.empty()) {
+            hash = SecurityUtils::calculateFileHash(std::string(path));
+        }
+#else
+        std::string hash = SecurityUtils::calculateFileHash(std::string(path));
+#endif
+        scheduler.setHash(task.index, hash);
+        checked[task.index] = true;
+    }
+
+    const unsigned hashMask = RefreshScheduler::mask(RefreshScheduler::Attribute::Hash);
+    for (size_t row = 0; row < table.size(); ++row) {
+        const RefreshScheduler::Entry& entry = scheduler.entries()[row];
+        if (entry.path.empty() || (entry.valid & hashMask) == 0) {
+            continue; //поток ядра или хеш еще не прочитан
+        }
+        Verdict verdict = check(imagePath(entry.path), entry.hash);
+        out.push_back(ProcessResult{static_cast<uint32_t>(row), verdict});
+        if (checked[row]) {
+            countVerdict(verdict); //метрики - только проверки этого цикла
+        }
+    }
+}
+
+bool ManifestCompiler::add(std::string_view path, std::string_view hexDigest) {
+    unsigned char digest[IntegrityManifest::DIGEST_SIZE];
+    if (path.empty() || !parseDigest(hexDigest, digest)) {
+        return false;
+    }
+    auto inserted = m_index.emplace(std::string(path), m_paths.size());
+    if (!inserted.second) {
+        ++m_duplicates;
+        std::memcpy(&m_digests[inserted.first->second * IntegrityManifest::DIGEST_SIZE], digest, sizeof(digest));
+        return true;
+    }
+    m_paths.emplace_back(path);
+    m_digests.insert(m_digests.end(), digest, digest + sizeof(digest));
+    return true;
+}
+
+bool ManifestCompiler::addList(const std::string& listFile) {
+    std::ifstream file(listFile);
+    if (!file) {
+        std::cerr << "Cannot open manifest list " << listFile << std::endl;
+        return false;
+    }
+    std::string line;
+    size_t number = 0;
+    while (std::getline(file, line)) {
+        ++number;
+        if (!line.empty() && line.back() == '\r') {
+            line.pop_back();
+        }
+        if (line.empty() || line[0] == '#') {
+            continue;
+        }
+        //"<hex>  <путь>" (текстовый режим sha256sum) или "<hex> *<путь>" (двоичный)
+        std::string_view text(line);
+        size_t hexLength = IntegrityManifest::DIGEST_SIZE * 2;
+        bool separated = text.size() > hexLength + 2 && text[hexLength] == ' '
+            && (text[hexLength + 1] == ' ' || text[hexLength + 1] == '*');
+        if (!separated || !add(text.substr(hexLength + 2), text.substr(0, hexLength))) {
+            std::cerr << listFile << ":" << number << ": expected \"<sha256 hex>  <path>\"" << std::endl;
+            return false;
+        }
+    }
+    return true;
+}
+
+bool ManifestCompiler::build(std::vector<uint32_t>& pilots, std::vector<uint32_t>& slotKeys, uint64_t& seed,
+                             uint64_t& buckets) const {
+    uint64_t entries = m_paths.size();
+    buckets = (entries + KEYS_PER_BUCKET - 1) / KEYS_PER_BUCKET;
+    //Последние одиночные корзины ищут единственный свободный слот: в среднем N попыток
+    uint64_t maxPilot = std::min<uint64_t>(0xFFFFFFFFu, std::max<uint64_t>(1u << 20, entries * 64));
+
+    std::vector<uint64_t> hashes(entries);
+    std::vector<uint32_t> bucketStart(buckets + 1);
+    std::vector<uint32_t> keys(entries);     //номера путей, сгруппированные по корзинам
+    std::vector<uint32_t> order(buckets);    //корзины от больших к малым
+    std::vector<uint8_t> taken(entries);
+    std::vector<uint64_t> positions;
+    for (int attempt = 0; attempt < MAX_SEEDS; ++attempt) {
+        seed = mix64(0x6d616e6966657374ULL + static_cast<uint64_t>(attempt));
+        std::fill(bucketStart.begin(), bucketStart.end(), 0);
+        for (size_t i = 0; i < entries; ++i) {
+            hashes[i] = IntegrityManifest::hashPath(m_paths[i], seed);
+            ++bucketStart[bucketOf(hashes[i], buckets) + 1];
+        }
+        for (size_t b = 0; b < buckets; ++b) {
+            bucketStart[b + 1] += bucketStart[b];
+        }
+        std::vector<uint32_t> fill(bucketStart.begin(), bucketStart.end() - 1);
+        for (size_t i = 0; i < entries; ++i) {
+            keys[fill[bucketOf(hashes[i], buckets)]++] = static_cast<uint32_t>(i);
+        }
+        for (size_t b = 0; b < buckets; ++b) {
+            order[b] = static_cast<uint32_t>(b);
+        }
+        std::stable_sort(order.begin(), order.end(), [&bucketStart](uint32_t a, uint32_t b) {
+            return bucketStart[a + 1] - bucketStart[a] > bucketStart[b + 1] - bucketStart[b];
+        });
+
+        std::fill(taken.begin(), taken.end(), 0);
+        pilots.assign(buckets, 0);
+        slotKeys.assign(entries, 0);
+        bool placedAll = true;
+        for (uint32_t bucket : order) {
+            uint32_t first = bucketStart[bucket];
+            uint32_t count = bucketStart[bucket + 1] - first;
+            if (count == 0) {
+                break; //дальше только пустые
+            }
+            //Одинаковые хеши в корзине не развести никаким pilot'ом
+            bool distinct = true;
+            for (uint32_t a = first; a < first + count && distinct; ++a) {
+                for (uint32_t b = a + 1; b < first + count && distinct; ++b) {
+                    distinct = hashes[keys[a]] != hashes[keys[b]];
+                }
+            }
+            bool placed = false;
+            for (uint64_t pilot = 0; distinct && pilot <= maxPilot && !placed; ++pilot) {
+                uint64_t mixed = pilotMix(static_cast<uint32_t>(pilot), seed);
+                positions.clear();
+                bool free = true;
+                for (uint32_t k = 0; k < count && free; ++k) {
+                    uint64_t position = (hashes[keys[first + k]] ^ mixed) % entries;
+                    free = !taken[position] && std::find(positions.begin(), positions.end(), position) == positions.end();
+                    positions.push_back(position);
+                }
+                if (free) {
+                    for (uint32_t k = 0; k < count; ++k) {
+                        taken[positions[k]] = 1;
+                        slotKeys[positions[k]] = keys[first + k];
+                    }
+                    pilots[bucket] = static_cast<uint32_t>(pilot);
+                    placed = true;
+                }
+            }
+            if (!placed) {
+                placedAll = false;
+                break;
+            }
+        }
+        if (placedAll) {
+            return true;
+        }
+    }
+    return false;
+}
+
+bool ManifestCompiler::write(const std::string& outputFile) const {
+    std::vector<uint32_t> pilots;
+    std::vector<uint32_t> slotKeys;
+    uint64_t seed = 0;
+    uint64_t buckets = 0;
+    if (!m_paths.empty() && !build(pilots, slotKeys, seed, buckets)) {
+        std::cerr << "Cannot build a perfect hash for " << m_paths.size() << " manifest entries" << std::endl;
+        return false;
+    }
+
+    //Строки в порядке слотов: соседние слоты - соседние пути
+    std::vector<IntegrityManifest::Slot> slots(m_paths.size());
+    std::string strings;
+    for (size_t position = 0; position < slots.size(); ++position) {
+        uint32_t key = slotKeys[position];
+        const std::string& path = m_paths[key];
+        if (strings.size() + path.size() > 0xFFFFFFFFu) {
+            std::cerr << "Manifest paths exceed 4 GiB" << std::endl;
+            return false;
+        }
+        IntegrityManifest::Slot& slot = slots[position];
+        slot.keyHash = IntegrityManifest::hashPath(path, seed);
+        slot.pathOffset = static_cast<uint32_t>(strings.size());
+        slot.pathLength = static_cast<uint32_t>(path.size());
+        std::memcpy(slot.digest, &m_digests[key * IntegrityManifest::DIGEST_SIZE], IntegrityManifest::DIGEST_SIZE);
+        strings += path;
+    }
+
+    IntegrityManifest::Header header;
+    std::memset(&header, 0, sizeof(header));
+    std::memcpy(header.magic, MANIFEST_MAGIC, sizeof(MANIFEST_MAGIC));
+    header.version = MANIFEST_VERSION;
+    header.slotSize = sizeof(IntegrityManifest::Slot);
+    header.seed = seed;
+    header.entries = m_paths.size();
+    header.buckets = buckets;
+    header.stringsSize = strings.size();
+    header.checksum = headerChecksum(reinterpret_cast<const char*>(&header), offsetof(IntegrityManifest::Header, checksum));
+
+    std::string temporary = outputFile + ".tmp";
+    std::FILE* file = std::fopen(temporary.c_str(), "wb");
+    if (!file) {
+        std::cerr << "Cannot create " << temporary << std::endl;
+        return false;
+    }
+    const char padding[8] = {};
+    size_t pilotBytes = pilots.size() * sizeof(uint32_t);
+    size_t paddingBytes = alignTo8(sizeof(header) + pilotBytes) - (sizeof(header) + pilotBytes);
+    bool written = std::fwrite(&header, sizeof(header), 1, file) == 1
+        && (pilots.empty() || std::fwrite(pilots.data(), pilotBytes, 1, file) == 1)
+        && (paddingBytes == 0 || std::fwrite(padding, paddingBytes, 1, file) == 1)
+        && (slots.empty() || std::fwrite(slots.data(), slots.size() * sizeof(IntegrityManifest::Slot), 1, file) == 1)
+        && (strings.empty() || std::fwrite(strings.data(), strings.size(), 1, file) == 1);
+    written = std::fclose(file) == 0 && written;
+    if (written) {
+#ifdef _WIN32
+        std::remove(outputFile.c_str()); //rename не заменяет существующий файл
+#endif
+        written = std::rename(temporary.c_str(), outputFile.c_str()) == 0;
+    }
+    if (!written) {
+        std::cerr << "Cannot write integrity manifest " << outputFile << std::endl;
+        std::remove(temporary.c_str());
+        return false;
+    }
+    return true;
+}
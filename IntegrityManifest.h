@@ -0,0 +1,129 @@
+// IntegrityManifest.h
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+#include "ProcessTable.h"
+
+class RefreshScheduler;
+
+/*
+Манифест эталонных хешей исполняемых файлов: пары (путь, SHA-256) из сборок пакетов.
+
+Текстовый список в формате sha256sum ("<64 hex>  <путь>" или "<64 hex> *<путь>",
+'#' - комментарий) компилируется ManifestCompiler в двоичный файл с
+минимальной совершенной хеш-функцией (hash-and-displace, как в PTHash):
+- путь -> 64-битный хеш с seed файла
+- хеш -> корзина (в среднем 4 пути); у каждой корзины свой pilot, подобранный
+  при компиляции так, что позиции (хеш ^ mix(pilot)) mod N всех путей
+  различны и занимают слоты 0..N-1 без пропусков
+- слот хранит полный хеш пути, смещение пути в блоке строк и digest
+Поиск - pilot корзины, один слот и сравнение пути: O(1) и без аллокаций.
+Путь не из манифеста попадает в чужой слот и отсекается по хешу и строке.
+
+Файл отображается в память как есть (mmap, только чтение): open проверяет
+заголовок и размеры, а не записи, поэтому загрузка не зависит от их числа.
+Компилятор пишет во временный файл и переименовывает его: уже открытые
+отображения старого манифеста остаются целыми.
+Порядок байт родной, как у HashCache.
+    Header | pilots: u32 x buckets (выравнивание до 8) | Slot x entries | строки путей
+*/
+class IntegrityManifest {
+public:
+    static constexpr size_t DIGEST_SIZE = 32;
+
+    IntegrityManifest() = default;
+    ~IntegrityManifest();
+
+    IntegrityManifest(const IntegrityManifest&) = delete;
+    IntegrityManifest& operator=(const IntegrityManifest&) = delete;
+
+    bool open(const std::string& path);
+    void close();
+    bool isOpen() const { return m_data != nullptr; }
+    size_t size() const { return m_entries; }
+
+    //Эталонный digest пути (DIGEST_SIZE байт внутри файла); nullptr - пути нет в манифесте
+    const unsigned char* find(std::string_view path) const;
+
+    enum class Verdict : uint8_t { Match, Mismatch, Unknown, Unreadable };
+    //Сверка хеша в hex (как у SecurityUtils::calculateFileHash); пустой hex - файл не прочитан
+    Verdict check(std::string_view path, std::string_view hexDigest) const;
+
+    struct ProcessResult {
+        uint32_t row;    //строка таблицы
+        Verdict verdict;
+    };
+/*
+Проверка образов всех процессов снимка одним пакетом (строки без пути пропускаются).
+Процессы с одним путем хешируются один раз, пути не из манифеста не хешируются вовсе.
+Linux: хешируется /proc/<pid>/exe - именно запущенный образ, даже если файл
+на диске заменен или удален (суффикс " (deleted)" при поиске отбрасывается);
+если он не читается (чужой процесс без прав) - файл по пути.
+Хеши идут через SecurityUtils::hashFiles: пул потоков и постоянный кеш хешей.
+*/
+    void verifyProcesses(const ProcessTable& table, std::vector<ProcessResult>& out, size_t threads = 0) const;
+/*
+Периодическая проверка: table - результат ProcessTable::scan(scheduler) этого цикла
+(строки совпадают с scheduler.entries()). Образы хешируются задачами Attribute::Hash -
+по интервалу уровня процесса и в пределах бюджета цикла; exec сбрасывает хеш.
+out - процессы, хеш которых уже прочитан; остальные проверятся в следующих циклах.
+*/
+    void verifyProcesses(const ProcessTable& table, RefreshScheduler& scheduler, std::vector<ProcessResult>& out) const;
+
+    static const char* verdictName(Verdict verdict);
+
+    //Хеш пути для поиска (общий у компилятора и читателя)
+    static uint64_t hashPath(std::string_view path, uint64_t seed);
+
+private:
+    struct Header;
+    struct Slot;
+
+    bool map(const std::string& path);
+
+    const unsigned char* m_data = nullptr;
+    size_t m_size = 0;
+    uint64_t m_seed = 0;
+    uint64_t m_entries = 0;
+    uint64_t m_buckets = 0;
+    const uint32_t* m_pilots = nullptr;
+    const Slot* m_slots = nullptr;
+    const char* m_strings = nullptr;
+    uint64_t m_stringsSize = 0;
+#ifdef _WIN32
+    std::string m_content; //без mmap: файл читается целиком
+#endif
+
+    friend class ManifestCompiler;
+};
+
+/*
+Сборка двоичного манифеста. Повтор пути заменяет прежний digest.
+Подбор pilot'ов: корзины от больших к малым, для каждой перебираются
+pilot = 0, 1, ... до первого, при котором все ее пути попадают в свободные
+слоты. Если корзина не размещается или у двух путей совпал 64-битный
+хеш, все начинается заново с другим seed.
+*/
+class ManifestCompiler {
+public:
+    //false - digest не 64 hex-символа или путь пустой
+    bool add(std::string_view path, std::string_view hexDigest);
+    //Список в формате sha256sum; ошибки разбора - в std::cerr с номером строки
+    bool addList(const std::string& listFile);
+    bool write(const std::string& outputFile) const;
+
+    size_t size() const { return m_paths.size(); }
+    size_t duplicates() const { return m_duplicates; }
+
+private:
+    bool build(std::vector<uint32_t>& pilots, std::vector<uint32_t>& slotKeys, uint64_t& seed, uint64_t& buckets) const;
+
+    std::vector<std::string> m_paths;
+    std::vector<unsigned char> m_digests; //DIGEST_SIZE байт на путь
+    std::unordered_map<std::string, size_t> m_index;
+    size_t m_duplicates = 0;
+};
@@ -0,0 +1,181 @@
+#include "JsonWriter.h"
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define JSON_WRITER_SSE2 1
+#endif
+
+namespace {
+
+const char DIGIT_PAIRS[] =
+    "00010203040506070809"
+    "10111213141516171819"
+    "20212223242526272829"
+    "30313233343536373839"
+    "40414243444546474849"
+    "50515253545556575859"
+    "60616263646566676869"
+    "70717273747576777879"
+    "80818283848586878889"
+    "90919293949596979899";
+
+const char HEX[] = "0123456789abcdef";
+
+//Экранирует один символ; возвращает сколько байт записано
+inline size_t escapeChar(unsigned char c, char* out) {
+    switch (c) {
+    case '"': out[0] = '\\'; out[1] = '"'; return 2;
+    case '\\': out[0] = '\\'; out[1] = '\\'; return 2;
+    case '\n': out[0] = '\\'; out[1] = 'n'; return 2;
+    case '\r': out[0] = '\\'; out[1] = 'r'; return 2;
+    case '\t': out[0] = '\\'; out[1] = 't'; return 2;
+    case '\b': out[0] = '\\'; out[1] = 'b'; return 2;
+    case '\f': out[0] = '\\'; out[1] = 'f'; return 2;
+    default:
+        std::memcpy(out, "\\u00", 4);
+        out[4] = HEX[c >> 4];
+        out[5] = HEX[c & 0x0F];
+        return 6;
+    }
+}
+
+//1 - символ нужно экранировать: управляющие, кавычка, обратная косая черта
+const unsigned char ESCAPE_TABLE[256] = {
+    1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1, 1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,1,
+    0,0,1,0,0,0,0,0,0,0,0,0,0,0,0,0, 0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,
+    0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0, 0,0,0,0,0,0,0,0,0,0,0,0,1,0,0,0,
+};
+
+inline bool needsEscape(unsigned char c) {
+    return ESCAPE_TABLE[c] != 0;
+}
+
+inline size_t digitCount(uint32_t value) {
+    size_t count = 1;
+    while (value >= 10000) {
+        value /= 10000;
+        count += 4;
+    }
+    if (value >= 1000) return count + 3;
+    if (value >= 100) return count + 2;
+    if (value >= 10) return count + 1;
+    return count;
+}
+
+#ifdef __GNUC__
+inline unsigned lowestBit(unsigned mask) { return static_cast<unsigned>(__builtin_ctz(mask)); }
+#else
+inline unsigned lowestBit(unsigned mask) {
+    unsigned index = 0;
+    while (!(mask & 1u)) {
+        mask >>= 1;
+        ++index;
+    }
+    return index;
+}
+#endif
+
+} // namespace
+
+void JsonWriter::grow(size_t required) {
+    size_t capacity = m_buffer.size() < 256 ? 256 : m_buffer.size() * 2;
+    while (capacity < required) {
+        capacity *= 2;
+    }
+    m_buffer.resize(capacity);
+}
+
+void JsonWriter::number(uint64_t value) {
+    ensure(20);
+    char* out = &m_buffer[m_size];
+    //PID и счетчики почти всегда 32-битные: деление uint32 заметно дешевле 64-битного
+    if (value <= 0xFFFFFFFFu) {
+        uint32_t small = static_cast<uint32_t>(value);
+        size_t length = digitCount(small);
+        char* pos = out + length;
+        while (small >= 100) {
+            uint32_t pair = (small % 100) * 2;
+            small /= 100;
+            pos -= 2;
+            std::memcpy(pos, DIGIT_PAIRS + pair, 2);
+        }
+        if (small >= 10) {
+            std::memcpy(pos - 2, DIGIT_PAIRS + small * 2, 2);
+        } else {
+            pos[-1] = static_cast<char>('0' + small);
+        }
+        m_size += length;
+        return;
+    }
+
+    char digits[20];
+    char* end = digits + sizeof(digits);
+    char* pos = end;
+    while (value >= 100) {
+        unsigned pair = static_cast<unsigned>(value % 100) * 2;
+        value /= 100;
+        pos -= 2;
+        std::memcpy(pos, DIGIT_PAIRS + pair, 2);
+    }
+    if (value >= 10) {
+        pos -= 2;
+        std::memcpy(pos, DIGIT_PAIRS + value * 2, 2);
+    } else {
+        *--pos = static_cast<char>('0' + value);
+    }
+    size_t length = static_cast<size_t>(end - pos);
+    std::memcpy(out, pos, length);
+    m_size += length;
+}
+
+void JsonWriter::string(std::string_view value) {
+    //Худший случай - каждый байт превращается в \u00XX; дальше пишем без проверок
+    ensure(value.size() * 6 + 2);
+    char* out = &m_buffer[m_size];
+    const char* in = value.data();
+    const char* end = in + value.size();
+    *out++ = '"';
+
+#ifdef JSON_WRITER_SSE2
+    const __m128i quote = _mm_set1_epi8('"');
+    const __m128i backslash = _mm_set1_epi8('\\');
+    const __m128i control = _mm_set1_epi8(0x1F);
+    while (end - in >= 16) {
+        __m128i chunk = _mm_loadu_si128(reinterpret_cast<const __m128i*>(in));
+        //c <= 0x1F  <=>  max(c, 0x1F) == 0x1F (беззнаковое сравнение)
+        __m128i special = _mm_or_si128(
+            _mm_or_si128(_mm_cmpeq_epi8(chunk, quote), _mm_cmpeq_epi8(chunk, backslash)),
+            _mm_cmpeq_epi8(_mm_max_epu8(chunk, control), control));
+        unsigned mask = static_cast<unsigned>(_mm_movemask_epi8(special));
+        if (mask == 0) {
+            _mm_storeu_si128(reinterpret_cast<__m128i*>(out), chunk);
+            in += 16;
+            out += 16;
+            continue;
+        }
+        unsigned clean = lowestBit(mask);
+        std::memcpy(out, in, clean);
+        out += clean;
+        in += clean;
+        out += escapeChar(static_cast<unsigned char>(*in++), out);
+    }
+#endif
+
+    //Хвост короче блока: копируем целиком, посимвольно - только если нашелся спецсимвол
+    size_t tail = static_cast<size_t>(end - in);
+    std::memcpy(out, in, tail);
+    const char* special = in;
+    while (special < end && !needsEscape(static_cast<unsigned char>(*special))) {
+        ++special;
+    }
+    out += special - in;
+    for (in = special; in < end; ++in) {
+        unsigned char c = static_cast<unsigned char>(*in);
+        if (needsEscape(c)) {
+            out += escapeChar(c, out);
+        } else {
+            *out++ = static_cast<char>(c);
+        }
+    }
+    *out++ = '"';
+    m_size = static_cast<size_t>(out - m_buffer.data());
+}
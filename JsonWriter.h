@@ -0,0 +1,58 @@
+// JsonWriter.h
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <string_view>
+
+/*
+Запись JSON в переиспользуемый буфер без промежуточных строк.
+- clear() сохраняет емкость: после прогрева сериализация не аллоцирует
+- целые форматируются вручную по таблице двузначных чисел
+- строки экранируются блоками по 16 байт (SSE2): чистые участки
+  копируются целиком, посимвольно обрабатываются только спецсимволы
+Структуру ({, [, запятые) вызывающий код пишет сам через raw().
+*/
+class JsonWriter {
+public:
+    JsonWriter() : m_size(0) {}
+
+    void clear() { m_size = 0; }
+    void reserve(size_t capacity) {
+        if (capacity > m_buffer.size()) {
+            m_buffer.resize(capacity);
+        }
+    }
+
+    const char* data() const { return m_buffer.data(); }
+    size_t size() const { return m_size; }
+    std::string_view view() const { return std::string_view(m_buffer.data(), m_size); }
+    std::string str() const { return std::string(m_buffer.data(), m_size); }
+
+    void raw(char value) {
+        ensure(1);
+        m_buffer[m_size++] = value;
+    }
+
+    void raw(std::string_view value) {
+        ensure(value.size());
+        std::memcpy(&m_buffer[m_size], value.data(), value.size());
+        m_size += value.size();
+    }
+
+    void number(uint64_t value);
+    //Строка в кавычках с экранированием по RFC 8259
+    void string(std::string_view value);
+
+private:
+    void ensure(size_t extra) {
+        if (m_size + extra > m_buffer.size()) {
+            grow(m_size + extra);
+        }
+    }
+    void grow(size_t required);
+
+    std::string m_buffer; //используется как массив байт; значимы первые m_size
+    size_t m_size;
+};
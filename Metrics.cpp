@@ -0,0 +1,264 @@
+#include "Metrics.h"
+#include "JsonWriter.h"
+#include <algorithm>
+#include <cstdio>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+namespace {
+
+struct MetricInfo {
+    Metrics::Type type;
+    std::string name;
+    std::string help;
+    std::string labelName;
+    std::string labelValue;
+    size_t cell;
+    const std::atomic<int64_t>* gauge;
+};
+
+//Сверх MAX_CELLS - запасные ячейки: метрика работает, но не выводится
+const size_t SPARE_CELLS = Metrics::HISTOGRAM_CELLS;
+
+struct ThreadCells {
+    std::atomic<uint64_t> cells[Metrics::MAX_CELLS + SPARE_CELLS];
+
+    ThreadCells() {
+        for (auto& cell : cells) {
+            cell.store(0, std::memory_order_relaxed);
+        }
+    }
+};
+
+struct Registry {
+    std::mutex mutex;
+    std::vector<MetricInfo> metrics;
+    size_t cells = 0;
+    std::vector<ThreadCells*> threads;
+    std::vector<uint64_t> retired = std::vector<uint64_t>(Metrics::MAX_CELLS); //завершившиеся потоки
+};
+
+//Не уничтожается: потоки могут завершаться после деструкторов статиков
+Registry& registry() {
+    static Registry* instance = new Registry();
+    return *instance;
+}
+
+struct ThreadAttachment {
+    ThreadCells* cells;
+
+    ThreadAttachment() : cells(new ThreadCells()) {
+        Registry& reg = registry();
+        std::lock_guard<std::mutex> lock(reg.mutex);
+        reg.threads.push_back(cells);
+    }
+
+    ~ThreadAttachment() {
+        Registry& reg = registry();
+        std::lock_guard<std::mutex> lock(reg.mutex);
+        for (size_t i = 0; i < Metrics::MAX_CELLS; ++i) {
+            reg.retired[i] += cells->cells[i].load(std::memory_order_relaxed);
+        }
+        reg.threads.erase(std::remove(reg.threads.begin(), reg.threads.end(), cells), reg.threads.end());
+        delete cells;
+    }
+};
+
+//Сумма ячеек по всем потокам; под registry().mutex
+void collect(std::vector<uint64_t>& totals) {
+    Registry& reg = registry();
+    totals = reg.retired;
+    for (ThreadCells* thread : reg.threads) {
+        for (size_t i = 0; i < reg.cells; ++i) {
+            totals[i] += thread->cells[i].load(std::memory_order_relaxed);
+        }
+    }
+}
+
+uint64_t bucketBoundNs(size_t bucket) {
+    return (1ull << bucket) * 1000;
+}
+
+//Верхняя граница интервала, в котором лежит доля quantile наблюдений
+uint64_t quantileNs(const uint64_t* buckets, uint64_t count, double quantile) {
+    uint64_t rank = static_cast<uint64_t>(static_cast<double>(count) * quantile + 0.5);
+    uint64_t seen = 0;
+    for (size_t bucket = 0; bucket < Metrics::BUCKETS; ++bucket) {
+        seen += buckets[bucket];
+        if (seen >= rank && seen > 0) {
+            return bucketBoundNs(bucket);
+        }
+    }
+    return bucketBoundNs(Metrics::BUCKETS - 1) * 2;
+}
+
+void appendSeconds(std::string& out, uint64_t nanoseconds) {
+    char text[32];
+    int length = std::snprintf(text, sizeof(text), "%.9g", static_cast<double>(nanoseconds) / 1e9);
+    out.append(text, static_cast<size_t>(length));
+}
+
+void appendLabels(std::string& out, const MetricInfo& metric, const char* extraName, const std::string& extraValue) {
+    bool hasLabel = !metric.labelName.empty();
+    if (!hasLabel && !extraName) {
+        return;
+    }
+    out += '{';
+    if (hasLabel) {
+        out += metric.labelName + "=\"" + metric.labelValue + "\"";
+    }
+    if (extraName) {
+        out += hasLabel ? "," : "";
+        out += std::string(extraName) + "=\"" + extraValue + "\"";
+    }
+    out += '}';
+}
+
+const char* typeName(Metrics::Type type) {
+    switch (type) {
+    case Metrics::Type::Counter: return "counter";
+    case Metrics::Type::Gauge: return "gauge";
+    default: return "histogram";
+    }
+}
+
+} // namespace
+
+size_t Metrics::registerMetric(Type type, const char* name, const char* help, const char* labelName,
+                               const char* labelValue, const std::atomic<int64_t>* gauge) {
+    Registry& reg = registry();
+    std::lock_guard<std::mutex> lock(reg.mutex);
+    size_t width = type == Type::Histogram ? HISTOGRAM_CELLS : type == Type::Counter ? 1 : 0;
+    if (reg.cells + width > MAX_CELLS) {
+        std::cerr << "Metric cells exhausted, not exported: " << name << std::endl;
+        return MAX_CELLS;
+    }
+    MetricInfo info;
+    info.type = type;
+    info.name = name;
+    info.help = help;
+    info.labelName = labelName ? labelName : "";
+    info.labelValue = labelValue ? labelValue : "";
+    info.cell = reg.cells;
+    info.gauge = gauge;
+    reg.metrics.push_back(info);
+    reg.cells += width;
+    return info.cell;
+}
+
+std::atomic<uint64_t>* Metrics::threadCells() {
+    thread_local ThreadAttachment attachment;
+    return attachment.cells->cells;
+}
+
+void Metrics::writeJson(JsonWriter& out) {
+    out.raw("{\"status\":\"success\",\"metrics_enabled\":");
+    out.raw(enabled() ? "true" : "false");
+    out.raw(",\"metrics\":[");
+    Registry& reg = registry();
+    std::vector<uint64_t> totals;
+    std::lock_guard<std::mutex> lock(reg.mutex);
+    collect(totals);
+    bool first = true;
+    for (const MetricInfo& metric : reg.metrics) {
+        out.raw(first ? "{\"name\":" : ",{\"name\":");
+        first = false;
+        out.string(metric.name);
+        if (!metric.labelName.empty()) {
+            out.raw(",\"labels\":{");
+            out.string(metric.labelName);
+            out.raw(':');
+            out.string(metric.labelValue);
+            out.raw('}');
+        }
+        out.raw(",\"type\":\"");
+        out.raw(typeName(metric.type));
+        out.raw('"');
+        if (metric.type == Type::Counter) {
+            out.raw(",\"value\":");
+            out.number(totals[metric.cell]);
+        } else if (metric.type == Type::Gauge) {
+            int64_t value = metric.gauge->load(std::memory_order_relaxed);
+            out.raw(",\"value\":");
+            if (value < 0) {
+                out.raw('-');
+            }
+            out.number(static_cast<uint64_t>(value < 0 ? -value : value));
+        } else {
+            const uint64_t* buckets = &totals[metric.cell];
+            uint64_t count = 0;
+            for (size_t bucket = 0; bucket <= BUCKETS; ++bucket) {
+                count += buckets[bucket];
+            }
+            out.raw(",\"count\":");
+            out.number(count);
+            out.raw(",\"sum_ns\":");
+            out.number(buckets[BUCKETS + 1]);
+            if (count > 0) {
+                out.raw(",\"p50_ns\":");
+                out.number(quantileNs(buckets, count, 0.5));
+                out.raw(",\"p99_ns\":");
+                out.number(quantileNs(buckets, count, 0.99));
+            }
+        }
+        out.raw('}');
+    }
+    out.raw("]}");
+}
+
+void Metrics::writePrometheus(std::string& out) {
+    Registry& reg = registry();
+    std::vector<uint64_t> totals;
+    std::lock_guard<std::mutex> lock(reg.mutex);
+    collect(totals);
+
+    //HELP и TYPE - один раз на имя; метрики с одним именем и разными метками идут подряд
+    std::vector<const MetricInfo*> ordered;
+    for (const MetricInfo& metric : reg.metrics) {
+        ordered.push_back(&metric);
+    }
+    std::stable_sort(ordered.begin(), ordered.end(), [](const MetricInfo* a, const MetricInfo* b) {
+        return a->name < b->name;
+    });
+    const std::string* previous = nullptr;
+    for (const MetricInfo* metric : ordered) {
+        if (!previous || *previous != metric->name) {
+            out += "# HELP " + metric->name + " " + metric->help + "\n";
+            out += "# TYPE " + metric->name + " " + typeName(metric->type) + "\n";
+            previous = &metric->name;
+        }
+        if (metric->type == Type::Counter) {
+            out += metric->name;
+            appendLabels(out, *metric, nullptr, "");
+            out += " " + std::to_string(totals[metric->cell]) + "\n";
+        } else if (metric->type == Type::Gauge) {
+            out += metric->name;
+            appendLabels(out, *metric, nullptr, "");
+            out += " " + std::to_string(metric->gauge->load(std::memory_order_relaxed)) + "\n";
+        } else {
+            const uint64_t* buckets = &totals[metric->cell];
+            uint64_t cumulative = 0;
+            for (size_t bucket = 0; bucket <= BUCKETS; ++bucket) {
+                cumulative += buckets[bucket];
+                std::string bound;
+                if (bucket < BUCKETS) {
+                    appendSeconds(bound, bucketBoundNs(bucket));
+                } else {
+                    bound = "+Inf";
+                }
+                out += metric->name + "_bucket";
+                appendLabels(out, *metric, "le", bound);
+                out += " " + std::to_string(cumulative) + "\n";
+            }
+            out += metric->name + "_sum";
+            appendLabels(out, *metric, nullptr, "");
+            out += ' ';
+            appendSeconds(out, buckets[BUCKETS + 1]);
+            out += "\n" + metric->name + "_count";
+            appendLabels(out, *metric, nullptr, "");
+            out += " " + std::to_string(cumulative) + "\n";
+        }
+    }
+}
@@ -0,0 +1,158 @@
+// Metrics.h
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+//Сборка с -DMONITOR_METRICS=0 (CMake: -DMONITOR_METRICS=OFF) превращает все вызовы в пустые
+#ifndef MONITOR_METRICS
+#define MONITOR_METRICS 1
+#endif
+
+class JsonWriter;
+
+/*
+Метрики самого монитора: счетчики, гистограммы задержек и мгновенные значения.
+- метрика - статический объект с именем в стиле Prometheus, объявляется
+  рядом с измеряемым кодом и регистрируется при старте
+- счетчики и гистограммы пишутся в ячейки своего потока без атомарных
+  операций чтения-изменения-записи и без блокировок; чтение (stats,
+  GET /metrics) складывает ячейки всех потоков. Ячейки завершившегося
+  потока прибавляются к общему остатку
+- гистограмма - фиксированные интервалы 1 мкс * 2^k (до ~67 с) и +Inf
+- мгновенные значения (глубина очереди, число процессов) - один атомик
+*/
+class Metrics {
+public:
+    static constexpr size_t MAX_CELLS = 1024;  //ячеек на поток на все метрики
+    static constexpr size_t BUCKETS = 27;      //границы гистограммы: 1 мкс .. 2^26 мкс
+    static constexpr size_t HISTOGRAM_CELLS = BUCKETS + 2; //+Inf и сумма, нс
+
+    enum class Type : uint8_t { Counter, Gauge, Histogram };
+
+    static constexpr bool enabled() { return MONITOR_METRICS != 0; }
+
+    //Регистрация (конструкторы метрик); возвращает первую ячейку
+    static size_t registerMetric(Type type, const char* name, const char* help, const char* labelName,
+                                 const char* labelValue, const std::atomic<int64_t>* gauge);
+    //Ячейки текущего потока (создаются при первом обращении)
+    static std::atomic<uint64_t>* threadCells();
+
+    //Все метрики, сложенные по потокам
+    static void writeJson(JsonWriter& out);
+    static void writePrometheus(std::string& out);
+
+    //Номер интервала гистограммы для длительности в нс
+    static size_t bucketOf(uint64_t nanoseconds) {
+        uint64_t micros = (nanoseconds + 999) / 1000;
+#if defined(__GNUC__)
+        //ceil(log2(micros)) без цикла
+        size_t bucket = micros <= 1 ? 0 : static_cast<size_t>(64 - __builtin_clzll(micros - 1));
+        return bucket < BUCKETS ? bucket : BUCKETS;
+#else
+        size_t bucket = 0;
+        while (bucket < BUCKETS && (1ull << bucket) < micros) {
+            ++bucket;
+        }
+        return bucket;
+#endif
+    }
+};
+
+#if MONITOR_METRICS
+
+class MetricCounter {
+public:
+    MetricCounter(const char* name, const char* help, const char* labelName = nullptr, const char* labelValue = nullptr)
+        : m_cell(Metrics::registerMetric(Metrics::Type::Counter, name, help, labelName, labelValue, nullptr)) {}
+
+    void add(uint64_t value = 1) const {
+        //Ячейку пишет только этот поток: обычные load/store вместо fetch_add
+        std::atomic<uint64_t>& cell = Metrics::threadCells()[m_cell];
+        cell.store(cell.load(std::memory_order_relaxed) + value, std::memory_order_relaxed);
+    }
+
+private:
+    size_t m_cell;
+};
+
+class MetricHistogram {
+public:
+    MetricHistogram(const char* name, const char* help, const char* labelName = nullptr, const char* labelValue = nullptr)
+        : m_cell(Metrics::registerMetric(Metrics::Type::Histogram, name, help, labelName, labelValue, nullptr)) {}
+
+    void observe(uint64_t nanoseconds) const {
+        std::atomic<uint64_t>* cells = Metrics::threadCells() + m_cell;
+        std::atomic<uint64_t>& bucket = cells[Metrics::bucketOf(nanoseconds)];
+        bucket.store(bucket.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+        std::atomic<uint64_t>& sum = cells[Metrics::BUCKETS + 1];
+        sum.store(sum.load(std::memory_order_relaxed) + nanoseconds, std::memory_order_relaxed);
+    }
+
+private:
+    size_t m_cell;
+};
+
+class MetricGauge {
+public:
+    MetricGauge(const char* name, const char* help, const char* labelName = nullptr, const char* labelValue = nullptr)
+        : m_value(0) {
+        Metrics::registerMetric(Metrics::Type::Gauge, name, help, labelName, labelValue, &m_value);
+    }
+
+    void set(int64_t value) { m_value.store(value, std::memory_order_relaxed); }
+    void add(int64_t delta) { m_value.fetch_add(delta, std::memory_order_relaxed); }
+    int64_t value() const { return m_value.load(std::memory_order_relaxed); }
+
+private:
+    std::atomic<int64_t> m_value;
+};
+
+//Время жизни объекта - в гистограмму
+class MetricTimer {
+public:
+    explicit MetricTimer(const MetricHistogram& histogram)
+        : m_histogram(histogram), m_start(std::chrono::steady_clock::now()) {}
+    ~MetricTimer() {
+        m_histogram.observe(static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now() - m_start).count()));
+    }
+
+    MetricTimer(const MetricTimer&) = delete;
+    MetricTimer& operator=(const MetricTimer&) = delete;
+
+private:
+    const MetricHistogram& m_histogram;
+    std::chrono::steady_clock::time_point m_start;
+};
+
+#else
+
+class MetricCounter {
+public:
+    MetricCounter(const char*, const char*, const char* = nullptr, const char* = nullptr) {}
+    void add(uint64_t = 1) const {}
+};
+
+class MetricHistogram {
+public:
+    MetricHistogram(const char*, const char*, const char* = nullptr, const char* = nullptr) {}
+    void observe(uint64_t) const {}
+};
+
+class MetricGauge {
+public:
+    MetricGauge(const char*, const char*, const char* = nullptr, const char* = nullptr) {}
+    void set(int64_t) {}
+    void add(int64_t) {}
+    int64_t value() const { return 0; }
+};
+
+class MetricTimer {
+public:
+    explicit MetricTimer(const MetricHistogram&) {}
+};
+
+#endif
@@ -0,0 +1,783 @@
+#include "NetworkServer.h"
+#include "ProcessJson.h"
+#include "ProcessBinary.h"
+#include "Metrics.h"
+#include <iostream>
+#include <algorithm>
+#include <deque>
+#include <unordered_map>
+#ifdef __linux__
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <unistd.h>
+#include <cerrno>
+#include <cstring>
+#endif
+
+#ifdef __linux__
+
+namespace {
+
+const size_t MAX_REQUEST_SIZE = 4096;      //длиннее - клиент неисправен, закрываем
+const size_t MAX_PENDING_RESPONSES = 64;   //больше - перестаем читать, пока клиент не заберет ответы
+const size_t MAX_STREAM_BACKLOG = 1 << 20; //неотправленных байт у подписчика; больше - resync
+const size_t READ_CHUNK = 4096;
+const int MAX_EVENTS = 256;
+const int MAX_IOV = 16;
+
+MetricGauge openConnections("monitor_connections", "Open client connections");
+MetricHistogram requestDuration("monitor_request_seconds", "Protocol request handling");
+MetricCounter invalidRequests("monitor_requests_total", "Protocol requests", "command", "invalid");
+//Порядок совпадает с requestCounters
+const char* const COMMANDS[] = {"get_processes", "subscribe", "get_history", "set_format", "stats", "http", "get_fds",
+                                "find_holders"};
+MetricCounter requestCounters[] = {
+    {"monitor_requests_total", "Protocol requests", "command", "get_processes"},
+    {"monitor_requests_total", "Protocol requests", "command", "subscribe"},
+    {"monitor_requests_total", "Protocol requests", "command", "get_history"},
+    {"monitor_requests_total", "Protocol requests", "command", "set_format"},
+    {"monitor_requests_total", "Protocol requests", "command", "stats"},
+    {"monitor_requests_total", "Protocol requests", "command", "http"},
+    {"monitor_requests_total", "Protocol requests", "command", "get_fds"},
+    {"monitor_requests_total", "Protocol requests", "command", "find_holders"},
+};
+
+void countRequest(std::string_view command) {
+    for (size_t i = 0; i < sizeof(COMMANDS) / sizeof(COMMANDS[0]); ++i) {
+        if (command == COMMANDS[i]) {
+            requestCounters[i].add();
+            return;
+        }
+    }
+    invalidRequests.add();
+}
+
+//HTTP/1.0 ответ на GET /metrics (текстовый формат Prometheus); остальные пути - 404
+SnapshotCache::Payload httpResponse(std::string_view requestLine) {
+    size_t pathEnd = requestLine.find(' ', 4);
+    std::string_view path = requestLine.substr(4, pathEnd == std::string_view::npos ? std::string_view::npos : pathEnd - 4);
+    std::string body;
+    const char* status = "200 OK";
+    if (path == "/metrics") {
+        Metrics::writePrometheus(body);
+    } else {
+        status = "404 Not Found";
+        body = "not found\n";
+    }
+    std::string text = std::string("HTTP/1.0 ") + status + "\r\n" +
+                       "Content-Type: text/plain; version=0.0.4\r\n" +
+                       "Content-Length: " + std::to_string(body.size()) + "\r\n" +
+                       "Connection: close\r\n\r\n";
+    text += body;
+    return std::make_shared<const std::string>(std::move(text));
+}
+
+SnapshotCache::Payload errorPayload(const std::string& message, bool binary) {
+    std::string text;
+    if (binary) {
+        ProcessBinaryEncoder::writeError(text, message);
+    } else {
+        text = ProcessJson::serializeError(message);
+        text += '\n';
+    }
+    return std::make_shared<const std::string>(std::move(text));
+}
+
+} // namespace
+
+struct NetworkServer::Connection {
+    //Ответ в очереди на отправку: общий снимок + сколько уже отправлено
+    struct Pending {
+        SnapshotCache::Payload data;
+        size_t offset;
+        bool stream; //сообщение подписки: при переполнении его можно выбросить
+    };
+
+    int fd = -1;
+    std::string input;
+    std::deque<Pending> output;
+    size_t pendingBytes = 0;
+
+    bool subscribed = false;
+    bool needsResync = false;
+    bool http = false; //запрос GET: после ответа соединение закрывается
+    //Первый запрос в input ждет поколения с нужной частью снимка; до него следующие не разбираются
+    bool waiting = false;
+    bool deferred = false; //первый запрос в input уже откладывался (учтен в метриках)
+    uint64_t generation = 0; //последнее поколение, отправленное подписчику
+
+    //Двоичный формат: какая часть общего словаря строк уже есть у клиента
+    bool binary = false;
+    uint32_t dictionaryEpoch = 0;
+    size_t knownStrings = 0;
+
+    void enqueue(const SnapshotCache::Payload& data, bool stream) {
+        output.push_back(Pending{data, 0, stream});
+        pendingBytes += data->size();
+    }
+
+    //Выбрасываем еще не начатые сообщения подписки - их заменит полный снимок
+    void dropStream() {
+        for (auto it = output.begin(); it != output.end();) {
+            if (it->stream && it->offset == 0) {
+                pendingBytes -= it->data->size();
+                it = output.erase(it);
+            } else {
+                ++it;
+            }
+        }
+    }
+};
+
+struct NetworkServer::Loop {
+    int epollFd = -1;
+    int listenFd = -1;
+    int wakeFd = -1; //eventfd: новое поколение снимка или остановка
+    std::unordered_map<int, std::unique_ptr<Connection>> connections;
+
+    ~Loop() {
+        for (auto& entry : connections) {
+            ::close(entry.first);
+        }
+        openConnections.add(-static_cast<int64_t>(connections.size()));
+        if (listenFd >= 0) ::close(listenFd);
+        if (wakeFd >= 0) ::close(wakeFd);
+        if (epollFd >= 0) ::close(epollFd);
+    }
+};
+
+namespace {
+
+int openListenSocket(int port) {
+    int fd = ::socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (fd < 0) {
+        std::cerr << "socket failed: " << std::strerror(errno) << std::endl;
+        return -1;
+    }
+    int enable = 1;
+    ::setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &enable, sizeof(enable));
+    if (::setsockopt(fd, SOL_SOCKET, SO_REUSEPORT, &enable, sizeof(enable)) != 0) {
+        std::cerr << "SO_REUSEPORT failed: " << std::strerror(errno) << std::endl;
+        ::close(fd);
+        return -1;
+    }
+
+    sockaddr_in address;
+    std::memset(&address, 0, sizeof(address));
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = htonl(INADDR_ANY);
+    address.sin_port = htons(static_cast<uint16_t>(port));
+    if (::bind(fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0 ||
+        ::listen(fd, SOMAXCONN) != 0) {
+        std::cerr << "Cannot listen on port " << port << ": " << std::strerror(errno) << std::endl;
+        ::close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+int boundPort(int fd) {
+    sockaddr_in address;
+    socklen_t length = sizeof(address);
+    if (::getsockname(fd, reinterpret_cast<sockaddr*>(&address), &length) != 0) {
+        return -1;
+    }
+    return ntohs(address.sin_port);
+}
+
+bool watch(int epollFd, int fd, uint32_t events) {
+    epoll_event event;
+    std::memset(&event, 0, sizeof(event));
+    event.events = events;
+    event.data.fd = fd;
+    return ::epoll_ctl(epollFd, EPOLL_CTL_ADD, fd, &event) == 0;
+}
+
+} // namespace
+
+NetworkServer::NetworkServer() : m_running(false), m_port(0) {}
+
+NetworkServer::~NetworkServer() {
+    stop();
+}
+
+bool NetworkServer::start(int port, size_t loops) {
+    if (m_running.load()) {
+        return false;
+    }
+    if (loops == 0) {
+        loops = std::max(1u, std::thread::hardware_concurrency());
+    }
+
+    m_port = port;
+    for (size_t i = 0; i < loops; ++i) {
+        std::unique_ptr<Loop> loop(new Loop());
+        //Первый сокет может получить порт от ядра (port = 0), остальные садятся на тот же
+        loop->listenFd = openListenSocket(m_port);
+        loop->epollFd = ::epoll_create1(EPOLL_CLOEXEC);
+        loop->wakeFd = ::eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+        if (loop->listenFd < 0 || loop->epollFd < 0 || loop->wakeFd < 0 ||
+            !watch(loop->epollFd, loop->listenFd, EPOLLIN | EPOLLET) ||
+            !watch(loop->epollFd, loop->wakeFd, EPOLLIN)) {
+            std::cerr << "Cannot create event loop " << i << std::endl;
+            m_loops.clear();
+            return false;
+        }
+        if (m_port == 0) {
+            m_port = boundPort(loop->listenFd);
+        }
+        m_loops.push_back(std::move(loop));
+    }
+
+    m_running.store(true);
+    m_cache.setListener([this]() { wakeLoops(); });
+    m_cache.setWakeup([this]() {
+        std::lock_guard<std::mutex> lock(m_publishMutex);
+        m_publishCondition.notify_all();
+    });
+    for (auto& loop : m_loops) {
+        Loop* current = loop.get();
+        m_threads.emplace_back([this, current]() { runLoop(*current); });
+    }
+    m_publisher = std::thread([this]() { publishLoop(); });
+    return true;
+}
+
+void NetworkServer::stop() {
+    if (!m_running.exchange(false)) {
+        return;
+    }
+    {
+        std::lock_guard<std::mutex> lock(m_publishMutex);
+        m_publishCondition.notify_all();
+    }
+    m_publisher.join();
+    wakeLoops();
+    for (auto& thread : m_threads) {
+        thread.join();
+    }
+    m_cache.setListener(nullptr);
+    m_cache.setWakeup(nullptr);
+    m_threads.clear();
+    m_loops.clear();
+}
+
+void NetworkServer::wakeLoops() {
+    for (auto& loop : m_loops) {
+        uint64_t one = 1;
+        if (::write(loop->wakeFd, &one, sizeof(one)) != sizeof(one)) {
+            std::cerr << "Cannot wake event loop: " << std::strerror(errno) << std::endl;
+        }
+    }
+}
+
+void NetworkServer::publishLoop() {
+    std::unique_lock<std::mutex> lock(m_publishMutex);
+    while (m_running.load()) {
+        lock.unlock();
+        m_cache.refresh(); //пересоберет, если снимок устарел или его заказал запрос; слушатель разбудит циклы
+        lock.lock();
+        m_publishCondition.wait_until(lock, m_cache.expiresAt(),
+                                      [this]() { return !m_running.load() || m_cache.wanted(); });
+    }
+}
+
+void NetworkServer::runLoop(Loop& loop) {
+    epoll_event events[MAX_EVENTS];
+    while (m_running.load()) {
+        int count = ::epoll_wait(loop.epollFd, events, MAX_EVENTS, -1);
+        if (count < 0) {
+            if (errno == EINTR) continue;
+            std::cerr << "epoll_wait failed: " << std::strerror(errno) << std::endl;
+            break;
+        }
+        for (int i = 0; i < count; ++i) {
+            int fd = events[i].data.fd;
+            if (fd == loop.wakeFd) {
+                uint64_t value;
+                if (::read(loop.wakeFd, &value, sizeof(value)) < 0 && errno != EAGAIN) {
+                    std::cerr << "eventfd read failed: " << std::strerror(errno) << std::endl;
+                }
+                if (m_running.load()) {
+                    deliverAll(loop); //опубликовано новое поколение
+                }
+                continue;
+            }
+            if (fd == loop.listenFd) {
+                acceptClients(loop);
+                continue;
+            }
+
+            auto it = loop.connections.find(fd);
+            if (it == loop.connections.end()) {
+                continue;
+            }
+            Connection& connection = *it->second;
+            bool alive = !(events[i].events & (EPOLLERR | EPOLLHUP));
+            //Сначала отдаем накопленное: освободившееся место позволяет читать дальше
+            if (alive && (events[i].events & EPOLLOUT)) {
+                alive = flushOutput(connection);
+            }
+            if (alive) {
+                alive = handleInput(connection);
+            }
+            //Буфер опустел - отстававший подписчик получает свежий снимок
+            if (alive && connection.needsResync && connection.output.empty()) {
+                if (SnapshotCache::PublishedPtr published = m_cache.latest()) {
+                    deliver(connection, *published);
+                    alive = flushOutput(connection);
+                }
+            }
+            if (!alive) {
+                closeConnection(loop, fd);
+            }
+        }
+    }
+}
+
+void NetworkServer::acceptClients(Loop& loop) {
+    //Edge-triggered: принимаем, пока очередь listen не опустеет
+    for (;;) {
+        int fd = ::accept4(loop.listenFd, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (fd < 0) {
+            if (errno == EINTR || errno == ECONNABORTED) continue;
+            if (errno != EAGAIN && errno != EWOULDBLOCK) {
+                std::cerr << "accept failed: " << std::strerror(errno) << std::endl;
+            }
+            return;
+        }
+        int enable = 1;
+        ::setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &enable, sizeof(enable));
+        if (!watch(loop.epollFd, fd, EPOLLIN | EPOLLOUT | EPOLLRDHUP | EPOLLET)) {
+            ::close(fd);
+            continue;
+        }
+        std::unique_ptr<Connection> connection(new Connection());
+        connection->fd = fd;
+        loop.connections[fd] = std::move(connection);
+        openConnections.add(1);
+    }
+}
+
+bool NetworkServer::handleInput(Connection& connection) {
+    for (;;) {
+        //Разбираем все полные строки, пока клиент не завален неотправленными ответами
+        size_t start = 0;
+        size_t newline;
+        while (!connection.waiting && connection.output.size() < MAX_PENDING_RESPONSES &&
+               (newline = connection.input.find('\n', start)) != std::string::npos) {
+            std::string_view request(connection.input.data() + start, newline - start);
+            if (!request.empty() && request.back() == '\r') {
+                request.remove_suffix(1);
+            }
+            //После GET остаются заголовки HTTP - их не разбираем
+            if (!request.empty() && !connection.http) {
+                if (!handleRequest(connection, request)) {
+                    connection.waiting = true; //строка остается в input до следующего поколения
+                    connection.deferred = true;
+                    break;
+                }
+                connection.deferred = false;
+            }
+            start = newline + 1;
+        }
+        connection.input.erase(0, start);
+        if (!connection.waiting && connection.input.size() > MAX_REQUEST_SIZE) {
+            return false;
+        }
+
+        if (!connection.output.empty() && !flushOutput(connection)) {
+            return false;
+        }
+        if (connection.http && connection.output.empty()) {
+            return false; //HTTP/1.0: ответ отправлен - закрываем
+        }
+        if (connection.output.size() >= MAX_PENDING_RESPONSES || connection.waiting) {
+            //Дочитаем после EPOLLOUT, когда клиент заберет ответы, или после нового поколения (deliverAll)
+            return true;
+        }
+
+        char buffer[READ_CHUNK];
+        ssize_t got = ::recv(connection.fd, buffer, sizeof(buffer), 0);
+        if (got > 0) {
+            connection.input.append(buffer, static_cast<size_t>(got));
+            continue;
+        }
+        if (got == 0) {
+            return false; //клиент закрыл соединение
+        }
+        if (errno == EINTR) continue;
+        return errno == EAGAIN || errno == EWOULDBLOCK;
+    }
+}
+
+bool NetworkServer::flushOutput(Connection& connection) {
+    while (!connection.output.empty()) {
+        //Несколько ответов одним системным вызовом, без копирования снимка
+        iovec parts[MAX_IOV];
+        int count = 0;
+        for (auto it = connection.output.begin(); it != connection.output.end() && count < MAX_IOV; ++it) {
+            parts[count].iov_base = const_cast<char*>(it->data->data() + it->offset);
+            parts[count].iov_len = it->data->size() - it->offset;
+            ++count;
+        }
+        msghdr message;
+        std::memset(&message, 0, sizeof(message));
+        message.msg_iov = parts;
+        message.msg_iovlen = static_cast<size_t>(count);
+
+        ssize_t sent = ::sendmsg(connection.fd, &message, MSG_NOSIGNAL);
+        if (sent < 0) {
+            if (errno == EINTR) continue;
+            return errno == EAGAIN || errno == EWOULDBLOCK;
+        }
+        size_t remaining = static_cast<size_t>(sent);
+        while (remaining > 0) {
+            Connection::Pending& front = connection.output.front();
+            size_t left = front.data->size() - front.offset;
+            if (remaining < left) {
+                front.offset += remaining;
+                connection.pendingBytes -= remaining;
+                break;
+            }
+            remaining -= left;
+            connection.pendingBytes -= left;
+            connection.output.pop_front();
+        }
+    }
+    return true;
+}
+
+void NetworkServer::closeConnection(Loop& loop, int fd) {
+    auto it = loop.connections.find(fd);
+    if (it == loop.connections.end()) {
+        return;
+    }
+    openConnections.add(-1);
+    ::epoll_ctl(loop.epollFd, EPOLL_CTL_DEL, fd, nullptr);
+    ::close(fd);
+    loop.connections.erase(fd);
+}
+
+bool NetworkServer::handleRequest(Connection& connection, std::string_view request) {
+    MetricTimer timer(requestDuration);
+    //Тот же порт отвечает сборщику Prometheus: "GET /metrics HTTP/1.x"
+    if (request.substr(0, 4) == "GET ") {
+        countRequest("http");
+        connection.http = true;
+        connection.enqueue(httpResponse(request), false);
+        return true;
+    }
+
+    ProtocolRequest parsed;
+    if (!ProcessJson::parseRequest(request, parsed)) {
+        invalidRequests.add();
+        connection.enqueue(errorPayload("invalid request", connection.binary), false);
+        return true;
+    }
+    if (!connection.deferred) {
+        countRequest(parsed.command);
+    }
+
+    if (parsed.command == "set_format") {
+        if (parsed.format != "json" && parsed.format != "binary") {
+            connection.enqueue(errorPayload("unknown format: " + parsed.format, connection.binary), false);
+            return true;
+        }
+        bool binary = parsed.format == "binary";
+        SnapshotCache::PublishedPtr published;
+        if (connection.subscribed && !(published = m_cache.current(binary))) {
+            return false;
+        }
+        //Подтверждение всегда строкой JSON, дальше ответы идут в новом формате
+        connection.enqueue(std::make_shared<const std::string>(
+            "{\"status\":\"success\",\"format\":\"" + parsed.format + "\"}\n"), false);
+        connection.binary = binary;
+        if (published) {
+            sendSnapshot(connection, *published, true);
+        }
+        return true;
+    }
+
+    if (parsed.command == "get_history") {
+        sendHistory(connection, parsed);
+        return true;
+    }
+
+    if (parsed.command == "stats") {
+        sendStats(connection);
+        return true;
+    }
+
+    if (parsed.command == "get_fds" || parsed.command == "find_holders") {
+        return sendFds(connection, parsed);
+    }
+
+    if (parsed.command != "get_processes" && parsed.command != "subscribe") {
+        connection.enqueue(errorPayload("unknown command: " + parsed.command, connection.binary), false);
+        return true;
+    }
+    if (ProcessQuery::isQuery(parsed)) {
+        if (parsed.command == "subscribe") {
+            connection.enqueue(errorPayload("where/sort_by/limit/fields not supported for subscribe", connection.binary), false);
+            return true;
+        }
+        return sendQuery(connection, parsed);
+    }
+    ProcessFilter filter;
+    if (!ProcessOwner::parseFilter(parsed.filter, filter)) {
+        connection.enqueue(errorPayload("unknown filter: " + parsed.filter, connection.binary), false);
+        return true;
+    }
+
+    if (parsed.command == "get_processes") {
+        SnapshotCache::PublishedPtr published = m_cache.current(connection.binary, filter);
+        if (!published) {
+            return false;
+        }
+        if (filter == ProcessFilter::All) {
+            sendSnapshot(connection, *published, false);
+            return true;
+        }
+        if (connection.binary) {
+            sendStrings(connection, *published);
+        }
+        connection.enqueue(published->snapshot(connection.binary, filter), false);
+        return true;
+    }
+    //Дельты подписки не фильтруются: отфильтрованный поток потребовал бы своей истории поколений
+    if (filter != ProcessFilter::All) {
+        connection.enqueue(errorPayload("filter not supported for subscribe: " + parsed.filter, connection.binary), false);
+        return true;
+    }
+
+    SnapshotCache::PublishedPtr published = m_cache.current(connection.binary);
+    if (!published) {
+        return false;
+    }
+
+    //subscribe: полный снимок с номером поколения, дальше только дельты
+    sendSnapshot(connection, *published, true);
+    connection.subscribed = true;
+    return true;
+}
+
+void NetworkServer::sendHistory(Connection& connection, const ProtocolRequest& request) {
+    if (connection.binary) {
+        connection.enqueue(errorPayload("get_history is available in json format only", true), false);
+        return;
+    }
+    if (request.pid == 0 || request.pid > 0xFFFFFFFFu) {
+        connection.enqueue(errorPayload("get_history requires pid", false), false);
+        return;
+    }
+    uint32_t to = request.to != 0 ? static_cast<uint32_t>(std::min<uint64_t>(request.to, 0xFFFFFFFFu)) : m_history.latestTime();
+    uint32_t from = request.from != 0 ? static_cast<uint32_t>(std::min<uint64_t>(request.from, to)) : (to > 3600 ? to - 3600 : 0);
+    uint32_t resolution = static_cast<uint32_t>(std::min<uint64_t>(request.resolution, 0xFFFFFFFFu));
+    HistoryResult history;
+    if (!m_history.query(static_cast<DWORD>(request.pid), request.startTime, from, to, resolution, history)) {
+        connection.enqueue(errorPayload("no history for pid " + std::to_string(request.pid), false), false);
+        return;
+    }
+    JsonWriter writer;
+    writer.reserve(history.samples.size() * 96 + 128);
+    ProcessJson::writeHistory(writer, history);
+    writer.raw('\n');
+    connection.enqueue(std::make_shared<const std::string>(writer.view()), false);
+}
+
+bool NetworkServer::sendQuery(Connection& connection, const ProtocolRequest& request) {
+    if (connection.binary) {
+        connection.enqueue(errorPayload("queries are available in json format only", true), false);
+        return true;
+    }
+    ProcessQuery query;
+    std::string error;
+    if (!query.compile(request, error)) {
+        connection.enqueue(errorPayload(error, false), false);
+        return true;
+    }
+    SnapshotCache::PublishedPtr published = m_cache.current(false, ProcessFilter::All, true);
+    if (!published) {
+        return false;
+    }
+    connection.enqueue(m_queries.get(query, *published->table, published->generation, &m_history), false);
+    return true;
+}
+
+bool NetworkServer::sendFds(Connection& connection, const ProtocolRequest& request) {
+    if (connection.binary) {
+        connection.enqueue(errorPayload(request.command + " is available in json format only", true), false);
+        return true;
+    }
+    bool byPid = request.command == "get_fds";
+    if (byPid && (request.pid == 0 || request.pid > 0xFFFFFFFFu)) {
+        connection.enqueue(errorPayload("get_fds requires pid", false), false);
+        return true;
+    }
+    int keys = (request.path.empty() ? 0 : 1) + (request.port != 0 ? 1 : 0) + (request.inode != 0 ? 1 : 0);
+    if (!byPid && keys != 1) {
+        connection.enqueue(errorPayload("find_holders requires one of path, port, inode", false), false);
+        return true;
+    }
+    if (request.port > 0xFFFF) {
+        connection.enqueue(errorPayload("invalid port: " + std::to_string(request.port), false), false);
+        return true;
+    }
+
+    //Инвентарь сканирует поток-публикатор по таблице поколения; здесь только поиск по индексам
+    SnapshotCache::PublishedPtr published = m_cache.current(false, ProcessFilter::All, false, true);
+    if (!published) {
+        return false;
+    }
+    const FdInventory& fds = *published->fds;
+    JsonWriter writer;
+    if (byPid) {
+        const FdInventory::Process* process = fds.findProcess(static_cast<DWORD>(request.pid));
+        if (!process) {
+            connection.enqueue(errorPayload("no process " + std::to_string(request.pid), false), false);
+            return true;
+        }
+        writer.reserve(process->fds.size() * 96 + 128);
+        ProcessJson::writeFds(writer, fds, *process);
+    } else {
+        std::vector<FdInventory::Holder> holders;
+        if (!request.path.empty()) {
+            fds.findByPath(request.path, holders);
+        } else if (request.port != 0) {
+            fds.findByPort(static_cast<uint16_t>(request.port), holders);
+        } else {
+            fds.findByInode(request.inode, holders);
+        }
+        writer.reserve(holders.size() * 128 + 64);
+        ProcessJson::writeHolders(writer, fds, holders);
+    }
+    writer.raw('\n');
+    connection.enqueue(std::make_shared<const std::string>(writer.view()), false);
+    return true;
+}
+
+void NetworkServer::sendStats(Connection& connection) {
+    if (connection.binary) {
+        connection.enqueue(errorPayload("stats is available in json format only", true), false);
+        return;
+    }
+    JsonWriter writer;
+    Metrics::writeJson(writer);
+    writer.raw('\n');
+    connection.enqueue(std::make_shared<const std::string>(writer.view()), false);
+}
+
+void NetworkServer::sendStrings(Connection& connection, const SnapshotCache::Published& published) {
+    if (connection.dictionaryEpoch == published.dictionaryEpoch && connection.knownStrings >= published.stringCount) {
+        return;
+    }
+    //Словарь не выбрасывается при переполнении: на него ссылаются следующие кадры
+    if (connection.dictionaryEpoch == published.dictionaryEpoch &&
+        connection.knownStrings >= published.stringsFirst && published.binaryStrings) {
+        connection.enqueue(published.binaryStrings, false);
+    } else {
+        connection.enqueue(published.binaryDictionary, false);
+    }
+    connection.dictionaryEpoch = published.dictionaryEpoch;
+    connection.knownStrings = published.stringCount;
+}
+
+void NetworkServer::sendSnapshot(Connection& connection, const SnapshotCache::Published& published, bool stream) {
+    if (stream) {
+        connection.dropStream();
+        connection.generation = published.generation;
+        connection.needsResync = false;
+    }
+    if (!connection.binary) {
+        connection.enqueue(published.full, stream);
+        return;
+    }
+    sendStrings(connection, published);
+    connection.enqueue(published.binaryFull, stream);
+}
+
+void NetworkServer::deliver(Connection& connection, const SnapshotCache::Published& published) {
+    if (!connection.subscribed || connection.generation >= published.generation) {
+        return;
+    }
+    //Двоичная подписка не может продолжиться дельтами: нет кадров или сменилась эпоха словаря
+    bool binaryGap = connection.binary &&
+        (!published.binaryFull || published.dictionaryEpoch != connection.dictionaryEpoch);
+    if (!connection.needsResync) {
+        const std::vector<SnapshotCache::Payload>& deltas = connection.binary ? published.binaryDeltas : published.deltas;
+        uint64_t behind = published.generation - connection.generation;
+        if (!binaryGap && behind <= deltas.size() && connection.pendingBytes <= MAX_STREAM_BACKLOG) {
+            if (connection.binary) {
+                sendStrings(connection, published);
+            }
+            for (size_t i = deltas.size() - static_cast<size_t>(behind); i < deltas.size(); ++i) {
+                if (deltas[i]) {
+                    connection.enqueue(deltas[i], true);
+                }
+            }
+            connection.generation = published.generation;
+            return;
+        }
+        //Клиент не успевает или пропустил слишком много поколений: дельты схлопываются в resync
+        connection.dropStream();
+        connection.needsResync = true;
+    }
+    if (connection.output.empty() && (!connection.binary || published.binaryFull)) {
+        sendSnapshot(connection, published, true);
+    }
+}
+
+void NetworkServer::deliverAll(Loop& loop) {
+    SnapshotCache::PublishedPtr published = m_cache.latest();
+    if (!published) {
+        return;
+    }
+    std::vector<int> broken;
+    for (auto& entry : loop.connections) {
+        Connection& connection = *entry.second;
+        if (connection.subscribed) {
+            deliver(connection, *published);
+        }
+        bool alive = connection.output.empty() || flushOutput(connection);
+        //Отложенный запрос: в новом поколении может быть то, чего он ждал; иначе он снова закажет пересборку
+        if (alive && connection.waiting) {
+            connection.waiting = false;
+            alive = handleInput(connection);
+        }
+        if (!alive) {
+            broken.push_back(entry.first);
+        }
+    }
+    for (int fd : broken) {
+        closeConnection(loop, fd);
+    }
+}
+
+#else
+
+struct NetworkServer::Loop {};
+struct NetworkServer::Connection {};
+
+NetworkServer::NetworkServer() : m_running(false), m_port(0) {}
+
+NetworkServer::~NetworkServer() {
+    stop();
+}
+
+bool NetworkServer::start(int port, size_t loops) {
+    (void)port;
+    (void)loops;
+    std::cerr << "NetworkServer is not supported on this platform yet" << std::endl;
+    return false;
+}
+
+void NetworkServer::stop() {
+    m_running.store(false);
+}
+
+#endif
@@ -0,0 +1,105 @@
+// NetworkServer.h
+#pragma once
+#include <atomic>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+#include "SnapshotCache.h"
+#include "HistoryStore.h"
+#include "ProcessQuery.h"
+
+/*
+TCP-сервер протокола get_processes (см. task.md).
+Вместо потока на клиента - по одному циклу событий на ядро:
+- у каждого цикла свой слушающий сокет на общем порту (SO_REUSEPORT),
+  ядро само распределяет входящие соединения между циклами
+- сокеты неблокирующие, epoll в edge-triggered режиме
+- запросы и ответы - JSON по одному на строку ('\n'), соединение живет
+  между запросами
+- все клиенты получают один и тот же сериализованный снимок из SnapshotCache:
+  1000 клиентов = один скан и одна сериализация за интервал. Сканирует
+  отдельный поток-публикатор, циклы событий отдают последнее поколение.
+  Запрос, которому нужного нет ни в одном поколении (первый снимок, первый
+  двоичный, фильтр, отбор, дескрипторы), ждет во входном буфере соединения
+  следующего поколения; публикатор собирает его сразу, не дожидаясь интервала
+- команда subscribe: полный снимок, затем только дельты каждого поколения.
+  Буфер отправки подписчика ограничен: не успевающий клиент теряет
+  неотправленные дельты и после опустошения буфера получает свежий полный
+  снимок (resync), сервер не копит для него данные без предела
+- формат выбирается для каждого соединения командой set_format:
+  JSON-строки (по умолчанию) или двоичные кадры ProcessBinary
+- команда get_history: история ресурсов процесса из HistoryStore
+  (заполняет владелец сервера, см. history()); ответ только JSON
+- get_processes с where/sort_by/limit/fields (ProcessQuery.h) выполняется
+  по копии таблицы поколения; одинаковые запросы в одном поколении
+  отдаются из QueryCache; ответ только JSON
+- команда stats: метрики самого монитора (Metrics) в JSON; строка
+  "GET /metrics HTTP/1.x" на том же порту - те же метрики в текстовом
+  формате Prometheus (ответ HTTP/1.0, затем соединение закрывается)
+Пока реализовано только для Linux (epoll); на других платформах start() возвращает false.
+*/
+class NetworkServer {
+public:
+    NetworkServer();
+    ~NetworkServer();
+
+    NetworkServer(const NetworkServer&) = delete;
+    NetworkServer& operator=(const NetworkServer&) = delete;
+
+    //port = 0 - выбрать свободный порт (см. port()); loops = 0 - по числу ядер
+    bool start(int port, size_t loops = 0);
+    void stop();
+
+    bool isRunning() const { return m_running.load(); }
+    int port() const { return m_port; }
+
+    //Как часто пересобирается снимок процессов
+    void setScanInterval(SnapshotCache::Clock::duration interval) { m_cache.setInterval(interval); }
+    SnapshotCache& cache() { return m_cache; }
+    //История для get_history; сервер ее только читает
+    HistoryStore& history() { return m_history; }
+    const QueryCache& queries() const { return m_queries; }
+
+private:
+    struct Loop;
+    struct Connection;
+
+    void runLoop(Loop& loop);
+    void acceptClients(Loop& loop);
+    bool handleInput(Connection& connection);
+    bool flushOutput(Connection& connection);
+    void closeConnection(Loop& loop, int fd);
+
+    //Обработка одной строки запроса: ответ ставится в очередь соединения.
+    //false - нужной части снимка еще нет ни в одном поколении: запрос повторится после следующего
+    bool handleRequest(Connection& connection, std::string_view request);
+
+    //Полный снимок в формате соединения; stream - сообщение подписки
+    void sendSnapshot(Connection& connection, const SnapshotCache::Published& published, bool stream);
+    void sendStrings(Connection& connection, const SnapshotCache::Published& published);
+    void sendHistory(Connection& connection, const ProtocolRequest& request);
+    void sendStats(Connection& connection);
+    bool sendQuery(Connection& connection, const ProtocolRequest& request);
+    bool sendFds(Connection& connection, const ProtocolRequest& request); //get_fds и find_holders
+
+    //Подписки: доставка нового поколения и resync
+    void deliver(Connection& connection, const SnapshotCache::Published& published);
+    void deliverAll(Loop& loop);
+    void wakeLoops();
+    void publishLoop(); //пересобирает снимок по интервалу; циклы событий его только читают
+
+    SnapshotCache m_cache;
+    HistoryStore m_history;
+    QueryCache m_queries;
+    std::vector<std::unique_ptr<Loop>> m_loops;
+    std::vector<std::thread> m_threads;
+    std::thread m_publisher;
+    std::mutex m_publishMutex;
+    std::condition_variable m_publishCondition;
+    std::atomic<bool> m_running;
+    int m_port;
+};
@@ -0,0 +1,10 @@
+// Platform.h
+#pragma once
+
+// Общие типы для Windows и Linux сборок
+#ifdef _WIN32
+#include <windows.h> //WinAPI
+#else
+#include <cstdint>
+typedef uint32_t DWORD; //pid_t на Linux помещается в 32 бита
+#endif
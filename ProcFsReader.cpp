@@ -0,0 +1,420 @@
+#include "ProcFsReader.h"
+#include "Metrics.h"
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <dirent.h>
+
+namespace {
+
+//stat - процесс исчез между readdir и чтением; exe - нет прав на путь (у потоков ядра пути нет, это не ошибка)
+MetricCounter statFailures("monitor_process_read_failures_total", "Per-PID lookups that failed", "stage", "stat");
+MetricCounter pathFailures("monitor_process_read_failures_total", "Per-PID lookups that failed", "stage", "exe");
+
+//Формат записи getdents64 (в glibc нет публичного объявления)
+struct LinuxDirent64 {
+    uint64_t d_ino;
+    int64_t d_off;
+    unsigned short d_reclen;
+    unsigned char d_type;
+    char d_name[1];
+};
+//Ядро выравнивает d_reclen по 8 байт, так что в выровненном буфере выровнена каждая запись
+static_assert(alignof(LinuxDirent64) == alignof(uint64_t), "getdents64 buffers are aligned for d_ino");
+
+//Разбор десятичного числа; p сдвигается за последнюю цифру
+uint64_t parseNumber(const char*& p, const char* end) {
+    uint64_t value = 0;
+    while (p < end && *p >= '0' && *p <= '9') {
+        value = value * 10 + static_cast<uint64_t>(*p - '0');
+        ++p;
+    }
+    return value;
+}
+
+//Пропуск count полей, разделенных пробелами
+const char* skipFields(const char* p, const char* end, int count) {
+    while (count > 0 && p < end) {
+        if (*p == ' ') {
+            --count;
+        }
+        ++p;
+    }
+    return p;
+}
+
+} // namespace
+
+ProcFsReader::ProcFsReader(const std::string& root) : m_root(root)
+{
+    m_rootFd = ::open(m_root.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+}
+
+ProcFsReader::~ProcFsReader() {
+    closeFds();
+    if (m_rootFd >= 0) {
+        ::close(m_rootFd);
+    }
+}
+
+bool ProcFsReader::rewind() {
+    if (m_rootFd < 0) {
+        return false;
+    }
+    m_direntSize = 0;
+    m_direntOffset = 0;
+    return ::lseek(m_rootFd, 0, SEEK_SET) == 0;
+}
+
+bool ProcFsReader::nextPid(DWORD& pid) {
+    for (;;) {
+        if (m_direntOffset >= m_direntSize) {
+            m_direntSize = ::syscall(SYS_getdents64, m_rootFd, m_direntBuffer, DIRENT_BUFFER_SIZE);
+            m_direntOffset = 0;
+            if (m_direntSize <= 0) {
+                return false; //конец каталога или ошибка
+            }
+        }
+
+        auto* entry = reinterpret_cast<LinuxDirent64*>(m_direntBuffer + m_direntOffset);
+        m_direntOffset += entry->d_reclen;
+
+        if (entry->d_type != DT_DIR && entry->d_type != DT_UNKNOWN) {
+            continue;
+        }
+        //Каталоги процессов - только цифры
+        const char* p = entry->d_name;
+        if (*p < '1' || *p > '9') {
+            continue;
+        }
+        const char* end = p + std::strlen(p);
+        uint64_t value = parseNumber(p, end);
+        if (p != end || value > 0xFFFFFFFFu) {
+            continue;
+        }
+        pid = static_cast<DWORD>(value);
+        return true;
+    }
+}
+
+size_t ProcFsReader::formatEntry(DWORD pid, const char* entry) {
+    char digits[10];
+    size_t count = 0;
+    do {
+        digits[count++] = static_cast<char>('0' + pid % 10);
+        pid /= 10;
+    } while (pid != 0);
+
+    size_t length = 0;
+    while (count > 0) {
+        m_entryPath[length++] = digits[--count];
+    }
+    m_entryPath[length++] = '/';
+    size_t entryLength = std::strlen(entry);
+    std::memcpy(m_entryPath + length, entry, entryLength + 1);
+    return length + entryLength;
+}
+
+size_t ProcFsReader::readEntry(DWORD pid, const char* entry, int* cachedFd, uint32_t* owner) {
+    if (cachedFd && *cachedFd >= 0) {
+        ssize_t size = ::pread(*cachedFd, m_statBuffer, sizeof(m_statBuffer), 0);
+        if (size > 0) {
+            return static_cast<size_t>(size);
+        }
+        ::close(*cachedFd);
+        *cachedFd = -1;
+    }
+    if (m_rootFd < 0) {
+        return 0;
+    }
+    formatEntry(pid, entry);
+    int fd = ::openat(m_rootFd, m_entryPath, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        return 0;
+    }
+    ssize_t size = ::read(fd, m_statBuffer, sizeof(m_statBuffer));
+    //fstat открытого файла дешевле отдельного stat по пути
+    struct stat info;
+    if (owner && size > 0 && ::fstat(fd, &info) == 0) {
+        *owner = static_cast<uint32_t>(info.st_uid);
+    }
+    if (cachedFd && size > 0) {
+        *cachedFd = fd;
+    } else {
+        ::close(fd);
+    }
+    return size > 0 ? static_cast<size_t>(size) : 0;
+}
+
+bool ProcFsReader::readStat(DWORD pid, std::string_view& name, const char*& fields, const char*& end,
+                            int* cachedFd, uint32_t* owner) {
+    size_t size = readEntry(pid, "stat", cachedFd, owner);
+    if (size == 0) {
+        return false;
+    }
+
+/*
+Формат: pid (comm) state ppid pgrp session tty_nr tpgid flags minflt cminflt
+majflt cmajflt utime stime cutime cstime priority nice num_threads itrealvalue starttime vsize rss ...
+comm может содержать пробелы и скобки, поэтому ищем последнюю ')'
+*/
+    const char* begin = m_statBuffer;
+    end = m_statBuffer + size;
+    const char* open = static_cast<const char*>(std::memchr(begin, '(', size));
+    const char* close = end;
+    while (close > begin && *(close - 1) != ')') {
+        --close;
+    }
+    if (!open || close <= open + 1 || close + 1 >= end) {
+        return false;
+    }
+    --close; //на самой ')'
+
+    name = std::string_view(open + 1, static_cast<size_t>(close - open - 1));
+    fields = close + 2;
+    return true;
+}
+
+bool ProcFsReader::readProcess(DWORD pid, ProcessRecord& record) {
+    std::string_view name;
+    const char* p;
+    const char* end;
+    record.uid = ProcessRecord::UNKNOWN_UID;
+    if (!readStat(pid, name, p, end, nullptr, &record.uid)) {
+        statFailures.add();
+        return false;
+    }
+    record.pid = pid;
+    record.name = name;
+
+    //state, затем ppid (поле 4)
+    p = skipFields(p, end, 1);
+    record.parentPid = static_cast<DWORD>(parseNumber(p, end));
+    //starttime - поле 22
+    p = skipFields(p, end, 22 - 4);
+    record.startTime = parseNumber(p, end);
+
+    record.path = readPath(pid);
+    return true;
+}
+
+bool ProcFsReader::readBasic(DWORD pid, ProcessRecord& record, uint64_t& cpuTicks) {
+    std::string_view name;
+    const char* p;
+    const char* end;
+    if (!readStat(pid, name, p, end)) {
+        statFailures.add();
+        return false;
+    }
+    record.pid = pid;
+    record.name = name;
+    record.path = std::string_view();
+
+    p = skipFields(p, end, 1);
+    record.parentPid = static_cast<DWORD>(parseNumber(p, end));
+    //utime и stime - поля 14 и 15, starttime - 22
+    p = skipFields(p, end, 14 - 4);
+    uint64_t userTicks = parseNumber(p, end);
+    p = skipFields(p, end, 1);
+    cpuTicks = userTicks + parseNumber(p, end);
+    p = skipFields(p, end, 22 - 15);
+    record.startTime = parseNumber(p, end);
+    return true;
+}
+
+std::string_view ProcFsReader::readPath(DWORD pid) {
+    //Путь к исполняемому файлу; у потоков ядра его нет
+    formatEntry(pid, "exe");
+    ssize_t pathLength = ::readlinkat(m_rootFd, m_entryPath, m_pathBuffer, sizeof(m_pathBuffer));
+    if (pathLength < 0) {
+        if (errno != ENOENT) {
+            pathFailures.add();
+        }
+        pathLength = 0;
+    }
+    return std::string_view(m_pathBuffer, static_cast<size_t>(pathLength));
+}
+
+bool ProcFsReader::readOwner(DWORD pid, uint32_t& uid) {
+    if (m_rootFd < 0) {
+        return false;
+    }
+    formatEntry(pid, "");
+    struct stat info;
+    if (::fstatat(m_rootFd, m_entryPath, &info, 0) != 0) {
+        return false;
+    }
+    uid = static_cast<uint32_t>(info.st_uid);
+    return true;
+}
+
+bool ProcFsReader::readUsage(DWORD pid, ProcessUsage& usage, int* cachedFd) {
+    std::string_view name;
+    const char* p;
+    const char* end;
+    if (!readStat(pid, name, p, end, cachedFd)) {
+        return false;
+    }
+    usage.pid = pid;
+
+    //utime и stime - поля 14 и 15 (p стоит на поле 3)
+    p = skipFields(p, end, 14 - 3);
+    uint64_t userTicks = parseNumber(p, end);
+    p = skipFields(p, end, 1);
+    usage.cpuTicks = userTicks + parseNumber(p, end);
+    //num_threads - поле 20, starttime - 22, rss - 24
+    p = skipFields(p, end, 20 - 15);
+    usage.threads = static_cast<uint32_t>(parseNumber(p, end));
+    p = skipFields(p, end, 22 - 20);
+    usage.startTime = parseNumber(p, end);
+    p = skipFields(p, end, 24 - 22);
+    usage.rssPages = parseNumber(p, end);
+    return true;
+}
+
+bool ProcFsReader::readIo(DWORD pid, ProcessUsage& usage, int* cachedFd) {
+    size_t size = readEntry(pid, "io", cachedFd);
+    if (size == 0) {
+        return false;
+    }
+/*
+Строки "ключ: значение": rchar wchar syscr syscw read_bytes write_bytes cancelled_write_bytes.
+Порядок фиксирован в ядре, но ищем по ключам - так надежнее.
+*/
+    const char* p = m_statBuffer;
+    const char* end = m_statBuffer + size;
+    bool found = false;
+    while (p < end) {
+        const char* line = p;
+        const char* colon = static_cast<const char*>(std::memchr(p, ':', static_cast<size_t>(end - p)));
+        if (!colon || colon + 2 > end) {
+            break;
+        }
+        p = colon + 2;
+        uint64_t value = parseNumber(p, end);
+        size_t keyLength = static_cast<size_t>(colon - line);
+        if (keyLength == 10 && std::memcmp(line, "read_bytes", 10) == 0) {
+            usage.readBytes = value;
+            found = true;
+        } else if (keyLength == 11 && std::memcmp(line, "write_bytes", 11) == 0) {
+            usage.writeBytes = value;
+        }
+        while (p < end && *p != '\n') {
+            ++p;
+        }
+        ++p;
+    }
+    return found;
+}
+
+bool ProcFsReader::readFdCount(DWORD pid, uint32_t& count) {
+    if (m_rootFd < 0) {
+        return false;
+    }
+    formatEntry(pid, "fd");
+    struct stat info;
+    if (::fstatat(m_rootFd, m_entryPath, &info, 0) != 0) {
+        return false;
+    }
+    count = static_cast<uint32_t>(info.st_size);
+    return true;
+}
+
+bool ProcFsReader::openFds(DWORD pid) {
+    closeFds();
+    if (m_rootFd < 0) {
+        return false;
+    }
+    formatEntry(pid, "fd");
+    m_fdDirFd = ::openat(m_rootFd, m_entryPath, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    m_fdSize = 0;
+    m_fdOffset = 0;
+    return m_fdDirFd >= 0;
+}
+
+bool ProcFsReader::nextFd(uint32_t& fd, std::string_view& target) {
+    for (;;) {
+        if (m_fdOffset >= m_fdSize) {
+            m_fdSize = ::syscall(SYS_getdents64, m_fdDirFd, m_fdBuffer, FD_BUFFER_SIZE);
+            m_fdOffset = 0;
+            if (m_fdSize <= 0) {
+                return false;
+            }
+        }
+
+        auto* entry = reinterpret_cast<LinuxDirent64*>(m_fdBuffer + m_fdOffset);
+        m_fdOffset += entry->d_reclen;
+
+        const char* p = entry->d_name;
+        if (*p < '0' || *p > '9') {
+            continue; //"." и ".."
+        }
+        const char* end = p + std::strlen(p);
+        uint64_t value = parseNumber(p, end);
+        if (p != end || value > 0xFFFFFFFFu) {
+            continue;
+        }
+        //Дескриптор мог закрыться после getdents - пропускаем
+        ssize_t length = ::readlinkat(m_fdDirFd, entry->d_name, m_pathBuffer, sizeof(m_pathBuffer));
+        if (length <= 0) {
+            continue;
+        }
+        fd = static_cast<uint32_t>(value);
+        target = std::string_view(m_pathBuffer, static_cast<size_t>(length));
+        return true;
+    }
+}
+
+void ProcFsReader::closeFds() {
+    if (m_fdDirFd >= 0) {
+        ::close(m_fdDirFd);
+        m_fdDirFd = -1;
+    }
+}
+
+bool ProcFsReader::readFile(const char* name, std::string& content) {
+    content.clear();
+    if (m_rootFd < 0) {
+        return false;
+    }
+    int fd = ::openat(m_rootFd, name, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        return false;
+    }
+    //Размер файлов procfs заранее неизвестен (st_size = 0) - читаем, пока не кончится
+    size_t size = 0;
+    for (;;) {
+        if (content.size() - size < 4096) {
+            content.resize(std::max<size_t>(content.size() * 2, size + 16384));
+        }
+        ssize_t chunk = ::read(fd, &content[size], content.size() - size);
+        if (chunk < 0 && errno == EINTR) {
+            continue;
+        }
+        if (chunk <= 0) {
+            break;
+        }
+        size += static_cast<size_t>(chunk);
+    }
+    ::close(fd);
+    content.resize(size);
+    return true;
+}
+
+std::string_view ProcFsReader::readCmdline(DWORD pid) {
+    size_t size = readEntry(pid, "cmdline");
+    //Аргументы разделены '\0', последний тоже заканчивается '\0'
+    while (size > 0 && m_statBuffer[size - 1] == '\0') {
+        --size;
+    }
+    for (size_t i = 0; i < size; ++i) {
+        if (m_statBuffer[i] == '\0') {
+            m_statBuffer[i] = ' ';
+        }
+    }
+    return std::string_view(m_statBuffer, size);
+}
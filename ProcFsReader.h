@@ -0,0 +1,157 @@
+// ProcFsReader.h
+#pragma once
+#include <string>
+#include <string_view>
+#include <cstdint>
+#include "ProcessInfo.h" //ProcessRecord
+
+//Накопительные счетчики ресурсов процесса с момента его старта
+struct ProcessUsage {
+    DWORD pid = 0;
+    uint64_t startTime = 0;
+    uint64_t cpuTicks = 0;   //utime + stime в тиках sysconf(_SC_CLK_TCK)
+    uint64_t rssPages = 0;
+    uint32_t threads = 0;
+    uint64_t readBytes = 0;  //io: read_bytes/write_bytes - обмен с блочными устройствами
+    uint64_t writeBytes = 0;
+};
+
+/*
+Перечисление процессов Linux через /proc без iostreams и лишних аллокаций:
+- один дескриптор каталога /proc держится открытым между сканами
+- каталог читается через getdents64 в переиспользуемый буфер
+- stat и exe читаются относительно этого дескриптора (openat/readlinkat)
+- таблицы сокетов (net/tcp и т.д.) - тоже относительно него: это сетевое
+  пространство имен самого reader'а
+Объект не потокобезопасен: один reader на поток.
+*/
+class ProcFsReader {
+public:
+    explicit ProcFsReader(const std::string& root = "/proc");
+    ~ProcFsReader();
+
+    ProcFsReader(const ProcFsReader&) = delete;
+    ProcFsReader& operator=(const ProcFsReader&) = delete;
+
+    bool isOpen() const { return m_rootFd >= 0; }
+    const std::string& root() const { return m_root; }
+
+    //Обходит все процессы, вызывая callback(const ProcessRecord&); возвращает число процессов
+    template<typename Callback>
+    size_t forEachProcess(Callback&& callback) {
+        size_t count = 0;
+        if (!rewind()) {
+            return 0;
+        }
+        DWORD pid = 0;
+        ProcessRecord record;
+        while (nextPid(pid)) {
+            //процесс мог завершиться между getdents и openat - просто пропускаем
+            if (readProcess(pid, record)) {
+                callback(static_cast<const ProcessRecord&>(record));
+                ++count;
+            }
+        }
+        return count;
+    }
+
+    //Обходит PID всех процессов без чтения их файлов; callback(DWORD pid)
+    template<typename Callback>
+    size_t forEachPid(Callback&& callback) {
+        size_t count = 0;
+        if (!rewind()) {
+            return 0;
+        }
+        DWORD pid = 0;
+        while (nextPid(pid)) {
+            callback(pid);
+            ++count;
+        }
+        return count;
+    }
+
+    //Чтение одного процесса (stat + exe); name и path указывают во внутренние буферы reader'а.
+    //uid - владелец файлов /proc/<pid>: эффективный uid процесса (root у недампируемых, например setuid)
+    bool readProcess(DWORD pid, ProcessRecord& record);
+
+    //Дешевая часть readProcess для RefreshScheduler: только stat (имя, ppid, время старта)
+    //и cpuTicks = utime + stime; path пустой, uid не заполняется
+    bool readBasic(DWORD pid, ProcessRecord& record, uint64_t& cpuTicks);
+    //Путь к исполняемому файлу; пустой у потоков ядра и без прав. Указывает во внутренний буфер reader'а
+    std::string_view readPath(DWORD pid);
+    //Владелец каталога /proc/<pid> (тот же uid, что у readProcess) без открытия файлов; false - процесса нет
+    bool readOwner(DWORD pid, uint32_t& uid);
+
+/*
+Повторяемое чтение для периодического сэмплинга.
+cachedFd != nullptr: файл читается через pread из *cachedFd, а если его еще нет -
+открывается и остается открытым в *cachedFd (открытие в procfs дороже самого чтения).
+Дескриптор завершившегося процесса перестает читаться - он закрывается и
+файл открывается заново по пути (PID мог достаться новому процессу).
+*/
+    //CPU, RSS и число потоков - все из одного stat (statm не нужен: resident там же, поле rss)
+    bool readUsage(DWORD pid, ProcessUsage& usage, int* cachedFd = nullptr);
+    //Счетчики io; false, если файла нет или нет прав (чужой процесс без CAP_SYS_PTRACE)
+    bool readIo(DWORD pid, ProcessUsage& usage, int* cachedFd = nullptr);
+
+    //Число открытых дескрипторов - размер каталога <pid>/fd (ядро 6.2+; на старых ядрах всегда 0).
+    //Без чтения каталога и readlink; false - процесса нет
+    bool readFdCount(DWORD pid, uint32_t& count);
+
+    //Обходит дескрипторы процесса, вызывая callback(uint32_t fd, std::string_view target);
+    //target - цель ссылки ("/path", "socket:[N]", "pipe:[N]", "anon_inode:...") во внутреннем буфере.
+    //false - каталог не открылся: процесса нет или нет прав (чужой процесс без CAP_SYS_PTRACE)
+    template<typename Callback>
+    bool forEachFd(DWORD pid, Callback&& callback) {
+        if (!openFds(pid)) {
+            return false;
+        }
+        uint32_t fd = 0;
+        std::string_view target;
+        while (nextFd(fd, target)) {
+            callback(fd, target);
+        }
+        closeFds();
+        return true;
+    }
+
+    //Файл целиком относительно корня (например "net/tcp"); content переиспользуется между вызовами
+    bool readFile(const char* name, std::string& content);
+
+    //Командная строка: аргументы через пробел, не длиннее буфера (4 КБ).
+    //Пустая у потоков ядра и зомби; указывает во внутренний буфер reader'а
+    std::string_view readCmdline(DWORD pid);
+
+private:
+    bool rewind();
+    bool nextPid(DWORD& pid);
+    size_t formatEntry(DWORD pid, const char* entry); //"<pid>/<entry>" в m_entryPath
+    //Читает <pid>/<entry> в m_statBuffer; размер прочитанного или 0. owner - uid владельца файла
+    size_t readEntry(DWORD pid, const char* entry, int* cachedFd = nullptr, uint32_t* owner = nullptr);
+    //Читает stat; fields - после ") ", т.е. на поле 3 (state)
+    bool readStat(DWORD pid, std::string_view& name, const char*& fields, const char*& end,
+                  int* cachedFd = nullptr, uint32_t* owner = nullptr);
+    bool openFds(DWORD pid);
+    bool nextFd(uint32_t& fd, std::string_view& target);
+    void closeFds();
+
+    std::string m_root;
+    int m_rootFd = -1;
+
+    //Буфер getdents64 и позиция разбора в нем; записи читаются по месту - буфер выровнен, как их поле d_ino
+    static const size_t DIRENT_BUFFER_SIZE = 64 * 1024;
+    alignas(uint64_t) char m_direntBuffer[DIRENT_BUFFER_SIZE];
+    long m_direntSize = 0;
+    long m_direntOffset = 0;
+
+    //Каталог <pid>/fd текущего forEachFd: свой буфер, чтобы не сбивать обход PID
+    static const size_t FD_BUFFER_SIZE = 16 * 1024;
+    int m_fdDirFd = -1;
+    alignas(uint64_t) char m_fdBuffer[FD_BUFFER_SIZE]; //записи getdents64, как m_direntBuffer
+    long m_fdSize = 0;
+    long m_fdOffset = 0;
+
+    char m_entryPath[64];
+    char m_statBuffer[4096];
+    char m_pathBuffer[4096];
+};
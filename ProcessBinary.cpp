@@ -0,0 +1,349 @@
+#include "ProcessBinary.h"
+#include <cstring>
+
+namespace {
+
+const size_t HEADER_SIZE = 5; //u32 длина + u8 тип
+const uint32_t MAX_FRAME = 64u << 20;
+
+const size_t MAX_VARINT = 10;
+
+//Запись по указателю: вызывающий заранее выделил MAX_VARINT байт
+char* putVarint(char* out, uint64_t value) {
+    while (value >= 0x80) {
+        *out++ = static_cast<char>((value & 0x7F) | 0x80);
+        value >>= 7;
+    }
+    *out++ = static_cast<char>(value);
+    return out;
+}
+
+void putVarint(std::string& out, uint64_t value) {
+    char bytes[MAX_VARINT];
+    out.append(bytes, static_cast<size_t>(putVarint(bytes, value) - bytes));
+}
+
+//Разность PID со знаком: zigzag превращает маленькие отрицательные в маленькие положительные
+uint64_t zigzagDelta(DWORD pid, DWORD& previous) {
+    int64_t delta = static_cast<int64_t>(pid) - static_cast<int64_t>(previous);
+    previous = pid;
+    return (static_cast<uint64_t>(delta) << 1) ^ static_cast<uint64_t>(delta >> 63);
+}
+
+void putPidDelta(std::string& out, DWORD pid, DWORD& previous) {
+    putVarint(out, zigzagDelta(pid, previous));
+}
+
+//Начинает кадр; длина дописывается в finishFrame
+size_t beginFrame(std::string& out, uint8_t type) {
+    size_t start = out.size();
+    out.append(4, '\0');
+    out += static_cast<char>(type);
+    return start;
+}
+
+void finishFrame(std::string& out, size_t start) {
+    uint32_t length = static_cast<uint32_t>(out.size() - start - 4);
+    for (int i = 0; i < 4; ++i) {
+        out[start + static_cast<size_t>(i)] = static_cast<char>((length >> (8 * i)) & 0xFF);
+    }
+}
+
+bool getVarint(const unsigned char*& pos, const unsigned char* end, uint64_t& value) {
+    value = 0;
+    for (int shift = 0; shift < 64 && pos < end; shift += 7) {
+        unsigned char byte = *pos++;
+        value |= static_cast<uint64_t>(byte & 0x7F) << shift;
+        if (!(byte & 0x80)) {
+            return true;
+        }
+    }
+    return false;
+}
+
+bool getPidDelta(const unsigned char*& pos, const unsigned char* end, DWORD& previous) {
+    uint64_t encoded;
+    if (!getVarint(pos, end, encoded)) {
+        return false;
+    }
+    int64_t delta = static_cast<int64_t>(encoded >> 1) ^ -static_cast<int64_t>(encoded & 1);
+    previous = static_cast<DWORD>(static_cast<int64_t>(previous) + delta);
+    return true;
+}
+
+} // namespace
+
+ProcessBinaryEncoder::ProcessBinaryEncoder() : m_epoch(1), m_mappedVersion(0) {}
+
+StringArena::Handle ProcessBinaryEncoder::mapHandle(const ProcessTable& table, StringArena::Handle handle) {
+    if (handle >= m_tableIds.size()) {
+        m_tableIds.resize(handle + 1, UNMAPPED);
+    }
+    if (m_tableIds[handle] == UNMAPPED) {
+        m_tableIds[handle] = m_dictionary.intern(table.strings().get(handle));
+    }
+    return m_tableIds[handle];
+}
+
+void ProcessBinaryEncoder::mapTable(const ProcessTable& table) {
+    //Словарь разросся мертвыми строками - новая эпоха только с живыми
+    if (m_dictionary.size() > MAX_DICTIONARY) {
+        m_dictionary.clear();
+        m_tableIds.clear();
+        ++m_epoch;
+    }
+    if (table.stringsVersion() != m_mappedVersion) {
+        m_tableIds.clear();
+        m_mappedVersion = table.stringsVersion();
+    }
+    if (m_tableIds.size() < table.strings().size()) {
+        m_tableIds.resize(table.strings().size(), UNMAPPED);
+    }
+    //Обычно все строки уже в словаре: проверка без вызова на строку таблицы
+    for (size_t row = 0; row < table.size(); ++row) {
+        if (m_tableIds[table.nameIds()[row]] == UNMAPPED) {
+            mapHandle(table, table.nameIds()[row]);
+        }
+        if (m_tableIds[table.pathIds()[row]] == UNMAPPED) {
+            mapHandle(table, table.pathIds()[row]);
+        }
+    }
+}
+
+void ProcessBinaryEncoder::writeSnapshot(std::string& out, const ProcessTable& table, uint64_t generation,
+                                         ProcessFilter filter) const {
+    const std::vector<uint32_t>& uids = table.uids();
+    size_t rows = table.size();
+    if (filter != ProcessFilter::All) {
+        rows = 0;
+        for (uint32_t uid : uids) {
+            rows += ProcessOwner::matches(filter, uid) ? 1 : 0;
+        }
+    }
+    size_t start = beginFrame(out, FRAME_SNAPSHOT);
+    putVarint(out, generation);
+    putVarint(out, rows);
+    //Место под худший случай выделяется один раз, строки пишутся по указателю
+    //(PID и идентификаторы - 32 бита, не больше 5 байт varint каждый)
+    size_t body = out.size();
+    out.resize(body + rows * 4 * 5);
+    char* pos = &out[body];
+    const std::vector<DWORD>& pids = table.pids();
+    const std::vector<DWORD>& parentPids = table.parentPids();
+    const std::vector<StringArena::Handle>& nameIds = table.nameIds();
+    const std::vector<StringArena::Handle>& pathIds = table.pathIds();
+    DWORD previous = 0;
+    for (size_t row = 0; row < table.size(); ++row) {
+        if (!ProcessOwner::matches(filter, uids[row])) {
+            continue;
+        }
+        pos = putVarint(pos, zigzagDelta(pids[row], previous));
+        pos = putVarint(pos, parentPids[row]);
+        pos = putVarint(pos, m_tableIds[nameIds[row]]);
+        pos = putVarint(pos, m_tableIds[pathIds[row]]);
+    }
+    out.resize(static_cast<size_t>(pos - out.data()));
+    finishFrame(out, start);
+}
+
+void ProcessBinaryEncoder::writeDelta(std::string& out, uint64_t generation, const std::vector<ProcessChange>& changes) {
+    size_t start = beginFrame(out, FRAME_DELTA);
+    putVarint(out, generation);
+
+    size_t exited = 0;
+    for (const auto& change : changes) {
+        exited += change.type == ProcessChange::Type::Exited ? 1 : 0;
+    }
+    //Как и в JSON: сначала завершения, потом запуски (переиспользование PID)
+    putVarint(out, exited);
+    DWORD previous = 0;
+    for (const auto& change : changes) {
+        if (change.type == ProcessChange::Type::Exited) {
+            putPidDelta(out, change.process->getPid(), previous);
+        }
+    }
+    putVarint(out, changes.size() - exited);
+    previous = 0;
+    for (const auto& change : changes) {
+        if (change.type == ProcessChange::Type::Exited) {
+            continue;
+        }
+        const ProcessInfo& process = *change.process;
+        out += static_cast<char>(change.type == ProcessChange::Type::Spawned ? 1 : 2);
+        putPidDelta(out, process.getPid(), previous);
+        putVarint(out, process.getParentPid());
+        putVarint(out, m_dictionary.intern(process.getName()));
+        putVarint(out, m_dictionary.intern(process.getPath()));
+    }
+    finishFrame(out, start);
+}
+
+void ProcessBinaryEncoder::writeStrings(std::string& out, size_t first) const {
+    size_t start = beginFrame(out, FRAME_STRINGS);
+    //Пустая строка (0) есть у клиента всегда
+    size_t from = first == 0 ? 1 : first;
+    out += static_cast<char>(first == 0 ? 1 : 0);
+    putVarint(out, m_epoch);
+    putVarint(out, from);
+    putVarint(out, from < m_dictionary.size() ? m_dictionary.size() - from : 0);
+    for (size_t id = from; id < m_dictionary.size(); ++id) {
+        const std::string& value = m_dictionary.get(static_cast<StringArena::Handle>(id));
+        putVarint(out, value.size());
+        out += value;
+    }
+    finishFrame(out, start);
+}
+
+void ProcessBinaryEncoder::writeError(std::string& out, std::string_view message) {
+    size_t start = beginFrame(out, FRAME_ERROR);
+    putVarint(out, message.size());
+    out.append(message.data(), message.size());
+    finishFrame(out, start);
+}
+
+size_t ProcessBinaryDecoder::frameSize(const char* data, size_t size) {
+    if (size < HEADER_SIZE) {
+        return 0;
+    }
+    uint32_t length = 0;
+    for (int i = 0; i < 4; ++i) {
+        length |= static_cast<uint32_t>(static_cast<unsigned char>(data[i])) << (8 * i);
+    }
+    size_t total = static_cast<size_t>(length) + 4;
+    return size >= total ? total : 0;
+}
+
+bool ProcessBinaryDecoder::apply(const char* frame, size_t size) {
+    if (frameSize(frame, size) != size || size - 4 > MAX_FRAME) {
+        return false;
+    }
+    const unsigned char* pos = reinterpret_cast<const unsigned char*>(frame) + HEADER_SIZE;
+    const unsigned char* end = reinterpret_cast<const unsigned char*>(frame) + size;
+    m_lastType = static_cast<unsigned char>(frame[4]);
+
+    bool ok = false;
+    switch (m_lastType) {
+    case ProcessBinaryEncoder::FRAME_SNAPSHOT: ok = applySnapshot(pos, end); break;
+    case ProcessBinaryEncoder::FRAME_DELTA: ok = applyDelta(pos, end); break;
+    case ProcessBinaryEncoder::FRAME_STRINGS: ok = applyStrings(pos, end); break;
+    case ProcessBinaryEncoder::FRAME_ERROR: {
+        uint64_t length;
+        ok = getVarint(pos, end, length) && length <= static_cast<uint64_t>(end - pos);
+        if (ok) {
+            m_error.assign(reinterpret_cast<const char*>(pos), static_cast<size_t>(length));
+            pos += length;
+        }
+        break;
+    }
+    default:
+        return false;
+    }
+    return ok && pos == end;
+}
+
+bool ProcessBinaryDecoder::applySnapshot(const unsigned char*& pos, const unsigned char* end) {
+    uint64_t generation, rows;
+    if (!getVarint(pos, end, generation) || !getVarint(pos, end, rows) ||
+        rows > static_cast<uint64_t>(end - pos)) {
+        return false;
+    }
+    m_processes.clear();
+    m_index.clear();
+    DWORD pid = 0;
+    for (uint64_t row = 0; row < rows; ++row) {
+        uint64_t parentPid, nameId, pathId;
+        if (!getPidDelta(pos, end, pid) || !getVarint(pos, end, parentPid) ||
+            !getVarint(pos, end, nameId) || !getVarint(pos, end, pathId) ||
+            nameId >= m_strings.size() || pathId >= m_strings.size()) {
+            return false;
+        }
+        m_index[pid] = m_processes.size();
+        m_processes.push_back(BinaryProcess{pid, static_cast<DWORD>(parentPid),
+                                            static_cast<uint32_t>(nameId), static_cast<uint32_t>(pathId)});
+    }
+    m_generation = generation;
+    return true;
+}
+
+bool ProcessBinaryDecoder::applyDelta(const unsigned char*& pos, const unsigned char* end) {
+    uint64_t generation, exited;
+    if (!getVarint(pos, end, generation) || !getVarint(pos, end, exited)) {
+        return false;
+    }
+    DWORD pid = 0;
+    for (uint64_t i = 0; i < exited; ++i) {
+        if (!getPidDelta(pos, end, pid)) {
+            return false;
+        }
+        auto it = m_index.find(pid);
+        if (it == m_index.end()) {
+            continue;
+        }
+        //Удаление перестановкой последнего элемента на освободившееся место
+        size_t index = it->second;
+        m_index.erase(it);
+        if (index + 1 != m_processes.size()) {
+            m_processes[index] = m_processes.back();
+            m_index[m_processes[index].pid] = index;
+        }
+        m_processes.pop_back();
+    }
+
+    uint64_t upserts;
+    if (!getVarint(pos, end, upserts)) {
+        return false;
+    }
+    pid = 0;
+    for (uint64_t i = 0; i < upserts; ++i) {
+        uint64_t parentPid, nameId, pathId;
+        if (pos >= end) {
+            return false;
+        }
+        ++pos; //kind: для состояния снимка запуск и изменение равнозначны
+        if (!getPidDelta(pos, end, pid) || !getVarint(pos, end, parentPid) ||
+            !getVarint(pos, end, nameId) || !getVarint(pos, end, pathId) ||
+            nameId >= m_strings.size() || pathId >= m_strings.size()) {
+            return false;
+        }
+        BinaryProcess process{pid, static_cast<DWORD>(parentPid),
+                              static_cast<uint32_t>(nameId), static_cast<uint32_t>(pathId)};
+        auto it = m_index.find(pid);
+        if (it != m_index.end()) {
+            m_processes[it->second] = process;
+        } else {
+            m_index[pid] = m_processes.size();
+            m_processes.push_back(process);
+        }
+    }
+    m_generation = generation;
+    return true;
+}
+
+bool ProcessBinaryDecoder::applyStrings(const unsigned char*& pos, const unsigned char* end) {
+    if (pos >= end) {
+        return false;
+    }
+    bool reset = *pos++ != 0;
+    uint64_t epoch, first, count;
+    if (!getVarint(pos, end, epoch) || !getVarint(pos, end, first) || !getVarint(pos, end, count)) {
+        return false;
+    }
+    if (reset) {
+        m_strings.assign(1, std::string());
+        m_epoch = static_cast<uint32_t>(epoch);
+    } else if (epoch != m_epoch || first > m_strings.size()) {
+        return false; //пропущена часть словаря
+    }
+    for (uint64_t i = 0; i < count; ++i) {
+        uint64_t length;
+        if (!getVarint(pos, end, length) || length > static_cast<uint64_t>(end - pos)) {
+            return false;
+        }
+        //Уже известные клиенту строки (перекрытие диапазонов) пропускаем
+        if (first + i >= m_strings.size()) {
+            m_strings.emplace_back(reinterpret_cast<const char*>(pos), static_cast<size_t>(length));
+        }
+        pos += length;
+    }
+    return true;
+}
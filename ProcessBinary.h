@@ -0,0 +1,102 @@
+// ProcessBinary.h
+#pragma once
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+#include "ProcessTable.h"
+#include "ProcessSnapshotDiffer.h"
+#include "ProcessOwner.h"
+
+/*
+Компактное двоичное представление протокола (включается командой set_format).
+Кадр: u32 длина (little-endian) | u8 тип | тело; длина считает тип и тело,
+но не само поле длины (в отличие от записей SnapshotFile, где она - только тело).
+Целые - LEB128 varint; PID в списках кодируются разностью с предыдущим (zigzag).
+Имена и пути передаются один раз: кадр STRINGS пополняет словарь клиента,
+остальные кадры ссылаются на строки по номеру (0 - пустая строка).
+Словарь общий для всех соединений сервера и в пределах эпохи только растет;
+при переполнении начинается новая эпоха (STRINGS с флагом reset).
+
+SNAPSHOT: generation, rows, rows x {pidDelta, parentPid, nameId, pathId}
+DELTA:    generation, exited, exited x {pidDelta},
+          upserts, upserts x {u8 kind (1 spawned, 2 changed), pidDelta, parentPid, nameId, pathId}
+STRINGS:  u8 reset, epoch, first, count, count x {length, bytes}
+ERROR:    length, bytes
+*/
+class ProcessBinaryEncoder {
+public:
+    enum FrameType : uint8_t { FRAME_SNAPSHOT = 1, FRAME_DELTA = 2, FRAME_STRINGS = 3, FRAME_ERROR = 4 };
+    static constexpr size_t MAX_DICTIONARY = 1 << 16; //строк в эпохе, дальше - новая эпоха
+
+    ProcessBinaryEncoder();
+
+    ProcessBinaryEncoder(const ProcessBinaryEncoder&) = delete;
+    ProcessBinaryEncoder& operator=(const ProcessBinaryEncoder&) = delete;
+
+    //Заносит строки скана в словарь; вызывается перед writeSnapshot/writeDelta этого скана
+    void mapTable(const ProcessTable& table);
+
+    void writeSnapshot(std::string& out, const ProcessTable& table, uint64_t generation,
+                       ProcessFilter filter = ProcessFilter::All) const;
+    void writeDelta(std::string& out, uint64_t generation, const std::vector<ProcessChange>& changes);
+    //Строки словаря начиная с first; first = 0 - весь словарь с флагом reset
+    void writeStrings(std::string& out, size_t first) const;
+    static void writeError(std::string& out, std::string_view message);
+
+    uint32_t epoch() const { return m_epoch; }
+    size_t stringCount() const { return m_dictionary.size(); }
+
+private:
+    static constexpr StringArena::Handle UNMAPPED = 0xFFFFFFFFu;
+
+    StringArena::Handle mapHandle(const ProcessTable& table, StringArena::Handle handle);
+
+    StringArena m_dictionary;
+    uint32_t m_epoch;
+    //handle арены таблицы -> номер в словаре; сбрасывается при пересборке арены таблицы
+    std::vector<StringArena::Handle> m_tableIds;
+    uint64_t m_mappedVersion;
+};
+
+//Процесс в декодированном двоичном снимке: строки - номера словаря
+struct BinaryProcess {
+    DWORD pid;
+    DWORD parentPid;
+    uint32_t nameId;
+    uint32_t pathId;
+};
+
+/*
+Клиентская сторона: собирает снимок из потока кадров.
+Используется тестами и генератором нагрузки.
+*/
+class ProcessBinaryDecoder {
+public:
+    //Полный размер кадра в начале data (с полем длины); 0 - данных пока недостаточно
+    static size_t frameSize(const char* data, size_t size);
+
+    //Применяет один кадр; false - кадр поврежден или ссылается на неизвестные строки
+    bool apply(const char* frame, size_t size);
+
+    uint8_t lastType() const { return m_lastType; }
+    uint64_t generation() const { return m_generation; }
+    const std::vector<BinaryProcess>& processes() const { return m_processes; }
+    const std::string& string(uint32_t id) const { return m_strings[id]; }
+    size_t stringCount() const { return m_strings.size(); }
+    const std::string& error() const { return m_error; }
+
+private:
+    bool applySnapshot(const unsigned char*& pos, const unsigned char* end);
+    bool applyDelta(const unsigned char*& pos, const unsigned char* end);
+    bool applyStrings(const unsigned char*& pos, const unsigned char* end);
+
+    std::vector<std::string> m_strings{std::string()};
+    uint32_t m_epoch = 0;
+    std::vector<BinaryProcess> m_processes;
+    std::unordered_map<DWORD, size_t> m_index; //pid -> позиция в m_processes
+    uint64_t m_generation = 0;
+    uint8_t m_lastType = 0;
+    std::string m_error;
+};
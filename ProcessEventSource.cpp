@@ -0,0 +1,457 @@
+#include "ProcessEventSource.h"
+#include "Metrics.h"
+#include <algorithm>
+#include <fstream>
+#include <iostream>
+#include <cstddef>
+#include <cstring>
+#ifndef _WIN32
+#include "ProcFsReader.h"
+#endif
+#ifdef __linux__
+#include <cerrno>
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#include <linux/netlink.h>
+#include <linux/connector.h>
+#include <linux/cn_proc.h>
+#endif
+
+namespace {
+
+MetricGauge queueDepth("monitor_event_queue_depth", "Process events waiting in the consumer queue");
+
+uint64_t monotonicNs() {
+    return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count());
+}
+
+#ifdef __linux__
+//Подтверждение подписки приходит от ядра почти сразу; дольше - событий не будет вовсе
+const int SUBSCRIBE_TIMEOUT_MS = 500;
+const int RECEIVE_BUFFER = 4 << 20;   //запас на всплеск fork'ов между чтениями
+const size_t DATAGRAM_SIZE = 8192;
+
+//Команда подписки/отписки на события proc connector
+bool sendControl(int socket, proc_cn_mcast_op operation) {
+    char buffer[NLMSG_SPACE(sizeof(cn_msg) + sizeof(proc_cn_mcast_op))];
+    std::memset(buffer, 0, sizeof(buffer));
+    nlmsghdr header;
+    std::memset(&header, 0, sizeof(header));
+    header.nlmsg_len = NLMSG_LENGTH(sizeof(cn_msg) + sizeof(operation));
+    header.nlmsg_type = NLMSG_DONE;
+    header.nlmsg_pid = static_cast<__u32>(::getpid());
+    cn_msg message;
+    std::memset(&message, 0, sizeof(message));
+    message.id.idx = CN_IDX_PROC;
+    message.id.val = CN_VAL_PROC;
+    message.len = sizeof(operation);
+    std::memcpy(buffer, &header, sizeof(header));
+    std::memcpy(buffer + NLMSG_HDRLEN, &message, sizeof(message));
+    std::memcpy(buffer + NLMSG_HDRLEN + sizeof(message), &operation, sizeof(operation));
+    return ::send(socket, buffer, header.nlmsg_len, 0) == static_cast<ssize_t>(header.nlmsg_len);
+}
+#endif
+
+} // namespace
+
+ProcessEventSource::ProcessEventSource(ThreadSafeQueue<ProcessEvent>& queue) : m_queue(queue) {
+    m_queue.setDepthGauge(&queueDepth);
+}
+
+ProcessEventSource::~ProcessEventSource() {
+    stop();
+}
+
+bool ProcessEventSource::start(Mode preferred) {
+    if (m_running.load()) {
+        return false;
+    }
+#ifndef _WIN32
+    if (!m_reader) {
+        m_reader.reset(new ProcFsReader());
+    }
+#endif
+    m_replayFinished.store(false);
+
+    if (preferred == Mode::Replay) {
+        if (m_replayPath.empty()) {
+            std::cerr << "Replay mode requires a replay file" << std::endl;
+            return false;
+        }
+        m_mode = Mode::Replay;
+        m_running.store(true);
+        m_thread = std::thread(&ProcessEventSource::replayLoop, this);
+        return true;
+    }
+
+#ifdef __linux__
+    if (preferred == Mode::Netlink && openNetlink()) {
+        m_mode = Mode::Netlink;
+        m_running.store(true);
+        m_thread = std::thread(&ProcessEventSource::netlinkLoop, this);
+        return true;
+    }
+#endif
+    if (preferred == Mode::Netlink) {
+        std::cerr << "Process connector unavailable, falling back to polling" << std::endl;
+    }
+    m_mode = Mode::Polling;
+    m_running.store(true);
+    m_thread = std::thread(&ProcessEventSource::pollLoop, this);
+    return true;
+}
+
+void ProcessEventSource::stop() {
+    {
+        std::lock_guard<std::mutex> lock(m_stopMutex);
+        m_running.store(false);
+    }
+    m_stopCondition.notify_all();
+#ifdef __linux__
+    if (m_wakeFd >= 0) {
+        uint64_t one = 1;
+        ssize_t written = ::write(m_wakeFd, &one, sizeof(one));
+        (void)written; //счетчик eventfd не переполнится от одной записи
+    }
+#endif
+    if (m_thread.joinable()) {
+        m_thread.join();
+    }
+#ifdef __linux__
+    closeNetlink();
+#endif
+}
+
+void ProcessEventSource::inject(ProcessEvent event) {
+    m_queue.push(std::move(event));
+}
+
+bool ProcessEventSource::waitStop(Clock::duration timeout) {
+    std::unique_lock<std::mutex> lock(m_stopMutex);
+    return m_stopCondition.wait_for(lock, timeout, [this]() { return !m_running.load(); });
+}
+
+void ProcessEventSource::enrich(ProcessEvent& event) {
+#ifdef _WIN32
+    auto info = ProcessInfo::getProcessInfo(event.pid);
+    if (info) {
+        event.name = info->getName();
+        event.path = info->getPath();
+        event.startTime = info->getStartTime();
+        if (event.parentPid == 0) {
+            event.parentPid = info->getParentPid();
+        }
+    }
+#else
+    ProcessRecord record;
+    if (m_reader->readProcess(event.pid, record)) {
+        event.name.assign(record.name.data(), record.name.size());
+        event.path.assign(record.path.data(), record.path.size());
+        event.startTime = record.startTime;
+        if (event.parentPid == 0) {
+            event.parentPid = record.parentPid;
+        }
+    }
+#endif
+}
+
+void ProcessEventSource::rescan(ProcessEvent::Source source, bool emit) {
+#ifdef _WIN32
+    const auto& changes = m_differ.update(ProcessInfo::getRunningProcesses());
+#else
+    const auto& changes = m_differ.update(*m_reader);
+#endif
+    if (!emit) {
+        return;
+    }
+    uint64_t now = monotonicNs();
+    for (const auto& change : changes) {
+        const ProcessInfo& process = *change.process;
+        //Сверка после netlink: о процессе уже сообщило ядро
+        if (source == ProcessEvent::Source::Rescan && m_reported.count(process.getPid()) != 0) {
+            continue;
+        }
+        ProcessEvent event;
+        event.source = source;
+        event.pid = process.getPid();
+        event.parentPid = process.getParentPid();
+        event.startTime = process.getStartTime();
+        event.timestampNs = now;
+        switch (change.type) {
+        case ProcessChange::Type::Spawned:
+            event.type = ProcessEvent::Type::Fork;
+            break;
+        case ProcessChange::Type::Changed:
+            //Смена только родителя (переподчинение) - не exec
+            if (change.previous && change.previous->getPath() == process.getPath() &&
+                change.previous->getName() == process.getName()) {
+                continue;
+            }
+            event.type = ProcessEvent::Type::Exec;
+            break;
+        case ProcessChange::Type::Exited:
+            event.type = ProcessEvent::Type::Exit;
+            event.exitCode = -1; //по скану код завершения неизвестен
+            break;
+        }
+        if (event.type != ProcessEvent::Type::Exit) {
+            event.name = process.getName();
+            event.path = process.getPath();
+        }
+        m_queue.push(std::move(event));
+    }
+}
+
+void ProcessEventSource::pollLoop() {
+    rescan(ProcessEvent::Source::Poll, false); //уже работающие процессы - не события
+    while (!waitStop(m_pollInterval)) {
+        rescan(ProcessEvent::Source::Poll, true);
+    }
+}
+
+void ProcessEventSource::replayLoop() {
+    std::ifstream file(m_replayPath, std::ios::binary);
+    if (!file) {
+        std::cerr << "Cannot open replay file " << m_replayPath << std::endl;
+        m_replayFinished.store(true);
+        return;
+    }
+    //Формат записи: u32 длина (little-endian), затем датаграмма
+    std::vector<char> datagram;
+    std::vector<ProcessEvent> events;
+    unsigned char prefix[4];
+    while (m_running.load() && file.read(reinterpret_cast<char*>(prefix), sizeof(prefix))) {
+        uint32_t length = static_cast<uint32_t>(prefix[0]) | (static_cast<uint32_t>(prefix[1]) << 8) |
+                          (static_cast<uint32_t>(prefix[2]) << 16) | (static_cast<uint32_t>(prefix[3]) << 24);
+        datagram.resize(length);
+        if (!file.read(datagram.data(), static_cast<std::streamsize>(length))) {
+            std::cerr << "Truncated replay file " << m_replayPath << std::endl;
+            break;
+        }
+        events.clear();
+        parseDatagram(datagram.data(), datagram.size(), events);
+        for (auto& event : events) {
+            event.source = ProcessEvent::Source::Replay;
+            m_queue.push(std::move(event));
+        }
+    }
+    m_replayFinished.store(true);
+}
+
+size_t ProcessEventSource::parseDatagram(const char* data, size_t size, std::vector<ProcessEvent>& out, bool* ack) {
+#ifdef __linux__
+    size_t added = 0;
+    while (size >= NLMSG_HDRLEN) {
+        //Данные могут быть не выровнены (файл записи) - только memcpy
+        nlmsghdr header;
+        std::memcpy(&header, data, sizeof(header));
+        if (header.nlmsg_len < NLMSG_HDRLEN || header.nlmsg_len > size) {
+            break;
+        }
+        size_t payloadSize = header.nlmsg_len - NLMSG_HDRLEN;
+        if (header.nlmsg_type != NLMSG_ERROR && header.nlmsg_type != NLMSG_NOOP && payloadSize >= sizeof(cn_msg)) {
+            cn_msg message;
+            std::memcpy(&message, data + NLMSG_HDRLEN, sizeof(message));
+            size_t eventSize = std::min<size_t>(message.len, payloadSize - sizeof(cn_msg));
+            if (message.id.idx == CN_IDX_PROC && message.id.val == CN_VAL_PROC &&
+                eventSize >= offsetof(proc_event, event_data)) {
+                proc_event event;
+                std::memset(&event, 0, sizeof(event));
+                std::memcpy(&event, data + NLMSG_HDRLEN + sizeof(cn_msg), std::min(eventSize, sizeof(event)));
+
+                ProcessEvent parsed;
+                parsed.source = ProcessEvent::Source::Netlink;
+                parsed.timestampNs = event.timestamp_ns;
+                bool keep = false;
+                switch (event.what) {
+                case proc_event::PROC_EVENT_NONE:
+                    if (ack) {
+                        *ack = true;
+                    }
+                    break;
+                case proc_event::PROC_EVENT_FORK:
+                    //Новые потоки тоже приходят как fork - нужны только процессы
+                    keep = event.event_data.fork.child_pid == event.event_data.fork.child_tgid;
+                    parsed.type = ProcessEvent::Type::Fork;
+                    parsed.pid = static_cast<DWORD>(event.event_data.fork.child_tgid);
+                    parsed.parentPid = static_cast<DWORD>(event.event_data.fork.parent_tgid);
+                    break;
+                case proc_event::PROC_EVENT_EXEC:
+                    keep = true;
+                    parsed.type = ProcessEvent::Type::Exec;
+                    parsed.pid = static_cast<DWORD>(event.event_data.exec.process_tgid);
+                    break;
+                case proc_event::PROC_EVENT_EXIT:
+                    keep = event.event_data.exit.process_pid == event.event_data.exit.process_tgid;
+                    parsed.type = ProcessEvent::Type::Exit;
+                    parsed.pid = static_cast<DWORD>(event.event_data.exit.process_tgid);
+                    parsed.parentPid = static_cast<DWORD>(event.event_data.exit.parent_tgid);
+                    parsed.exitCode = static_cast<int>(event.event_data.exit.exit_code);
+                    break;
+                default:
+                    break; //uid/gid/sid/comm/ptrace/coredump не отслеживаем
+                }
+                if (keep) {
+                    out.push_back(std::move(parsed));
+                    ++added;
+                }
+            }
+        }
+        size_t step = NLMSG_ALIGN(header.nlmsg_len);
+        if (step >= size) {
+            break;
+        }
+        data += step;
+        size -= step;
+    }
+    return added;
+#else
+    (void)data;
+    (void)size;
+    (void)out;
+    (void)ack;
+    return 0;
+#endif
+}
+
+#ifdef __linux__
+
+bool ProcessEventSource::openNetlink() {
+    m_socket = ::socket(PF_NETLINK, SOCK_DGRAM | SOCK_CLOEXEC, NETLINK_CONNECTOR);
+    if (m_socket < 0) {
+        return false;
+    }
+    sockaddr_nl address;
+    std::memset(&address, 0, sizeof(address));
+    address.nl_family = AF_NETLINK;
+    address.nl_groups = CN_IDX_PROC;
+    //Без CAP_NET_ADMIN bind в группу proc connector дает EPERM
+    if (::bind(m_socket, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0) {
+        closeNetlink();
+        return false;
+    }
+    int size = RECEIVE_BUFFER;
+    if (::setsockopt(m_socket, SOL_SOCKET, SO_RCVBUFFORCE, &size, sizeof(size)) != 0) {
+        ::setsockopt(m_socket, SOL_SOCKET, SO_RCVBUF, &size, sizeof(size));
+    }
+    if (!sendControl(m_socket, PROC_CN_MCAST_LISTEN)) {
+        closeNetlink();
+        return false;
+    }
+    m_subscribed = true;
+
+    //Ядро подтверждает подписку событием PROC_EVENT_NONE; вне начальных
+    //пространств имен PID/user подписка молча игнорируется - ждать событий бессмысленно
+    alignas(nlmsghdr) char buffer[DATAGRAM_SIZE];
+    std::vector<ProcessEvent> ignored;
+    bool acknowledged = false;
+    auto deadline = Clock::now() + std::chrono::milliseconds(SUBSCRIBE_TIMEOUT_MS);
+    while (!acknowledged) {
+        auto left = std::chrono::duration_cast<std::chrono::milliseconds>(deadline - Clock::now()).count();
+        pollfd descriptor{m_socket, POLLIN, 0};
+        if (left <= 0 || ::poll(&descriptor, 1, static_cast<int>(left)) <= 0) {
+            break;
+        }
+        ssize_t got = ::recv(m_socket, buffer, sizeof(buffer), 0);
+        if (got <= 0) {
+            break;
+        }
+        parseDatagram(buffer, static_cast<size_t>(got), ignored, &acknowledged);
+    }
+    if (!acknowledged) {
+        closeNetlink();
+        return false;
+    }
+
+    m_wakeFd = ::eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+    if (m_wakeFd < 0) {
+        closeNetlink();
+        return false;
+    }
+    return true;
+}
+
+void ProcessEventSource::closeNetlink() {
+    if (m_socket >= 0) {
+        if (m_subscribed) {
+            sendControl(m_socket, PROC_CN_MCAST_IGNORE);
+            m_subscribed = false;
+        }
+        ::close(m_socket);
+        m_socket = -1;
+    }
+    if (m_wakeFd >= 0) {
+        ::close(m_wakeFd);
+        m_wakeFd = -1;
+    }
+}
+
+void ProcessEventSource::netlinkLoop() {
+    rescan(ProcessEvent::Source::Rescan, false);
+    std::ofstream record;
+    if (!m_recordPath.empty()) {
+        record.open(m_recordPath, std::ios::binary | std::ios::trunc);
+        if (!record) {
+            std::cerr << "Cannot write event record " << m_recordPath << std::endl;
+        }
+    }
+
+    alignas(nlmsghdr) char buffer[DATAGRAM_SIZE];
+    std::vector<ProcessEvent> events;
+    auto nextRescan = Clock::now() + m_rescanInterval;
+    while (m_running.load()) {
+        auto left = std::chrono::duration_cast<std::chrono::milliseconds>(nextRescan - Clock::now()).count();
+        pollfd descriptors[2] = {{m_socket, POLLIN, 0}, {m_wakeFd, POLLIN, 0}};
+        int ready = ::poll(descriptors, 2, static_cast<int>(std::max<long long>(0, std::min<long long>(left, 60000))));
+        if (ready < 0 && errno != EINTR) {
+            std::cerr << "poll() on process connector failed: " << std::strerror(errno) << std::endl;
+            break;
+        }
+        if (descriptors[1].revents & POLLIN) {
+            break; //stop()
+        }
+
+        bool lost = false;
+        if (descriptors[0].revents & POLLIN) {
+            for (;;) {
+                ssize_t got = ::recv(m_socket, buffer, sizeof(buffer), MSG_DONTWAIT);
+                if (got < 0) {
+                    if (errno == ENOBUFS) {
+                        //Ядро выбросило события, пока мы не читали: сверка сканом
+                        ++m_overruns;
+                        lost = true;
+                        continue;
+                    }
+                    break; //EAGAIN - все прочитано
+                }
+                if (record.is_open()) {
+                    unsigned char prefix[4] = {
+                        static_cast<unsigned char>(got & 0xFF), static_cast<unsigned char>((got >> 8) & 0xFF),
+                        static_cast<unsigned char>((got >> 16) & 0xFF), static_cast<unsigned char>((got >> 24) & 0xFF)};
+                    record.write(reinterpret_cast<const char*>(prefix), sizeof(prefix));
+                    record.write(buffer, got);
+                }
+                events.clear();
+                parseDatagram(buffer, static_cast<size_t>(got), events);
+                for (auto& event : events) {
+                    if (event.type != ProcessEvent::Type::Exit) {
+                        enrich(event);
+                    }
+                    m_reported.insert(event.pid);
+                    m_queue.push(std::move(event));
+                }
+            }
+        }
+
+        if (lost || Clock::now() >= nextRescan) {
+            rescan(ProcessEvent::Source::Rescan, true);
+            m_reported.clear();
+            nextRescan = Clock::now() + m_rescanInterval;
+        }
+    }
+}
+
+#endif
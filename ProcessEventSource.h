@@ -0,0 +1,125 @@
+// ProcessEventSource.h
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <string>
+#include <memory>
+#include <thread>
+#include <unordered_set>
+#include <vector>
+#include <cstdint>
+#include "Platform.h"
+#include "ThreadSafeQueue.h"
+#include "ProcessSnapshotDiffer.h"
+
+#ifndef _WIN32
+class ProcFsReader;
+#endif
+
+//Событие жизненного цикла процесса
+struct ProcessEvent {
+    enum class Type { Fork, Exec, Exit };
+    //Откуда событие: ядро, сравнение сканов, сверочный скан, запись или ручная вставка
+    enum class Source { Netlink, Poll, Rescan, Replay, Injected };
+
+    Type type = Type::Fork;
+    Source source = Source::Injected;
+    DWORD pid = 0;
+    DWORD parentPid = 0;
+    uint64_t startTime = 0;   //как в ProcessRecord; 0 - процесс завершился раньше, чем его прочитали
+    uint64_t timestampNs = 0; //CLOCK_MONOTONIC (у netlink - время ядра)
+    int exitCode = 0;         //только Exit: статус в формате wait()
+    std::string name;         //Fork/Exec: comm и путь, если процесс еще был жив
+    std::string path;
+};
+
+/*
+Поток событий fork/exec/exit в ThreadSafeQueue<ProcessEvent>.
+Режимы:
+- Netlink: proc connector ядра (нужен CAP_NET_ADMIN в начальном сетевом
+  пространстве имен). Видит каждый exec, даже процессы, прожившие
+  миллисекунды. Раз в rescanInterval (по умолчанию минуты) идет сверочный
+  скан: он находит только то, что ядро не доставило (переполнение буфера
+  сокета - ENOBUFS - запускает сверку сразу), и помечает это Source::Rescan
+- Polling: сравнение полных сканов через ProcessSnapshotDiffer раз в
+  pollInterval. Выбирается автоматически, если netlink недоступен
+  (нет прав, нет подтверждения подписки от ядра, не Linux)
+- Replay: проигрывание записанных датаграмм netlink из файла (см. setRecordFile) -
+  тот же разбор, что и у живого сокета, но без привилегий
+inject() кладет событие в очередь в любом режиме (тесты, внешние источники).
+*/
+class ProcessEventSource {
+public:
+    enum class Mode { Netlink, Polling, Replay };
+    typedef std::chrono::steady_clock Clock;
+
+    explicit ProcessEventSource(ThreadSafeQueue<ProcessEvent>& queue);
+    ~ProcessEventSource();
+
+    ProcessEventSource(const ProcessEventSource&) = delete;
+    ProcessEventSource& operator=(const ProcessEventSource&) = delete;
+
+    //Netlink с откатом на Polling; Replay требует setReplayFile
+    bool start(Mode preferred = Mode::Netlink);
+    void stop();
+    bool isRunning() const { return m_running.load(); }
+    Mode mode() const { return m_mode; }
+
+    void setPollInterval(Clock::duration interval) { m_pollInterval = interval; }
+    void setRescanInterval(Clock::duration interval) { m_rescanInterval = interval; }
+    //Netlink: сохранять сырые датаграммы в файл для последующего Replay
+    void setRecordFile(const std::string& path) { m_recordPath = path; }
+    void setReplayFile(const std::string& path) { m_replayPath = path; }
+
+    void inject(ProcessEvent event);
+
+    //Replay: все датаграммы файла разобраны
+    bool replayFinished() const { return m_replayFinished.load(); }
+    //Сколько раз ядро теряло события (ENOBUFS)
+    size_t overruns() const { return m_overruns.load(); }
+
+    //Разбор одной датаграммы proc connector; возвращает число добавленных событий.
+    //ack = true, если в датаграмме подтверждение подписки
+    static size_t parseDatagram(const char* data, size_t size, std::vector<ProcessEvent>& out, bool* ack = nullptr);
+
+private:
+    void pollLoop();
+    void replayLoop();
+    //Скан и отправка отличий от прошлого скана; emit = false - только запомнить состояние
+    void rescan(ProcessEvent::Source source, bool emit);
+    //Имя, путь и время старта из /proc (процесс мог уже завершиться)
+    void enrich(ProcessEvent& event);
+    bool waitStop(Clock::duration timeout);
+
+#ifdef __linux__
+    bool openNetlink();
+    void closeNetlink();
+    void netlinkLoop();
+    int m_socket = -1;
+    int m_wakeFd = -1;
+    bool m_subscribed = false; //IGNORE без LISTEN сбил бы счетчик слушателей в ядре
+#endif
+
+    ThreadSafeQueue<ProcessEvent>& m_queue;
+    Mode m_mode = Mode::Polling;
+    std::thread m_thread;
+    std::atomic<bool> m_running{false};
+    std::atomic<bool> m_replayFinished{false};
+    std::atomic<size_t> m_overruns{0};
+    std::mutex m_stopMutex;
+    std::condition_variable m_stopCondition;
+
+    Clock::duration m_pollInterval = std::chrono::seconds(1);
+    Clock::duration m_rescanInterval = std::chrono::minutes(5);
+    std::string m_recordPath;
+    std::string m_replayPath;
+
+    //Сканы - только из рабочего потока
+    ProcessSnapshotDiffer m_differ;
+    std::unordered_set<DWORD> m_reported; //PID, о которых ядро сообщило после прошлого скана
+#ifndef _WIN32
+    std::unique_ptr<ProcFsReader> m_reader;
+#endif
+};
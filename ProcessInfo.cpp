@@ -1,13 +1,49 @@
 #include "ProcessInfo.h"
+#include "Metrics.h"
+#ifdef _WIN32
 #include <tlhelp32.h> // Для функций процессов
 #include <psapi.h>  // Для получения информации о процессах
+#else
+#include "ProcFsReader.h"
+#endif
 
 ProcessInfo::ProcessInfo(DWORD pid, const std::string& name, 
-            const std::string& path, DWORD parentPid) : m_pid(pid), m_name(name), m_path(path), m_parentPid(parentPid)
+            const std::string& path, DWORD parentPid, uint64_t startTime) : m_pid(pid), m_name(name), m_path(path), m_parentPid(parentPid), m_startTime(startTime)
             {
 
             }
 
+#ifdef _WIN32
+
+namespace {
+MetricCounter openFailures("monitor_process_read_failures_total", "Per-PID lookups that failed", "stage", "open");
+MetricCounter pathFailures("monitor_process_read_failures_total", "Per-PID lookups that failed", "stage", "exe");
+
+//Один OpenProcess на процесс: путь и время создания (FILETIME как 64-битное число)
+bool queryProcess(DWORD pid, std::string& path, uint64_t& startTime) {
+    HANDLE hProcess = OpenProcess(PROCESS_QUERY_INFORMATION | PROCESS_VM_READ, FALSE, pid);
+    if (!hProcess) {
+        openFailures.add();
+        return false;
+    }
+
+    char buffer[MAX_PATH];
+    if (GetModuleFileNameExA(hProcess, NULL, buffer, MAX_PATH)) {
+        path = buffer;
+    } else {
+        pathFailures.add();
+    }
+
+    FILETIME creation, exitTime, kernelTime, userTime;
+    if (GetProcessTimes(hProcess, &creation, &exitTime, &kernelTime, &userTime)) {
+        startTime = (static_cast<uint64_t>(creation.dwHighDateTime) << 32) | creation.dwLowDateTime;
+    }
+
+    CloseHandle(hProcess);
+    return true;
+}
+} // namespace
+
 std::vector<std::shared_ptr<ProcessInfo>> ProcessInfo::getRunningProcesses() {
     
     std::vector <std::shared_ptr<ProcessInfo>> processes;
@@ -33,13 +69,16 @@ Process32Next - получаем следующий процесс
 */
     if (Process32First(snapshot, &processEntry)) {
         do {
-            std::string fullPath = getProcessPath(processEntry.th32ProcessID);
+            std::string fullPath;
+            uint64_t startTime = 0;
+            queryProcess(processEntry.th32ProcessID, fullPath, startTime);
 
             auto process = std::make_shared<ProcessInfo>(
                 processEntry.th32ProcessID, //PID
                 processEntry.szExeFile, //name of file
                 fullPath, //path
-                processEntry.th32ParentProcessID //Parent PID
+                processEntry.th32ParentProcessID, //Parent PID
+                startTime //время создания, отличает переиспользованный PID
             );
             processes.push_back(process);
         } while (Process32Next(snapshot, &processEntry));
@@ -58,19 +97,59 @@ WinAPI функции: CreateToolhelp32Snapshot, Process32First/Next
 */
 
 std::string ProcessInfo::getProcessPath(DWORD pid) {
-    HANDLE hProcess = OpenProcess(PROCESS_QUERY_INFORMATION | PROCESS_VM_READ, FALSE, pid);
-    if (!hProcess) {
-        return "";
+    std::string path;
+    uint64_t startTime = 0;
+    queryProcess(pid, path, startTime);
+    return path;
+}
+
+#else
+
+/*
+Linux: данные берутся из /proc через ProcFsReader.
+Reader держит дескриптор /proc и буферы, поэтому один экземпляр на поток
+переиспользуется между вызовами.
+*/
+namespace {
+ProcFsReader& threadReader() {
+    thread_local ProcFsReader reader;
+    return reader;
+}
+} // namespace
+
+std::vector<std::shared_ptr<ProcessInfo>> ProcessInfo::getRunningProcesses() {
+    return getRunningProcesses(threadReader());
+}
+
+std::vector<std::shared_ptr<ProcessInfo>> ProcessInfo::getRunningProcesses(ProcFsReader& reader) {
+    std::vector<std::shared_ptr<ProcessInfo>> processes;
+    reader.forEachProcess([&processes](const ProcessRecord& record) {
+        processes.push_back(std::make_shared<ProcessInfo>(
+            record.pid,
+            std::string(record.name),
+            std::string(record.path),
+            record.parentPid,
+            record.startTime
+        ));
+    });
+    return processes;
+}
+
+std::shared_ptr<ProcessInfo> ProcessInfo::getProcessInfo(DWORD pid) {
+    ProcessRecord record;
+    if (!threadReader().readProcess(pid, record)) {
+        return nullptr;
     }
+    return std::make_shared<ProcessInfo>(record.pid, std::string(record.name),
+                                         std::string(record.path), record.parentPid, record.startTime);
+}
 
-    char path[MAX_PATH];
-    DWORD pathSize = MAX_PATH;
-    
-    if(GetModuleFileNameExA(hProcess, NULL, path, pathSize)) {
-        CloseHandle(hProcess);
-        return std::string(path);
+std::string ProcessInfo::getProcessPath(DWORD pid) {
+    ProcessRecord record;
+    if (!threadReader().readProcess(pid, record)) {
+        return "";
     }
+    return std::string(record.path);
+}
 
-    CloseHandle(hProcess);
-    return "";
-}
\ No newline at end of file
+#endif
@@ -1,11 +1,32 @@
 // ProcessInfo.h
 #pragma once
 #include <string>
-#include <windows.h> //WinAPI
 #include <memory> //shared_ptr
 #include <vector> 
+#include <string_view>
+#include <cstdint>
+#include "Platform.h"
 
 class ProcessInfo;
+#ifndef _WIN32
+class ProcFsReader;
+#endif
+
+/*
+Сырая запись о процессе от источника данных (/proc, снимок WinAPI).
+name и path не владеют памятью и действительны только до следующего
+чтения источника - кто хочет сохранить, копирует.
+*/
+struct ProcessRecord {
+    static constexpr uint32_t UNKNOWN_UID = 0xFFFFFFFFu; //(uid_t)-1 в Linux не бывает у процесса
+
+    DWORD pid = 0;
+    DWORD parentPid = 0;
+    uint64_t startTime = 0; //время старта: Linux - тики с загрузки, Windows - FILETIME
+    std::string_view name;
+    std::string_view path;
+    uint32_t uid = UNKNOWN_UID; //владелец (Linux - эффективный uid); WinAPI-скан его не заполняет
+};
 
 class ProcessInfo {
 
@@ -14,23 +35,30 @@ private:
     std::string m_name; //m - member
     std::string m_path;
     DWORD m_parentPid;
+    uint64_t m_startTime; //вместе с pid однозначно определяет процесс (pid может быть переиспользован)
 
 public:
 //Constructor вызывается при создании объекта
     ProcessInfo (DWORD pid, const std::string& name, 
-        const std::string& path, DWORD parentPid);
+        const std::string& path, DWORD parentPid, uint64_t startTime = 0);
 
 //Getter для безопасного доступа к private данным
     DWORD getPid() const {return m_pid;}
     const std::string& getName() const {return m_name;} //const - метод не меняет объект
     const std::string& getPath() const {return m_path;}
     DWORD getParentPid() const { return m_parentPid;}
+    uint64_t getStartTime() const { return m_startTime;}
 
 //Static methods work without creating an object 
 //static - принадлжеит к классу, а не объекту; умный указатель автоматически удаляется когда не нужен; вектор возвращает список процессов;
     static std::vector <std::shared_ptr<ProcessInfo>> getRunningProcesses(); 
     static std::shared_ptr<ProcessInfo> getProcessInfo(DWORD pid);
     static std::string getProcessPath(DWORD pid);
+
+#ifndef _WIN32
+//Linux: скан через уже открытый reader (переиспользует дескриптор /proc и буферы)
+    static std::vector <std::shared_ptr<ProcessInfo>> getRunningProcesses(ProcFsReader& reader);
+#endif
 };
 
 /*
@@ -0,0 +1,537 @@
+#include "ProcessJson.h"
+
+void ProcessJson::appendString(std::string& out, std::string_view value) {
+    JsonWriter writer;
+    writer.string(value);
+    out.append(writer.data(), writer.size());
+}
+
+namespace {
+
+void writeProcess(JsonWriter& out, DWORD pid, std::string_view name, std::string_view path, DWORD parentPid) {
+    out.raw("\"pid\":");
+    out.number(pid);
+    out.raw(",\"name\":");
+    out.string(name);
+    out.raw(",\"path\":");
+    out.string(path);
+    out.raw(",\"parent_pid\":");
+    out.number(parentPid);
+}
+
+//Поля дескриптора без фигурных скобок
+void writeFd(JsonWriter& out, const FdInventory& inventory, const FdInventory::Fd& fd) {
+    out.raw("\"fd\":");
+    out.number(fd.fd);
+    out.raw(",\"type\":\"");
+    out.raw(FdInventory::typeName(inventory.type(fd)));
+    out.raw('"');
+    if (fd.kind == FdInventory::Type::File) {
+        out.raw(",\"path\":");
+        out.string(inventory.string(fd.target));
+        return;
+    }
+    if (fd.kind == FdInventory::Type::Other) {
+        out.raw(",\"target\":");
+        out.string(inventory.string(fd.target));
+        return;
+    }
+    out.raw(",\"inode\":");
+    out.number(fd.inode);
+    const FdInventory::Socket* socket = fd.kind == FdInventory::Type::Socket ? inventory.findSocket(fd.inode) : nullptr;
+    if (!socket) {
+        return;
+    }
+    if (socket->type == FdInventory::Type::Unix) {
+        out.raw(",\"path\":");
+        out.string(inventory.string(socket->path));
+    } else {
+        char address[64];
+        out.raw(",\"local\":\"");
+        out.raw(std::string_view(address, FdInventory::formatAddress(*socket, false, address, sizeof(address))));
+        out.raw("\",\"remote\":\"");
+        out.raw(std::string_view(address, FdInventory::formatAddress(*socket, true, address, sizeof(address))));
+        out.raw('"');
+    }
+    out.raw(",\"state\":\"");
+    out.raw(FdInventory::stateName(*socket));
+    out.raw('"');
+}
+
+} // namespace
+
+std::string_view JsonStringCache::get(const ProcessTable& table, StringArena::Handle handle) {
+    if (m_table != &table || m_version != table.stringsVersion()) {
+        m_escaped.clear();
+        m_table = &table;
+        m_version = table.stringsVersion();
+    }
+    if (handle >= m_escaped.size()) {
+        m_escaped.resize(table.strings().size());
+    }
+    std::string& escaped = m_escaped[handle];
+    if (escaped.empty()) {
+        m_writer.clear();
+        m_writer.string(table.strings().get(handle));
+        escaped.assign(m_writer.data(), m_writer.size());
+    }
+    return escaped;
+}
+
+namespace {
+
+void writeHeader(JsonWriter& out, uint64_t generation) {
+    out.raw("{\"status\":\"success\",");
+    if (generation != 0) {
+        out.raw("\"generation\":");
+        out.number(generation);
+        out.raw(',');
+    }
+    out.raw("\"processes\":[");
+}
+
+} // namespace
+
+void ProcessJson::writeProcesses(JsonWriter& out, const ProcessTable& table, uint64_t generation, JsonStringCache& strings,
+                                 ProcessFilter filter) {
+    writeHeader(out, generation);
+    const std::vector<DWORD>& pids = table.pids();
+    const std::vector<DWORD>& parentPids = table.parentPids();
+    const std::vector<uint32_t>& uids = table.uids();
+    const std::vector<StringArena::Handle>& nameIds = table.nameIds();
+    const std::vector<StringArena::Handle>& pathIds = table.pathIds();
+    bool first = true;
+    for (size_t row = 0; row < table.size(); ++row) {
+        if (!ProcessOwner::matches(filter, uids[row])) {
+            continue;
+        }
+        out.raw(first ? "{\"pid\":" : ",{\"pid\":");
+        first = false;
+        out.number(pids[row]);
+        out.raw(",\"name\":");
+        out.raw(strings.get(table, nameIds[row]));
+        out.raw(",\"path\":");
+        out.raw(strings.get(table, pathIds[row]));
+        out.raw(",\"parent_pid\":");
+        out.number(parentPids[row]);
+        out.raw('}');
+    }
+    out.raw("]}");
+}
+
+void ProcessJson::writeProcesses(JsonWriter& out, const ProcessTable& table, uint64_t generation) {
+    writeHeader(out, generation);
+    //Колонки напрямую, без ProcessView: строки берутся из арены по handle
+    const std::vector<DWORD>& pids = table.pids();
+    const std::vector<DWORD>& parentPids = table.parentPids();
+    const std::vector<StringArena::Handle>& nameIds = table.nameIds();
+    const std::vector<StringArena::Handle>& pathIds = table.pathIds();
+    const StringArena& strings = table.strings();
+    for (size_t row = 0; row < table.size(); ++row) {
+        out.raw(row > 0 ? ",{" : "{");
+        writeProcess(out, pids[row], strings.get(nameIds[row]), strings.get(pathIds[row]), parentPids[row]);
+        out.raw('}');
+    }
+    out.raw("]}");
+}
+
+void ProcessJson::writeChanges(JsonWriter& out, uint64_t generation, const std::vector<ProcessChange>& changes) {
+    out.raw("{\"event\":\"delta\",\"generation\":");
+    out.number(generation);
+    out.raw(",\"changes\":[");
+    bool first = true;
+    //Сначала завершения: при переиспользовании PID клиент удалит старый процесс раньше, чем добавит новый
+    for (int pass = 0; pass < 2; ++pass) {
+        for (const auto& change : changes) {
+            bool exited = change.type == ProcessChange::Type::Exited;
+            if (exited != (pass == 0)) {
+                continue;
+            }
+            if (!first) {
+                out.raw(',');
+            }
+            first = false;
+            const ProcessInfo& process = *change.process;
+            if (exited) {
+                out.raw("{\"type\":\"exited\",\"pid\":");
+                out.number(process.getPid());
+                out.raw('}');
+                continue;
+            }
+            out.raw(change.type == ProcessChange::Type::Spawned ? "{\"type\":\"spawned\"," : "{\"type\":\"changed\",");
+            writeProcess(out, process.getPid(), process.getName(), process.getPath(), process.getParentPid());
+            out.raw('}');
+        }
+    }
+    out.raw("]}");
+}
+
+void ProcessJson::writeError(JsonWriter& out, std::string_view message) {
+    out.raw("{\"status\":\"error\",\"message\":");
+    out.string(message);
+    out.raw('}');
+}
+
+void ProcessJson::writeHistory(JsonWriter& out, const HistoryResult& history) {
+    out.raw("{\"status\":\"success\",\"pid\":");
+    out.number(history.pid);
+    out.raw(",\"start_time\":");
+    out.number(history.startTime);
+    out.raw(history.alive ? ",\"alive\":true" : ",\"alive\":false");
+    out.raw(",\"resolution\":");
+    out.number(history.resolution);
+    out.raw(",\"samples\":[");
+    bool first = true;
+    for (const HistorySample& sample : history.samples) {
+        out.raw(first ? "{\"time\":" : ",{\"time\":");
+        first = false;
+        out.number(sample.time);
+        //CPU хранится в десятых долях процента - столько же знаков и в ответе
+        uint64_t cpuTenths = static_cast<uint64_t>(sample.cpuPercent * 10.0 + 0.5);
+        out.raw(",\"cpu\":");
+        out.number(cpuTenths / 10);
+        out.raw('.');
+        out.raw(static_cast<char>('0' + cpuTenths % 10));
+        out.raw(",\"rss\":");
+        out.number(sample.rssBytes);
+        out.raw(",\"threads\":");
+        out.number(sample.threads);
+        out.raw(",\"read_bps\":");
+        out.number(static_cast<uint64_t>(sample.readBytesPerSec));
+        out.raw(",\"write_bps\":");
+        out.number(static_cast<uint64_t>(sample.writeBytesPerSec));
+        out.raw('}');
+    }
+    out.raw("]}");
+}
+
+void ProcessJson::writeFds(JsonWriter& out, const FdInventory& inventory, const FdInventory::Process& process) {
+    out.raw("{\"status\":\"success\",\"pid\":");
+    out.number(process.pid);
+    out.raw(",\"name\":");
+    out.string(process.name);
+    out.raw(process.denied ? ",\"denied\":true" : ",\"denied\":false");
+    out.raw(",\"fds\":[");
+    bool first = true;
+    for (const FdInventory::Fd& fd : process.fds) {
+        out.raw(first ? "{" : ",{");
+        first = false;
+        writeFd(out, inventory, fd);
+        out.raw('}');
+    }
+    out.raw("]}");
+}
+
+void ProcessJson::writeHolders(JsonWriter& out, const FdInventory& inventory,
+                               const std::vector<FdInventory::Holder>& holders) {
+    out.raw("{\"status\":\"success\",\"holders\":[");
+    bool first = true;
+    for (const FdInventory::Holder& holder : holders) {
+        const FdInventory::Process& process = inventory.processes()[holder.process];
+        out.raw(first ? "{\"pid\":" : ",{\"pid\":");
+        first = false;
+        out.number(process.pid);
+        out.raw(",\"name\":");
+        out.string(process.name);
+        out.raw(',');
+        writeFd(out, inventory, inventory.fd(holder));
+        out.raw('}');
+    }
+    out.raw("]}");
+}
+
+std::string ProcessJson::serializeProcesses(const ProcessTable& table, uint64_t generation) {
+    JsonWriter writer;
+    writer.reserve(table.size() * 96 + 64);
+    writeProcesses(writer, table, generation);
+    return writer.str();
+}
+
+std::string ProcessJson::serializeChanges(uint64_t generation, const std::vector<ProcessChange>& changes) {
+    JsonWriter writer;
+    writeChanges(writer, generation, changes);
+    return writer.str();
+}
+
+std::string ProcessJson::serializeError(const std::string& message) {
+    JsonWriter writer;
+    writeError(writer, message);
+    return writer.str();
+}
+
+namespace {
+
+void skipSpaces(std::string_view text, size_t& pos) {
+    while (pos < text.size() && (text[pos] == ' ' || text[pos] == '\t' || text[pos] == '\r' || text[pos] == '\n')) {
+        ++pos;
+    }
+}
+
+//Строка JSON начиная с кавычки; \uXXXX поддерживается только для ASCII
+bool parseString(std::string_view text, size_t& pos, std::string& out) {
+    if (pos >= text.size() || text[pos] != '"') {
+        return false;
+    }
+    out.clear();
+    for (++pos; pos < text.size(); ++pos) {
+        char ch = text[pos];
+        if (ch == '"') {
+            ++pos;
+            return true;
+        }
+        if (static_cast<unsigned char>(ch) < 0x20) {
+            return false;
+        }
+        if (ch != '\\') {
+            out += ch;
+            continue;
+        }
+        if (++pos >= text.size()) {
+            return false;
+        }
+        switch (text[pos]) {
+        case '"': out += '"'; break;
+        case '\\': out += '\\'; break;
+        case '/': out += '/'; break;
+        case 'b': out += '\b'; break;
+        case 'f': out += '\f'; break;
+        case 'n': out += '\n'; break;
+        case 'r': out += '\r'; break;
+        case 't': out += '\t'; break;
+        case 'u': {
+            if (pos + 4 >= text.size()) {
+                return false;
+            }
+            unsigned code = 0;
+            for (size_t i = 1; i <= 4; ++i) {
+                char digit = text[pos + i];
+                code <<= 4;
+                if (digit >= '0' && digit <= '9') code |= static_cast<unsigned>(digit - '0');
+                else if (digit >= 'a' && digit <= 'f') code |= static_cast<unsigned>(digit - 'a' + 10);
+                else if (digit >= 'A' && digit <= 'F') code |= static_cast<unsigned>(digit - 'A' + 10);
+                else return false;
+            }
+            if (code >= 0x80) {
+                return false;
+            }
+            out += static_cast<char>(code);
+            pos += 4;
+            break;
+        }
+        default:
+            return false;
+        }
+    }
+    return false;
+}
+
+//Целое неотрицательное число JSON
+bool parseNumber(std::string_view text, size_t& pos, uint64_t& out) {
+    size_t begin = pos;
+    out = 0;
+    while (pos < text.size() && text[pos] >= '0' && text[pos] <= '9') {
+        uint64_t digit = static_cast<uint64_t>(text[pos] - '0');
+        if (out > (UINT64_MAX - digit) / 10) {
+            return false;
+        }
+        out = out * 10 + digit;
+        ++pos;
+    }
+    return pos > begin;
+}
+
+//Цифры числа JSON; хотя бы одна
+bool skipDigits(std::string_view text, size_t& pos) {
+    size_t begin = pos;
+    while (pos < text.size() && text[pos] >= '0' && text[pos] <= '9') {
+        ++pos;
+    }
+    return pos > begin;
+}
+
+//Число JSON целиком: знак, дробная часть, экспонента
+bool skipNumber(std::string_view text, size_t& pos) {
+    if (pos < text.size() && text[pos] == '-') {
+        ++pos;
+    }
+    if (pos < text.size() && text[pos] == '0') {
+        ++pos;
+    } else if (!skipDigits(text, pos)) {
+        return false;
+    }
+    if (pos < text.size() && text[pos] == '.') {
+        ++pos;
+        if (!skipDigits(text, pos)) {
+            return false;
+        }
+    }
+    if (pos < text.size() && (text[pos] == 'e' || text[pos] == 'E')) {
+        ++pos;
+        if (pos < text.size() && (text[pos] == '+' || text[pos] == '-')) {
+            ++pos;
+        }
+        if (!skipDigits(text, pos)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+const int MAX_SKIP_DEPTH = 32; //глубже в запросе не бывает - защита стека от "[[[[..."
+
+//Любое значение JSON (значение неизвестного ключа): литерал, число, строка, массив, объект
+bool skipValue(std::string_view text, size_t& pos, std::string& scratch, int depth = 0) {
+    if (pos >= text.size()) {
+        return false;
+    }
+    char ch = text[pos];
+    if (ch == '"') {
+        return parseString(text, pos, scratch);
+    }
+    if (ch == '-' || (ch >= '0' && ch <= '9')) {
+        return skipNumber(text, pos);
+    }
+    for (std::string_view literal : {std::string_view("true"), std::string_view("false"), std::string_view("null")}) {
+        if (text.substr(pos, literal.size()) == literal) {
+            pos += literal.size();
+            return true;
+        }
+    }
+    if ((ch != '[' && ch != '{') || depth >= MAX_SKIP_DEPTH) {
+        return false;
+    }
+    char close = ch == '[' ? ']' : '}';
+    ++pos;
+    skipSpaces(text, pos);
+    if (pos < text.size() && text[pos] == close) {
+        ++pos;
+        return true;
+    }
+    for (;;) {
+        skipSpaces(text, pos);
+        if (close == '}') {
+            if (!parseString(text, pos, scratch)) {
+                return false;
+            }
+            skipSpaces(text, pos);
+            if (pos >= text.size() || text[pos] != ':') {
+                return false;
+            }
+            ++pos;
+            skipSpaces(text, pos);
+        }
+        if (!skipValue(text, pos, scratch, depth + 1)) {
+            return false;
+        }
+        skipSpaces(text, pos);
+        if (pos < text.size() && text[pos] == ',') {
+            ++pos;
+            continue;
+        }
+        if (pos < text.size() && text[pos] == close) {
+            ++pos;
+            return true;
+        }
+        return false;
+    }
+}
+
+} // namespace
+
+bool ProcessJson::parseRequest(std::string_view text, ProtocolRequest& request) {
+    request.command.clear();
+    request.filter.clear();
+    request.format.clear();
+    request.where.clear();
+    request.sortBy.clear();
+    request.order.clear();
+    request.fields.clear();
+    request.path.clear();
+    request.pid = request.startTime = request.from = request.to = request.resolution = request.limit = 0;
+    request.port = request.inode = 0;
+    size_t pos = 0;
+    skipSpaces(text, pos);
+    if (pos >= text.size() || text[pos] != '{') {
+        return false;
+    }
+    ++pos;
+    skipSpaces(text, pos);
+    if (pos < text.size() && text[pos] == '}') {
+        ++pos;
+    } else {
+        std::string key;
+        std::string value;
+        for (;;) {
+            skipSpaces(text, pos);
+            if (!parseString(text, pos, key)) {
+                return false;
+            }
+            skipSpaces(text, pos);
+            if (pos >= text.size() || text[pos] != ':') {
+                return false;
+            }
+            ++pos;
+            skipSpaces(text, pos);
+            //Неизвестные ключи с любым значением пропускаем - старые серверы понимают новых клиентов
+            uint64_t* target = nullptr;
+            if (key == "pid") {
+                target = &request.pid;
+            } else if (key == "start_time") {
+                target = &request.startTime;
+            } else if (key == "from") {
+                target = &request.from;
+            } else if (key == "to") {
+                target = &request.to;
+            } else if (key == "resolution") {
+                target = &request.resolution;
+            } else if (key == "limit") {
+                target = &request.limit;
+            } else if (key == "port") {
+                target = &request.port;
+            } else if (key == "inode") {
+                target = &request.inode;
+            }
+            if (target) {
+                //Числовые ключи - только целые неотрицательные
+                if (!parseNumber(text, pos, *target)) {
+                    return false;
+                }
+            } else if (pos < text.size() && text[pos] == '"') {
+                if (!parseString(text, pos, value)) {
+                    return false;
+                }
+                if (key == "command") {
+                    request.command = value;
+                } else if (key == "filter") {
+                    request.filter = value;
+                } else if (key == "format") {
+                    request.format = value;
+                } else if (key == "where") {
+                    request.where = value;
+                } else if (key == "sort_by") {
+                    request.sortBy = value;
+                } else if (key == "order") {
+                    request.order = value;
+                } else if (key == "fields") {
+                    request.fields = value;
+                } else if (key == "path") {
+                    request.path = value;
+                }
+            } else if (!skipValue(text, pos, value)) {
+                return false;
+            }
+            skipSpaces(text, pos);
+            if (pos < text.size() && text[pos] == ',') {
+                ++pos;
+                continue;
+            }
+            if (pos < text.size() && text[pos] == '}') {
+                ++pos;
+                break;
+            }
+            return false;
+        }
+    }
+    skipSpaces(text, pos);
+    return pos == text.size();
+}
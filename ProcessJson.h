@@ -0,0 +1,98 @@
+// ProcessJson.h
+#pragma once
+#include <string>
+#include <string_view>
+#include <vector>
+#include "JsonWriter.h"
+#include "ProcessTable.h"
+#include "ProcessSnapshotDiffer.h"
+#include "ProcessOwner.h"
+#include "HistoryStore.h"
+#include "FdInventory.h"
+
+/*
+JSON-представление протокола (см. task.md):
+запрос  {"command":"get_processes","filter":"all"}
+ответ   {"status":"success","processes":[{"pid":1234,"name":"...","path":"...","parent_pid":456}]}
+подписка (subscribe): сначала полный ответ с полем "generation", затем дельты
+        {"event":"delta","generation":N,"changes":[{"type":"exited","pid":..},{"type":"spawned",...}]}
+формат соединения: {"command":"set_format","format":"binary"} (см. ProcessBinary.h)
+история процесса: {"command":"get_history","pid":1234,"from":T1,"to":T2,"resolution":60}
+        {"status":"success","pid":1234,"start_time":..,"alive":true,"resolution":60,
+         "samples":[{"time":T,"cpu":12.5,"rss":..,"threads":..,"read_bps":..,"write_bps":..}]}
+        время - unix-секунды; to по умолчанию - последний сэмпл, from - час до to
+запрос с отбором (ProcessQuery.h): get_processes с полями where, sort_by, order, limit, fields
+        {"command":"get_processes","where":"name=nginx* and cpu>5","sort_by":"cpu","limit":10,"fields":"pid,name,cpu"}
+        {"status":"success","generation":N,"matched":M,"processes":[{"pid":..,"name":"..","cpu":12.5}]}
+открытые дескрипторы (FdInventory.h): {"command":"get_fds","pid":1234}
+        {"status":"success","pid":1234,"name":"..","denied":false,"fds":[{"fd":3,"type":"tcp",
+         "inode":..,"local":"127.0.0.1:80","remote":"0.0.0.0:0","state":"LISTEN"},{"fd":4,"type":"file","path":".."}]}
+кто держит файл, порт или inode: {"command":"find_holders","port":80} (или "path":"..", или "inode":N)
+        {"status":"success","holders":[{"pid":..,"name":"..","fd":3,"type":"tcp",...}]}
+*/
+struct ProtocolRequest {
+    std::string command;
+    std::string filter;
+    std::string format;
+    //get_history; 0 - не задано
+    uint64_t pid = 0;
+    uint64_t startTime = 0;
+    uint64_t from = 0;
+    uint64_t to = 0;
+    uint64_t resolution = 0;
+    //Запрос с отбором (get_processes); пусто/0 - не задано
+    std::string where;
+    std::string sortBy;
+    std::string order;
+    std::string fields;
+    uint64_t limit = 0;
+    //find_holders: ровно одно из трех
+    std::string path;
+    uint64_t port = 0;
+    uint64_t inode = 0;
+};
+
+/*
+Уже экранированные строки арены таблицы (с кавычками), по handle.
+Имена и пути процессов повторяются, поэтому каждая строка экранируется
+один раз, а в снимок копируется готовый фрагмент. Кеш сбрасывается сам,
+когда таблица пересобирает арену.
+*/
+class JsonStringCache {
+public:
+    std::string_view get(const ProcessTable& table, StringArena::Handle handle);
+
+private:
+    std::vector<std::string> m_escaped; //пустая строка - еще не экранирована
+    const ProcessTable* m_table = nullptr;
+    uint64_t m_version = 0;
+    JsonWriter m_writer;
+};
+
+class ProcessJson {
+public:
+    //Запись в переиспользуемый буфер (горячий путь сервера)
+    //generation != 0 добавляет номер поколения снимка (для подписчиков)
+    static void writeProcesses(JsonWriter& out, const ProcessTable& table, uint64_t generation = 0);
+    //filter - только системные или только пользовательские процессы (по колонке uid)
+    static void writeProcesses(JsonWriter& out, const ProcessTable& table, uint64_t generation, JsonStringCache& strings,
+                               ProcessFilter filter = ProcessFilter::All);
+    //Изменения между поколениями generation - 1 и generation
+    static void writeChanges(JsonWriter& out, uint64_t generation, const std::vector<ProcessChange>& changes);
+    static void writeError(JsonWriter& out, std::string_view message);
+    static void writeHistory(JsonWriter& out, const HistoryResult& history);
+    static void writeFds(JsonWriter& out, const FdInventory& inventory, const FdInventory::Process& process);
+    static void writeHolders(JsonWriter& out, const FdInventory& inventory, const std::vector<FdInventory::Holder>& holders);
+
+    //То же с результатом в отдельной строке
+    static std::string serializeProcesses(const ProcessTable& table, uint64_t generation = 0);
+    static std::string serializeChanges(uint64_t generation, const std::vector<ProcessChange>& changes);
+    static std::string serializeError(const std::string& message);
+
+    //Разбор запроса: объект, известные ключи - строки и целые неотрицательные числа, значения
+    //неизвестных ключей (любой JSON) пропускаются; false - некорректный JSON или неверный тип числового ключа
+    static bool parseRequest(std::string_view text, ProtocolRequest& request);
+
+    //Строка в кавычках с экранированием по RFC 8259
+    static void appendString(std::string& out, std::string_view value);
+};
@@ -0,0 +1,263 @@
+#include "ProcessOwner.h"
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+#ifndef _WIN32
+#include <grp.h>
+#include <pwd.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace {
+
+const uint32_t DEFAULT_UID_MIN = 1000;
+const uint32_t NOBODY_UID = 65534;
+
+//UID_MIN из /etc/login.defs: "UID_MIN  1000"
+uint32_t readUidMin() {
+#ifndef _WIN32
+    FILE* file = std::fopen("/etc/login.defs", "r");
+    if (!file) {
+        return DEFAULT_UID_MIN;
+    }
+    char line[256];
+    uint32_t uidMin = DEFAULT_UID_MIN;
+    while (std::fgets(line, sizeof(line), file)) {
+        const char* p = line;
+        while (*p == ' ' || *p == '\t') {
+            ++p;
+        }
+        if (std::strncmp(p, "UID_MIN", 7) != 0 || (p[7] != ' ' && p[7] != '\t')) {
+            continue;
+        }
+        char* end = nullptr;
+        unsigned long value = std::strtoul(p + 7, &end, 10);
+        if (end != p + 7 && value > 0 && value < ProcessRecord::UNKNOWN_UID) {
+            uidMin = static_cast<uint32_t>(value);
+        }
+    }
+    std::fclose(file);
+    return uidMin;
+#else
+    return DEFAULT_UID_MIN;
+#endif
+}
+
+} // namespace
+
+bool ProcessOwner::parseFilter(std::string_view name, ProcessFilter& filter) {
+    if (name.empty() || name == "all") {
+        filter = ProcessFilter::All;
+    } else if (name == "system") {
+        filter = ProcessFilter::System;
+    } else if (name == "user") {
+        filter = ProcessFilter::User;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+uint32_t ProcessOwner::firstUserUid() {
+    static const uint32_t uidMin = readUidMin();
+    return uidMin;
+}
+
+bool ProcessOwner::isSystemUid(uint32_t uid) {
+    return uid < firstUserUid() || uid == NOBODY_UID;
+}
+
+UserNameCache::UserNameCache() : m_resolver(&UserNameCache::systemResolve) {}
+
+UserNameCache::~UserNameCache() {
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stopping = true;
+    }
+    m_workCondition.notify_all();
+    if (m_thread.joinable()) {
+        m_thread.join();
+    }
+}
+
+bool UserNameCache::systemResolve(Kind kind, uint32_t id, std::string& name) {
+#ifndef _WIN32
+    //Буфер на стеке хватает почти всегда; ERANGE - повтор с большим в куче
+    char stackBuffer[1024];
+    std::vector<char> heapBuffer;
+    char* buffer = stackBuffer;
+    size_t size = sizeof(stackBuffer);
+    for (;;) {
+        int error;
+        const char* found = nullptr;
+        if (kind == Kind::User) {
+            passwd entry;
+            passwd* result = nullptr;
+            error = ::getpwuid_r(static_cast<uid_t>(id), &entry, buffer, size, &result);
+            found = result ? result->pw_name : nullptr;
+        } else {
+            group entry;
+            group* result = nullptr;
+            error = ::getgrgid_r(static_cast<gid_t>(id), &entry, buffer, size, &result);
+            found = result ? result->gr_name : nullptr;
+        }
+        if (error == ERANGE && size < (1u << 20)) {
+            size *= 4;
+            heapBuffer.resize(size);
+            buffer = heapBuffer.data();
+            continue;
+        }
+        if (!found) {
+            return false;
+        }
+        name = found;
+        return true;
+    }
+#else
+    (void)kind;
+    (void)id;
+    (void)name;
+    return false;
+#endif
+}
+
+bool UserNameCache::answer(Entry& entry, uint64_t key, std::string& name) {
+    if (entry.state == State::Pending || entry.generation != m_generation) {
+        enqueue(entry, key);
+    }
+    if (entry.state == State::Resolved) {
+        name = entry.name;
+        return true;
+    }
+    name = std::to_string(static_cast<uint32_t>(key));
+    return false;
+}
+
+void UserNameCache::enqueue(Entry& entry, uint64_t key) {
+    if (entry.queued || m_stopping) {
+        return;
+    }
+    entry.queued = true;
+    m_queue.push_back(key);
+    if (!m_thread.joinable()) {
+        m_thread = std::thread(&UserNameCache::resolverLoop, this);
+    }
+    m_workCondition.notify_one();
+}
+
+bool UserNameCache::lookup(Kind kind, uint32_t id, std::string& name) {
+    uint64_t key = keyOf(kind, id);
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return answer(m_entries[key], key, name);
+}
+
+bool UserNameCache::resolve(Kind kind, uint32_t id, std::string& name, std::chrono::milliseconds timeout) {
+    uint64_t key = keyOf(kind, id);
+    auto deadline = std::chrono::steady_clock::now() + timeout;
+    std::unique_lock<std::mutex> lock(m_mutex);
+    //Узлы unordered_map не перемещаются - ссылка живет, пока запись не удалена (а удалений нет)
+    Entry& entry = m_entries[key];
+    while (entry.state == State::Pending || entry.generation != m_generation) {
+        enqueue(entry, key);
+        if (m_doneCondition.wait_until(lock, deadline) == std::cv_status::timeout) {
+            break;
+        }
+    }
+    return answer(entry, key, name);
+}
+
+void UserNameCache::invalidate() {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    ++m_generation;
+}
+
+uint64_t UserNameCache::generation() const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_generation;
+}
+
+size_t UserNameCache::pending() const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_queue.size();
+}
+
+void UserNameCache::setResolver(Resolver resolver) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_resolver = std::move(resolver);
+}
+
+void UserNameCache::setFileCheckInterval(std::chrono::milliseconds interval) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_fileCheckInterval = interval;
+    m_workCondition.notify_all();
+}
+
+bool UserNameCache::filesChanged() {
+#ifndef _WIN32
+    uint64_t stamp = 0; //беззнаковый: перемешивание переполняется по модулю
+    for (const char* path : {"/etc/passwd", "/etc/group"}) {
+        struct stat info;
+        if (::stat(path, &info) == 0) {
+            stamp = stamp * 31 + static_cast<uint64_t>(info.st_mtim.tv_sec) * 1000000000ull + static_cast<uint64_t>(info.st_mtim.tv_nsec);
+            stamp = stamp * 31 + static_cast<uint64_t>(info.st_size);
+        }
+    }
+    bool changed = m_filesStamp != 0 && stamp != m_filesStamp;
+    m_filesStamp = stamp;
+    return changed;
+#else
+    return false;
+#endif
+}
+
+void UserNameCache::resolverLoop() {
+    filesChanged(); //исходное состояние файлов
+    std::unique_lock<std::mutex> lock(m_mutex);
+    auto nextCheck = std::chrono::steady_clock::now() + m_fileCheckInterval;
+    while (!m_stopping) {
+        if (m_queue.empty()) {
+            m_workCondition.wait_until(lock, nextCheck, [this] { return m_stopping || !m_queue.empty(); });
+            if (m_stopping) {
+                break;
+            }
+        }
+        auto now = std::chrono::steady_clock::now();
+        if (now >= nextCheck) {
+            lock.unlock();
+            bool changed = filesChanged();
+            lock.lock();
+            if (changed) {
+                ++m_generation;
+            }
+            nextCheck = now + m_fileCheckInterval;
+        }
+        if (m_queue.empty()) {
+            continue;
+        }
+
+        uint64_t key = m_queue.front();
+        m_queue.pop_front();
+        Resolver resolver = m_resolver;
+        uint64_t generation = m_generation;
+        //NSS - без блокировки: lookup() в это время отвечает из кеша
+        lock.unlock();
+        std::string name;
+        bool found = resolver(static_cast<Kind>(key >> 32), static_cast<uint32_t>(key), name);
+        lock.lock();
+
+        Entry& entry = m_entries[key];
+        entry.queued = false;
+        entry.generation = generation;
+        if (found) {
+            entry.name = std::move(name);
+            entry.state = State::Resolved;
+        } else {
+            entry.name.clear();
+            entry.state = State::Missing;
+        }
+        m_doneCondition.notify_all();
+    }
+}
@@ -0,0 +1,106 @@
+// ProcessOwner.h
+#pragma once
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <unordered_map>
+#include "ProcessInfo.h" //ProcessRecord::UNKNOWN_UID
+
+//Фильтр протокола: "all", "system", "user"
+enum class ProcessFilter : uint8_t { All, System, User };
+
+/*
+Системный или пользовательский процесс - только по числовому uid, без NSS.
+Linux: системные учетные записи - uid ниже UID_MIN из /etc/login.defs
+(по умолчанию 1000) и nobody (65534). Процесс с неизвестным владельцем
+не попадает ни в "system", ни в "user".
+*/
+class ProcessOwner {
+public:
+    static bool parseFilter(std::string_view name, ProcessFilter& filter);
+    static bool isSystemUid(uint32_t uid);
+    static bool matches(ProcessFilter filter, uint32_t uid) {
+        if (filter == ProcessFilter::All) {
+            return true;
+        }
+        if (uid == ProcessRecord::UNKNOWN_UID) {
+            return false;
+        }
+        return isSystemUid(uid) == (filter == ProcessFilter::System);
+    }
+    //Первый uid обычных пользователей (читается один раз)
+    static uint32_t firstUserUid();
+};
+
+/*
+Кеш uid/gid -> имя с разрешением в фоновом потоке.
+getpwuid_r/getgrgid_r идут через NSS и при LDAP/sssd могут стоять
+сотни миллисекунд, поэтому lookup() никогда их не вызывает: промах
+ставит id в очередь фонового потока и сразу отдает число строкой.
+
+Записи помечены поколением. invalidate() (и изменение /etc/passwd или
+/etc/group, которое фоновый поток проверяет сам) начинает новое
+поколение: старые имена продолжают отдаваться, но перепроверяются в фоне.
+*/
+class UserNameCache {
+public:
+    enum class Kind : uint8_t { User, Group };
+    //Разрешение имени; false - такого id нет
+    typedef std::function<bool(Kind kind, uint32_t id, std::string& name)> Resolver;
+
+    UserNameCache();
+    ~UserNameCache();
+
+    UserNameCache(const UserNameCache&) = delete;
+    UserNameCache& operator=(const UserNameCache&) = delete;
+
+    //Не блокируется. name - имя, если оно уже известно, иначе число; true - это имя
+    bool lookup(Kind kind, uint32_t id, std::string& name);
+    //То же, но ждет фоновое разрешение не дольше timeout
+    bool resolve(Kind kind, uint32_t id, std::string& name, std::chrono::milliseconds timeout);
+
+    void invalidate();
+    uint64_t generation() const;
+    size_t pending() const;
+
+    //Подмена NSS (тесты); по умолчанию getpwuid_r/getgrgid_r
+    void setResolver(Resolver resolver);
+    //Как часто фоновый поток проверяет /etc/passwd и /etc/group
+    void setFileCheckInterval(std::chrono::milliseconds interval);
+
+private:
+    enum class State : uint8_t { Pending, Resolved, Missing };
+    struct Entry {
+        std::string name;
+        uint64_t generation = 0;
+        State state = State::Pending;
+        bool queued = false;
+    };
+    static uint64_t keyOf(Kind kind, uint32_t id) {
+        return (static_cast<uint64_t>(kind) << 32) | id;
+    }
+    static bool systemResolve(Kind kind, uint32_t id, std::string& name);
+    //Вызывается под m_mutex
+    bool answer(Entry& entry, uint64_t key, std::string& name);
+    void enqueue(Entry& entry, uint64_t key);
+    void resolverLoop();
+    bool filesChanged();
+
+    mutable std::mutex m_mutex;
+    std::condition_variable m_workCondition;  //есть работа или остановка
+    std::condition_variable m_doneCondition;  //очередное имя разрешено
+    std::unordered_map<uint64_t, Entry> m_entries;
+    std::deque<uint64_t> m_queue;
+    uint64_t m_generation = 1;
+    bool m_stopping = false;
+    std::thread m_thread; //запускается при первом промахе
+    Resolver m_resolver;
+    std::chrono::milliseconds m_fileCheckInterval{30000};
+    uint64_t m_filesStamp = 0; //только фоновый поток
+};
@@ -0,0 +1,499 @@
+#include "ProcessQuery.h"
+#include "Metrics.h"
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+
+namespace {
+
+MetricHistogram queryDuration("monitor_query_seconds", "Process query: cache lookup or run and serialization");
+MetricCounter queryHits("monitor_query_cache_total", "Process query results by cache outcome", "result", "hit");
+MetricCounter queryMisses("monitor_query_cache_total", "Process query results by cache outcome", "result", "miss");
+
+typedef ProcessQuery::Field Field;
+typedef ProcessQuery::Op Op;
+
+struct FieldName {
+    const char* name;
+    Field field;
+};
+
+//Первое имя поля - имя в ответе
+const FieldName FIELD_NAMES[] = {
+    {"pid", Field::Pid},           {"parent_pid", Field::ParentPid}, {"ppid", Field::ParentPid},
+    {"uid", Field::Uid},           {"start_time", Field::StartTime}, {"name", Field::Name},
+    {"path", Field::Path},         {"cpu", Field::Cpu},              {"rss", Field::Rss},
+    {"threads", Field::Threads},   {"read_bps", Field::ReadRate},    {"write_bps", Field::WriteRate},
+};
+
+bool findField(std::string_view name, Field& field) {
+    for (const FieldName& entry : FIELD_NAMES) {
+        if (name == entry.name) {
+            field = entry.field;
+            return true;
+        }
+    }
+    return false;
+}
+
+const char* outputName(Field field) {
+    for (const FieldName& entry : FIELD_NAMES) {
+        if (entry.field == field) {
+            return entry.name;
+        }
+    }
+    return "";
+}
+
+bool isMetric(Field field) {
+    return field >= Field::Cpu;
+}
+
+bool isString(Field field) {
+    return field == Field::Name || field == Field::Path;
+}
+
+double numericValue(Field field, const ProcessTable& table, const std::vector<HistorySample>* metrics, uint32_t row) {
+    switch (field) {
+    case Field::Pid: return table.pids()[row];
+    case Field::ParentPid: return table.parentPids()[row];
+    case Field::Uid: return table.uids()[row];
+    case Field::StartTime: return static_cast<double>(table.startTimes()[row]);
+    default: break;
+    }
+    if (!metrics) {
+        return 0;
+    }
+    const HistorySample& sample = (*metrics)[row];
+    switch (field) {
+    case Field::Cpu: return sample.cpuPercent;
+    case Field::Rss: return static_cast<double>(sample.rssBytes);
+    case Field::Threads: return sample.threads;
+    case Field::ReadRate: return sample.readBytesPerSec;
+    case Field::WriteRate: return sample.writeBytesPerSec;
+    default: return 0;
+    }
+}
+
+bool compare(double value, Op op, double number) {
+    switch (op) {
+    case Op::Equal: return value == number;
+    case Op::NotEqual: return value != number;
+    case Op::Less: return value < number;
+    case Op::LessEqual: return value <= number;
+    case Op::Greater: return value > number;
+    default: return value >= number;
+    }
+}
+
+//Число с необязательным множителем K/M/G/T (степени 1024)
+bool parseValue(std::string_view text, double& out) {
+    std::string value(text);
+    char* end = nullptr;
+    out = std::strtod(value.c_str(), &end);
+    if (end == value.c_str()) {
+        return false;
+    }
+    if (*end != '\0') {
+        const char* units = "KMGT";
+        const char* unit = std::strchr(units, *end & ~0x20);
+        if (!unit || end[1] != '\0') {
+            return false;
+        }
+        for (const char* p = units; p <= unit; ++p) {
+            out *= 1024;
+        }
+    }
+    return true;
+}
+
+void skipSpaces(std::string_view text, size_t& pos) {
+    while (pos < text.size() && (text[pos] == ' ' || text[pos] == '\t')) {
+        ++pos;
+    }
+}
+
+//Первые limit строк по less; отсортированы только они
+template <typename Less>
+void selectTop(std::vector<uint32_t>& rows, size_t limit, Less less) {
+    if (limit != 0 && limit < rows.size()) {
+        std::nth_element(rows.begin(), rows.begin() + static_cast<long>(limit), rows.end(), less);
+        rows.resize(limit);
+    }
+    std::sort(rows.begin(), rows.end(), less);
+}
+
+} // namespace
+
+bool ProcessQuery::isQuery(const ProtocolRequest& request) {
+    return !request.where.empty() || !request.sortBy.empty() || !request.order.empty() || request.limit != 0 ||
+           !request.fields.empty();
+}
+
+bool ProcessQuery::compile(const ProtocolRequest& request, std::string& error) {
+    m_conditions.clear();
+    m_fields.clear();
+    m_needsMetrics = false;
+    m_key = request.filter + '\x1f' + request.where + '\x1f' + request.sortBy + '\x1f' + request.order + '\x1f' +
+            std::to_string(request.limit) + '\x1f' + request.fields;
+
+    if (!ProcessOwner::parseFilter(request.filter, m_filter)) {
+        error = "unknown filter: " + request.filter;
+        return false;
+    }
+    if (!parseWhere(request.where, error) || !parseFields(request.fields, error)) {
+        return false;
+    }
+
+    m_sorted = !request.sortBy.empty();
+    if (m_sorted && !findField(request.sortBy, m_sortField)) {
+        error = "unknown sort field: " + request.sortBy;
+        return false;
+    }
+    if (request.order.empty()) {
+        m_descending = isMetric(m_sortField);
+    } else if (request.order == "asc" || request.order == "desc") {
+        m_descending = request.order == "desc";
+    } else {
+        error = "unknown order: " + request.order;
+        return false;
+    }
+    m_limit = static_cast<size_t>(request.limit);
+
+    m_needsMetrics = m_sorted && isMetric(m_sortField);
+    for (const Condition& condition : m_conditions) {
+        m_needsMetrics = m_needsMetrics || isMetric(condition.field);
+    }
+    for (Field field : m_fields) {
+        m_needsMetrics = m_needsMetrics || isMetric(field);
+    }
+    return true;
+}
+
+bool ProcessQuery::parseWhere(std::string_view text, std::string& error) {
+    size_t pos = 0;
+    skipSpaces(text, pos);
+    while (pos < text.size()) {
+        //Поле
+        size_t begin = pos;
+        while (pos < text.size() && ((text[pos] >= 'a' && text[pos] <= 'z') || text[pos] == '_')) {
+            ++pos;
+        }
+        std::string_view name = text.substr(begin, pos - begin);
+        Condition condition;
+        if (!findField(name, condition.field)) {
+            error = "unknown field in where: " + std::string(name.empty() ? text.substr(begin, 1) : name);
+            return false;
+        }
+
+        //Оператор
+        skipSpaces(text, pos);
+        std::string_view rest = text.substr(pos);
+        size_t length = 2;
+        if (rest.substr(0, 2) == "!=") {
+            condition.op = Op::NotEqual;
+        } else if (rest.substr(0, 2) == "<=") {
+            condition.op = Op::LessEqual;
+        } else if (rest.substr(0, 2) == ">=") {
+            condition.op = Op::GreaterEqual;
+        } else if (rest.substr(0, 2) == "==") {
+            condition.op = Op::Equal;
+        } else if (!rest.empty() && (rest[0] == '=' || rest[0] == '<' || rest[0] == '>')) {
+            condition.op = rest[0] == '=' ? Op::Equal : rest[0] == '<' ? Op::Less : Op::Greater;
+            length = 1;
+        } else {
+            error = "expected operator after " + std::string(name);
+            return false;
+        }
+        pos += length;
+
+        //Значение: 'строка' или до пробела
+        skipSpaces(text, pos);
+        std::string_view value;
+        if (pos < text.size() && text[pos] == '\'') {
+            size_t close = text.find('\'', pos + 1);
+            if (close == std::string_view::npos) {
+                error = "unterminated quote in where";
+                return false;
+            }
+            value = text.substr(pos + 1, close - pos - 1);
+            pos = close + 1;
+        } else {
+            begin = pos;
+            while (pos < text.size() && text[pos] != ' ' && text[pos] != '\t') {
+                ++pos;
+            }
+            value = text.substr(begin, pos - begin);
+            if (value.empty()) {
+                error = "missing value for " + std::string(name);
+                return false;
+            }
+        }
+
+        if (isString(condition.field)) {
+            if (condition.op != Op::Equal && condition.op != Op::NotEqual) {
+                error = std::string(name) + " supports only = and !=";
+                return false;
+            }
+            condition.number = 0;
+            condition.pattern = std::string(value);
+        } else if (!parseValue(value, condition.number)) {
+            error = "not a number for " + std::string(name) + ": " + std::string(value);
+            return false;
+        }
+        m_conditions.push_back(condition);
+
+        //Следующее условие через and
+        skipSpaces(text, pos);
+        if (pos >= text.size()) {
+            break;
+        }
+        if (text.substr(pos, 3) != "and" || (pos + 3 < text.size() && text[pos + 3] != ' ' && text[pos + 3] != '\t')) {
+            error = "expected 'and' in where at: " + std::string(text.substr(pos));
+            return false;
+        }
+        pos += 3;
+        skipSpaces(text, pos);
+        if (pos >= text.size()) {
+            error = "where ends with 'and'";
+            return false;
+        }
+    }
+    return true;
+}
+
+bool ProcessQuery::parseFields(std::string_view text, std::string& error) {
+    if (text.empty()) {
+        m_fields = {Field::Pid, Field::Name, Field::Path, Field::ParentPid};
+        return true;
+    }
+    size_t pos = 0;
+    while (pos <= text.size()) {
+        size_t comma = text.find(',', pos);
+        if (comma == std::string_view::npos) {
+            comma = text.size();
+        }
+        std::string_view name = text.substr(pos, comma - pos);
+        while (!name.empty() && name.front() == ' ') {
+            name.remove_prefix(1);
+        }
+        while (!name.empty() && name.back() == ' ') {
+            name.remove_suffix(1);
+        }
+        Field field;
+        if (!findField(name, field)) {
+            error = "unknown field: " + std::string(name);
+            return false;
+        }
+        m_fields.push_back(field);
+        pos = comma + 1;
+    }
+    return true;
+}
+
+void ProcessQuery::filterRows(const Condition& condition, const ProcessTable& table,
+                              const std::vector<HistorySample>* metrics, std::vector<uint32_t>& rows) const {
+    size_t kept = 0;
+    if (isString(condition.field)) {
+        //Имена и пути повторяются: шаблон проверяется один раз на строку арены (0 - еще не проверена)
+        const std::vector<StringArena::Handle>& ids = condition.field == Field::Name ? table.nameIds() : table.pathIds();
+        const StringArena& strings = table.strings();
+        std::vector<uint8_t> matches(strings.size(), 0);
+        uint8_t wanted = condition.op == Op::Equal ? 1 : 2;
+        for (uint32_t row : rows) {
+            uint8_t& match = matches[ids[row]];
+            if (match == 0) {
+                match = globMatch(condition.pattern, strings.get(ids[row])) ? 1 : 2;
+            }
+            if (match == wanted) {
+                rows[kept++] = row;
+            }
+        }
+    } else {
+        for (uint32_t row : rows) {
+            if (compare(numericValue(condition.field, table, metrics, row), condition.op, condition.number)) {
+                rows[kept++] = row;
+            }
+        }
+    }
+    rows.resize(kept);
+}
+
+void ProcessQuery::run(const ProcessTable& table, const std::vector<HistorySample>* metrics,
+                       std::vector<uint32_t>& rows, size_t& matched) const {
+    rows.clear();
+    rows.reserve(table.size());
+    const std::vector<uint32_t>& uids = table.uids();
+    for (size_t row = 0; row < table.size(); ++row) {
+        if (ProcessOwner::matches(m_filter, uids[row])) {
+            rows.push_back(static_cast<uint32_t>(row));
+        }
+    }
+    for (const Condition& condition : m_conditions) {
+        if (rows.empty()) {
+            break;
+        }
+        filterRows(condition, table, metrics, rows);
+    }
+    matched = rows.size();
+
+    if (!m_sorted) {
+        if (m_limit != 0 && m_limit < rows.size()) {
+            rows.resize(m_limit);
+        }
+        return;
+    }
+    //Равные ключи - в порядке строк таблицы, ответ не зависит от реализации nth_element
+    bool descending = m_descending;
+    if (isString(m_sortField)) {
+        const std::vector<StringArena::Handle>& ids = m_sortField == Field::Name ? table.nameIds() : table.pathIds();
+        const StringArena& strings = table.strings();
+        selectTop(rows, m_limit, [&](uint32_t a, uint32_t b) {
+            int order = strings.get(ids[a]).compare(strings.get(ids[b]));
+            if (order != 0) {
+                return descending ? order > 0 : order < 0;
+            }
+            return a < b;
+        });
+        return;
+    }
+    std::vector<double> keys(table.size());
+    for (uint32_t row : rows) {
+        keys[row] = numericValue(m_sortField, table, metrics, row);
+    }
+    selectTop(rows, m_limit, [&](uint32_t a, uint32_t b) {
+        if (keys[a] != keys[b]) {
+            return descending ? keys[a] > keys[b] : keys[a] < keys[b];
+        }
+        return a < b;
+    });
+}
+
+void ProcessQuery::write(JsonWriter& out, const ProcessTable& table, const std::vector<HistorySample>* metrics,
+                         uint64_t generation) const {
+    std::vector<uint32_t> rows;
+    size_t matched = 0;
+    run(table, metrics, rows, matched);
+
+    out.raw("{\"status\":\"success\",\"generation\":");
+    out.number(generation);
+    out.raw(",\"matched\":");
+    out.number(matched);
+    out.raw(",\"processes\":[");
+    const StringArena& strings = table.strings();
+    for (size_t i = 0; i < rows.size(); ++i) {
+        uint32_t row = rows[i];
+        out.raw(i == 0 ? "{" : ",{");
+        for (size_t f = 0; f < m_fields.size(); ++f) {
+            Field field = m_fields[f];
+            out.raw(f == 0 ? "\"" : ",\"");
+            out.raw(outputName(field));
+            out.raw("\":");
+            switch (field) {
+            case Field::Name:
+                out.string(strings.get(table.nameIds()[row]));
+                break;
+            case Field::Path:
+                out.string(strings.get(table.pathIds()[row]));
+                break;
+            case Field::Uid:
+                if (table.uids()[row] == ProcessRecord::UNKNOWN_UID) {
+                    out.raw("null");
+                } else {
+                    out.number(table.uids()[row]);
+                }
+                break;
+            case Field::Cpu: {
+                //Как в get_history: десятые доли процента
+                uint64_t tenths = static_cast<uint64_t>(numericValue(field, table, metrics, row) * 10.0 + 0.5);
+                out.number(tenths / 10);
+                out.raw('.');
+                out.raw(static_cast<char>('0' + tenths % 10));
+                break;
+            }
+            default:
+                out.number(static_cast<uint64_t>(numericValue(field, table, metrics, row)));
+                break;
+            }
+        }
+        out.raw('}');
+    }
+    out.raw("]}");
+}
+
+bool ProcessQuery::globMatch(std::string_view pattern, std::string_view text) {
+    //Жадный проход с возвратом к последней '*': O(n*m) в худшем случае, без рекурсии
+    size_t p = 0;
+    size_t t = 0;
+    size_t star = std::string_view::npos;
+    size_t resume = 0;
+    while (t < text.size()) {
+        if (p < pattern.size() && (pattern[p] == '?' || pattern[p] == text[t])) {
+            ++p;
+            ++t;
+        } else if (p < pattern.size() && pattern[p] == '*') {
+            star = p++;
+            resume = t;
+        } else if (star != std::string_view::npos) {
+            p = star + 1;
+            t = ++resume;
+        } else {
+            return false;
+        }
+    }
+    while (p < pattern.size() && pattern[p] == '*') {
+        ++p;
+    }
+    return p == pattern.size();
+}
+
+QueryCache::Payload QueryCache::get(const ProcessQuery& query, const ProcessTable& table, uint64_t generation,
+                                    const HistoryStore* history) {
+    MetricTimer timer(queryDuration);
+    std::shared_ptr<const std::vector<HistorySample>> metrics;
+    bool wantMetrics = query.needsMetrics() && history;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (generation > m_generation) {
+            m_generation = generation;
+            m_results.clear();
+            m_metrics.reset();
+        }
+        if (generation == m_generation) {
+            auto found = m_results.find(query.key());
+            if (found != m_results.end()) {
+                m_hits.fetch_add(1);
+                queryHits.add();
+                return found->second;
+            }
+            if (wantMetrics && !m_metrics) {
+                auto column = std::make_shared<std::vector<HistorySample>>();
+                history->latestSamples(table.pids(), table.startTimes(), *column);
+                m_metrics = column;
+            }
+            metrics = m_metrics;
+        }
+    }
+    m_misses.fetch_add(1);
+    queryMisses.add();
+
+    //Запрос по уже замененному поколению: метрики только для него, в кеш не попадает
+    if (wantMetrics && !metrics) {
+        auto column = std::make_shared<std::vector<HistorySample>>();
+        history->latestSamples(table.pids(), table.startTimes(), *column);
+        metrics = column;
+    }
+    JsonWriter writer;
+    query.write(writer, table, wantMetrics ? metrics.get() : nullptr, generation);
+    writer.raw('\n');
+    Payload payload = std::make_shared<const std::string>(writer.view());
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if (generation == m_generation) {
+        if (m_results.size() >= MAX_RESULTS) {
+            m_results.clear();
+        }
+        m_results.emplace(query.key(), payload);
+    }
+    return payload;
+}
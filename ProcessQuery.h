@@ -0,0 +1,111 @@
+// ProcessQuery.h
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+#include "JsonWriter.h"
+#include "ProcessTable.h"
+#include "ProcessJson.h"
+#include "ProcessOwner.h"
+#include "HistoryStore.h"
+
+/*
+Запрос с отбором к снимку процессов: get_processes с where, sort_by, order, limit, fields.
+- where: условия через "and", каждое <поле> <оператор> <значение>
+  поля снимка: pid, ppid (parent_pid), uid, start_time, name, path
+  метрики (последний сэмпл HistoryStore): cpu (% ядра), rss (байт), threads, read_bps, write_bps
+  операторы: = != < <= > >=; у name и path только = и != с шаблоном (* и ?)
+  значение: число (можно с K/M/G - степени 1024), слово или 'строка в кавычках'
+- sort_by: любое поле; order: asc/desc (по умолчанию desc у метрик, asc у остальных)
+- limit: первые N после сортировки (0 - все)
+- fields: поля ответа через запятую (по умолчанию pid,name,path,parent_pid)
+- filter (system/user) работает как еще одно условие
+
+Запрос компилируется один раз: поля и операторы превращаются в массив
+условий. Выполнение идет по колонкам таблицы: каждое условие сужает список
+подходящих строк, шаблон имени или пути проверяется один раз на
+уникальную строку арены. Первые limit строк выбираются nth_element и
+сортируется только эта часть: "top 10 по CPU" на 50k процессов не
+сортирует весь список.
+*/
+class ProcessQuery {
+public:
+    enum class Field : uint8_t { Pid, ParentPid, Uid, StartTime, Name, Path, Cpu, Rss, Threads, ReadRate, WriteRate };
+    enum class Op : uint8_t { Equal, NotEqual, Less, LessEqual, Greater, GreaterEqual };
+
+    //В запросе есть что-то кроме filter - его выполняет ProcessQuery, а не готовый снимок
+    static bool isQuery(const ProtocolRequest& request);
+
+    //false - запрос некорректен, error - причина
+    bool compile(const ProtocolRequest& request, std::string& error);
+
+    //Запросу нужны метрики (cpu, rss, ... в where, sort_by или fields)
+    bool needsMetrics() const { return m_needsMetrics; }
+    //Ключ кеша результатов: одинаковый у одинаковых запросов
+    const std::string& key() const { return m_key; }
+
+    //Строки таблицы в порядке ответа; metrics - по строкам таблицы (nullptr - метрики нулевые);
+    //matched - сколько строк прошло условия (до limit)
+    void run(const ProcessTable& table, const std::vector<HistorySample>* metrics,
+             std::vector<uint32_t>& rows, size_t& matched) const;
+    //Ответ целиком (без '\n')
+    void write(JsonWriter& out, const ProcessTable& table, const std::vector<HistorySample>* metrics,
+               uint64_t generation) const;
+
+    //Шаблон с * (любая последовательность) и ? (один символ)
+    static bool globMatch(std::string_view pattern, std::string_view text);
+
+private:
+    struct Condition {
+        Field field;
+        Op op;
+        double number;       //числовые поля
+        std::string pattern; //name и path
+    };
+
+    bool parseWhere(std::string_view text, std::string& error);
+    bool parseFields(std::string_view text, std::string& error);
+    void filterRows(const Condition& condition, const ProcessTable& table, const std::vector<HistorySample>* metrics,
+                    std::vector<uint32_t>& rows) const;
+
+    std::vector<Condition> m_conditions;
+    ProcessFilter m_filter = ProcessFilter::All;
+    bool m_sorted = false;
+    Field m_sortField = Field::Pid;
+    bool m_descending = false;
+    size_t m_limit = 0;
+    std::vector<Field> m_fields;
+    bool m_needsMetrics = false;
+    std::string m_key;
+};
+
+/*
+Кеш результатов запросов в пределах поколения снимка: одинаковые запросы
+за один интервал сканирования получают готовый сериализованный ответ.
+Новое поколение сбрасывает кеш. Колонка метрик из HistoryStore
+собирается тоже один раз на поколение - при первом запросе, которому она нужна.
+*/
+class QueryCache {
+public:
+    typedef std::shared_ptr<const std::string> Payload;
+    static constexpr size_t MAX_RESULTS = 256; //больше разных запросов за поколение - кеш начинается заново
+
+    //Ответ с '\n'; history = nullptr - метрики нулевые
+    Payload get(const ProcessQuery& query, const ProcessTable& table, uint64_t generation, const HistoryStore* history);
+
+    uint64_t hits() const { return m_hits.load(); }
+    uint64_t misses() const { return m_misses.load(); }
+
+private:
+    std::mutex m_mutex;
+    uint64_t m_generation = 0;
+    std::unordered_map<std::string, Payload> m_results;
+    std::shared_ptr<const std::vector<HistorySample>> m_metrics; //метрики строк таблицы поколения m_generation
+    std::atomic<uint64_t> m_hits{0};
+    std::atomic<uint64_t> m_misses{0};
+};
@@ -0,0 +1,212 @@
+#include "ProcessSampler.h"
+#include "RefreshScheduler.h"
+#include <algorithm>
+#include <sys/resource.h>
+#include <unistd.h>
+
+ProcessSampler::ProcessSampler(const std::string& root) : m_reader(root) {
+    long ticks = ::sysconf(_SC_CLK_TCK);
+    long pageSize = ::sysconf(_SC_PAGESIZE);
+    m_ticksPerSecond = ticks > 0 ? static_cast<double>(ticks) : 100.0;
+    m_pageSize = pageSize > 0 ? static_cast<uint64_t>(pageSize) : 4096;
+
+    //Половина лимита: вторая остается приложению (сокеты сервера, файлы)
+    rlimit limit;
+    m_fileBudget = 0;
+    if (::getrlimit(RLIMIT_NOFILE, &limit) == 0) {
+        m_fileBudget = limit.rlim_cur == RLIM_INFINITY ? (1u << 20) : static_cast<size_t>(limit.rlim_cur / 2);
+    }
+}
+
+ProcessSampler::~ProcessSampler() {
+    for (auto& files : m_currentFiles) {
+        closeFiles(files);
+    }
+}
+
+void ProcessSampler::closeFiles(OpenFiles& files) {
+    for (int* fd : {&files.stat, &files.io}) {
+        if (*fd >= 0) {
+            ::close(*fd);
+            *fd = -1;
+            --m_openFiles;
+        }
+    }
+}
+
+bool ProcessSampler::readUsage(DWORD pid, ProcessUsage& usage, OpenFiles& files) {
+    if (files.stat < 0 && m_openFiles >= m_fileBudget) {
+        return m_reader.readUsage(pid, usage);
+    }
+    bool wasOpen = files.stat >= 0;
+    bool ok = m_reader.readUsage(pid, usage, &files.stat);
+    bool isOpen = files.stat >= 0;
+    if (wasOpen != isOpen) {
+        isOpen ? ++m_openFiles : --m_openFiles;
+    }
+    return ok;
+}
+
+bool ProcessSampler::readIo(DWORD pid, ProcessUsage& usage, OpenFiles& files) {
+    if (files.io < 0 && m_openFiles >= m_fileBudget) {
+        return m_reader.readIo(pid, usage);
+    }
+    bool wasOpen = files.io >= 0;
+    bool ok = m_reader.readIo(pid, usage, &files.io);
+    bool isOpen = files.io >= 0;
+    if (wasOpen != isOpen) {
+        isOpen ? ++m_openFiles : --m_openFiles;
+    }
+    return ok;
+}
+
+size_t ProcessSampler::findPrevious(DWORD pid, size_t& cursor) const {
+    if (cursor > 0 && m_previous[cursor - 1].pid >= pid) {
+        //PID пришли не по порядку - бинарный поиск по всему прошлому сэмплу
+        cursor = static_cast<size_t>(std::lower_bound(m_previous.begin(), m_previous.end(), pid,
+            [](const ProcessSample& sample, DWORD value) { return sample.pid < value; }) - m_previous.begin());
+    } else {
+        //Обычный случай: курсор за весь проход сдвигается не больше чем на размер сэмпла
+        while (cursor < m_previous.size() && m_previous[cursor].pid < pid) {
+            ++cursor;
+        }
+    }
+    if (cursor == m_previous.size() || m_previous[cursor].pid != pid) {
+        return m_previous.size();
+    }
+    return cursor++;
+}
+
+void ProcessSampler::refreshIo(size_t index, Clock::time_point now) {
+    ProcessSample& sample = m_current[index];
+    ProcessUsage usage;
+    bool hasIo = readIo(sample.pid, usage, m_currentFiles[index]);
+    if (hasIo && sample.hasIo && now > sample.ioTime) {
+        //Счетчики монотонны; защита от мусора в поврежденном файле
+        double seconds = std::chrono::duration<double>(now - sample.ioTime).count();
+        uint64_t read = usage.readBytes >= sample.readBytes ? usage.readBytes - sample.readBytes : 0;
+        uint64_t written = usage.writeBytes >= sample.writeBytes ? usage.writeBytes - sample.writeBytes : 0;
+        sample.readBytesPerSec = static_cast<double>(read) / seconds;
+        sample.writeBytesPerSec = static_cast<double>(written) / seconds;
+    } else {
+        sample.readBytesPerSec = 0;
+        sample.writeBytesPerSec = 0;
+    }
+    sample.hasIo = hasIo;
+    sample.ioDenied = !hasIo;
+    sample.readBytes = usage.readBytes;
+    sample.writeBytes = usage.writeBytes;
+    sample.ioTime = now;
+}
+
+size_t ProcessSampler::sample() {
+    return sample(nullptr);
+}
+
+size_t ProcessSampler::sample(RefreshScheduler& scheduler) {
+    return sample(&scheduler);
+}
+
+size_t ProcessSampler::sample(RefreshScheduler* scheduler) {
+    Clock::time_point now = Clock::now();
+    bool hasPrevious = !m_current.empty();
+    m_interval = hasPrevious ? std::chrono::duration<double>(now - m_lastSample).count() : 0;
+    m_lastSample = now;
+    m_previous.swap(m_current);
+    m_previousFiles.swap(m_currentFiles);
+    m_current.clear();
+    m_currentFiles.clear();
+    if (scheduler) {
+        scheduler->beginCycle(now);
+    }
+
+    size_t cursor = 0;
+    ProcessUsage usage;
+    m_reader.forEachPid([&](DWORD pid) {
+        //Дескрипторы переходят от прошлого сэмпла; если процесс с этим PID уже другой,
+        //pread не прочитается и файл откроется заново
+        OpenFiles files;
+        size_t index = findPrevious(pid, cursor);
+        const ProcessSample* previous = nullptr;
+        if (index < m_previous.size()) {
+            previous = &m_previous[index];
+            std::swap(files, m_previousFiles[index]);
+        }
+        if (!readUsage(pid, usage, files)) {
+            closeFiles(files);
+            return; //процесс завершился между getdents и чтением
+        }
+        if (previous && previous->startTime != usage.startTime) {
+            previous = nullptr; //PID переиспользован
+        }
+
+        m_current.emplace_back();
+        ProcessSample& sample = m_current.back();
+        sample.pid = pid;
+        sample.startTime = usage.startTime;
+        sample.cpuTicks = usage.cpuTicks;
+        sample.rssBytes = usage.rssPages * m_pageSize;
+        sample.threads = usage.threads;
+        if (previous) {
+            //io до следующего чтения - от прошлого сэмпла
+            sample.readBytes = previous->readBytes;
+            sample.writeBytes = previous->writeBytes;
+            sample.readBytesPerSec = previous->readBytesPerSec;
+            sample.writeBytesPerSec = previous->writeBytesPerSec;
+            sample.hasIo = previous->hasIo;
+            sample.ioDenied = previous->ioDenied;
+            sample.ioTime = previous->ioTime;
+        }
+        m_currentFiles.push_back(files);
+
+        if (previous && m_interval > 0) {
+            sample.hasRates = true;
+            uint64_t ticks = usage.cpuTicks >= previous->cpuTicks ? usage.cpuTicks - previous->cpuTicks : 0;
+            sample.cpuPercent = static_cast<double>(ticks) / m_ticksPerSecond / m_interval * 100.0;
+        }
+        if (scheduler) {
+            //Имя и ppid сэмплеру не нужны: уровень задает активность по CPU-тикам
+            scheduler->observe(pid, 0, usage.startTime, std::string_view(), usage.cpuTicks);
+        } else if (m_collectIo && !sample.ioDenied) {
+            refreshIo(m_current.size() - 1, now);
+        }
+    });
+
+    //Индексы записей scheduler'а совпадают с m_current: observe на каждый сэмпл
+    if (scheduler && m_collectIo) {
+        scheduler->plan(RefreshScheduler::mask(RefreshScheduler::Attribute::Metrics));
+        RefreshScheduler::Task task;
+        while (scheduler->next(task)) {
+            if (!m_current[task.index].ioDenied) {
+                refreshIo(task.index, now);
+            }
+            scheduler->markRefreshed(task.index, task.attribute);
+        }
+    }
+
+    //Файлы завершившихся процессов
+    for (auto& files : m_previousFiles) {
+        closeFiles(files);
+    }
+
+    //Для следующего findPrevious сэмпл должен быть отсортирован (для /proc это уже так)
+    if (!std::is_sorted(m_current.begin(), m_current.end(),
+                        [](const ProcessSample& a, const ProcessSample& b) { return a.pid < b.pid; })) {
+        std::vector<size_t> order(m_current.size());
+        for (size_t i = 0; i < order.size(); ++i) {
+            order[i] = i;
+        }
+        std::sort(order.begin(), order.end(), [this](size_t a, size_t b) { return m_current[a].pid < m_current[b].pid; });
+        std::vector<ProcessSample> samples;
+        std::vector<OpenFiles> files;
+        samples.reserve(order.size());
+        files.reserve(order.size());
+        for (size_t i : order) {
+            samples.push_back(m_current[i]);
+            files.push_back(m_currentFiles[i]);
+        }
+        m_current.swap(samples);
+        m_currentFiles.swap(files);
+    }
+    return m_current.size();
+}
@@ -0,0 +1,105 @@
+// ProcessSampler.h
+#pragma once
+#include <chrono>
+#include <string>
+#include <vector>
+#include <cstdint>
+#include "ProcFsReader.h"
+
+class RefreshScheduler;
+
+//Ресурсы одного процесса в последнем сэмпле
+struct ProcessSample {
+    DWORD pid = 0;
+    uint64_t startTime = 0;
+    //Накопительные счетчики (см. ProcessUsage)
+    uint64_t cpuTicks = 0;
+    uint64_t readBytes = 0;
+    uint64_t writeBytes = 0;
+    //Мгновенные значения
+    uint64_t rssBytes = 0;
+    uint32_t threads = 0;
+    //Скорости между двумя последними сэмплами; cpuPercent - от одного ядра
+    double cpuPercent = 0;
+    double readBytesPerSec = 0;
+    double writeBytesPerSec = 0;
+    bool hasRates = false; //false - процесс впервые виден в этом сэмпле
+    bool hasIo = false;    //io недоступен для чужих процессов без CAP_SYS_PTRACE
+    bool ioDenied = false; //io уже не прочитался для этого процесса: не пытаемся снова
+    std::chrono::steady_clock::time_point ioTime; //последнее чтение io (с расписанием - не каждый сэмпл)
+};
+
+/*
+Периодический сбор CPU/RSS/потоков/io всех процессов Linux с расчетом скоростей.
+- на процесс один stat и (если доступен) один io, разбор без аллокаций
+- скорости считаются по паре (pid, время старта): процесс с переиспользованным
+  PID начинает с нуля, а не получает чужую разницу счетчиков
+- /proc отдает процессы по возрастанию PID, поэтому прошлый сэмпл ищется
+  проходом курсора, а не хеш-таблицей
+- stat и io каждого процесса остаются открытыми между сэмплами и читаются
+  через pread: открытие файла в procfs стоит дороже, чем само чтение.
+  Число таких дескрипторов ограничено (по умолчанию половина RLIMIT_NOFILE),
+  процессы сверх лимита читаются с открытием на каждый сэмпл
+- после прогрева sample() не аллоцирует (векторы меняются местами)
+- с RefreshScheduler stat (CPU, RSS, потоки) читается каждый сэмпл, а io -
+  задача Attribute::Metrics по интервалу уровня процесса; между чтениями
+  счетчики и скорости io остаются от последнего чтения
+Объект не потокобезопасен.
+*/
+class ProcessSampler {
+public:
+    typedef std::chrono::steady_clock Clock;
+
+    explicit ProcessSampler(const std::string& root = "/proc");
+    ~ProcessSampler();
+
+    ProcessSampler(const ProcessSampler&) = delete;
+    ProcessSampler& operator=(const ProcessSampler&) = delete;
+
+    bool isOpen() const { return m_reader.isOpen(); }
+
+    //Новый сэмпл всех процессов; возвращает их число
+    size_t sample();
+    //То же, io - по расписанию (цикл scheduler'а на каждый сэмпл, по одному scheduler'у на сэмплер)
+    size_t sample(RefreshScheduler& scheduler);
+
+    //Процессы последнего сэмпла, по возрастанию PID
+    const std::vector<ProcessSample>& samples() const { return m_current; }
+    //Интервал между двумя последними сэмплами, секунды (0 после первого)
+    double interval() const { return m_interval; }
+
+    //Без чтения io: вдвое меньше системных вызовов, если диск не интересен
+    void setCollectIo(bool enabled) { m_collectIo = enabled; }
+    //Сколько дескрипторов держать открытыми между сэмплами (0 - не держать)
+    void setOpenFileBudget(size_t files) { m_fileBudget = files; }
+    size_t openFiles() const { return m_openFiles; }
+
+private:
+    //Открытые файлы процесса; индексы совпадают с m_previous/m_current
+    struct OpenFiles {
+        int stat = -1;
+        int io = -1;
+    };
+
+    size_t sample(RefreshScheduler* scheduler);
+    size_t findPrevious(DWORD pid, size_t& cursor) const;
+    //Чтение io процесса m_current[index] и скорости с прошлого чтения
+    void refreshIo(size_t index, Clock::time_point now);
+    //Чтение через дескриптор из files, если он есть или на него хватает лимита
+    bool readUsage(DWORD pid, ProcessUsage& usage, OpenFiles& files);
+    bool readIo(DWORD pid, ProcessUsage& usage, OpenFiles& files);
+    void closeFiles(OpenFiles& files);
+
+    ProcFsReader m_reader;
+    std::vector<ProcessSample> m_previous;
+    std::vector<ProcessSample> m_current;
+    std::vector<OpenFiles> m_previousFiles;
+    std::vector<OpenFiles> m_currentFiles;
+    size_t m_openFiles = 0;
+    size_t m_fileBudget;
+    Clock::time_point m_lastSample;
+    double m_interval = 0;
+    double m_ticksPerSecond;
+    uint64_t m_pageSize;
+    bool m_collectIo = true;
+};
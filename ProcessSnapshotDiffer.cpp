@@ -0,0 +1,98 @@
+#include "ProcessSnapshotDiffer.h"
+#ifndef _WIN32
+#include "ProcFsReader.h"
+#endif
+
+namespace {
+//Сравнение без создания временных строк
+bool sameAttributes(const ProcessInfo& info, const ProcessRecord& record) {
+    return info.getParentPid() == record.parentPid
+        && std::string_view(info.getName()) == record.name
+        && std::string_view(info.getPath()) == record.path;
+}
+
+std::shared_ptr<ProcessInfo> makeInfo(const ProcessRecord& record) {
+    return std::make_shared<ProcessInfo>(record.pid, std::string(record.name),
+                                         std::string(record.path), record.parentPid,
+                                         record.startTime);
+}
+} // namespace
+
+void ProcessSnapshotDiffer::begin() {
+    ++m_generation;
+    m_changes.clear(); //capacity сохраняется
+}
+
+void ProcessSnapshotDiffer::observe(const ProcessRecord& record) {
+    ProcessKey key{record.pid, record.startTime};
+    auto it = m_entries.find(key);
+
+    if (it == m_entries.end()) {
+        auto info = makeInfo(record);
+        m_entries.emplace(key, Entry{info, m_generation});
+        m_changes.push_back(ProcessChange{ProcessChange::Type::Spawned, std::move(info), nullptr});
+        return;
+    }
+
+    Entry& entry = it->second;
+    entry.seenGeneration = m_generation;
+    if (sameAttributes(*entry.info, record)) {
+        return; //без изменений - объект переиспользуется
+    }
+
+    //exec, смена comm или переподчинение родителю - новое неизменяемое состояние
+    auto info = makeInfo(record);
+    m_changes.push_back(ProcessChange{ProcessChange::Type::Changed, info, std::move(entry.info)});
+    entry.info = std::move(info);
+}
+
+const std::vector<ProcessChange>& ProcessSnapshotDiffer::finish() {
+    //Все, кого не видели в этом поколении, завершились
+    for (auto it = m_entries.begin(); it != m_entries.end();) {
+        if (it->second.seenGeneration != m_generation) {
+            m_changes.push_back(ProcessChange{ProcessChange::Type::Exited, std::move(it->second.info), nullptr});
+            it = m_entries.erase(it);
+        } else {
+            ++it;
+        }
+    }
+    return m_changes;
+}
+
+const std::vector<ProcessChange>& ProcessSnapshotDiffer::update(const std::vector<std::shared_ptr<ProcessInfo>>& processes) {
+    begin();
+    for (const auto& process : processes) {
+        ProcessRecord record;
+        record.pid = process->getPid();
+        record.parentPid = process->getParentPid();
+        record.startTime = process->getStartTime();
+        record.name = process->getName();
+        record.path = process->getPath();
+        observe(record);
+    }
+    return finish();
+}
+
+#ifndef _WIN32
+const std::vector<ProcessChange>& ProcessSnapshotDiffer::update(ProcFsReader& reader) {
+    begin();
+    reader.forEachProcess([this](const ProcessRecord& record) {
+        observe(record);
+    });
+    return finish();
+}
+#endif
+
+std::vector<std::shared_ptr<ProcessInfo>> ProcessSnapshotDiffer::snapshot() const {
+    std::vector<std::shared_ptr<ProcessInfo>> processes;
+    processes.reserve(m_entries.size());
+    for (const auto& item : m_entries) {
+        processes.push_back(item.second.info);
+    }
+    return processes;
+}
+
+std::shared_ptr<ProcessInfo> ProcessSnapshotDiffer::find(const ProcessKey& key) const {
+    auto it = m_entries.find(key);
+    return it == m_entries.end() ? nullptr : it->second.info;
+}
@@ -0,0 +1,88 @@
+// ProcessSnapshotDiffer.h
+#pragma once
+#include <memory>
+#include <vector>
+#include <unordered_map>
+#include <cstdint>
+#include "ProcessInfo.h"
+
+#ifndef _WIN32
+class ProcFsReader;
+#endif
+
+//Процесс однозначно определяется парой (pid, время старта): PID может быть переиспользован
+struct ProcessKey {
+    DWORD pid;
+    uint64_t startTime;
+
+    bool operator==(const ProcessKey& other) const {
+        return pid == other.pid && startTime == other.startTime;
+    }
+};
+
+struct ProcessKeyHash {
+    size_t operator()(const ProcessKey& key) const {
+        uint64_t h = (static_cast<uint64_t>(key.pid) << 32) ^ key.startTime;
+        h ^= h >> 33;
+        h *= 0xff51afd7ed558ccdULL;
+        h ^= h >> 33;
+        return static_cast<size_t>(h);
+    }
+};
+
+//Изменение между двумя сканами
+struct ProcessChange {
+    enum class Type { Spawned, Exited, Changed };
+
+    Type type;
+    std::shared_ptr<ProcessInfo> process;  //новое состояние (для Exited - последнее известное)
+    std::shared_ptr<ProcessInfo> previous; //только для Changed: состояние до изменения
+};
+
+/*
+Инкрементальный diff снимков процессов.
+Хранит последнее поколение, и на каждом скане выдает только записи
+Spawned/Exited/Changed. Неизменившиеся процессы переиспользуют тот же
+shared_ptr<ProcessInfo>, поэтому аллокации пропорциональны числу изменений,
+а не числу процессов.
+
+Использование с произвольным источником:
+    differ.begin();
+    for (каждая запись) differ.observe(record);
+    const auto& changes = differ.finish();
+*/
+class ProcessSnapshotDiffer {
+public:
+    ProcessSnapshotDiffer() = default;
+
+    ProcessSnapshotDiffer(const ProcessSnapshotDiffer&) = delete;
+    ProcessSnapshotDiffer& operator=(const ProcessSnapshotDiffer&) = delete;
+
+    void begin();
+    void observe(const ProcessRecord& record);
+    //Ссылка действительна до следующего begin()
+    const std::vector<ProcessChange>& finish();
+
+    //Полный цикл для готового списка процессов
+    const std::vector<ProcessChange>& update(const std::vector<std::shared_ptr<ProcessInfo>>& processes);
+#ifndef _WIN32
+    //Полный цикл прямо из /proc без промежуточного вектора ProcessInfo
+    const std::vector<ProcessChange>& update(ProcFsReader& reader);
+#endif
+
+    //Текущее поколение: живые процессы
+    std::vector<std::shared_ptr<ProcessInfo>> snapshot() const;
+    std::shared_ptr<ProcessInfo> find(const ProcessKey& key) const;
+    size_t size() const { return m_entries.size(); }
+    uint64_t generation() const { return m_generation; }
+
+private:
+    struct Entry {
+        std::shared_ptr<ProcessInfo> info;
+        uint64_t seenGeneration;
+    };
+
+    std::unordered_map<ProcessKey, Entry, ProcessKeyHash> m_entries;
+    std::vector<ProcessChange> m_changes; //переиспользуется между сканами
+    uint64_t m_generation = 0;
+};
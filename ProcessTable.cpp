@@ -0,0 +1,187 @@
+#include "ProcessTable.h"
+#include "Metrics.h"
+#include "RefreshScheduler.h"
+#ifndef _WIN32
+#include "ProcFsReader.h"
+#endif
+
+namespace {
+//Арена пересобирается, когда мертвых строк становится заметно больше живых
+const size_t ARENA_COMPACT_MIN = 4096;
+
+MetricHistogram scanDuration("monitor_scan_duration_seconds", "Full process table scan");
+MetricCounter scans("monitor_scans_total", "Process table scans");
+MetricGauge scannedProcesses("monitor_processes", "Processes seen by the last scan");
+}
+
+std::shared_ptr<ProcessInfo> ProcessView::toProcessInfo() const {
+    return std::make_shared<ProcessInfo>(getPid(), getName(), getPath(), getParentPid(), getStartTime());
+}
+
+ProcessTable::ProcessTable() = default;
+ProcessTable::~ProcessTable() = default;
+
+void ProcessTable::clear() {
+    //clear() сохраняет capacity - следующий скан не аллоцирует
+    m_pids.clear();
+    m_parentPids.clear();
+    m_startTimes.clear();
+    m_uids.clear();
+    m_nameIds.clear();
+    m_pathIds.clear();
+}
+
+void ProcessTable::append(const ProcessRecord& record) {
+    m_pids.push_back(record.pid);
+    m_parentPids.push_back(record.parentPid);
+    m_startTimes.push_back(record.startTime);
+    m_uids.push_back(record.uid);
+    m_nameIds.push_back(m_strings.intern(record.name));
+    m_pathIds.push_back(m_strings.intern(record.path));
+}
+
+void ProcessTable::finishScan() {
+    scans.add();
+    scannedProcesses.set(static_cast<int64_t>(size()));
+    //каждая строка дает максимум два handle'а (имя и путь)
+    if (m_strings.size() > ARENA_COMPACT_MIN && m_strings.size() > 4 * size()) {
+        compactStrings();
+    }
+}
+
+void ProcessTable::copyFrom(const ProcessTable& other) {
+    m_pids = other.m_pids;
+    m_parentPids = other.m_parentPids;
+    m_startTimes = other.m_startTimes;
+    m_uids = other.m_uids;
+    m_nameIds = other.m_nameIds;
+    m_pathIds = other.m_pathIds;
+    m_strings.assign(other.m_strings);
+    ++m_stringsVersion;
+}
+
+void ProcessTable::compactStrings() {
+    //Переносим в новую арену только строки живых процессов и переписываем handle'ы
+    StringArena fresh;
+    for (size_t row = 0; row < size(); ++row) {
+        m_nameIds[row] = fresh.intern(m_strings.get(m_nameIds[row]));
+        m_pathIds[row] = fresh.intern(m_strings.get(m_pathIds[row]));
+    }
+    m_strings = std::move(fresh);
+    ++m_stringsVersion;
+}
+
+#ifndef _WIN32
+
+size_t ProcessTable::scan() {
+    if (!m_reader) {
+        m_reader.reset(new ProcFsReader());
+    }
+    return scan(*m_reader);
+}
+
+size_t ProcessTable::scan(ProcFsReader& reader) {
+    MetricTimer timer(scanDuration);
+    clear();
+    reader.forEachProcess([this](const ProcessRecord& record) {
+        append(record);
+    });
+    finishScan();
+    return size();
+}
+
+size_t ProcessTable::scan(RefreshScheduler& scheduler) {
+    if (!m_reader) {
+        m_reader.reset(new ProcFsReader());
+    }
+    return scan(*m_reader, scheduler);
+}
+
+size_t ProcessTable::scan(ProcFsReader& reader, RefreshScheduler& scheduler) {
+    MetricTimer timer(scanDuration);
+    scheduler.beginCycle();
+    ProcessRecord record;
+    uint64_t cpuTicks = 0;
+    reader.forEachPid([&](DWORD pid) {
+        //процесс мог завершиться между getdents и openat - просто пропускаем
+        if (reader.readBasic(pid, record, cpuTicks)) {
+            scheduler.observe(pid, record.parentPid, record.startTime, record.name, cpuTicks);
+        }
+    });
+
+    scheduler.plan(RefreshScheduler::mask(RefreshScheduler::Attribute::Path) |
+                   RefreshScheduler::mask(RefreshScheduler::Attribute::Owner));
+    RefreshScheduler::Task task;
+    while (scheduler.next(task)) {
+        DWORD pid = scheduler.entries()[task.index].pid;
+        if (task.attribute == RefreshScheduler::Attribute::Path) {
+            scheduler.setPath(task.index, reader.readPath(pid));
+        } else {
+            uint32_t uid = 0;
+            if (reader.readOwner(pid, uid)) {
+                scheduler.setOwner(task.index, uid);
+            } else {
+                scheduler.markRefreshed(task.index, task.attribute);
+            }
+        }
+    }
+
+    clear();
+    for (const RefreshScheduler::Entry& entry : scheduler.entries()) {
+        record.pid = entry.pid;
+        record.parentPid = entry.parentPid;
+        record.startTime = entry.startTime;
+        record.name = entry.name;
+        record.path = entry.path;
+        record.uid = entry.uid;
+        append(record);
+    }
+    finishScan();
+    return size();
+}
+
+#else
+
+size_t ProcessTable::scan() {
+    //WinAPI уже отдает готовые объекты - переносим их в колонки
+    MetricTimer timer(scanDuration);
+    clear();
+    for (const auto& process : ProcessInfo::getRunningProcesses()) {
+        ProcessRecord record;
+        record.pid = process->getPid();
+        record.parentPid = process->getParentPid();
+        record.startTime = process->getStartTime();
+        record.name = process->getName();
+        record.path = process->getPath();
+        append(record);
+    }
+    finishScan();
+    return size();
+}
+
+size_t ProcessTable::scan(RefreshScheduler&) {
+    //WinAPI-скан берет путь и время старта одним OpenProcess на процесс; расписание пока не применяется
+    return scan();
+}
+
+#endif
+
+size_t ProcessTable::findRow(DWORD pid) const {
+    const DWORD* pids = m_pids.data();
+    size_t count = m_pids.size();
+    for (size_t row = 0; row < count; ++row) {
+        if (pids[row] == pid) {
+            return row;
+        }
+    }
+    return count;
+}
+
+std::vector<std::shared_ptr<ProcessInfo>> ProcessTable::toProcessInfos() const {
+    std::vector<std::shared_ptr<ProcessInfo>> processes;
+    processes.reserve(size());
+    for (size_t row = 0; row < size(); ++row) {
+        processes.push_back((*this)[row].toProcessInfo());
+    }
+    return processes;
+}
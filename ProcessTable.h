@@ -0,0 +1,118 @@
+// ProcessTable.h
+#pragma once
+#include <memory>
+#include <string>
+#include <vector>
+#include <cstdint>
+#include "ProcessInfo.h"
+#include "StringArena.h"
+
+#ifndef _WIN32
+class ProcFsReader;
+#endif
+
+class ProcessTable;
+class RefreshScheduler;
+
+//Легкое представление строки таблицы с тем же интерфейсом, что у ProcessInfo
+class ProcessView {
+public:
+    ProcessView(const ProcessTable& table, size_t row) : m_table(&table), m_row(row) {}
+
+    DWORD getPid() const;
+    const std::string& getName() const;
+    const std::string& getPath() const;
+    DWORD getParentPid() const;
+    uint64_t getStartTime() const;
+    uint32_t getUid() const;
+    size_t getRow() const { return m_row; }
+
+    //Копия в обычный ProcessInfo для старого API
+    std::shared_ptr<ProcessInfo> toProcessInfo() const;
+
+private:
+    const ProcessTable* m_table;
+    size_t m_row;
+};
+
+/*
+Снимок процессов в виде struct-of-arrays:
+- pid, ppid, время старта, uid владельца и handle'ы строк лежат в непрерывных колонках
+- имена и пути интернированы в StringArena, которая живет между сканами
+Колонки очищаются без освобождения памяти, поэтому после прогрева
+повторный скан не делает аллокаций. Фильтры идут по плотным массивам
+чисел, а не по указателям на отдельные объекты в куче.
+*/
+class ProcessTable {
+public:
+    ProcessTable();
+    ~ProcessTable();
+
+    ProcessTable(const ProcessTable&) = delete;
+    ProcessTable& operator=(const ProcessTable&) = delete;
+
+    //Полный скан системы (Linux - /proc, Windows - getRunningProcesses)
+    size_t scan();
+#ifndef _WIN32
+    size_t scan(ProcFsReader& reader);
+#endif
+    //Скан с расписанием: stat каждого процесса, путь и владелец - по RefreshScheduler
+    //(у простаивающих процессов значения из прошлых циклов). Windows - полный скан
+    size_t scan(RefreshScheduler& scheduler);
+#ifndef _WIN32
+    size_t scan(ProcFsReader& reader, RefreshScheduler& scheduler);
+#endif
+
+    //Ручное наполнение (для других источников и тестов)
+    void clear();
+    void append(const ProcessRecord& record);
+    //Вызывается после наполнения: чистит арену от строк умерших процессов
+    void finishScan();
+    //Неизменяемая копия снимка (для чтения в других потоках, пока эта таблица сканирует дальше)
+    void copyFrom(const ProcessTable& other);
+
+    size_t size() const { return m_pids.size(); }
+    bool empty() const { return m_pids.empty(); }
+
+    //Колонки
+    const std::vector<DWORD>& pids() const { return m_pids; }
+    const std::vector<DWORD>& parentPids() const { return m_parentPids; }
+    const std::vector<uint64_t>& startTimes() const { return m_startTimes; }
+    //Владелец: числовой uid (ProcessRecord::UNKNOWN_UID - неизвестен); имена - UserNameCache
+    const std::vector<uint32_t>& uids() const { return m_uids; }
+    const std::vector<StringArena::Handle>& nameIds() const { return m_nameIds; }
+    const std::vector<StringArena::Handle>& pathIds() const { return m_pathIds; }
+    const StringArena& strings() const { return m_strings; }
+    //Меняется при пересборке арены: handle'ы из прошлых сканов больше не действительны
+    uint64_t stringsVersion() const { return m_stringsVersion; }
+
+    ProcessView operator[](size_t row) const { return ProcessView(*this, row); }
+    //Строка по pid (линейный проход по колонке pid), size() если не найден
+    size_t findRow(DWORD pid) const;
+
+    //Совместимость со старым API
+    std::vector<std::shared_ptr<ProcessInfo>> toProcessInfos() const;
+
+private:
+    void compactStrings();
+
+    std::vector<DWORD> m_pids;
+    std::vector<DWORD> m_parentPids;
+    std::vector<uint64_t> m_startTimes;
+    std::vector<uint32_t> m_uids;
+    std::vector<StringArena::Handle> m_nameIds;
+    std::vector<StringArena::Handle> m_pathIds;
+    StringArena m_strings;
+    uint64_t m_stringsVersion = 0;
+
+#ifndef _WIN32
+    std::unique_ptr<ProcFsReader> m_reader; //открывается при первом scan()
+#endif
+};
+
+inline DWORD ProcessView::getPid() const { return m_table->pids()[m_row]; }
+inline const std::string& ProcessView::getName() const { return m_table->strings().get(m_table->nameIds()[m_row]); }
+inline const std::string& ProcessView::getPath() const { return m_table->strings().get(m_table->pathIds()[m_row]); }
+inline DWORD ProcessView::getParentPid() const { return m_table->parentPids()[m_row]; }
+inline uint64_t ProcessView::getStartTime() const { return m_table->startTimes()[m_row]; }
+inline uint32_t ProcessView::getUid() const { return m_table->uids()[m_row]; }
@@ -0,0 +1,202 @@
+#include "ProcessTree.h"
+#include "ProcessTable.h"
+
+namespace {
+
+//Состояния строки при поиске циклов
+const uint32_t UNSEEN = 0;
+const uint32_t WALKING = 1;
+const uint32_t DONE = 2;
+
+size_t slotFor(DWORD pid, size_t mask) {
+    //Мультипликативный хеш: PID идут подряд, старшие биты произведения перемешаны лучше младших
+    return static_cast<size_t>((static_cast<uint64_t>(pid) * 0x9E3779B97F4A7C15ull) >> 32) & mask;
+}
+
+} // namespace
+
+void ProcessTree::build(const ProcessTable& table) {
+    build(table.pids(), table.parentPids(), &table.startTimes());
+}
+
+void ProcessTree::build(const std::vector<DWORD>& pids, const std::vector<DWORD>& parentPids,
+                        const std::vector<uint64_t>* startTimes) {
+    m_pids.assign(pids.begin(), pids.end());
+    buildIndex();
+
+    const Row none = static_cast<Row>(size());
+    m_parents.resize(size());
+    for (size_t row = 0; row < size(); ++row) {
+        size_t parentRow = findRow(parentPids[row]);
+        //Сам себе родитель (PID 0 в Windows) - корень
+        if (parentRow == row) {
+            parentRow = none;
+        }
+        //Родитель моложе ребенка: PID родителя уже занят другим процессом
+        if (parentRow != none && startTimes != nullptr) {
+            uint64_t parentStart = (*startTimes)[parentRow];
+            uint64_t childStart = (*startTimes)[row];
+            if (parentStart != 0 && childStart != 0 && parentStart > childStart) {
+                parentRow = none;
+            }
+        }
+        m_parents[row] = static_cast<Row>(parentRow);
+    }
+
+    breakCycles();
+    buildChildren();
+    buildPreorder();
+}
+
+void ProcessTree::buildIndex() {
+    size_t capacity = 16;
+    while (capacity < size() * 2) {
+        capacity <<= 1;
+    }
+    m_slotMask = capacity - 1;
+    m_slots.assign(capacity, static_cast<Row>(size()));
+    for (size_t row = 0; row < size(); ++row) {
+        size_t slot = slotFor(m_pids[row], m_slotMask);
+        while (m_slots[slot] != size()) {
+            if (m_pids[m_slots[slot]] == m_pids[row]) {
+                break; //повтор PID в снимке: остается первая строка
+            }
+            slot = (slot + 1) & m_slotMask;
+        }
+        if (m_slots[slot] == size()) {
+            m_slots[slot] = static_cast<Row>(row);
+        }
+    }
+}
+
+size_t ProcessTree::findRow(DWORD pid) const {
+    if (m_slots.empty()) {
+        return size();
+    }
+    for (size_t slot = slotFor(pid, m_slotMask); m_slots[slot] != size(); slot = (slot + 1) & m_slotMask) {
+        if (m_pids[m_slots[slot]] == pid) {
+            return m_slots[slot];
+        }
+    }
+    return size();
+}
+
+void ProcessTree::breakCycles() {
+    //Подъем по родителям из каждой строки; вернулись в строку текущего подъема - цикл.
+    //m_depths и m_preorder здесь - рабочие буферы, они заполняются позже
+    const Row none = static_cast<Row>(size());
+    m_depths.assign(size(), UNSEEN);
+    m_preorder.clear();
+    for (size_t row = 0; row < size(); ++row) {
+        Row current = static_cast<Row>(row);
+        while (current != none && m_depths[current] == UNSEEN) {
+            m_depths[current] = WALKING;
+            m_preorder.push_back(current);
+            current = m_parents[current];
+        }
+        if (current != none && m_depths[current] == WALKING) {
+            m_parents[current] = none; //разрываем цикл: процесс становится корнем
+        }
+        for (Row walked : m_preorder) {
+            m_depths[walked] = DONE;
+        }
+        m_preorder.clear();
+    }
+}
+
+void ProcessTree::buildChildren() {
+    const Row none = static_cast<Row>(size());
+    m_childOffsets.assign(size() + 1, 0);
+    m_roots.clear();
+    for (size_t row = 0; row < size(); ++row) {
+        if (m_parents[row] == none) {
+            m_roots.push_back(static_cast<Row>(row));
+        } else {
+            ++m_childOffsets[m_parents[row] + 1];
+        }
+    }
+    for (size_t row = 0; row < size(); ++row) {
+        m_childOffsets[row + 1] += m_childOffsets[row];
+    }
+    //m_positions - курсор записи для каждого родителя; дети идут в порядке строк
+    m_positions.assign(m_childOffsets.begin(), m_childOffsets.end() - 1);
+    m_children.resize(size() - m_roots.size());
+    for (size_t row = 0; row < size(); ++row) {
+        if (m_parents[row] != none) {
+            m_children[m_positions[m_parents[row]]++] = static_cast<Row>(row);
+        }
+    }
+}
+
+void ProcessTree::buildPreorder() {
+    const Row none = static_cast<Row>(size());
+    m_preorder.clear();
+    m_positions.resize(size());
+    m_depths.resize(size());
+    //m_subtreeSizes до подсчета размеров служит стеком обхода: каждая строка кладется один раз
+    m_subtreeSizes.resize(size());
+    for (Row root : m_roots) {
+        size_t top = 0;
+        m_subtreeSizes[top++] = root;
+        while (top > 0) {
+            Row row = m_subtreeSizes[--top];
+            m_positions[row] = static_cast<Row>(m_preorder.size());
+            m_preorder.push_back(row);
+            m_depths[row] = m_parents[row] == none ? 0 : m_depths[m_parents[row]] + 1;
+            //Дети в стек в обратном порядке, чтобы обойти их в порядке строк
+            for (Row child = m_childOffsets[row + 1]; child > m_childOffsets[row]; --child) {
+                m_subtreeSizes[top++] = m_children[child - 1];
+            }
+        }
+    }
+
+    //В preorder потомки идут после предка: размеры собираются одним проходом с конца
+    m_subtreeSizes.assign(size(), 1);
+    for (size_t i = m_preorder.size(); i > 0; --i) {
+        Row row = m_preorder[i - 1];
+        if (m_parents[row] != none) {
+            m_subtreeSizes[m_parents[row]] += m_subtreeSizes[row];
+        }
+    }
+}
+
+ProcessTree::Range ProcessTree::children(size_t row) const {
+    const Row* base = m_children.data();
+    return Range(base + m_childOffsets[row], base + m_childOffsets[row + 1]);
+}
+
+ProcessTree::Range ProcessTree::roots() const {
+    return Range(m_roots.data(), m_roots.data() + m_roots.size());
+}
+
+ProcessTree::Range ProcessTree::subtree(size_t row) const {
+    const Row* first = m_preorder.data() + m_positions[row];
+    return Range(first, first + m_subtreeSizes[row]);
+}
+
+bool ProcessTree::contains(size_t ancestor, size_t row) const {
+    return m_positions[row] >= m_positions[ancestor] &&
+           m_positions[row] < m_positions[ancestor] + m_subtreeSizes[ancestor];
+}
+
+void ProcessTree::ancestors(size_t row, std::vector<Row>& out) const {
+    out.clear();
+    out.reserve(m_depths[row]);
+    for (size_t current = m_parents[row]; current != size(); current = m_parents[current]) {
+        out.push_back(static_cast<Row>(current));
+    }
+}
+
+std::vector<DWORD> ProcessTree::subtreePids(DWORD pid) const {
+    std::vector<DWORD> result;
+    size_t row = findRow(pid);
+    if (row == size()) {
+        return result;
+    }
+    Range rows = subtree(row);
+    result.reserve(rows.size());
+    for (Row member : rows) {
+        result.push_back(m_pids[member]);
+    }
+    return result;
+}
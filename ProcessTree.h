@@ -0,0 +1,92 @@
+// ProcessTree.h
+#pragma once
+#include <vector>
+#include <cstddef>
+#include <cstdint>
+#include "Platform.h"
+
+class ProcessTable;
+
+/*
+Дерево процессов по колонкам pid/ppid снимка, пересобирается за O(n):
+- дети хранятся в CSR-виде: один массив строк и смещения начала для каждого
+  родителя, дети процесса - непрерывный отрезок
+- процессы дополнительно разложены в порядке обхода в глубину (preorder),
+  поэтому все поддерево - тоже непрерывный отрезок, а проверка
+  "предок ли A процесса B" - два сравнения
+- pid -> строка через открытую адресацию, без аллокаций на запрос
+Сироты (родителя нет в снимке) становятся корнями. Если известно время
+старта, родитель, запущенный позже ребенка, считается чужим процессом
+с переиспользованным PID - ребенок тоже становится корнем. Циклы
+(возможны при переиспользовании PID) разрываются.
+Строки - номера строк исходного ProcessTable; после нового скана дерево
+нужно пересобрать.
+*/
+class ProcessTree {
+public:
+    typedef uint32_t Row;
+
+    //Непрерывный отрезок строк (дети, поддерево, корни, предки)
+    class Range {
+    public:
+        Range(const Row* first, const Row* last) : m_first(first), m_last(last) {}
+        const Row* begin() const { return m_first; }
+        const Row* end() const { return m_last; }
+        size_t size() const { return static_cast<size_t>(m_last - m_first); }
+        bool empty() const { return m_first == m_last; }
+        Row operator[](size_t index) const { return m_first[index]; }
+
+    private:
+        const Row* m_first;
+        const Row* m_last;
+    };
+
+    void build(const ProcessTable& table);
+    //startTimes может быть nullptr: тогда переиспользование PID не распознается
+    void build(const std::vector<DWORD>& pids, const std::vector<DWORD>& parentPids,
+               const std::vector<uint64_t>* startTimes = nullptr);
+
+    size_t size() const { return m_pids.size(); }
+
+    //Строка по pid за O(1), size() если не найден
+    size_t findRow(DWORD pid) const;
+    DWORD pid(size_t row) const { return m_pids[row]; }
+
+    //Строка родителя, size() для корня
+    size_t parent(size_t row) const { return m_parents[row]; }
+    Range children(size_t row) const;
+    Range roots() const;
+
+    //Сам процесс и все его потомки в порядке обхода в глубину
+    Range subtree(size_t row) const;
+    //Число уровней до корня (у корня 0)
+    uint32_t depth(size_t row) const { return m_depths[row]; }
+    //Является ли ancestor предком row (или самим row)
+    bool contains(size_t ancestor, size_t row) const;
+
+    //Цепочка предков от родителя до корня ("кто запустил")
+    void ancestors(size_t row, std::vector<Row>& out) const;
+
+    //Поддерево по pid; пусто, если процесса нет
+    std::vector<DWORD> subtreePids(DWORD pid) const;
+
+private:
+    void buildIndex();
+    void breakCycles();
+    void buildChildren();
+    void buildPreorder();
+
+    std::vector<DWORD> m_pids;
+    std::vector<Row> m_parents;       //size() для корня
+    std::vector<Row> m_childOffsets;  //дети row: m_children[m_childOffsets[row] .. m_childOffsets[row + 1])
+    std::vector<Row> m_children;
+    std::vector<Row> m_roots;
+    std::vector<Row> m_preorder;      //строки в порядке обхода в глубину
+    std::vector<Row> m_positions;     //позиция строки в m_preorder
+    std::vector<Row> m_subtreeSizes;
+    std::vector<uint32_t> m_depths;
+
+    //Открытая адресация pid -> строка; пустая ячейка - size()
+    std::vector<Row> m_slots;
+    size_t m_slotMask = 0;
+};
@@ -0,0 +1,211 @@
+#include "RefreshScheduler.h"
+#include "Metrics.h"
+#include <algorithm>
+
+namespace {
+
+MetricCounter pathRefreshes("monitor_refresh_total", "Expensive per-process attribute reads", "attribute", "path");
+MetricCounter ownerRefreshes("monitor_refresh_total", "Expensive per-process attribute reads", "attribute", "owner");
+MetricCounter hashRefreshes("monitor_refresh_total", "Expensive per-process attribute reads", "attribute", "hash");
+MetricCounter metricsRefreshes("monitor_refresh_total", "Expensive per-process attribute reads", "attribute", "metrics");
+MetricCounter deferredRefreshes("monitor_refresh_deferred_total", "Attribute reads postponed by the per-cycle budget");
+MetricGauge newProcesses("monitor_refresh_processes", "Processes per refresh tier", "tier", "new");
+MetricGauge changedProcesses("monitor_refresh_processes", "Processes per refresh tier", "tier", "changed");
+MetricGauge idleProcesses("monitor_refresh_processes", "Processes per refresh tier", "tier", "idle");
+
+const MetricCounter* const refreshCounters[RefreshScheduler::ATTRIBUTES] = {
+    &pathRefreshes, &ownerRefreshes, &hashRefreshes, &metricsRefreshes
+};
+
+} // namespace
+
+RefreshScheduler::Policy::Policy() {
+    using std::chrono::seconds;
+    //Путь, владелец, хеш, метрики
+    const Clock::duration defaults[TIERS][ATTRIBUTES] = {
+        {seconds(0), seconds(0), seconds(0), seconds(0)},     //New
+        {seconds(5), seconds(5), seconds(30), seconds(1)},    //Changed
+        {seconds(60), seconds(60), seconds(600), seconds(10)} //Idle
+    };
+    for (size_t tier = 0; tier < TIERS; ++tier) {
+        for (size_t attribute = 0; attribute < ATTRIBUTES; ++attribute) {
+            intervals[tier][attribute] = defaults[tier][attribute];
+        }
+    }
+}
+
+void RefreshScheduler::beginCycle(Clock::time_point now) {
+    //Для курсора прошлый цикл должен быть отсортирован (для /proc это уже так)
+    if (!std::is_sorted(m_current.begin(), m_current.end(),
+                        [](const Entry& a, const Entry& b) { return a.pid < b.pid; })) {
+        std::sort(m_current.begin(), m_current.end(), [](const Entry& a, const Entry& b) { return a.pid < b.pid; });
+    }
+    m_previous.swap(m_current);
+    m_current.clear();
+    m_cursor = 0;
+    m_now = now;
+    ++m_cycles;
+    m_tasks.clear();
+    m_nextTask = 0;
+    m_spent = Clock::duration(0);
+    m_taskRunning = false;
+    m_deferred = 0;
+    std::fill(std::begin(m_tierCounts), std::end(m_tierCounts), 0);
+}
+
+size_t RefreshScheduler::findPrevious(DWORD pid, size_t& cursor) const {
+    if (cursor > 0 && m_previous[cursor - 1].pid >= pid) {
+        //PID пришли не по порядку - бинарный поиск по всему прошлому циклу
+        cursor = static_cast<size_t>(std::lower_bound(m_previous.begin(), m_previous.end(), pid,
+            [](const Entry& entry, DWORD value) { return entry.pid < value; }) - m_previous.begin());
+    } else {
+        while (cursor < m_previous.size() && m_previous[cursor].pid < pid) {
+            ++cursor;
+        }
+    }
+    if (cursor == m_previous.size() || m_previous[cursor].pid != pid) {
+        return m_previous.size();
+    }
+    return cursor++;
+}
+
+size_t RefreshScheduler::observe(DWORD pid, DWORD parentPid, uint64_t startTime, std::string_view name,
+                                 uint64_t activity) {
+    size_t index = findPrevious(pid, m_cursor);
+    if (index < m_previous.size() && m_previous[index].startTime == startTime) {
+        //Записи переходят из прошлого цикла перемещением: строки не копируются
+        m_current.push_back(std::move(m_previous[index]));
+        Entry& entry = m_current.back();
+        bool changed = entry.parentPid != parentPid || entry.activity != activity;
+        if (entry.name != name) {
+            //exec: исполняемый файл другой
+            changed = true;
+            entry.name.assign(name.data(), name.size());
+            entry.valid &= ~(mask(Attribute::Path) | mask(Attribute::Owner) | mask(Attribute::Hash));
+        }
+        entry.parentPid = parentPid;
+        entry.activity = activity;
+        entry.quiet = changed ? 0 : entry.quiet + 1;
+        ++entry.age;
+    } else {
+        //Новый процесс или PID переиспользован
+        m_current.emplace_back();
+        Entry& entry = m_current.back();
+        entry.pid = pid;
+        entry.parentPid = parentPid;
+        entry.startTime = startTime;
+        entry.name.assign(name.data(), name.size());
+        entry.activity = activity;
+        if (m_cycles == 1) {
+            entry.age = m_policy.newCycles; //работал до запуска монитора
+        }
+    }
+
+    Entry& entry = m_current.back();
+    if (entry.age < m_policy.newCycles) {
+        entry.tier = Tier::New;
+    } else {
+        entry.tier = entry.quiet < m_policy.quietCycles ? Tier::Changed : Tier::Idle;
+    }
+    ++m_tierCounts[static_cast<size_t>(entry.tier)];
+    return m_current.size() - 1;
+}
+
+void RefreshScheduler::plan(unsigned attributes) {
+    newProcesses.set(static_cast<int64_t>(tierCount(Tier::New)));
+    changedProcesses.set(static_cast<int64_t>(tierCount(Tier::Changed)));
+    idleProcesses.set(static_cast<int64_t>(tierCount(Tier::Idle)));
+
+    m_tasks.clear();
+    m_nextTask = 0;
+    m_deferred = 0;
+    for (size_t index = 0; index < m_current.size(); ++index) {
+        const Entry& entry = m_current[index];
+        for (size_t a = 0; a < ATTRIBUTES; ++a) {
+            Attribute attribute = static_cast<Attribute>(a);
+            if ((attributes & mask(attribute)) == 0) {
+                continue;
+            }
+            Planned task;
+            task.index = static_cast<uint32_t>(index);
+            task.attribute = attribute;
+            task.tier = entry.tier;
+            if ((entry.valid & mask(attribute)) == 0) {
+                task.due = Clock::time_point();
+                task.required = (m_policy.required & mask(attribute)) != 0;
+            } else {
+                task.due = entry.refreshed[a] + m_policy.intervals[static_cast<size_t>(entry.tier)][a];
+                task.required = false;
+                if (task.due > m_now) {
+                    continue;
+                }
+            }
+            m_tasks.push_back(task);
+        }
+    }
+    //Обязательные, затем по уровням, внутри уровня - дольше всех ждущие
+    std::sort(m_tasks.begin(), m_tasks.end(), [](const Planned& a, const Planned& b) {
+        if (a.required != b.required) {
+            return a.required;
+        }
+        if (a.tier != b.tier) {
+            return a.tier < b.tier;
+        }
+        if (a.due != b.due) {
+            return a.due < b.due;
+        }
+        return a.index < b.index;
+    });
+}
+
+bool RefreshScheduler::next(Task& task) {
+    if (m_nextTask >= m_tasks.size()) {
+        return false;
+    }
+    const Planned& planned = m_tasks[m_nextTask];
+    if (!planned.required && m_policy.budget > Clock::duration(0) && m_spent >= m_policy.budget) {
+        //Обязательные отсортированы первыми - остальные задачи цикла ждут следующего
+        m_deferred = m_tasks.size() - m_nextTask;
+        deferredRefreshes.add(m_deferred);
+        m_nextTask = m_tasks.size();
+        return false;
+    }
+    task.index = planned.index;
+    task.attribute = planned.attribute;
+    ++m_nextTask;
+    m_taskStart = Clock::now();
+    m_taskRunning = true;
+    return true;
+}
+
+void RefreshScheduler::complete(size_t index, Attribute attribute) {
+    if (m_taskRunning) {
+        m_spent += Clock::now() - m_taskStart;
+        m_taskRunning = false;
+    }
+    Entry& entry = m_current[index];
+    size_t a = static_cast<size_t>(attribute);
+    entry.valid |= mask(attribute);
+    entry.refreshed[a] = m_now;
+    ++m_refreshes[a];
+    refreshCounters[a]->add();
+}
+
+void RefreshScheduler::setPath(size_t index, std::string_view path) {
+    m_current[index].path.assign(path.data(), path.size());
+    complete(index, Attribute::Path);
+}
+
+void RefreshScheduler::setOwner(size_t index, uint32_t uid) {
+    m_current[index].uid = uid;
+    complete(index, Attribute::Owner);
+}
+
+void RefreshScheduler::setHash(size_t index, std::string_view hash) {
+    m_current[index].hash.assign(hash.data(), hash.size());
+    complete(index, Attribute::Hash);
+}
+
+void RefreshScheduler::markRefreshed(size_t index, Attribute attribute) {
+    complete(index, attribute);
+}
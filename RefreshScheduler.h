@@ -0,0 +1,142 @@
+// RefreshScheduler.h
+#pragma once
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "ProcessInfo.h" //ProcessRecord
+
+/*
+Расписание обновления дорогих атрибутов процессов между сканами.
+Дешевые поля (stat: имя, ppid, время старта, CPU-тики) читаются каждый цикл,
+а путь, владелец, хеш и метрики - по интервалу уровня процесса:
+- New: первые newCycles циклов; exec обычно идет сразу после fork,
+  поэтому путь нового процесса перечитывается каждый цикл. Процессы,
+  найденные первым циклом, новыми не считаются
+- Changed: за последние quietCycles циклов менялись имя, ppid или CPU-тики
+- Idle: все остальное (долгоживущие демоны) - самые длинные интервалы
+Смена имени (comm) - это exec: путь, владелец и хеш становятся
+недействительными и читаются в этом же цикле.
+Атрибуты планируют разные потребители, у каждого свой scheduler:
+путь и владельца - ProcessTable::scan, хеш образа - IntegrityManifest::verifyProcesses,
+метрики (io) - ProcessSampler::sample.
+
+Дорогие чтения цикла ограничены бюджетом времени: задачи идут по
+уровням (New, Changed, Idle), внутри уровня - дольше всех ждущие,
+не уместившиеся ждут следующего цикла и оказываются в нем раньше.
+Первое чтение обязательных атрибутов (по умолчанию путь и владелец)
+идет вне бюджета: без него строка таблицы неполна.
+В установившемся режиме стоимость цикла - N дешевых чтений плюс
+дорогие только у активных процессов и у доли простаивающих.
+
+Записи хранятся по возрастанию PID (так их отдает /proc), прошлый
+цикл ищется курсором, как в ProcessSampler; после прогрева циклы не
+аллоцируют, кроме строк новых процессов.
+Объект не потокобезопасен.
+*/
+class RefreshScheduler {
+public:
+    typedef std::chrono::steady_clock Clock;
+
+    enum class Tier : uint8_t { New, Changed, Idle };
+    enum class Attribute : uint8_t { Path, Owner, Hash, Metrics };
+    static constexpr size_t TIERS = 3;
+    static constexpr size_t ATTRIBUTES = 4;
+
+    //Маска атрибутов для plan() и Policy::required
+    static constexpr unsigned mask(Attribute attribute) { return 1u << static_cast<unsigned>(attribute); }
+
+    struct Policy {
+        Policy();
+
+        Clock::duration intervals[TIERS][ATTRIBUTES]; //[уровень][атрибут]; 0 - каждый цикл
+        uint32_t newCycles = 3;    //циклов, пока процесс считается новым
+        uint32_t quietCycles = 10; //циклов без изменений до перехода в Idle
+        Clock::duration budget = std::chrono::milliseconds(5); //дорогие чтения за цикл; 0 - без ограничения
+        unsigned required = mask(Attribute::Path) | mask(Attribute::Owner); //первое чтение вне бюджета
+    };
+
+    struct Entry {
+        DWORD pid = 0;
+        DWORD parentPid = 0;
+        uint64_t startTime = 0;
+        std::string name;        //comm не длиннее 15 символов - без аллокаций
+        uint64_t activity = 0;   //CPU-тики из stat
+        std::string path;
+        uint32_t uid = ProcessRecord::UNKNOWN_UID;
+        std::string hash;
+        Tier tier = Tier::New;
+        uint32_t age = 0;        //циклов с первого появления
+        uint32_t quiet = 0;      //циклов подряд без изменений
+        unsigned valid = 0;      //маска атрибутов, прочитанных после старта или exec
+        Clock::time_point refreshed[ATTRIBUTES];
+    };
+
+    struct Task {
+        uint32_t index = 0; //запись в entries()
+        Attribute attribute = Attribute::Path;
+    };
+
+    RefreshScheduler() = default;
+
+    void setPolicy(const Policy& policy) { m_policy = policy; }
+    const Policy& policy() const { return m_policy; }
+
+/*
+Цикл: beginCycle, observe для каждого процесса (по возрастанию PID), затем
+plan с нужными атрибутами и next/set* до исчерпания задач или бюджета.
+Каждая полученная задача завершается set* или markRefreshed (в том числе
+при ошибке чтения - повтор будет по интервалу, а не каждый цикл).
+*/
+    void beginCycle(Clock::time_point now = Clock::now());
+    //Дешевые поля процесса в этом цикле; возвращает индекс записи
+    size_t observe(DWORD pid, DWORD parentPid, uint64_t startTime, std::string_view name, uint64_t activity);
+    //Задачи цикла по атрибутам из маски attributes
+    void plan(unsigned attributes);
+    //false - задач нет или бюджет исчерпан
+    bool next(Task& task);
+
+    void setPath(size_t index, std::string_view path);
+    void setOwner(size_t index, uint32_t uid);
+    void setHash(size_t index, std::string_view hash);
+    void markRefreshed(size_t index, Attribute attribute);
+
+    //Процессы текущего цикла, по возрастанию PID
+    const std::vector<Entry>& entries() const { return m_current; }
+    size_t tierCount(Tier tier) const { return m_tierCounts[static_cast<size_t>(tier)]; }
+    //Задачи последнего plan, не уместившиеся в бюджет
+    size_t deferred() const { return m_deferred; }
+    //Выполненные задачи за все циклы
+    uint64_t refreshes(Attribute attribute) const { return m_refreshes[static_cast<size_t>(attribute)]; }
+
+private:
+    struct Planned {
+        Clock::time_point due; //когда задача стала нужна; у недействительных атрибутов - начало эпохи
+        uint32_t index;
+        Attribute attribute;
+        bool required;
+        Tier tier;
+    };
+
+    size_t findPrevious(DWORD pid, size_t& cursor) const;
+    void complete(size_t index, Attribute attribute);
+
+    Policy m_policy;
+    std::vector<Entry> m_previous;
+    std::vector<Entry> m_current;
+    size_t m_cursor = 0;
+    Clock::time_point m_now;
+    uint64_t m_cycles = 0;
+
+    std::vector<Planned> m_tasks;
+    size_t m_nextTask = 0;
+    Clock::duration m_spent{0};       //время дорогих чтений в этом цикле
+    Clock::time_point m_taskStart;
+    bool m_taskRunning = false;
+    size_t m_deferred = 0;
+
+    size_t m_tierCounts[TIERS] = {};
+    uint64_t m_refreshes[ATTRIBUTES] = {};
+};
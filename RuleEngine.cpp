@@ -0,0 +1,423 @@
+#include "RuleEngine.h"
+#include "ProcessTable.h"
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <sys/stat.h>
+#ifndef _WIN32
+#include "ProcFsReader.h"
+#endif
+
+namespace {
+
+inline unsigned char foldCase(unsigned char c) {
+    return (c >= 'A' && c <= 'Z') ? static_cast<unsigned char>(c - 'A' + 'a') : c;
+}
+
+inline bool isBlank(char c) {
+    return c == ' ' || c == '\t' || c == '\r';
+}
+
+std::string_view trim(std::string_view value) {
+    while (!value.empty() && isBlank(value.front())) {
+        value.remove_prefix(1);
+    }
+    while (!value.empty() && isBlank(value.back())) {
+        value.remove_suffix(1);
+    }
+    return value;
+}
+
+//Следующее слово строки; line сдвигается за него
+std::string_view nextToken(std::string_view& line) {
+    line = trim(line);
+    size_t length = 0;
+    while (length < line.size() && !isBlank(line[length])) {
+        ++length;
+    }
+    std::string_view token = line.substr(0, length);
+    line.remove_prefix(length);
+    return token;
+}
+
+bool parseField(std::string_view token, RuleField& field) {
+    if (token == "any") {
+        field = RuleField::Any;
+    } else if (token == "name") {
+        field = RuleField::Name;
+    } else if (token == "path") {
+        field = RuleField::Path;
+    } else if (token == "cmdline") {
+        field = RuleField::Cmdline;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+inline bool fieldAccepts(RuleField rule, RuleField text) {
+    return rule == RuleField::Any || rule == text;
+}
+
+const uint32_t NOT_EVALUATED = UINT32_MAX;
+
+} // namespace
+
+std::shared_ptr<const RuleSet> RuleSet::compile(std::string_view text) {
+    std::shared_ptr<RuleSet> rules(new RuleSet());
+    size_t lineNumber = 0;
+    bool ok = true;
+    while (!text.empty()) {
+        size_t newline = text.find('\n');
+        std::string_view line = text.substr(0, newline);
+        text.remove_prefix(newline == std::string_view::npos ? text.size() : newline + 1);
+        ++lineNumber;
+
+        line = trim(line);
+        if (line.empty() || line.front() == '#') {
+            continue;
+        }
+        Rule rule;
+        rule.line = lineNumber;
+        std::string_view field = nextToken(line);
+        std::string_view label = nextToken(line);
+        std::string_view pattern = trim(line);
+        if (!parseField(field, rule.field)) {
+            std::cerr << "Rules: line " << lineNumber << ": unknown field '" << field
+                      << "' (expected any, name, path or cmdline)" << std::endl;
+            ok = false;
+            continue;
+        }
+        if (label.empty() || pattern.empty()) {
+            std::cerr << "Rules: line " << lineNumber << ": expected '<field> <label> <pattern>'" << std::endl;
+            ok = false;
+            continue;
+        }
+        rule.label = label;
+        rule.pattern.reserve(pattern.size());
+        for (char c : pattern) {
+            rule.pattern.push_back(static_cast<char>(foldCase(static_cast<unsigned char>(c))));
+        }
+        rules->m_needsCmdline = rules->m_needsCmdline || rule.field == RuleField::Cmdline;
+        rules->m_rules.push_back(std::move(rule));
+    }
+    //Набор с ошибкой не применяется целиком: половина правил хуже, чем старые правила
+    if (!ok || !rules->build()) {
+        return nullptr;
+    }
+    return rules;
+}
+
+std::shared_ptr<const RuleSet> RuleSet::fromFile(const std::string& path) {
+    std::ifstream file(path, std::ios::binary);
+    if (!file) {
+        std::cerr << "Rules: cannot open " << path << std::endl;
+        return nullptr;
+    }
+    std::ostringstream content;
+    content << file.rdbuf();
+    return compile(content.str());
+}
+
+bool RuleSet::build() {
+    //Классы байтов: регистр букв сворачивается в один класс
+    m_classCount = 1;
+    for (const Rule& rule : m_rules) {
+        for (char c : rule.pattern) {
+            unsigned char byte = static_cast<unsigned char>(c);
+            if (m_classes[byte] == 0) {
+                if (m_classCount == 256) {
+                    return false; //не бывает: классов не больше, чем различных байтов
+                }
+                m_classes[byte] = static_cast<uint8_t>(m_classCount);
+                if (byte >= 'a' && byte <= 'z') {
+                    m_classes[byte - 'a' + 'A'] = static_cast<uint8_t>(m_classCount);
+                }
+                ++m_classCount;
+            }
+        }
+    }
+
+    //Бор: 0 в таблице - нет ребра (в корень ребра не ведут)
+    const uint32_t classes = m_classCount;
+    m_next.assign(classes, 0);
+    std::vector<std::vector<uint32_t>> outputs(1);
+    for (uint32_t id = 0; id < m_rules.size(); ++id) {
+        uint32_t state = 0;
+        for (char c : m_rules[id].pattern) {
+            size_t edge = static_cast<size_t>(state) * classes + m_classes[static_cast<unsigned char>(c)];
+            if (m_next[edge] == 0) {
+                m_next[edge] = static_cast<uint32_t>(outputs.size());
+                outputs.emplace_back();
+                m_next.resize(m_next.size() + classes, 0);
+            }
+            state = m_next[edge];
+        }
+        outputs[state].push_back(id);
+    }
+
+/*
+BFS по бору: fail-ссылка узла - самый длинный собственный суффикс, который
+тоже есть в боре. Недостающие переходы узла копируются из его fail-узла
+(он мельче и уже обработан), после чего таблица - полный DFA.
+*/
+    const size_t states = outputs.size();
+    std::vector<uint32_t> fail(states, 0);
+    m_outputLinks.assign(states, 0);
+    m_terminal.assign(states, 0);
+    std::vector<uint32_t> queue;
+    queue.reserve(states);
+    for (uint32_t c = 0; c < classes; ++c) {
+        if (m_next[c] != 0) {
+            queue.push_back(m_next[c]);
+        }
+    }
+    m_terminal[0] = !outputs[0].empty();
+    for (size_t head = 0; head < queue.size(); ++head) {
+        uint32_t state = queue[head];
+        uint32_t link = fail[state];
+        m_outputLinks[state] = outputs[link].empty() ? m_outputLinks[link] : link;
+        m_terminal[state] = !outputs[state].empty() || m_terminal[link];
+
+        uint32_t* row = &m_next[static_cast<size_t>(state) * classes];
+        const uint32_t* linkRow = &m_next[static_cast<size_t>(link) * classes];
+        for (uint32_t c = 0; c < classes; ++c) {
+            if (row[c] != 0) {
+                fail[row[c]] = linkRow[c];
+                queue.push_back(row[c]);
+            } else {
+                row[c] = linkRow[c];
+            }
+        }
+    }
+
+    m_outputOffsets.assign(states + 1, 0);
+    m_outputs.clear();
+    for (size_t state = 0; state < states; ++state) {
+        m_outputs.insert(m_outputs.end(), outputs[state].begin(), outputs[state].end());
+        m_outputOffsets[state + 1] = static_cast<uint32_t>(m_outputs.size());
+    }
+    return true;
+}
+
+template<typename Callback>
+void RuleSet::scan(std::string_view text, Callback&& callback) const {
+    if (m_rules.empty()) {
+        return;
+    }
+    const uint32_t* next = m_next.data();
+    const size_t classes = m_classCount;
+    uint32_t state = 0;
+    for (char c : text) {
+        state = next[state * classes + m_classes[static_cast<unsigned char>(c)]];
+        if (!m_terminal[state]) {
+            continue;
+        }
+        //Свои шаблоны узла, затем по цепочке суффиксов
+        for (uint32_t output = state; output != 0; output = m_outputLinks[output]) {
+            for (uint32_t i = m_outputOffsets[output]; i < m_outputOffsets[output + 1]; ++i) {
+                if (!callback(m_outputs[i])) {
+                    return;
+                }
+            }
+        }
+    }
+}
+
+size_t RuleSet::match(RuleField field, std::string_view text, std::vector<uint32_t>& rules) const {
+    size_t first = rules.size();
+    scan(text, [&](uint32_t id) {
+        if (!fieldAccepts(m_rules[id].field, field)) {
+            return true;
+        }
+        //Срабатываний на строку единицы - линейный поиск дешевле множества
+        for (size_t i = first; i < rules.size(); ++i) {
+            if (rules[i] == id) {
+                return true;
+            }
+        }
+        rules.push_back(id);
+        return true;
+    });
+    return rules.size() - first;
+}
+
+bool RuleSet::matchesAny(RuleField field, std::string_view text) const {
+    bool found = false;
+    scan(text, [&](uint32_t id) {
+        found = fieldAccepts(m_rules[id].field, field);
+        return !found;
+    });
+    return found;
+}
+
+void RuleSet::evaluate(const ProcessTable& table, std::vector<RuleMatch>& out,
+                       const std::vector<std::string>* cmdlines) const {
+    out.clear();
+    if (m_rules.empty()) {
+        return;
+    }
+    const StringArena& strings = table.strings();
+    const size_t handles = strings.size();
+    //Результаты по handle: [begin, end) в found; NOT_EVALUATED - строка еще не проверялась
+    std::vector<uint32_t> nameBegin(handles, NOT_EVALUATED), nameEnd(handles, 0);
+    std::vector<uint32_t> pathBegin(handles, NOT_EVALUATED), pathEnd(handles, 0);
+    std::vector<uint32_t> found;
+    std::vector<uint32_t> cmdlineRules;
+
+    auto emit = [&](size_t row, RuleField field, const uint32_t* begin, const uint32_t* end) {
+        for (; begin != end; ++begin) {
+            out.push_back(RuleMatch{row, *begin, field});
+        }
+    };
+    auto evaluateString = [&](RuleField field, StringArena::Handle handle,
+                              std::vector<uint32_t>& begins, std::vector<uint32_t>& ends) {
+        if (begins[handle] == NOT_EVALUATED) {
+            begins[handle] = static_cast<uint32_t>(found.size());
+            match(field, strings.get(handle), found);
+            ends[handle] = static_cast<uint32_t>(found.size());
+        }
+    };
+
+    const auto& names = table.nameIds();
+    const auto& paths = table.pathIds();
+    for (size_t row = 0; row < table.size(); ++row) {
+        StringArena::Handle name = names[row];
+        if (name != StringArena::EMPTY) {
+            evaluateString(RuleField::Name, name, nameBegin, nameEnd);
+            emit(row, RuleField::Name, found.data() + nameBegin[name], found.data() + nameEnd[name]);
+        }
+        StringArena::Handle path = paths[row];
+        if (path != StringArena::EMPTY) {
+            evaluateString(RuleField::Path, path, pathBegin, pathEnd);
+            emit(row, RuleField::Path, found.data() + pathBegin[path], found.data() + pathEnd[path]);
+        }
+        if (cmdlines && m_needsCmdline && row < cmdlines->size() && !(*cmdlines)[row].empty()) {
+            cmdlineRules.clear();
+            match(RuleField::Cmdline, (*cmdlines)[row], cmdlineRules);
+            emit(row, RuleField::Cmdline, cmdlineRules.data(), cmdlineRules.data() + cmdlineRules.size());
+        }
+    }
+}
+
+RuleEngine::RuleEngine() = default;
+
+RuleEngine::~RuleEngine() {
+    stopWatching();
+}
+
+bool RuleEngine::stampOf(const std::string& path, FileStamp& stamp) {
+#ifdef _WIN32
+    struct _stat64 info;
+    if (::_stat64(path.c_str(), &info) != 0) {
+        return false;
+    }
+    stamp.inode = 0;
+    stamp.mtimeNs = static_cast<int64_t>(info.st_mtime) * 1000000000LL;
+#else
+    struct stat info;
+    if (::stat(path.c_str(), &info) != 0) {
+        return false;
+    }
+    stamp.inode = static_cast<uint64_t>(info.st_ino);
+    stamp.mtimeNs = static_cast<int64_t>(info.st_mtim.tv_sec) * 1000000000LL + info.st_mtim.tv_nsec;
+#endif
+    stamp.size = static_cast<uint64_t>(info.st_size);
+    return true;
+}
+
+bool RuleEngine::load(const std::string& path) {
+    std::lock_guard<std::mutex> lock(m_reloadMutex);
+    //Отметка до чтения: правка во время компиляции будет замечена следующей проверкой
+    FileStamp stamp;
+    stampOf(path, stamp);
+    std::shared_ptr<const RuleSet> rules = RuleSet::fromFile(path);
+    m_path = path;
+    m_stamp = stamp;
+    if (!rules) {
+        return false;
+    }
+    setRules(std::move(rules));
+    return true;
+}
+
+bool RuleEngine::reloadIfChanged() {
+    std::lock_guard<std::mutex> lock(m_reloadMutex);
+    FileStamp stamp;
+    if (m_path.empty() || !stampOf(m_path, stamp) || stamp == m_stamp) {
+        return false;
+    }
+    //Ошибочный файл запоминается тоже - иначе ошибка печаталась бы на каждой проверке
+    m_stamp = stamp;
+    std::shared_ptr<const RuleSet> rules = RuleSet::fromFile(m_path);
+    if (!rules) {
+        std::cerr << "Rules: " << m_path << " not applied, keeping previous rules" << std::endl;
+        return false;
+    }
+    setRules(std::move(rules));
+    return true;
+}
+
+void RuleEngine::startWatching(std::chrono::milliseconds interval) {
+    stopWatching();
+    m_watching = true;
+    m_watcher = std::thread([this, interval] {
+        std::unique_lock<std::mutex> lock(m_watchMutex);
+        while (!m_watchCondition.wait_for(lock, interval, [this] { return !m_watching; })) {
+            lock.unlock();
+            reloadIfChanged();
+            lock.lock();
+        }
+    });
+}
+
+void RuleEngine::stopWatching() {
+    {
+        std::lock_guard<std::mutex> lock(m_watchMutex);
+        m_watching = false;
+    }
+    m_watchCondition.notify_all();
+    if (m_watcher.joinable()) {
+        m_watcher.join();
+    }
+}
+
+void RuleEngine::setRules(std::shared_ptr<const RuleSet> rules) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_rules = std::move(rules);
+    ++m_version;
+}
+
+std::shared_ptr<const RuleSet> RuleEngine::rules() const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_rules;
+}
+
+uint64_t RuleEngine::version() const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_version;
+}
+
+std::shared_ptr<const RuleSet> RuleEngine::scan(const ProcessTable& table, std::vector<RuleMatch>& out) {
+    std::shared_ptr<const RuleSet> rules = this->rules();
+    if (!rules) {
+        out.clear();
+        return nullptr;
+    }
+    std::lock_guard<std::mutex> lock(m_scanMutex);
+    const std::vector<std::string>* cmdlines = nullptr;
+#ifndef _WIN32
+    if (rules->needsCmdline()) {
+        if (!m_reader) {
+            m_reader.reset(new ProcFsReader());
+        }
+        m_cmdlines.resize(table.size());
+        for (size_t row = 0; row < table.size(); ++row) {
+            m_cmdlines[row].assign(m_reader->readCmdline(table.pids()[row]));
+        }
+        cmdlines = &m_cmdlines;
+    }
+#endif
+    rules->evaluate(table, out, cmdlines);
+    return rules;
+}
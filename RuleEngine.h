@@ -0,0 +1,153 @@
+// RuleEngine.h
+#pragma once
+#include <chrono>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+#include <cstdint>
+#include "Platform.h"
+
+class ProcessTable;
+#ifndef _WIN32
+class ProcFsReader;
+#endif
+
+//Где ищется индикатор
+enum class RuleField : uint8_t { Any, Name, Path, Cmdline };
+
+struct Rule {
+    RuleField field = RuleField::Any;
+    std::string label;   //что сообщать при срабатывании
+    std::string pattern; //подстрока, без учета регистра ASCII
+    size_t line = 0;     //строка файла правил
+};
+
+//Срабатывание правила для строки снимка
+struct RuleMatch {
+    size_t row;
+    uint32_t rule;     //индекс в RuleSet::rule()
+    RuleField field;   //в каком поле найдено
+};
+
+/*
+Скомпилированный набор правил: автомат Ахо-Корасик в виде плотной таблицы
+переходов (DFA). Байты приводятся к классам эквивалентности: все символы,
+которых нет ни в одном шаблоне, - один класс, поэтому строка таблицы
+короткая. Поиск - один переход на байт текста без возвратов по
+fail-ссылкам, сколько бы ни было шаблонов.
+
+Формат файла правил - по одному на строку, '#' - комментарий:
+    <поле> <метка> <шаблон до конца строки>
+    name    miner     xmrig
+    path    tmp-exec  /tmp/
+    cmdline revshell  bash -i >& /dev/tcp/
+    any     mimikatz  mimikatz
+Набор неизменяем после компиляции и безопасно используется из многих потоков.
+*/
+class RuleSet {
+public:
+    //nullptr при ошибке разбора (ошибки с номерами строк - в std::cerr)
+    static std::shared_ptr<const RuleSet> compile(std::string_view text);
+    static std::shared_ptr<const RuleSet> fromFile(const std::string& path);
+
+    size_t size() const { return m_rules.size(); }
+    const Rule& rule(uint32_t id) const { return m_rules[id]; }
+    size_t states() const { return m_outputOffsets.size() - 1; }
+    size_t tableBytes() const { return m_next.size() * sizeof(uint32_t); }
+    //Есть правила по командной строке (ее нужно читать отдельно)
+    bool needsCmdline() const { return m_needsCmdline; }
+
+    //Правила, сработавшие в text для поля field, каждое один раз; возвращает число добавленных
+    size_t match(RuleField field, std::string_view text, std::vector<uint32_t>& rules) const;
+    bool matchesAny(RuleField field, std::string_view text) const;
+
+    //Весь снимок за один проход: имена и пути интернированы, каждая уникальная
+    //строка проверяется один раз. cmdlines (по строкам таблицы) - если нужны
+    void evaluate(const ProcessTable& table, std::vector<RuleMatch>& out,
+                  const std::vector<std::string>* cmdlines = nullptr) const;
+
+private:
+    RuleSet() = default;
+    bool build();
+    //Обход автомата; callback(ruleId) на каждое срабатывание, false - остановиться
+    template<typename Callback>
+    void scan(std::string_view text, Callback&& callback) const;
+
+    std::vector<Rule> m_rules;
+    bool m_needsCmdline = false;
+
+    uint8_t m_classes[256] = {};     //байт -> класс (0 - нет ни в одном шаблоне)
+    uint32_t m_classCount = 1;
+    std::vector<uint32_t> m_next;    //state * m_classCount + класс -> state
+    std::vector<uint8_t> m_terminal; //в состоянии (или по суффиксным ссылкам) заканчивается шаблон
+    //Шаблоны, заканчивающиеся ровно в состоянии: m_outputs[m_outputOffsets[s] .. m_outputOffsets[s + 1])
+    std::vector<uint32_t> m_outputOffsets;
+    std::vector<uint32_t> m_outputs;
+    //Ближайшее по fail-цепочке состояние со своими шаблонами (0 - нет)
+    std::vector<uint32_t> m_outputLinks;
+};
+
+/*
+Текущий набор правил с горячей перезагрузкой.
+Новый набор компилируется в стороне и подменяет указатель; идущие проверки
+дорабатывают на старом наборе (shared_ptr), новые берут новый. Файл с
+ошибкой не применяется - остаются прежние правила.
+*/
+class RuleEngine {
+public:
+    RuleEngine();
+    ~RuleEngine();
+
+    RuleEngine(const RuleEngine&) = delete;
+    RuleEngine& operator=(const RuleEngine&) = delete;
+
+    bool load(const std::string& path);
+    //Перечитывает файл, если он изменился (inode, размер, mtime); true - набор заменен
+    bool reloadIfChanged();
+    //Фоновая проверка файла раз в interval
+    void startWatching(std::chrono::milliseconds interval);
+    void stopWatching();
+
+    void setRules(std::shared_ptr<const RuleSet> rules);
+    std::shared_ptr<const RuleSet> rules() const;
+    //Номер набора: растет при каждой замене
+    uint64_t version() const;
+
+    //Проверка снимка; командные строки читаются из /proc, только если есть такие правила.
+    //Возвращает набор, по которому считались индексы правил в out
+    std::shared_ptr<const RuleSet> scan(const ProcessTable& table, std::vector<RuleMatch>& out);
+
+private:
+    struct FileStamp {
+        uint64_t inode = 0;
+        uint64_t size = 0;
+        int64_t mtimeNs = 0;
+        bool operator==(const FileStamp& other) const {
+            return inode == other.inode && size == other.size && mtimeNs == other.mtimeNs;
+        }
+    };
+    static bool stampOf(const std::string& path, FileStamp& stamp);
+
+    mutable std::mutex m_mutex; //только копирование указателя и версии
+    std::shared_ptr<const RuleSet> m_rules;
+    uint64_t m_version = 0;
+
+    std::mutex m_reloadMutex; //путь и отметка файла; перезагружает один поток
+    std::string m_path;
+    FileStamp m_stamp;
+
+    std::mutex m_scanMutex;   //буферы scan()
+    std::vector<std::string> m_cmdlines;
+#ifndef _WIN32
+    std::unique_ptr<ProcFsReader> m_reader;
+#endif
+
+    std::thread m_watcher;
+    std::mutex m_watchMutex;
+    std::condition_variable m_watchCondition;
+    bool m_watching = false;
+};
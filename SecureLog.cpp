@@ -0,0 +1,705 @@
+#include "SecureLog.h"
+#include "Metrics.h"
+#include "Sha256.h"
+#include <algorithm>
+#include <cstring>
+#include <ctime>
+#include <fstream>
+#include <iostream>
+#ifdef _WIN32
+#include <io.h>
+#include <windows.h>
+#else
+#include <cerrno>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#include <unistd.h>
+#endif
+
+namespace {
+
+const size_t DEFAULT_THREAD_BUFFER = 256 * 1024;
+const size_t RECORD_HEADER = 12;       //u32 длина + u64 время, нс
+const size_t MAX_MESSAGE = 16 * 1024;  //длиннее - обрезается
+const size_t TAIL_SCAN = 64 * 1024;    //последняя строка ищется в этом хвосте файла
+const size_t HASH_HEX = 64;
+#ifndef _WIN32
+const int MAX_IOV = 512;
+#endif
+
+//Пишет только поток сброса; log() метрик не касается
+MetricCounter loggedEntries("monitor_secure_log_entries_total", "Security log lines written");
+MetricCounter droppedEntries("monitor_secure_log_dropped_total", "Security log entries lost to full thread buffers");
+MetricHistogram syncDuration("monitor_secure_log_sync_seconds", "Security log fdatasync");
+
+std::atomic<uint64_t> g_nextLogId{1};
+
+uint64_t wallClockNs() {
+    return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count());
+}
+
+uint32_t currentThreadId() {
+#ifdef _WIN32
+    return static_cast<uint32_t>(GetCurrentThreadId());
+#else
+    return static_cast<uint32_t>(::syscall(SYS_gettid));
+#endif
+}
+
+size_t roundUpPow2(size_t value) {
+    size_t result = 4096;
+    while (result < value) {
+        result <<= 1;
+    }
+    return result;
+}
+
+void appendNumber(std::string& out, uint64_t value) {
+    char digits[20];
+    size_t count = 0;
+    do {
+        digits[count++] = static_cast<char>('0' + value % 10);
+        value /= 10;
+    } while (value != 0);
+    while (count > 0) {
+        out += digits[--count];
+    }
+}
+
+void appendPadded(std::string& out, unsigned value, size_t width) {
+    char digits[10];
+    for (size_t i = width; i > 0; --i) {
+        digits[i - 1] = static_cast<char>('0' + value % 10);
+        value /= 10;
+    }
+    out.append(digits, width);
+}
+
+//2026-10-17T12:34:56.123456Z
+void appendTime(std::string& out, uint64_t timestampNs) {
+    std::time_t seconds = static_cast<std::time_t>(timestampNs / 1000000000ull);
+    std::tm parts;
+#ifdef _WIN32
+    gmtime_s(&parts, &seconds);
+#else
+    gmtime_r(&seconds, &parts);
+#endif
+    appendPadded(out, static_cast<unsigned>(parts.tm_year + 1900), 4);
+    out += '-';
+    appendPadded(out, static_cast<unsigned>(parts.tm_mon + 1), 2);
+    out += '-';
+    appendPadded(out, static_cast<unsigned>(parts.tm_mday), 2);
+    out += 'T';
+    appendPadded(out, static_cast<unsigned>(parts.tm_hour), 2);
+    out += ':';
+    appendPadded(out, static_cast<unsigned>(parts.tm_min), 2);
+    out += ':';
+    appendPadded(out, static_cast<unsigned>(parts.tm_sec), 2);
+    out += '.';
+    appendPadded(out, static_cast<unsigned>(timestampNs % 1000000000ull / 1000), 6);
+    out += 'Z';
+}
+
+void appendEscaped(std::string& out, const char* data, size_t size) {
+    for (size_t i = 0; i < size; ++i) {
+        char ch = data[i];
+        if (ch == '\n') {
+            out += "\\n";
+        } else if (ch == '\r') {
+            out += "\\r";
+        } else if (ch == '\\') {
+            out += "\\\\";
+        } else {
+            out += ch;
+        }
+    }
+}
+
+void toHex(const unsigned char* data, size_t size, char* out) {
+    static const char digits[] = "0123456789abcdef";
+    for (size_t i = 0; i < size; ++i) {
+        out[i * 2] = digits[data[i] >> 4];
+        out[i * 2 + 1] = digits[data[i] & 15];
+    }
+}
+
+//hash строки: SHA-256(hex предыдущего + '\n' + "<seq> <время> <tid> " + сообщение)
+void chainHash(unsigned char chain[Sha256::DIGEST_SIZE], std::string_view prefix, std::string_view message) {
+    char previous[HASH_HEX + 1];
+    toHex(chain, Sha256::DIGEST_SIZE, previous);
+    previous[HASH_HEX] = '\n';
+    Sha256 hasher;
+    hasher.update(previous, sizeof(previous));
+    hasher.update(prefix.data(), prefix.size());
+    hasher.update(message.data(), message.size());
+    hasher.finish(chain);
+}
+
+bool parseDigits(std::string_view text, size_t& pos, uint64_t& value) {
+    size_t begin = pos;
+    value = 0;
+    while (pos < text.size() && text[pos] >= '0' && text[pos] <= '9') {
+        value = value * 10 + static_cast<uint64_t>(text[pos] - '0');
+        ++pos;
+    }
+    return pos > begin && pos < text.size() && text[pos] == ' ';
+}
+
+//Поля строки журнала; prefix - "<seq> <время> <tid> " без hash
+struct ParsedLine {
+    uint64_t sequence;
+    std::string_view hash;
+    std::string_view message;
+    std::string prefix;
+};
+
+bool parseLine(std::string_view line, ParsedLine& parsed) {
+    size_t pos = 0;
+    uint64_t tid;
+    if (!parseDigits(line, pos, parsed.sequence)) {
+        return false;
+    }
+    size_t timeBegin = ++pos;
+    pos = line.find(' ', pos);
+    if (pos == std::string_view::npos || pos == timeBegin) {
+        return false;
+    }
+    ++pos;
+    if (!parseDigits(line, pos, tid)) {
+        return false;
+    }
+    size_t hashBegin = ++pos;
+    if (line.size() < hashBegin + HASH_HEX + 1 || line[hashBegin + HASH_HEX] != ' ') {
+        return false;
+    }
+    parsed.prefix.assign(line.data(), hashBegin);
+    parsed.hash = line.substr(hashBegin, HASH_HEX);
+    parsed.message = line.substr(hashBegin + HASH_HEX + 1);
+    return true;
+}
+
+bool parseHex(std::string_view hex, unsigned char* out) {
+    for (size_t i = 0; i < hex.size() / 2; ++i) {
+        unsigned value = 0;
+        for (size_t j = 0; j < 2; ++j) {
+            char digit = hex[i * 2 + j];
+            value <<= 4;
+            if (digit >= '0' && digit <= '9') value |= static_cast<unsigned>(digit - '0');
+            else if (digit >= 'a' && digit <= 'f') value |= static_cast<unsigned>(digit - 'a' + 10);
+            else return false;
+        }
+        out[i] = static_cast<unsigned char>(value);
+    }
+    return true;
+}
+
+#ifndef _WIN32
+//writev до конца: частичная запись продолжается с недописанного места
+bool writeAll(int fd, iovec* iov, int count) {
+    while (count > 0) {
+        ssize_t written = ::writev(fd, iov, std::min(count, MAX_IOV));
+        if (written < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return false;
+        }
+        size_t left = static_cast<size_t>(written);
+        while (count > 0 && left >= iov->iov_len) {
+            left -= iov->iov_len;
+            ++iov;
+            --count;
+        }
+        if (count > 0) {
+            iov->iov_base = static_cast<char*>(iov->iov_base) + left;
+            iov->iov_len -= left;
+        }
+    }
+    return true;
+}
+#endif
+
+} // namespace
+
+//Кольцо одного потока: пишет только он, читает только поток сброса
+struct SecureLog::ThreadBuffer {
+    explicit ThreadBuffer(size_t size) : data(new unsigned char[size]), capacity(size) {}
+
+    std::unique_ptr<unsigned char[]> data;
+    const size_t capacity; //степень двойки
+    uint32_t tid = 0;
+    std::atomic<bool> retired{false};  //поток завершился
+    std::atomic<bool> orphaned{false}; //журнал уничтожен
+
+    alignas(64) std::atomic<uint64_t> head{0};
+    uint64_t cachedTail = 0; //копия tail у производителя: меньше обращений к чужой строке кеша
+    std::atomic<uint64_t> dropped{0};
+    alignas(64) std::atomic<uint64_t> tail{0};
+
+    void write(uint64_t position, const void* source, size_t size) {
+        size_t offset = static_cast<size_t>(position) & (capacity - 1);
+        size_t first = std::min(size, capacity - offset);
+        std::memcpy(data.get() + offset, source, first);
+        std::memcpy(data.get(), static_cast<const unsigned char*>(source) + first, size - first);
+    }
+
+    void read(uint64_t position, void* target, size_t size) const {
+        size_t offset = static_cast<size_t>(position) & (capacity - 1);
+        size_t first = std::min(size, capacity - offset);
+        std::memcpy(target, data.get() + offset, first);
+        std::memcpy(static_cast<unsigned char*>(target) + first, data.get(), size - first);
+    }
+};
+
+SecureLog::SecureLog()
+    : m_id(g_nextLogId.fetch_add(1)), m_open(false), m_bufferSize(DEFAULT_THREAD_BUFFER),
+      m_written(0), m_droppedTotal(0), m_syncs(0) {
+    std::memset(m_chain, 0, sizeof(m_chain));
+}
+
+SecureLog::~SecureLog() {
+    close();
+    std::lock_guard<std::mutex> lock(m_buffersMutex);
+    for (auto& buffer : m_buffers) {
+        buffer->orphaned.store(true, std::memory_order_release);
+    }
+}
+
+SecureLog::ThreadBuffer* SecureLog::threadBuffer() {
+    struct Slot {
+        uint64_t logId;
+        std::shared_ptr<ThreadBuffer> buffer;
+    };
+    struct Slots {
+        std::vector<Slot> list;
+        ~Slots() {
+            for (Slot& slot : list) {
+                slot.buffer->retired.store(true, std::memory_order_release);
+            }
+        }
+    };
+    static thread_local Slots slots;
+
+    //Обычно журнал один: последний использованный - в конце списка
+    if (!slots.list.empty() && slots.list.back().logId == m_id) {
+        return slots.list.back().buffer.get();
+    }
+    for (size_t i = 0; i < slots.list.size(); ++i) {
+        if (slots.list[i].logId == m_id) {
+            std::swap(slots.list[i], slots.list.back());
+            return slots.list.back().buffer.get();
+        }
+    }
+    slots.list.erase(std::remove_if(slots.list.begin(), slots.list.end(), [](const Slot& slot) {
+        return slot.buffer->orphaned.load(std::memory_order_acquire);
+    }), slots.list.end());
+
+    auto buffer = std::make_shared<ThreadBuffer>(m_bufferSize.load(std::memory_order_relaxed));
+    buffer->tid = currentThreadId();
+    {
+        std::lock_guard<std::mutex> lock(m_buffersMutex);
+        m_buffers.push_back(buffer);
+    }
+    slots.list.push_back(Slot{m_id, buffer});
+    return buffer.get();
+}
+
+bool SecureLog::log(std::string_view message) {
+    if (!m_open.load(std::memory_order_acquire)) {
+        return false;
+    }
+    ThreadBuffer* buffer = threadBuffer();
+    uint32_t length = static_cast<uint32_t>(std::min(message.size(), MAX_MESSAGE));
+    uint64_t needed = RECORD_HEADER + length;
+    uint64_t head = buffer->head.load(std::memory_order_relaxed);
+    if (head + needed - buffer->cachedTail > buffer->capacity) {
+        buffer->cachedTail = buffer->tail.load(std::memory_order_acquire);
+        if (head + needed - buffer->cachedTail > buffer->capacity) {
+            buffer->dropped.fetch_add(1, std::memory_order_relaxed);
+            return false;
+        }
+    }
+    unsigned char header[RECORD_HEADER];
+    uint64_t timestamp = wallClockNs();
+    std::memcpy(header, &length, 4);
+    std::memcpy(header + 4, &timestamp, 8);
+    buffer->write(head, header, RECORD_HEADER);
+    buffer->write(head + RECORD_HEADER, message.data(), length);
+    buffer->head.store(head + needed, std::memory_order_release);
+    return true;
+}
+
+void SecureLog::setFlushInterval(Interval interval) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_flushInterval = std::max(interval, Interval(1));
+    m_wakeCondition.notify_all();
+}
+
+void SecureLog::setSyncInterval(Interval interval) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_syncInterval = interval;
+}
+
+void SecureLog::setThreadBuffer(size_t bytes) {
+    m_bufferSize.store(roundUpPow2(std::max(bytes, RECORD_HEADER + MAX_MESSAGE)), std::memory_order_relaxed);
+}
+
+bool SecureLog::resumeChain(int fd) {
+#ifdef _WIN32
+    (void)fd;
+#endif
+    m_sequence = 0;
+    std::memset(m_chain, 0, sizeof(m_chain));
+    std::FILE* file = std::fopen(m_path.c_str(), "rb");
+    if (!file) {
+        return true; //файла еще нет
+    }
+    std::fseek(file, 0, SEEK_END);
+    long size = std::ftell(file);
+    size_t scan = std::min<size_t>(static_cast<size_t>(std::max(size, 0L)), TAIL_SCAN);
+    std::string tail(scan, '\0');
+    std::fseek(file, size - static_cast<long>(scan), SEEK_SET);
+    bool read = std::fread(&tail[0], 1, scan, file) == scan;
+    std::fclose(file);
+    if (!read) {
+        std::cerr << "Cannot read secure log: " << m_path << std::endl;
+        return false;
+    }
+    if (tail.empty()) {
+        return true;
+    }
+
+    //Недописанная последняя строка (сбой во время записи) отрезается
+    size_t lastNewline = tail.rfind('\n');
+    if (lastNewline != tail.size() - 1) {
+        size_t keep = lastNewline == std::string::npos ? 0 : lastNewline + 1;
+        if (keep == 0 && static_cast<size_t>(size) > scan) {
+            std::cerr << "Secure log has no line end in the last " << TAIL_SCAN << " bytes: " << m_path << std::endl;
+            return false;
+        }
+        long newSize = size - static_cast<long>(scan - keep);
+#ifdef _WIN32
+        bool truncated = _chsize_s(_fileno(m_file), newSize) == 0;
+#else
+        bool truncated = ::ftruncate(fd, newSize) == 0;
+#endif
+        if (!truncated) {
+            std::cerr << "Cannot truncate incomplete secure log entry: " << m_path << std::endl;
+            return false;
+        }
+        m_note = "secure log: removed " + std::to_string(scan - keep) + " bytes of an incomplete entry";
+        tail.resize(keep);
+        if (tail.empty()) {
+            return true;
+        }
+    }
+    size_t lineBegin = tail.rfind('\n', tail.size() - 2);
+    lineBegin = lineBegin == std::string::npos ? 0 : lineBegin + 1;
+    if (lineBegin == 0 && static_cast<size_t>(size) > scan) {
+        std::cerr << "Secure log line is too long: " << m_path << std::endl;
+        return false;
+    }
+    ParsedLine parsed;
+    if (!parseLine(std::string_view(tail).substr(lineBegin, tail.size() - 1 - lineBegin), parsed) ||
+        !parseHex(parsed.hash, m_chain)) {
+        std::cerr << "Not a secure log: " << m_path << std::endl;
+        return false;
+    }
+    m_sequence = parsed.sequence;
+    return true;
+}
+
+bool SecureLog::open(const std::string& path) {
+    close();
+    m_path = path;
+    m_note.clear();
+#ifdef _WIN32
+    m_file = std::fopen(path.c_str(), "ab");
+    if (!m_file) {
+        std::cerr << "Cannot open secure log: " << path << std::endl;
+        return false;
+    }
+    int fd = -1;
+#else
+    int fd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0600);
+    if (fd < 0) {
+        std::cerr << "Cannot open secure log: " << path << ": " << std::strerror(errno) << std::endl;
+        return false;
+    }
+#endif
+    if (!resumeChain(fd)) {
+#ifdef _WIN32
+        std::fclose(m_file);
+        m_file = nullptr;
+#else
+        ::close(fd);
+#endif
+        return false;
+    }
+    m_fd = fd;
+    m_dirty = false;
+    m_lastSync = std::chrono::steady_clock::now();
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stopping = false;
+    }
+    m_open.store(true, std::memory_order_release);
+    m_thread = std::thread(&SecureLog::flushLoop, this);
+    return true;
+}
+
+void SecureLog::close() {
+    if (!m_open.exchange(false)) {
+        return;
+    }
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_stopping = true;
+    }
+    m_wakeCondition.notify_all();
+    if (m_thread.joinable()) {
+        m_thread.join();
+    }
+#ifdef _WIN32
+    std::fclose(m_file);
+    m_file = nullptr;
+#else
+    ::close(m_fd);
+#endif
+    m_fd = -1;
+}
+
+bool SecureLog::flush(Interval timeout) {
+    std::unique_lock<std::mutex> lock(m_mutex);
+    if (!isOpen()) {
+        return false;
+    }
+    uint64_t ticket = ++m_flushRequested;
+    m_wakeCondition.notify_all();
+    return m_doneCondition.wait_for(lock, timeout, [this, ticket] { return m_flushCompleted >= ticket || m_stopping; });
+}
+
+void SecureLog::flushLoop() {
+    std::unique_lock<std::mutex> lock(m_mutex);
+    for (;;) {
+        uint64_t requested = m_flushRequested;
+        bool forced = requested != m_flushCompleted || m_stopping;
+        bool stopping = m_stopping;
+        Interval syncInterval = m_syncInterval;
+        lock.unlock();
+
+        drain();
+        writeBatch();
+        if (m_dirty && (forced || std::chrono::steady_clock::now() - m_lastSync >= syncInterval)) {
+            sync();
+        }
+
+        lock.lock();
+        m_flushCompleted = requested;
+        m_doneCondition.notify_all();
+        if (stopping) {
+            break;
+        }
+        m_wakeCondition.wait_for(lock, m_flushInterval, [this, requested] {
+            return m_stopping || m_flushRequested != requested;
+        });
+    }
+}
+
+void SecureLog::drain() {
+    m_entries.clear();
+    m_text.clear();
+    std::vector<std::shared_ptr<ThreadBuffer>> buffers;
+    {
+        std::lock_guard<std::mutex> lock(m_buffersMutex);
+        buffers = m_buffers;
+    }
+
+    uint64_t lost = 0;
+    bool removeRetired = false;
+    for (const auto& buffer : buffers) {
+        //retired читается до head: все записи завершившегося потока уже видны
+        bool retired = buffer->retired.load(std::memory_order_acquire);
+        uint64_t tail = buffer->tail.load(std::memory_order_relaxed);
+        uint64_t head = buffer->head.load(std::memory_order_acquire);
+        while (tail < head) {
+            unsigned char header[RECORD_HEADER];
+            buffer->read(tail, header, RECORD_HEADER);
+            uint32_t length;
+            Entry entry;
+            std::memcpy(&length, header, 4);
+            std::memcpy(&entry.timestampNs, header + 4, 8);
+            m_raw.resize(length);
+            buffer->read(tail + RECORD_HEADER, &m_raw[0], length);
+            entry.tid = buffer->tid;
+            entry.offset = m_text.size();
+            appendEscaped(m_text, m_raw.data(), length);
+            entry.length = m_text.size() - entry.offset;
+            m_text += '\n';
+            m_entries.push_back(entry);
+            tail += RECORD_HEADER + length;
+        }
+        buffer->tail.store(tail, std::memory_order_release);
+        lost += buffer->dropped.exchange(0, std::memory_order_relaxed);
+        removeRetired = removeRetired || retired;
+    }
+    if (removeRetired) {
+        std::lock_guard<std::mutex> lock(m_buffersMutex);
+        m_buffers.erase(std::remove_if(m_buffers.begin(), m_buffers.end(), [](const std::shared_ptr<ThreadBuffer>& buffer) {
+            return buffer->retired.load(std::memory_order_acquire) &&
+                   buffer->tail.load(std::memory_order_relaxed) == buffer->head.load(std::memory_order_acquire);
+        }), m_buffers.end());
+    }
+
+    //Потери тоже попадают в цепочку: пропуск в журнале виден
+    if (lost > 0) {
+        m_droppedTotal.fetch_add(lost, std::memory_order_relaxed);
+        droppedEntries.add(lost);
+        if (!m_note.empty()) {
+            m_note += "; ";
+        }
+        m_note += "secure log: " + std::to_string(lost) + " entries dropped (thread buffer full)";
+    }
+    if (!m_note.empty()) {
+        Entry entry;
+        entry.timestampNs = wallClockNs();
+        entry.tid = 0;
+        entry.offset = m_text.size();
+        appendEscaped(m_text, m_note.data(), m_note.size());
+        entry.length = m_text.size() - entry.offset;
+        m_text += '\n';
+        m_entries.push_back(entry);
+        m_note.clear();
+    }
+
+    std::stable_sort(m_entries.begin(), m_entries.end(), [](const Entry& a, const Entry& b) {
+        return a.timestampNs < b.timestampNs;
+    });
+}
+
+void SecureLog::writeBatch() {
+    if (m_entries.empty()) {
+        return;
+    }
+    //Номера и цепочка пачки - во временных: журнал сдвигается только после успешной записи
+    uint64_t sequence = m_sequence;
+    unsigned char chain[sizeof(m_chain)];
+    std::memcpy(chain, m_chain, sizeof(chain));
+    //Префиксы строк с хешами: "<seq> <время> <tid> <hash> "
+    m_prefixes.clear();
+    m_prefixEnds.clear();
+    for (const Entry& entry : m_entries) {
+        size_t begin = m_prefixes.size();
+        appendNumber(m_prefixes, ++sequence);
+        m_prefixes += ' ';
+        appendTime(m_prefixes, entry.timestampNs);
+        m_prefixes += ' ';
+        appendNumber(m_prefixes, entry.tid);
+        m_prefixes += ' ';
+        chainHash(chain, std::string_view(m_prefixes).substr(begin),
+                  std::string_view(m_text).substr(entry.offset, entry.length));
+        size_t hashBegin = m_prefixes.size();
+        m_prefixes.resize(hashBegin + HASH_HEX);
+        toHex(chain, sizeof(chain), &m_prefixes[hashBegin]);
+        m_prefixes += ' ';
+        m_prefixEnds.push_back(m_prefixes.size());
+    }
+
+#ifdef _WIN32
+    long before = std::ftell(m_file);
+    size_t begin = 0;
+    bool ok = before >= 0;
+    for (size_t i = 0; i < m_entries.size(); ++i) {
+        ok = ok && std::fwrite(m_prefixes.data() + begin, 1, m_prefixEnds[i] - begin, m_file) == m_prefixEnds[i] - begin &&
+             std::fwrite(m_text.data() + m_entries[i].offset, 1, m_entries[i].length + 1, m_file) == m_entries[i].length + 1;
+        begin = m_prefixEnds[i];
+    }
+    ok = ok && std::fflush(m_file) == 0;
+    bool restored = ok || (before >= 0 && _chsize_s(_fileno(m_file), before) == 0);
+#else
+    //Две части на строку: префикс и сообщение с '\n' - без склейки в один буфер
+    std::vector<iovec> iov(m_entries.size() * 2);
+    size_t begin = 0;
+    for (size_t i = 0; i < m_entries.size(); ++i) {
+        iov[i * 2].iov_base = &m_prefixes[begin];
+        iov[i * 2].iov_len = m_prefixEnds[i] - begin;
+        iov[i * 2 + 1].iov_base = &m_text[m_entries[i].offset];
+        iov[i * 2 + 1].iov_len = m_entries[i].length + 1;
+        begin = m_prefixEnds[i];
+    }
+    struct stat info;
+    bool sized = ::fstat(m_fd, &info) == 0;
+    bool ok = sized && writeAll(m_fd, iov.data(), static_cast<int>(iov.size()));
+    bool restored = ok || (sized && ::ftruncate(m_fd, info.st_size) == 0);
+#endif
+    if (!ok) {
+        //Недописанная часть пачки отрезана - следующая продолжает последнюю целую строку
+        //и первой записью отмечает потерю; не отрезалась - verify() покажет место обрыва
+        std::cerr << "Secure log write failed: " << m_path << (restored ? "" : " (incomplete batch left in file)") << std::endl;
+        m_droppedTotal.fetch_add(m_entries.size(), std::memory_order_relaxed);
+        droppedEntries.add(m_entries.size());
+        if (!m_note.empty()) {
+            m_note += "; ";
+        }
+        m_note += "secure log: " + std::to_string(m_entries.size()) + " entries lost (write failed)";
+        return;
+    }
+    m_sequence = sequence;
+    std::memcpy(m_chain, chain, sizeof(m_chain));
+    m_written.fetch_add(m_entries.size(), std::memory_order_relaxed);
+    loggedEntries.add(m_entries.size());
+    m_dirty = true;
+}
+
+void SecureLog::sync() {
+    MetricTimer timer(syncDuration);
+#ifdef _WIN32
+    _commit(_fileno(m_file));
+#elif defined(__APPLE__)
+    ::fsync(m_fd);
+#else
+    ::fdatasync(m_fd);
+#endif
+    m_dirty = false;
+    m_lastSync = std::chrono::steady_clock::now();
+    m_syncs.fetch_add(1, std::memory_order_relaxed);
+}
+
+bool SecureLog::verify(const std::string& path, uint64_t& lines, std::string& error) {
+    lines = 0;
+    error.clear();
+    std::ifstream file(path, std::ios::binary);
+    if (!file) {
+        error = "cannot open " + path;
+        return false;
+    }
+    unsigned char chain[Sha256::DIGEST_SIZE] = {};
+    char expected[HASH_HEX];
+    std::string line;
+    ParsedLine parsed;
+    while (std::getline(file, line)) {
+        if (file.eof()) {
+            error = "line " + std::to_string(lines + 1) + ": incomplete (no line end)";
+            return false;
+        }
+        if (!parseLine(line, parsed)) {
+            error = "line " + std::to_string(lines + 1) + ": malformed";
+            return false;
+        }
+        if (parsed.sequence != lines + 1) {
+            error = "line " + std::to_string(lines + 1) + ": sequence " + std::to_string(parsed.sequence);
+            return false;
+        }
+        chainHash(chain, parsed.prefix, parsed.message);
+        toHex(chain, sizeof(chain), expected);
+        if (parsed.hash != std::string_view(expected, HASH_HEX)) {
+            error = "line " + std::to_string(lines + 1) + ": hash mismatch";
+            return false;
+        }
+        ++lines;
+    }
+    return true;
+}
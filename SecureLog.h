@@ -0,0 +1,125 @@
+// SecureLog.h
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+/*
+Асинхронный журнал событий безопасности с цепочкой хешей.
+
+log() не берет блокировок и не делает системных вызовов: сообщение
+копируется в кольцевой буфер своего потока (один производитель - этот
+поток, один потребитель - поток сброса). Полный буфер - запись
+отбрасывается и учитывается (dropped()), вызывающий никогда не ждет диск.
+О потерянных записях поток сброса сам пишет строку в журнал.
+
+Поток сброса раз в flushInterval забирает записи всех потоков, в пределах
+пачки упорядочивает их по времени и пишет одним writev; fdatasync -
+не чаще раза в syncInterval (групповая фиксация: одна синхронизация на
+все записи интервала). flush() ждет, пока записанное до него окажется на диске.
+
+Строка файла:
+    <seq> <время UTC> <tid> <hash> <сообщение>
+hash - SHA-256 (hex) от hash предыдущей строки, '\n' и строки без поля hash
+("<seq> <время UTC> <tid> <сообщение>"), у первой строки предыдущий - 64 нуля.
+Перевод строки и '\' в сообщении экранируются. Правка, удаление или
+вставка строки ломает хеши всех следующих (verify()). Открытие
+существующего файла продолжает его цепочку; недописанный хвост
+(сбой во время записи) отрезается с отметкой в журнале.
+*/
+class SecureLog {
+public:
+    typedef std::chrono::milliseconds Interval;
+
+    SecureLog();
+    ~SecureLog();
+
+    SecureLog(const SecureLog&) = delete;
+    SecureLog& operator=(const SecureLog&) = delete;
+
+    bool open(const std::string& path);
+    //Сбрасывает все записи и синхронизирует файл
+    void close();
+    bool isOpen() const { return m_open.load(std::memory_order_acquire); }
+
+    //false - журнал закрыт или буфер потока полон (запись потеряна)
+    bool log(std::string_view message);
+    //Ждет записи и fdatasync всего, что записано до вызова; false - не успели за timeout
+    bool flush(Interval timeout = Interval(5000));
+
+    void setFlushInterval(Interval interval);
+    //0 - синхронизация после каждой пачки
+    void setSyncInterval(Interval interval);
+    //Размер буфера новых потоков (округляется вверх до степени двойки)
+    void setThreadBuffer(size_t bytes);
+
+    uint64_t written() const { return m_written.load(std::memory_order_relaxed); }
+    uint64_t dropped() const { return m_droppedTotal.load(std::memory_order_relaxed); }
+    uint64_t syncs() const { return m_syncs.load(std::memory_order_relaxed); }
+
+    //Проверка цепочки файла; lines - сколько строк верны, error - первая ошибка
+    static bool verify(const std::string& path, uint64_t& lines, std::string& error);
+
+private:
+    struct ThreadBuffer;
+    struct Entry {
+        uint64_t timestampNs;
+        uint32_t tid;
+        size_t offset; //сообщение (уже экранированное) в m_text
+        size_t length;
+    };
+
+    ThreadBuffer* threadBuffer();
+    void flushLoop();
+    //Поток сброса: забрать записи всех буферов, записать и, если пора, синхронизировать
+    void drain();
+    void writeBatch();
+    void sync();
+    bool resumeChain(int fd);
+
+    const uint64_t m_id; //отличает журналы в кеше буферов потока
+    std::atomic<bool> m_open;
+    std::string m_path;
+    int m_fd = -1;
+#ifdef _WIN32
+    std::FILE* m_file = nullptr;
+#endif
+
+    std::mutex m_buffersMutex; //только регистрация потоков и обход буферов
+    std::vector<std::shared_ptr<ThreadBuffer>> m_buffers;
+    std::atomic<size_t> m_bufferSize;
+
+    std::mutex m_mutex;
+    std::condition_variable m_wakeCondition;
+    std::condition_variable m_doneCondition;
+    Interval m_flushInterval{10};
+    Interval m_syncInterval{100};
+    bool m_stopping = false;
+    uint64_t m_flushRequested = 0;
+    uint64_t m_flushCompleted = 0;
+    std::thread m_thread;
+
+    //Только поток сброса
+    std::vector<Entry> m_entries;
+    std::string m_text;
+    std::string m_raw;
+    std::string m_prefixes;
+    std::vector<size_t> m_prefixEnds;
+    std::string m_note; //служебная запись (потери, обрезанный хвост)
+    uint64_t m_sequence = 0;
+    unsigned char m_chain[32];
+    bool m_dirty = false; //записано после последней синхронизации
+    std::chrono::steady_clock::time_point m_lastSync;
+
+    std::atomic<uint64_t> m_written;
+    std::atomic<uint64_t> m_droppedTotal;
+    std::atomic<uint64_t> m_syncs;
+};
@@ -1,12 +1,464 @@
 #include "SecurityUtils.h"
+#include "HashCache.h"
+#include "IntegrityManifest.h"
+#include "Metrics.h"
+#include "RuleEngine.h"
+#include "Sha256.h"
 #include <iostream>
-#include <fstream>
-#include <iomanip>
-#include <sstream>
-#include <wincrypt.h>
 #include <vector>
+#include <thread>
+#include <atomic>
+#include <memory>
 #include <algorithm>
+#include <cstdio>
+#include <mutex>
+#include <unordered_map>
+#ifndef _WIN32
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#endif
 
+namespace {
+
+const size_t READ_BLOCK_SIZE = 1 << 20; //крупные блоки чтения: меньше системных вызовов
+
+HashCache& hashCache() {
+    static HashCache cache;
+    return cache;
+}
+
+//Пропускная способность хеширования = rate(bytes) / rate(файлов)
+MetricCounter hashedBytes("monitor_hash_bytes_total", "Bytes read and hashed");
+MetricCounter hashedFiles("monitor_hash_files_total", "Files hashed (cache misses)");
+MetricCounter hashCacheHits("monitor_hash_cache_hits_total", "Hashes served from the persistent cache");
+MetricCounter hashFailures("monitor_hash_failures_total", "Files that could not be opened or read");
+MetricHistogram hashFileDuration("monitor_hash_file_duration_seconds", "Single file hash (calculateFileHash)");
+MetricHistogram hashBatchDuration("monitor_hash_batch_duration_seconds", "Whole hashFiles batch");
+
+//Ошибки хеширования - в журнал безопасности: вызывающий (пул хеширования, сканы) не ждет консоль
+void logHashFailure(const char* what, const std::string& path) {
+    hashFailures.add();
+    SecurityUtils::secureLog(std::string("hash: ") + what + ": " + path);
+}
+
+//Встроенные правила: действуют, пока не загружен файл (loadSuspiciousRules)
+const char* const DEFAULT_SUSPICIOUS_RULES =
+    "any credential-dumper mimikatz\n"
+    "any credential-dumper lazagne\n"
+    "any miner xmrig\n"
+    "any miner cpuminer\n"
+    "any miner minerd\n"
+    "any remote-shell netcat\n"
+    "any remote-shell psexec\n"
+    "any c2-agent meterpreter\n"
+    "any c2-agent cobaltstrike\n"
+    "any c2-agent beacon.exe\n"
+    "path temp-exec /tmp/\n"
+    "path temp-exec /dev/shm/\n"
+    "path temp-exec \\appdata\\local\\temp\\\n";
+
+std::unique_ptr<RuleEngine> makeRuleEngine() {
+    std::unique_ptr<RuleEngine> engine(new RuleEngine());
+    engine->setRules(RuleSet::compile(DEFAULT_SUSPICIOUS_RULES));
+    return engine;
+}
+
+RuleEngine& ruleEngine() {
+    static std::unique_ptr<RuleEngine> engine = makeRuleEngine();
+    return *engine;
+}
+
+//getProcessOwner ждет фоновое разрешение имени не дольше этого, дальше отдает uid
+const std::chrono::milliseconds OWNER_RESOLVE_TIMEOUT(50);
+
+#ifdef _WIN32
+
+//SID пользователя токена процесса; buffer владеет памятью sid
+bool processUserSid(DWORD pid, std::vector<BYTE>& buffer, PSID& sid) {
+    HANDLE process = OpenProcess(PROCESS_QUERY_LIMITED_INFORMATION, FALSE, pid);
+    if (!process) {
+        return false;
+    }
+    bool ok = false;
+    HANDLE token = NULL;
+    if (OpenProcessToken(process, TOKEN_QUERY, &token)) {
+        DWORD size = 0;
+        GetTokenInformation(token, TokenUser, NULL, 0, &size);
+        if (size > 0) {
+            buffer.resize(size);
+            if (GetTokenInformation(token, TokenUser, buffer.data(), size, &size)) {
+                sid = reinterpret_cast<TOKEN_USER*>(buffer.data())->User.Sid;
+                ok = true;
+            }
+        }
+        CloseHandle(token);
+    }
+    CloseHandle(process);
+    return ok;
+}
+
+#else
+
+//Владелец каталога /proc/<pid> - эффективный uid процесса
+bool processUid(DWORD pid, uint32_t& uid) {
+    char path[32];
+    std::snprintf(path, sizeof(path), "/proc/%u", static_cast<unsigned>(pid));
+    struct stat info;
+    if (::stat(path, &info) != 0) {
+        return false;
+    }
+    uid = static_cast<uint32_t>(info.st_uid);
+    return true;
+}
+
+#endif
+
+/*
+Файл, открытый для хеширования: дескриптор + identity на момент открытия.
+Чтение позиционное (pread / ReadFile с OVERLAPPED), подсказка ядру о
+последовательном доступе.
+*/
+class InputFile {
+public:
+    explicit InputFile(const std::string& path) {
+#ifdef _WIN32
+        m_file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ,
+                             NULL, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+        if (m_file != INVALID_HANDLE_VALUE) {
+            m_haveIdentity = HashCache::identityOf(m_file, m_identity);
+        }
+#else
+        m_fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+        if (m_fd >= 0) {
+            m_haveIdentity = HashCache::identityOf(m_fd, m_identity);
+            ::posix_fadvise(m_fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+        }
+#endif
+    }
+
+    ~InputFile() {
+#ifdef _WIN32
+        if (m_file != INVALID_HANDLE_VALUE) CloseHandle(m_file);
+#else
+        if (m_fd >= 0) ::close(m_fd);
+#endif
+    }
+
+    InputFile(const InputFile&) = delete;
+    InputFile& operator=(const InputFile&) = delete;
+
+    bool isOpen() const {
+#ifdef _WIN32
+        return m_file != INVALID_HANDLE_VALUE;
+#else
+        return m_fd >= 0;
+#endif
+    }
+
+    bool hasIdentity() const { return m_haveIdentity; }
+    const FileIdentity& identity() const { return m_identity; }
+
+    //Файл не менялся с момента открытия
+    bool unchanged() const {
+        FileIdentity now;
+#ifdef _WIN32
+        return m_haveIdentity && HashCache::identityOf(m_file, now) && now == m_identity;
+#else
+        return m_haveIdentity && HashCache::identityOf(m_fd, now) && now == m_identity;
+#endif
+    }
+
+    //Читает до size байт со смещения offset; -1 при ошибке, 0 в конце файла
+    long long readAt(unsigned char* buffer, size_t size, uint64_t offset) {
+        size_t total = 0;
+        while (total < size) {
+#ifdef _WIN32
+            OVERLAPPED position = {};
+            uint64_t at = offset + total;
+            position.Offset = static_cast<DWORD>(at);
+            position.OffsetHigh = static_cast<DWORD>(at >> 32);
+            DWORD bytesRead = 0;
+            if (!ReadFile(m_file, buffer + total, static_cast<DWORD>(size - total), &bytesRead, &position)) {
+                if (GetLastError() == ERROR_HANDLE_EOF) break;
+                return -1;
+            }
+            long long got = bytesRead;
+#else
+            ssize_t got = ::pread(m_fd, buffer + total, size - total, static_cast<off_t>(offset + total));
+            if (got < 0) {
+                return -1;
+            }
+#endif
+            if (got == 0) {
+                break;
+            }
+            total += static_cast<size_t>(got);
+        }
+        return static_cast<long long>(total);
+    }
+
+private:
+#ifdef _WIN32
+    HANDLE m_file = INVALID_HANDLE_VALUE;
+#else
+    int m_fd = -1;
+#endif
+    FileIdentity m_identity;
+    bool m_haveIdentity = false;
+};
+
+//Кешированный хеш, если файл не менялся
+bool lookupCached(const InputFile& file, std::string& hashStr) {
+    unsigned char cached[HashCache::DIGEST_SIZE];
+    if (file.hasIdentity() && hashCache().lookup(file.identity(), cached)) {
+        hashStr = Sha256::toHex(cached, sizeof(cached));
+        hashCacheHits.add();
+        return true;
+    }
+    return false;
+}
+
+//Сохраняем, только если файл не менялся во время чтения
+std::string storeResult(const InputFile& file, const unsigned char digest[Sha256::DIGEST_SIZE]) {
+    hashedFiles.add();
+    if (file.unchanged()) {
+        hashCache().store(file.identity(), digest);
+    }
+    return Sha256::toHex(digest, Sha256::DIGEST_SIZE);
+}
+
+//Однопоточное хеширование целого файла (SHA-NI или скалярное ядро)
+bool hashStream(InputFile& file, std::vector<unsigned char>& buffer, unsigned char digest[Sha256::DIGEST_SIZE]) {
+    Sha256 sha;
+    uint64_t offset = 0;
+    for (;;) {
+        long long got = file.readAt(buffer.data(), buffer.size(), offset);
+        if (got < 0) {
+            return false;
+        }
+        if (got == 0) {
+            break;
+        }
+        sha.update(buffer.data(), static_cast<size_t>(got));
+        offset += static_cast<uint64_t>(got);
+    }
+    hashedBytes.add(offset);
+    sha.finish(digest);
+    return true;
+}
+
+std::string hashPath(const std::string& filePath, std::vector<unsigned char>& buffer) {
+    MetricTimer timer(hashFileDuration);
+    InputFile file(filePath);
+    if (!file.isOpen()) {
+        logHashFailure("cannot open file", filePath);
+        return "";
+    }
+
+    std::string hashStr;
+    if (lookupCached(file, hashStr)) {
+        return hashStr;
+    }
+
+    unsigned char digest[Sha256::DIGEST_SIZE];
+    if (!hashStream(file, buffer, digest)) {
+        logHashFailure("read failed", filePath);
+        return "";
+    }
+    return storeResult(file, digest);
+}
+
+/*
+Многобуферный режим (AVX2): до 8 файлов хешируются одновременно.
+Каждый раунд линия читает READ_BLOCK_SIZE байт; линия, дошедшая до конца
+файла, дописывает padding и после раунда отдает результат, а на ее место
+встает следующий файл из общей очереди.
+*/
+void hashFilesMultiLane(const std::vector<std::string>& paths, std::vector<std::string>& results,
+                        std::atomic<size_t>& next) {
+    struct Lane {
+        size_t index = 0;
+        std::unique_ptr<InputFile> file;
+        uint64_t offset = 0;
+        uint32_t state[8];
+        std::vector<unsigned char> buffer;
+        bool finishing = false;
+    };
+
+    Lane lanes[Sha256::MAX_LANES];
+    for (auto& lane : lanes) {
+        lane.buffer.resize(READ_BLOCK_SIZE + 2 * Sha256::BLOCK_SIZE);
+    }
+
+    for (;;) {
+        //Заполняем свободные линии следующими файлами
+        for (auto& lane : lanes) {
+            while (!lane.file) {
+                size_t index = next.fetch_add(1);
+                if (index >= paths.size()) {
+                    break;
+                }
+                auto file = std::unique_ptr<InputFile>(new InputFile(paths[index]));
+                if (!file->isOpen()) {
+                    logHashFailure("cannot open file", paths[index]);
+                    continue;
+                }
+                if (lookupCached(*file, results[index])) {
+                    continue;
+                }
+                lane.index = index;
+                lane.file = std::move(file);
+                lane.offset = 0;
+                lane.finishing = false;
+                Sha256::initState(lane.state);
+            }
+        }
+
+        uint32_t* states[Sha256::MAX_LANES];
+        const unsigned char* data[Sha256::MAX_LANES];
+        size_t blocks[Sha256::MAX_LANES];
+        Lane* active[Sha256::MAX_LANES];
+        size_t count = 0;
+
+        for (auto& lane : lanes) {
+            if (!lane.file) continue;
+            long long got = lane.file->readAt(lane.buffer.data(), READ_BLOCK_SIZE, lane.offset);
+            if (got < 0) {
+                logHashFailure("read failed", paths[lane.index]);
+                lane.file.reset();
+                continue;
+            }
+            size_t bytes = static_cast<size_t>(got);
+            size_t full = bytes / Sha256::BLOCK_SIZE;
+            lane.offset += bytes;
+            hashedBytes.add(bytes);
+            blocks[count] = full;
+            if (bytes < READ_BLOCK_SIZE) {
+                //Конец файла: хвост + padding сразу за данными
+                blocks[count] += Sha256::padTail(lane.buffer.data() + full * Sha256::BLOCK_SIZE,
+                                                 bytes - full * Sha256::BLOCK_SIZE, lane.offset);
+                lane.finishing = true;
+            }
+            states[count] = lane.state;
+            data[count] = lane.buffer.data();
+            active[count] = &lane;
+            ++count;
+        }
+        if (count == 0) {
+            return;
+        }
+
+        Sha256::compressLanes(states, data, blocks, count);
+
+        for (size_t i = 0; i < count; ++i) {
+            Lane& lane = *active[i];
+            if (lane.finishing) {
+                unsigned char digest[Sha256::DIGEST_SIZE];
+                Sha256::stateToDigest(lane.state, digest);
+                results[lane.index] = storeResult(*lane.file, digest);
+                lane.file.reset();
+            }
+        }
+    }
+}
+
+void hashFilesSingleLane(const std::vector<std::string>& paths, std::vector<std::string>& results,
+                         std::atomic<size_t>& next) {
+    std::vector<unsigned char> buffer(READ_BLOCK_SIZE);
+    for (size_t index = next.fetch_add(1); index < paths.size(); index = next.fetch_add(1)) {
+        results[index] = hashPath(paths[index], buffer);
+    }
+}
+
+} // namespace
+
+bool SecurityUtils::enableHashCache(const std::string& cacheFile) {
+    return hashCache().open(cacheFile);
+}
+
+void SecurityUtils::disableHashCache() {
+    hashCache().close();
+}
+
+bool SecurityUtils::isSuspiciousProcess(const std::string& processName) {
+    std::shared_ptr<const RuleSet> rules = ruleEngine().rules();
+    if (!rules) {
+        return false;
+    }
+    //Передать можно и имя, и полный путь - проверяются правила обоих полей
+    return rules->matchesAny(RuleField::Name, processName) || rules->matchesAny(RuleField::Path, processName);
+}
+
+bool SecurityUtils::loadSuspiciousRules(const std::string& rulesFile) {
+    if (!ruleEngine().load(rulesFile)) {
+        return false;
+    }
+    ruleEngine().startWatching(std::chrono::seconds(5));
+    return true;
+}
+
+RuleEngine& SecurityUtils::suspiciousRules() {
+    return ruleEngine();
+}
+
+UserNameCache& SecurityUtils::userNames() {
+    static UserNameCache cache;
+    return cache;
+}
+
+#ifdef _WIN32
+
+bool SecurityUtils::isSystemProcess(DWORD pid) {
+    if (pid == 0 || pid == 4) {
+        return true; //System Idle Process и System
+    }
+    std::vector<BYTE> buffer;
+    PSID sid = NULL;
+    if (!processUserSid(pid, buffer, sid)) {
+        return false;
+    }
+    return IsWellKnownSid(sid, WinLocalSystemSid) || IsWellKnownSid(sid, WinLocalServiceSid) ||
+           IsWellKnownSid(sid, WinNetworkServiceSid);
+}
+
+std::string SecurityUtils::getProcessOwner(DWORD pid) {
+    std::vector<BYTE> buffer;
+    PSID sid = NULL;
+    if (!processUserSid(pid, buffer, sid)) {
+        return std::string();
+    }
+    char name[256];
+    char domain[256];
+    DWORD nameSize = sizeof(name);
+    DWORD domainSize = sizeof(domain);
+    SID_NAME_USE use;
+    if (!LookupAccountSidA(NULL, sid, name, &nameSize, domain, &domainSize, &use)) {
+        return std::string();
+    }
+    return domainSize > 0 ? std::string(domain) + "\\" + name : std::string(name);
+}
+
+#else
+
+bool SecurityUtils::isSystemProcess(DWORD pid) {
+    uint32_t uid;
+    return processUid(pid, uid) && ProcessOwner::isSystemUid(uid);
+}
+
+std::string SecurityUtils::getProcessOwner(DWORD pid) {
+    uint32_t uid;
+    if (!processUid(pid, uid)) {
+        return std::string();
+    }
+    std::string name;
+    userNames().resolve(UserNameCache::Kind::User, uid, name, OWNER_RESOLVE_TIMEOUT);
+    return name;
+}
+
+#endif
+
+#ifdef _WIN32
 
 bool SecurityUtils::isRunningAsAdmin() {
     BOOL isAdmin = FALSE;
@@ -15,7 +467,7 @@ bool SecurityUtils::isRunningAsAdmin() {
     SID_IDENTIFIER_AUTHORITY ntAuthority = SECURITY_NT_AUTHORITY;
 
     //SID для группвы администраторов
-    if (AllocateAndInitializeSid(&ntAuthority, 2, SECURITY_BUILTIN_DOMAIN_RID, 
+    if (AllocateAndInitializeSid(&ntAuthority, 2, SECURITY_BUILTIN_DOMAIN_RID,
                                 DOMAIN_ALIAS_RID_ADMINS,
                                  0,0,0,0,0,0, &adminGroup)) {
         if(!CheckTokenMembership(NULL, adminGroup, &isAdmin)) {
@@ -26,67 +478,118 @@ bool SecurityUtils::isRunningAsAdmin() {
     return isAdmin == TRUE;
 }
 
+#else
+
+bool SecurityUtils::isRunningAsAdmin() {
+    return ::geteuid() == 0; //root
+}
+
+#endif
+
 std::string SecurityUtils::calculateFileHash(const std::string& filePath) {
-    HCRYPTPROV hProv = 0;
-    HCRYPTHASH hHash = 0;
-    std::string hashStr;
+    //Буфер чтения переиспользуется между вызовами в одном потоке
+    thread_local std::vector<unsigned char> buffer(READ_BLOCK_SIZE);
+    return hashPath(filePath, buffer);
+}
 
-    HANDLE hFile = CreateFileA(filePath.c_str(), GENERIC_READ, FILE_SHARE_READ,
-                              NULL, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+namespace {
+std::mutex manifestMutex;
+std::shared_ptr<const IntegrityManifest> loadedManifest;
+} // namespace
 
-    if (hFile == INVALID_HANDLE_VALUE) {
-        std::cerr << "Cannot open file: " << filePath << std::endl;
-        return "";
+bool SecurityUtils::loadIntegrityManifest(const std::string& manifestFile) {
+    std::shared_ptr<IntegrityManifest> manifest = std::make_shared<IntegrityManifest>();
+    if (!manifest->open(manifestFile)) {
+        return false;
     }
-    if (!CryptAcquireContext (&hProv, NULL, NULL, PROV_RSA_AES, CRYPT_VERIFYCONTEXT)){
-        CloseHandle(hFile);
-        std::cerr << "CryptAcquireContext failed" << std::endl;
-        return "";
+    //Читатели держат свою ссылку: старый манифест закрывается, когда его отпустит последний
+    std::lock_guard<std::mutex> lock(manifestMutex);
+    loadedManifest = manifest;
+    return true;
+}
+
+std::shared_ptr<const IntegrityManifest> SecurityUtils::integrityManifest() {
+    std::lock_guard<std::mutex> lock(manifestMutex);
+    return loadedManifest;
+}
+
+bool SecurityUtils::verifyDigitalSignature(const std::string& filePath) {
+    std::shared_ptr<const IntegrityManifest> manifest = integrityManifest();
+    if (!manifest || !manifest->find(filePath)) {
+        return false; //непроверенный файл не считается подписанным
     }
-    if (!CryptCreateHash (hProv, CALG_SHA_256, 0, 0, &hHash)) {
-        CryptReleaseContext(hProv, 0);
-        CloseHandle(hFile);
-        std::cerr << "CryptCreateHash failed" << std::endl;
-        return "";
+    return manifest->check(filePath, calculateFileHash(filePath)) == IntegrityManifest::Verdict::Match;
+}
+
+std::vector<std::string> SecurityUtils::hashFiles(const std::vector<std::string>& filePaths, size_t threads) {
+    std::vector<std::string> results(filePaths.size());
+    if (filePaths.empty()) {
+        return results;
     }
+    MetricTimer timer(hashBatchDuration);
 
-    const DWORD BUFFER_SIZE = 8192;
-    BYTE buffer[BUFFER_SIZE];
-    DWORD bytesRead = 0;
-    BOOL success = TRUE;
+    if (threads == 0) {
+        threads = std::max(1u, std::thread::hardware_concurrency());
+    }
+    threads = std::min(threads, filePaths.size());
 
-    while ((success = ReadFile (hFile, buffer, BUFFER_SIZE, &bytesRead, NULL))) {
-        if (bytesRead == 0) {
-            break;
-        }
-        if (!CryptHashData (hHash, buffer, bytesRead, 0)) {
-            std::cerr << "CryptHash failed" << std::endl;
-            break;
+    //Общий счетчик - потоки сами берут следующий файл, медленные файлы не тормозят остальных
+    std::atomic<size_t> next{0};
+    bool multiLane = Sha256::activeKernel() == Sha256::Kernel::Avx2;
+    auto worker = [&]() {
+        if (multiLane) {
+            hashFilesMultiLane(filePaths, results, next);
+        } else {
+            hashFilesSingleLane(filePaths, results, next);
         }
+    };
+
+    std::vector<std::thread> pool;
+    for (size_t i = 1; i < threads; ++i) {
+        pool.emplace_back(worker);
     }
-    if (!success) {
-        std::cerr << "ReadFile failed" << std::endl;
-    }
-    else {
-        DWORD hashSize = 0;
-        DWORD hashSizeSize = sizeof(hashSize);
-        if (CryptGetHashParam(hHash, HP_HASHSIZE, (BYTE*)&hashSize, &hashSizeSize,0)) {
-                        std::vector<BYTE> hash(hashSize);
-            if (CryptGetHashParam(hHash, HP_HASHVAL, hash.data(), &hashSize, 0)) {
-                // Конвертируем в hex-строку
-                std::stringstream ss;
-                for (DWORD i = 0; i < hashSize; i++) {
-                    ss << std::hex << std::setw(2) << std::setfill('0') << (int)hash[i];
-                }
-                hashStr = ss.str();
-            }
-        }
+    worker(); //текущий поток тоже работает
+    for (auto& thread : pool) {
+        thread.join();
     }
+    return results;
+}
 
-    // Очищаем ресурсы
-    if (hHash) CryptDestroyHash(hHash);
-    if (hProv) CryptReleaseContext(hProv, 0);
-    if (hFile != INVALID_HANDLE_VALUE) CloseHandle(hFile);
+namespace {
+
+std::string& defaultLogFile() {
+    static std::string file = "security.log";
+    return file;
+}
+
+} // namespace
+
+void SecurityUtils::setDefaultLogFile(const std::string& logFile) {
+    defaultLogFile() = logFile;
+}
+
+SecureLog& SecurityUtils::securityLog(const std::string& logFile) {
+    //Журналы живут до конца процесса: деструкторы статиков сбрасывают их на диск
+    static std::mutex mutex;
+    static std::unordered_map<std::string, std::unique_ptr<SecureLog>> logs;
+    //Почти всегда пишут в один файл - без блокировки, если он тот же, что в прошлый раз
+    thread_local std::string lastFile;
+    thread_local SecureLog* lastLog = nullptr;
+    if (lastLog && lastFile == logFile) {
+        return *lastLog;
+    }
+    std::lock_guard<std::mutex> lock(mutex);
+    const std::string& file = logFile.empty() ? defaultLogFile() : logFile;
+    std::unique_ptr<SecureLog>& log = logs[file];
+    if (!log) {
+        log.reset(new SecureLog());
+        log->open(file);
+    }
+    lastFile = logFile;
+    lastLog = log.get();
+    return *log;
+}
 
-    return hashStr;
+void SecurityUtils::secureLog(const std::string& message, const std::string& logFile) {
+    securityLog(logFile).log(message);
 }
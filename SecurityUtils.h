@@ -1,35 +1,63 @@
 #pragma once
+#include <memory>
 #include <string>
-#include <windows.h>
+#include <vector>
+#include "Platform.h"
+#include "RuleEngine.h"
+#include "ProcessOwner.h"
+#include "SecureLog.h"
+
+class IntegrityManifest;
 
 class SecurityUtils {
     public:
     // 1. Проверка прав администратора
     static bool isRunningAsAdmin();
 
-    /* 2. Проверка цифровой подписи файла
+    // 2. Проверка исполняемого файла по манифесту эталонных хешей (IntegrityManifest.h):
+    // Authenticode на Linux нет, поэтому SHA-256 файла сверяется с манифестом из сборок пакетов.
+    // false - манифест не загружен, файла в нем нет или хеш не совпал
     static bool verifyDigitalSignature(const std::string& filePath);
-    */
+    // Манифест для verifyDigitalSignature и проверки процессов; заменяет прежний
+    static bool loadIntegrityManifest(const std::string& manifestFile);
+    static std::shared_ptr<const IntegrityManifest> integrityManifest(); //nullptr - не загружен
     
-    /* 3. Проверка системного процесса
+    // 3. Проверка системного процесса: Linux - uid системной учетной записи (без NSS),
+    // Windows - LocalSystem, LocalService или NetworkService
     static bool isSystemProcess(DWORD pid);
-    */
 
-    /* 4. Проверка подозрительных процессов
+    // 4. Проверка подозрительных процессов: имя или путь против набора правил
+    // (по умолчанию - встроенный список известных инструментов, см. RuleEngine.h)
     static bool isSuspiciousProcess(const std::string& processName);
-    */
+    // Правила из файла вместо встроенных; файл перечитывается при изменении
+    static bool loadSuspiciousRules(const std::string& rulesFile);
+    static RuleEngine& suspiciousRules();
     
     // 5. Вычисление хеша файла (SHA-256)
     static std::string calculateFileHash(const std::string& filePath);
+
+    // Пакетное хеширование: файлы распределяются по пулу потоков, результат в том же порядке
+    // (пустая строка - файл не прочитан). threads = 0 - по числу ядер
+    static std::vector<std::string> hashFiles(const std::vector<std::string>& filePaths, size_t threads = 0);
+
+    // Постоянный кеш хешей: неизменившиеся файлы (inode, размер, mtime, ctime) не перечитываются
+    static bool enableHashCache(const std::string& cacheFile = "hash_cache.bin");
+    static void disableHashCache();
+    // 6. Безопасное логирование: асинхронно, с цепочкой хешей (см. SecureLog.h).
+    // Вызов не ждет диск; журнал открывается при первой записи в него.
+    // Пустое имя - журнал по умолчанию (security.log); в него же пишутся ошибки хеширования
+    static void secureLog(const std::string& message, const std::string& logFile = "");
+    static SecureLog& securityLog(const std::string& logFile = "");
+    // Файл журнала по умолчанию; вызывать до первой записи в него
+    static void setDefaultLogFile(const std::string& logFile);
 /*
-    // 4. Безопасное логирование
-    static void secureLog(const std::string& message, const std::string& logFile = "security.log");
-    
     // 6. Проверка целостности пути
     static bool validatePath(const std::string& path);
-    
-    // 7. Получение информации о владельце процесса
+*/
+
+    // 7. Владелец процесса: имя пользователя, пока имя не разрешено (или его нет) - uid числом;
+    // пустая строка - процесса нет. Имена кешируются и разрешаются в фоне (UserNameCache)
     static std::string getProcessOwner(DWORD pid);
-*/    
+    static UserNameCache& userNames();
 
 };
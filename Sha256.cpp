@@ -0,0 +1,541 @@
+#include "Sha256.h"
+#include <atomic>
+#include <cstring>
+#include <algorithm>
+
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_X64) || defined(_M_IX86)
+#define SHA256_X86 1
+#include <immintrin.h>
+#if defined(_MSC_VER) && !defined(__clang__)
+#include <intrin.h>
+#define SHA256_TARGET(x)
+#else
+#include <cpuid.h>
+#define SHA256_TARGET(x) __attribute__((target(x)))
+#endif
+#endif
+
+namespace {
+
+const uint32_t K[64] = {
+    0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5, 0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+    0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3, 0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+    0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc, 0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+    0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7, 0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+    0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13, 0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+    0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3, 0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+    0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5, 0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+    0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208, 0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2
+};
+
+const uint32_t INITIAL_STATE[8] = {
+    0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a, 0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19
+};
+
+inline uint32_t rotr(uint32_t x, int n) { return (x >> n) | (x << (32 - n)); }
+
+inline uint32_t loadBigEndian(const unsigned char* p) {
+    return (static_cast<uint32_t>(p[0]) << 24) | (static_cast<uint32_t>(p[1]) << 16)
+         | (static_cast<uint32_t>(p[2]) << 8) | static_cast<uint32_t>(p[3]);
+}
+
+// ---------- Scalar ----------
+
+void compressScalar(uint32_t state[8], const unsigned char* data, size_t blocks) {
+    uint32_t w[16];
+    for (; blocks > 0; --blocks, data += Sha256::BLOCK_SIZE) {
+        uint32_t a = state[0], b = state[1], c = state[2], d = state[3];
+        uint32_t e = state[4], f = state[5], g = state[6], h = state[7];
+
+        for (int t = 0; t < 64; ++t) {
+            uint32_t word;
+            if (t < 16) {
+                word = w[t] = loadBigEndian(data + t * 4);
+            } else {
+                uint32_t w15 = w[(t - 15) & 15];
+                uint32_t w2 = w[(t - 2) & 15];
+                uint32_t s0 = rotr(w15, 7) ^ rotr(w15, 18) ^ (w15 >> 3);
+                uint32_t s1 = rotr(w2, 17) ^ rotr(w2, 19) ^ (w2 >> 10);
+                word = w[t & 15] = w[t & 15] + s0 + w[(t - 7) & 15] + s1;
+            }
+            uint32_t t1 = h + (rotr(e, 6) ^ rotr(e, 11) ^ rotr(e, 25)) + ((e & f) ^ (~e & g)) + K[t] + word;
+            uint32_t t2 = (rotr(a, 2) ^ rotr(a, 13) ^ rotr(a, 22)) + ((a & b) ^ (a & c) ^ (b & c));
+            h = g; g = f; f = e; e = d + t1;
+            d = c; c = b; b = a; a = t1 + t2;
+        }
+
+        state[0] += a; state[1] += b; state[2] += c; state[3] += d;
+        state[4] += e; state[5] += f; state[6] += g; state[7] += h;
+    }
+}
+
+#ifdef SHA256_X86
+
+// ---------- SHA-NI ----------
+
+/*
+Четыре раунда SHA-NI. G - номер четверки раундов (0..15),
+cur/prev/next - векторы расписания сообщений M[G%4], M[(G+3)%4], M[(G+1)%4]
+*/
+template<int G>
+SHA256_TARGET("sha,sse4.1,ssse3")
+inline void shaNiQuad(__m128i& state0, __m128i& state1, __m128i& cur, __m128i& prev, __m128i& next) {
+    __m128i msg = _mm_add_epi32(cur, _mm_loadu_si128(reinterpret_cast<const __m128i*>(&K[G * 4])));
+    state1 = _mm_sha256rnds2_epu32(state1, state0, msg);
+    if (G >= 3 && G < 15) {
+        next = _mm_add_epi32(next, _mm_alignr_epi8(cur, prev, 4));
+        next = _mm_sha256msg2_epu32(next, cur);
+    }
+    msg = _mm_shuffle_epi32(msg, 0x0E);
+    state0 = _mm_sha256rnds2_epu32(state0, state1, msg);
+    if (G >= 1 && G <= 12) {
+        prev = _mm_sha256msg1_epu32(prev, cur);
+    }
+}
+
+SHA256_TARGET("sha,sse4.1,ssse3")
+void compressShaNi(uint32_t state[8], const unsigned char* data, size_t blocks) {
+    const __m128i mask = _mm_set_epi64x(0x0c0d0e0f08090a0bULL, 0x0405060700010203ULL);
+
+    //Состояние в порядке ABEF/CDGH, как его ждут инструкции
+    __m128i tmp = _mm_shuffle_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(&state[0])), 0xB1);
+    __m128i state1 = _mm_shuffle_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(&state[4])), 0x1B);
+    __m128i state0 = _mm_alignr_epi8(tmp, state1, 8);
+    state1 = _mm_blend_epi16(state1, tmp, 0xF0);
+
+    for (; blocks > 0; --blocks, data += Sha256::BLOCK_SIZE) {
+        __m128i saveAbef = state0;
+        __m128i saveCdgh = state1;
+
+        __m128i m0 = _mm_shuffle_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(data)), mask);
+        __m128i m1 = _mm_shuffle_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(data + 16)), mask);
+        __m128i m2 = _mm_shuffle_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(data + 32)), mask);
+        __m128i m3 = _mm_shuffle_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(data + 48)), mask);
+
+        shaNiQuad<0>(state0, state1, m0, m3, m1);
+        shaNiQuad<1>(state0, state1, m1, m0, m2);
+        shaNiQuad<2>(state0, state1, m2, m1, m3);
+        shaNiQuad<3>(state0, state1, m3, m2, m0);
+        shaNiQuad<4>(state0, state1, m0, m3, m1);
+        shaNiQuad<5>(state0, state1, m1, m0, m2);
+        shaNiQuad<6>(state0, state1, m2, m1, m3);
+        shaNiQuad<7>(state0, state1, m3, m2, m0);
+        shaNiQuad<8>(state0, state1, m0, m3, m1);
+        shaNiQuad<9>(state0, state1, m1, m0, m2);
+        shaNiQuad<10>(state0, state1, m2, m1, m3);
+        shaNiQuad<11>(state0, state1, m3, m2, m0);
+        shaNiQuad<12>(state0, state1, m0, m3, m1);
+        shaNiQuad<13>(state0, state1, m1, m0, m2);
+        shaNiQuad<14>(state0, state1, m2, m1, m3);
+        shaNiQuad<15>(state0, state1, m3, m2, m0);
+
+        state0 = _mm_add_epi32(state0, saveAbef);
+        state1 = _mm_add_epi32(state1, saveCdgh);
+    }
+
+    //Обратно в порядок ABCDEFGH
+    tmp = _mm_shuffle_epi32(state0, 0x1B);
+    state1 = _mm_shuffle_epi32(state1, 0xB1);
+    state0 = _mm_blend_epi16(tmp, state1, 0xF0);
+    state1 = _mm_alignr_epi8(state1, tmp, 8);
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(&state[0]), state0);
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(&state[4]), state1);
+}
+
+// ---------- AVX2, 8 линий ----------
+
+SHA256_TARGET("avx2")
+inline __m256i rotr8(__m256i x, int n) {
+    return _mm256_or_si256(_mm256_srli_epi32(x, n), _mm256_slli_epi32(x, 32 - n));
+}
+
+//Транспонирование 8x8 32-битных слов: строка - линия, столбец - номер слова
+SHA256_TARGET("avx2")
+inline void transpose8(__m256i r[8]) {
+    __m256i t0 = _mm256_unpacklo_epi32(r[0], r[1]);
+    __m256i t1 = _mm256_unpackhi_epi32(r[0], r[1]);
+    __m256i t2 = _mm256_unpacklo_epi32(r[2], r[3]);
+    __m256i t3 = _mm256_unpackhi_epi32(r[2], r[3]);
+    __m256i t4 = _mm256_unpacklo_epi32(r[4], r[5]);
+    __m256i t5 = _mm256_unpackhi_epi32(r[4], r[5]);
+    __m256i t6 = _mm256_unpacklo_epi32(r[6], r[7]);
+    __m256i t7 = _mm256_unpackhi_epi32(r[6], r[7]);
+
+    __m256i u0 = _mm256_unpacklo_epi64(t0, t2);
+    __m256i u1 = _mm256_unpackhi_epi64(t0, t2);
+    __m256i u2 = _mm256_unpacklo_epi64(t1, t3);
+    __m256i u3 = _mm256_unpackhi_epi64(t1, t3);
+    __m256i u4 = _mm256_unpacklo_epi64(t4, t6);
+    __m256i u5 = _mm256_unpackhi_epi64(t4, t6);
+    __m256i u6 = _mm256_unpacklo_epi64(t5, t7);
+    __m256i u7 = _mm256_unpackhi_epi64(t5, t7);
+
+    r[0] = _mm256_permute2x128_si256(u0, u4, 0x20);
+    r[1] = _mm256_permute2x128_si256(u1, u5, 0x20);
+    r[2] = _mm256_permute2x128_si256(u2, u6, 0x20);
+    r[3] = _mm256_permute2x128_si256(u3, u7, 0x20);
+    r[4] = _mm256_permute2x128_si256(u0, u4, 0x31);
+    r[5] = _mm256_permute2x128_si256(u1, u5, 0x31);
+    r[6] = _mm256_permute2x128_si256(u2, u6, 0x31);
+    r[7] = _mm256_permute2x128_si256(u3, u7, 0x31);
+}
+
+SHA256_TARGET("avx2")
+void compressAvx2x8(uint32_t* const states[8], const unsigned char* const data[8], size_t blocks) {
+    const __m256i byteSwap = _mm256_set_epi8(
+        12, 13, 14, 15, 8, 9, 10, 11, 4, 5, 6, 7, 0, 1, 2, 3,
+        12, 13, 14, 15, 8, 9, 10, 11, 4, 5, 6, 7, 0, 1, 2, 3);
+
+    //s[j] - j-е слово состояния всех 8 линий
+    __m256i s[8];
+    for (int j = 0; j < 8; ++j) {
+        s[j] = _mm256_set_epi32(static_cast<int>(states[7][j]), static_cast<int>(states[6][j]),
+                                static_cast<int>(states[5][j]), static_cast<int>(states[4][j]),
+                                static_cast<int>(states[3][j]), static_cast<int>(states[2][j]),
+                                static_cast<int>(states[1][j]), static_cast<int>(states[0][j]));
+    }
+
+    __m256i w[16];
+    for (size_t block = 0; block < blocks; ++block) {
+        size_t offset = block * Sha256::BLOCK_SIZE;
+        for (int half = 0; half < 2; ++half) {
+            for (int lane = 0; lane < 8; ++lane) {
+                w[half * 8 + lane] = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(data[lane] + offset + half * 32));
+            }
+            transpose8(&w[half * 8]);
+            for (int i = 0; i < 8; ++i) {
+                w[half * 8 + i] = _mm256_shuffle_epi8(w[half * 8 + i], byteSwap);
+            }
+        }
+
+        __m256i a = s[0], b = s[1], c = s[2], d = s[3];
+        __m256i e = s[4], f = s[5], g = s[6], h = s[7];
+
+        for (int t = 0; t < 64; ++t) {
+            if (t >= 16) {
+                __m256i w15 = w[(t - 15) & 15];
+                __m256i w2 = w[(t - 2) & 15];
+                __m256i s0 = _mm256_xor_si256(_mm256_xor_si256(rotr8(w15, 7), rotr8(w15, 18)), _mm256_srli_epi32(w15, 3));
+                __m256i s1 = _mm256_xor_si256(_mm256_xor_si256(rotr8(w2, 17), rotr8(w2, 19)), _mm256_srli_epi32(w2, 10));
+                w[t & 15] = _mm256_add_epi32(_mm256_add_epi32(w[t & 15], s0), _mm256_add_epi32(w[(t - 7) & 15], s1));
+            }
+            __m256i sigma1 = _mm256_xor_si256(_mm256_xor_si256(rotr8(e, 6), rotr8(e, 11)), rotr8(e, 25));
+            __m256i ch = _mm256_xor_si256(_mm256_and_si256(e, f), _mm256_andnot_si256(e, g));
+            __m256i t1 = _mm256_add_epi32(_mm256_add_epi32(h, sigma1),
+                         _mm256_add_epi32(_mm256_add_epi32(ch, _mm256_set1_epi32(static_cast<int>(K[t]))), w[t & 15]));
+            __m256i sigma0 = _mm256_xor_si256(_mm256_xor_si256(rotr8(a, 2), rotr8(a, 13)), rotr8(a, 22));
+            __m256i maj = _mm256_xor_si256(_mm256_xor_si256(_mm256_and_si256(a, b), _mm256_and_si256(a, c)), _mm256_and_si256(b, c));
+            __m256i t2 = _mm256_add_epi32(sigma0, maj);
+            h = g; g = f; f = e; e = _mm256_add_epi32(d, t1);
+            d = c; c = b; b = a; a = _mm256_add_epi32(t1, t2);
+        }
+
+        s[0] = _mm256_add_epi32(s[0], a); s[1] = _mm256_add_epi32(s[1], b);
+        s[2] = _mm256_add_epi32(s[2], c); s[3] = _mm256_add_epi32(s[3], d);
+        s[4] = _mm256_add_epi32(s[4], e); s[5] = _mm256_add_epi32(s[5], f);
+        s[6] = _mm256_add_epi32(s[6], g); s[7] = _mm256_add_epi32(s[7], h);
+    }
+
+    alignas(32) uint32_t lanes[8];
+    for (int j = 0; j < 8; ++j) {
+        _mm256_store_si256(reinterpret_cast<__m256i*>(lanes), s[j]);
+        for (int lane = 0; lane < 8; ++lane) {
+            states[lane][j] = lanes[lane];
+        }
+    }
+}
+
+void cpuid(uint32_t leaf, uint32_t subleaf, uint32_t regs[4]) {
+#if defined(_MSC_VER) && !defined(__clang__)
+    int info[4];
+    __cpuidex(info, static_cast<int>(leaf), static_cast<int>(subleaf));
+    for (int i = 0; i < 4; ++i) regs[i] = static_cast<uint32_t>(info[i]);
+#else
+    if (!__get_cpuid_count(leaf, subleaf, &regs[0], &regs[1], &regs[2], &regs[3])) {
+        regs[0] = regs[1] = regs[2] = regs[3] = 0;
+    }
+#endif
+}
+
+//ОС сохраняет регистры AVX при переключении контекста
+bool osSupportsAvx() {
+    uint32_t regs[4];
+    cpuid(1, 0, regs);
+    if (!(regs[2] & (1u << 27))) { //OSXSAVE
+        return false;
+    }
+#if defined(_MSC_VER) && !defined(__clang__)
+    unsigned long long xcr0 = _xgetbv(0);
+#else
+    uint32_t lo, hi;
+    __asm__ volatile("xgetbv" : "=a"(lo), "=d"(hi) : "c"(0));
+    unsigned long long xcr0 = (static_cast<unsigned long long>(hi) << 32) | lo;
+#endif
+    return (xcr0 & 6) == 6;
+}
+
+bool cpuHasShaNi() {
+    uint32_t regs[4];
+    cpuid(0, 0, regs);
+    if (regs[0] < 7) return false;
+    cpuid(1, 0, regs);
+    bool sse41 = regs[2] & (1u << 19);
+    bool ssse3 = regs[2] & (1u << 9);
+    cpuid(7, 0, regs);
+    return sse41 && ssse3 && (regs[1] & (1u << 29));
+}
+
+bool cpuHasAvx2() {
+    uint32_t regs[4];
+    cpuid(0, 0, regs);
+    if (regs[0] < 7) return false;
+    cpuid(7, 0, regs);
+    return (regs[1] & (1u << 5)) && osSupportsAvx();
+}
+
+#endif // SHA256_X86
+
+int detectKernel() {
+#ifdef SHA256_X86
+    if (cpuHasShaNi()) return static_cast<int>(Sha256::Kernel::ShaNi);
+    if (cpuHasAvx2()) return static_cast<int>(Sha256::Kernel::Avx2);
+#endif
+    return static_cast<int>(Sha256::Kernel::Scalar);
+}
+
+std::atomic<int>& kernelSlot() {
+    static std::atomic<int> kernel{detectKernel()};
+    return kernel;
+}
+
+//Одиночный поток: ShaNi, если выбран, иначе переносимая версия
+void compressSingle(uint32_t state[8], const unsigned char* data, size_t blocks) {
+#ifdef SHA256_X86
+    if (kernelSlot().load(std::memory_order_relaxed) == static_cast<int>(Sha256::Kernel::ShaNi)) {
+        compressShaNi(state, data, blocks);
+        return;
+    }
+#endif
+    compressScalar(state, data, blocks);
+}
+
+} // namespace
+
+Sha256::Sha256() {
+    reset();
+}
+
+void Sha256::reset() {
+    initState(m_state);
+    m_buffered = 0;
+    m_length = 0;
+}
+
+void Sha256::update(const void* data, size_t size) {
+    const unsigned char* p = static_cast<const unsigned char*>(data);
+    m_length += size;
+
+    if (m_buffered > 0) {
+        size_t take = std::min(size, BLOCK_SIZE - m_buffered);
+        std::memcpy(m_buffer + m_buffered, p, take);
+        m_buffered += take;
+        p += take;
+        size -= take;
+        if (m_buffered < BLOCK_SIZE) {
+            return;
+        }
+        compressSingle(m_state, m_buffer, 1);
+        m_buffered = 0;
+    }
+
+    //Целые блоки - напрямую из буфера вызывающего
+    size_t blocks = size / BLOCK_SIZE;
+    if (blocks > 0) {
+        compressSingle(m_state, p, blocks);
+        p += blocks * BLOCK_SIZE;
+        size -= blocks * BLOCK_SIZE;
+    }
+    if (size > 0) {
+        std::memcpy(m_buffer, p, size);
+        m_buffered = size;
+    }
+}
+
+void Sha256::finish(unsigned char digest[DIGEST_SIZE]) {
+    unsigned char tail[BLOCK_SIZE * 2];
+    std::memcpy(tail, m_buffer, m_buffered);
+    size_t blocks = padTail(tail, m_buffered, m_length);
+    compressSingle(m_state, tail, blocks);
+    stateToDigest(m_state, digest);
+    reset();
+}
+
+void Sha256::hash(const void* data, size_t size, unsigned char digest[DIGEST_SIZE]) {
+    Sha256 sha;
+    sha.update(data, size);
+    sha.finish(digest);
+}
+
+std::string Sha256::toHex(const unsigned char* data, size_t size) {
+    static const char digits[] = "0123456789abcdef";
+    std::string hex(size * 2, '0');
+    for (size_t i = 0; i < size; i++) {
+        hex[i * 2] = digits[data[i] >> 4];
+        hex[i * 2 + 1] = digits[data[i] & 0x0F];
+    }
+    return hex;
+}
+
+bool Sha256::isSupported(Kernel kernel) {
+    switch (kernel) {
+    case Kernel::Scalar:
+        return true;
+#ifdef SHA256_X86
+    case Kernel::ShaNi:
+        return cpuHasShaNi();
+    case Kernel::Avx2:
+        return cpuHasAvx2();
+#endif
+    default:
+        return false;
+    }
+}
+
+Sha256::Kernel Sha256::activeKernel() {
+    return static_cast<Kernel>(kernelSlot().load(std::memory_order_relaxed));
+}
+
+void Sha256::setKernel(Kernel kernel) {
+    if (isSupported(kernel)) {
+        kernelSlot().store(static_cast<int>(kernel), std::memory_order_relaxed);
+    }
+}
+
+const char* Sha256::kernelName(Kernel kernel) {
+    switch (kernel) {
+    case Kernel::ShaNi: return "sha-ni";
+    case Kernel::Avx2: return "avx2-x8";
+    default: return "scalar";
+    }
+}
+
+void Sha256::initState(uint32_t state[8]) {
+    std::memcpy(state, INITIAL_STATE, sizeof(INITIAL_STATE));
+}
+
+size_t Sha256::padTail(unsigned char* tail, size_t partial, uint64_t totalLength) {
+    //0x80, нули, длина в битах big-endian в последних 8 байтах
+    size_t blocks = partial + 9 > BLOCK_SIZE ? 2 : 1;
+    size_t end = blocks * BLOCK_SIZE;
+    tail[partial] = 0x80;
+    std::memset(tail + partial + 1, 0, end - partial - 1 - 8);
+    uint64_t bits = totalLength * 8;
+    for (int i = 0; i < 8; ++i) {
+        tail[end - 1 - i] = static_cast<unsigned char>(bits >> (i * 8));
+    }
+    return blocks;
+}
+
+void Sha256::stateToDigest(const uint32_t state[8], unsigned char digest[DIGEST_SIZE]) {
+    for (int i = 0; i < 8; ++i) {
+        digest[i * 4] = static_cast<unsigned char>(state[i] >> 24);
+        digest[i * 4 + 1] = static_cast<unsigned char>(state[i] >> 16);
+        digest[i * 4 + 2] = static_cast<unsigned char>(state[i] >> 8);
+        digest[i * 4 + 3] = static_cast<unsigned char>(state[i]);
+    }
+}
+
+void Sha256::compressLanes(uint32_t* const states[], const unsigned char* const data[],
+                           const size_t blocks[], size_t lanes) {
+#ifdef SHA256_X86
+    if (activeKernel() == Kernel::Avx2 && lanes > 1) {
+        const unsigned char* ptr[MAX_LANES];
+        size_t left[MAX_LANES];
+        uint32_t scratch[MAX_LANES][8];
+        for (size_t i = 0; i < lanes; ++i) {
+            ptr[i] = data[i];
+            left[i] = blocks[i];
+        }
+
+        for (;;) {
+            size_t active = 0;
+            size_t step = 0;
+            size_t first = 0;
+            for (size_t i = 0; i < lanes; ++i) {
+                if (left[i] == 0) continue;
+                if (active == 0 || left[i] < step) step = left[i];
+                if (active == 0) first = i;
+                ++active;
+            }
+            if (active == 0) {
+                return;
+            }
+            if (active == 1) {
+                //одна линия дешевле в скалярном ядре
+                compressScalar(states[first], ptr[first], left[first]);
+                return;
+            }
+
+            //Пустые линии считают мусор в scratch по данным первой активной
+            uint32_t* laneStates[8];
+            const unsigned char* laneData[8];
+            for (size_t i = 0; i < 8; ++i) {
+                if (i < lanes && left[i] > 0) {
+                    laneStates[i] = states[i];
+                    laneData[i] = ptr[i];
+                } else {
+                    laneStates[i] = scratch[i];
+                    laneData[i] = ptr[first];
+                }
+            }
+            compressAvx2x8(laneStates, laneData, step);
+
+            for (size_t i = 0; i < lanes; ++i) {
+                if (left[i] > 0) {
+                    ptr[i] += step * BLOCK_SIZE;
+                    left[i] -= step;
+                }
+            }
+        }
+    }
+#endif
+    for (size_t i = 0; i < lanes; ++i) {
+        compressSingle(states[i], data[i], blocks[i]);
+    }
+}
+
+void Sha256::hashMany(const unsigned char* const data[], const size_t sizes[], size_t count,
+                      unsigned char (*digests)[DIGEST_SIZE]) {
+    for (size_t base = 0; base < count; base += MAX_LANES) {
+        size_t lanes = std::min(MAX_LANES, count - base);
+        uint32_t state[MAX_LANES][8];
+        uint32_t* states[MAX_LANES];
+        const unsigned char* ptr[MAX_LANES];
+        size_t blocks[MAX_LANES];
+        unsigned char tails[MAX_LANES][BLOCK_SIZE * 2];
+
+        //Сначала все целые блоки, затем хвосты с padding
+        for (size_t i = 0; i < lanes; ++i) {
+            initState(state[i]);
+            states[i] = state[i];
+            ptr[i] = data[base + i];
+            blocks[i] = sizes[base + i] / BLOCK_SIZE;
+        }
+        compressLanes(states, ptr, blocks, lanes);
+
+        for (size_t i = 0; i < lanes; ++i) {
+            size_t full = blocks[i] * BLOCK_SIZE;
+            size_t partial = sizes[base + i] - full;
+            if (partial > 0) {
+                std::memcpy(tails[i], data[base + i] + full, partial);
+            }
+            blocks[i] = padTail(tails[i], partial, sizes[base + i]);
+            ptr[i] = tails[i];
+        }
+        compressLanes(states, ptr, blocks, lanes);
+
+        for (size_t i = 0; i < lanes; ++i) {
+            stateToDigest(state[i], digests[base + i]);
+        }
+    }
+}
@@ -0,0 +1,59 @@
+// Sha256.h
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+/*
+Встроенная реализация SHA-256 (без CryptoAPI/OpenSSL).
+Ядра выбираются во время выполнения по возможностям процессора:
+- ShaNi  - инструкции Intel SHA Extensions (один поток данных)
+- Avx2   - многобуферное ядро: 8 независимых сообщений за проход
+- Scalar - переносимая реализация, работает везде
+Одиночное хеширование использует ShaNi или Scalar; многобуферное -
+Avx2, если нет ShaNi (SHA-NI на один поток не медленнее 8 линий AVX2).
+*/
+class Sha256 {
+public:
+    static constexpr size_t DIGEST_SIZE = 32;
+    static constexpr size_t BLOCK_SIZE = 64;
+    static constexpr size_t MAX_LANES = 8;
+
+    enum class Kernel { Scalar, ShaNi, Avx2 };
+
+    Sha256();
+    void reset();
+    void update(const void* data, size_t size);
+    void finish(unsigned char digest[DIGEST_SIZE]);
+
+    static void hash(const void* data, size_t size, unsigned char digest[DIGEST_SIZE]);
+    static std::string toHex(const unsigned char* data, size_t size);
+
+    //Выбор ядра
+    static bool isSupported(Kernel kernel);
+    static Kernel activeKernel();
+    static void setKernel(Kernel kernel); //для бенчмарков и тестов; неподдерживаемое игнорируется
+    static const char* kernelName(Kernel kernel);
+
+    /*
+    Низкоуровневый интерфейс для многобуферного хеширования.
+    Каждая линия - свое состояние и свой указатель на blocks[i] целых блоков;
+    линии с разной длиной обрабатываются вместе, пока у них есть общие блоки.
+    */
+    static void initState(uint32_t state[8]);
+    static void compressLanes(uint32_t* const states[], const unsigned char* const data[],
+                              const size_t blocks[], size_t lanes);
+    //Дописывает padding после partial байт хвоста; tail должен вмещать 2 блока. Возвращает число блоков
+    static size_t padTail(unsigned char* tail, size_t partial, uint64_t totalLength);
+    static void stateToDigest(const uint32_t state[8], unsigned char digest[DIGEST_SIZE]);
+
+    //Хеширование до MAX_LANES сообщений в памяти за раз
+    static void hashMany(const unsigned char* const data[], const size_t sizes[], size_t count,
+                         unsigned char (*digests)[DIGEST_SIZE]);
+
+private:
+    uint32_t m_state[8];
+    unsigned char m_buffer[BLOCK_SIZE];
+    size_t m_buffered;
+    uint64_t m_length;
+};
@@ -0,0 +1,261 @@
+#include "SnapshotCache.h"
+#include "ProcessJson.h"
+#include "Metrics.h"
+
+namespace {
+MetricHistogram rebuildDuration("monitor_snapshot_rebuild_seconds", "Snapshot rebuild: scan, serialization and deltas");
+MetricHistogram jsonDuration("monitor_serialize_seconds", "Full snapshot serialization", "format", "json");
+MetricHistogram binaryDuration("monitor_serialize_seconds", "Full snapshot serialization", "format", "binary");
+}
+
+SnapshotCache::SnapshotCache(Clock::duration interval) : m_interval(interval) {}
+
+void SnapshotCache::setInterval(Clock::duration interval) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_interval = interval;
+}
+
+SnapshotCache::Clock::duration SnapshotCache::interval() const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_interval;
+}
+
+SnapshotCache::Clock::time_point SnapshotCache::expiresAt() const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_published ? m_builtAt + m_interval : Clock::now();
+}
+
+void SnapshotCache::setListener(std::function<void()> listener) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_listener = std::move(listener);
+}
+
+void SnapshotCache::setWakeup(std::function<void()> wakeup) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_wakeup = std::move(wakeup);
+}
+
+void SnapshotCache::setSource(ScanSource source) {
+    std::lock_guard<std::mutex> lock(m_rebuildMutex);
+    m_source = std::move(source);
+}
+
+void SnapshotCache::setRefreshPolicy(const RefreshScheduler::Policy& policy) {
+    std::lock_guard<std::mutex> lock(m_rebuildMutex);
+    m_refresh.setPolicy(policy);
+}
+
+SnapshotCache::PublishedPtr SnapshotCache::latest() const {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_published;
+}
+
+const SnapshotCache::Payload& SnapshotCache::Published::snapshot(bool binary, ProcessFilter filter) const {
+    switch (filter) {
+    case ProcessFilter::System:
+        return binary ? binarySystemFull : systemFull;
+    case ProcessFilter::User:
+        return binary ? binaryUserFull : userFull;
+    default:
+        return binary ? binaryFull : full;
+    }
+}
+
+bool SnapshotCache::contains(const Published& published, bool binary, ProcessFilter filter, bool table, bool fds) {
+    return published.snapshot(binary, filter) && (!table || published.table) && (!fds || published.fds);
+}
+
+SnapshotCache::Payload SnapshotCache::get() {
+    PublishedPtr published = current(false);
+    return published ? published->full : nullptr;
+}
+
+SnapshotCache::PublishedPtr SnapshotCache::current(bool binary, ProcessFilter filter, bool table, bool fds) {
+    if (binary) {
+        enableBinary();
+    }
+    if (filter != ProcessFilter::All) {
+        enableFilters();
+    }
+    if (table) {
+        enableQueries();
+    }
+    if (fds) {
+        enableFds();
+    }
+    std::function<void()> wakeup;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (m_published && contains(*m_published, binary, filter, table, fds)) {
+            return m_published;
+        }
+        wakeup = m_wakeup;
+    }
+
+    //Нужного нет ни в одном поколении - собирает публикатор, не дожидаясь интервала
+    m_wanted.store(true);
+    if (wakeup) {
+        wakeup();
+    }
+    return nullptr;
+}
+
+SnapshotCache::PublishedPtr SnapshotCache::refresh() {
+    std::lock_guard<std::mutex> rebuilding(m_rebuildMutex);
+    //Сбрасываем до пересборки: заказ, пришедший во время нее, даст еще одно поколение
+    bool wanted = m_wanted.exchange(false);
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        if (m_published && !wanted && Clock::now() - m_builtAt < m_interval) {
+            return m_published;
+        }
+    }
+    return rebuild();
+}
+
+bool SnapshotCache::fdsRequested() const {
+    Clock::rep requestedAt = m_fdsRequestedAt.load();
+    return requestedAt != 0 && Clock::now() - Clock::time_point(Clock::duration(requestedAt)) < interval() * FD_IDLE_GENERATIONS;
+}
+
+SnapshotCache::PublishedPtr SnapshotCache::rebuild() {
+    MetricTimer timer(rebuildDuration);
+    PublishedPtr previous = latest();
+    std::shared_ptr<Published> next = std::make_shared<Published>();
+    next->generation = previous ? previous->generation + 1 : 1;
+
+    if (m_source) {
+        m_source(m_table);
+    } else {
+        m_table.scan(m_refresh);
+    }
+    {
+        MetricTimer serializing(jsonDuration);
+        m_writer.clear();
+        ProcessJson::writeProcesses(m_writer, m_table, next->generation, m_jsonStrings);
+        m_writer.raw('\n');
+        next->full = std::make_shared<const std::string>(m_writer.view());
+        if (m_filtersEnabled.load()) {
+            for (ProcessFilter filter : {ProcessFilter::System, ProcessFilter::User}) {
+                m_writer.clear();
+                ProcessJson::writeProcesses(m_writer, m_table, next->generation, m_jsonStrings, filter);
+                m_writer.raw('\n');
+                (filter == ProcessFilter::System ? next->systemFull : next->userFull) =
+                    std::make_shared<const std::string>(m_writer.view());
+            }
+        }
+    }
+
+    //Дельта относительно предыдущего поколения по строкам той же таблицы
+    m_differ.begin();
+    for (size_t row = 0; row < m_table.size(); ++row) {
+        ProcessView process = m_table[row];
+        ProcessRecord record;
+        record.pid = process.getPid();
+        record.parentPid = process.getParentPid();
+        record.startTime = process.getStartTime();
+        record.name = process.getName();
+        record.path = process.getPath();
+        record.uid = process.getUid();
+        m_differ.observe(record);
+    }
+    const std::vector<ProcessChange>& changes = m_differ.finish();
+
+    if (previous) {
+        size_t keep = std::min(previous->deltas.size(), DELTA_HISTORY - 1);
+        next->deltas.assign(previous->deltas.end() - static_cast<long>(keep), previous->deltas.end());
+        Payload delta;
+        if (!changes.empty()) {
+            m_writer.clear();
+            ProcessJson::writeChanges(m_writer, next->generation, changes);
+            m_writer.raw('\n');
+            delta = std::make_shared<const std::string>(m_writer.view());
+        }
+        next->deltas.push_back(delta);
+    }
+    if (m_binaryEnabled.load()) {
+        buildBinary(previous.get(), *next, changes);
+    }
+    if (m_queriesEnabled.load()) {
+        std::shared_ptr<ProcessTable> copy = std::make_shared<ProcessTable>();
+        copy->copyFrom(m_table);
+        next->table = copy;
+    }
+    if (fdsRequested()) {
+        if (!m_fds) {
+            m_fds.reset(new FdInventory());
+        }
+        m_fds->scan(m_table);
+        std::shared_ptr<FdInventory> copy = std::make_shared<FdInventory>();
+        copy->copyFrom(*m_fds);
+        next->fds = copy;
+    } else {
+        m_fds.reset(); //клиенты дескрипторов ушли - не сканируем и не держим инвентарь
+    }
+    m_rebuilds.fetch_add(1);
+
+    std::function<void()> listener;
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_published = next;
+        m_builtAt = Clock::now();
+        listener = m_listener;
+    }
+    if (listener) {
+        listener();
+    }
+    return next;
+}
+
+void SnapshotCache::buildBinary(const Published* previous, Published& next, const std::vector<ProcessChange>& changes) {
+    MetricTimer timer(binaryDuration);
+    m_encoder.mapTable(m_table);
+
+    m_binaryBuffer.clear();
+    m_encoder.writeSnapshot(m_binaryBuffer, m_table, next.generation);
+    next.binaryFull = std::make_shared<const std::string>(m_binaryBuffer);
+    if (m_filtersEnabled.load()) {
+        for (ProcessFilter filter : {ProcessFilter::System, ProcessFilter::User}) {
+            m_binaryBuffer.clear();
+            m_encoder.writeSnapshot(m_binaryBuffer, m_table, next.generation, filter);
+            (filter == ProcessFilter::System ? next.binarySystemFull : next.binaryUserFull) =
+                std::make_shared<const std::string>(m_binaryBuffer);
+        }
+    }
+
+    //История двоичных дельт идет параллельно JSON; до включения формата в ней пустые места
+    bool continued = previous && previous->binaryFull && previous->dictionaryEpoch == m_encoder.epoch();
+    if (previous) {
+        size_t keep = next.deltas.size() - 1;
+        if (previous->binaryDeltas.size() >= keep) {
+            next.binaryDeltas.assign(previous->binaryDeltas.end() - static_cast<long>(keep), previous->binaryDeltas.end());
+        } else {
+            next.binaryDeltas.assign(keep, Payload());
+        }
+        Payload delta;
+        if (!changes.empty()) {
+            m_binaryBuffer.clear();
+            m_encoder.writeDelta(m_binaryBuffer, next.generation, changes);
+            delta = std::make_shared<const std::string>(m_binaryBuffer);
+        }
+        next.binaryDeltas.push_back(delta);
+    }
+
+    next.dictionaryEpoch = m_encoder.epoch();
+    next.stringCount = m_encoder.stringCount();
+    next.stringsFirst = continued ? previous->stringCount : 0;
+    if (continued && next.stringsFirst == next.stringCount) {
+        next.binaryDictionary = previous->binaryDictionary; //словарь не изменился
+        return;
+    }
+    m_binaryBuffer.clear();
+    m_encoder.writeStrings(m_binaryBuffer, 0);
+    next.binaryDictionary = std::make_shared<const std::string>(m_binaryBuffer);
+    if (continued) {
+        m_binaryBuffer.clear();
+        m_encoder.writeStrings(m_binaryBuffer, next.stringsFirst);
+        next.binaryStrings = std::make_shared<const std::string>(m_binaryBuffer);
+    } else {
+        next.binaryStrings = next.binaryDictionary;
+    }
+}
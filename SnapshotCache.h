@@ -0,0 +1,167 @@
+// SnapshotCache.h
+#pragma once
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+#include "ProcessTable.h"
+#include "ProcessSnapshotDiffer.h"
+#include "ProcessBinary.h"
+#include "JsonWriter.h"
+#include "ProcessJson.h"
+#include "RefreshScheduler.h"
+#include "FdInventory.h"
+
+/*
+Общий сериализованный снимок процессов для всех клиентов сервера.
+Ответ хранится как shared_ptr<const std::string>: соединения держат ссылку,
+пока дописывают его в сокет, а новый снимок просто подменяет указатель.
+Пересборку (scan + сериализация) делает только refresh() из отдельного
+потока (публикатор сервера). current() из потоков клиентов отдает последнее
+опубликованное поколение, даже устаревшее, и никогда не пересобирает сам:
+если ни одно поколение еще не содержит нужного (самый первый снимок, первый
+запрос двоичного формата, фильтра, отбора или дескрипторов), он включает
+нужное, будит публикатора (setWakeup) и возвращает nullptr - запрос ждет
+следующего поколения, а refresh() пересобирает, не дожидаясь интервала.
+
+Каждая пересборка - новое поколение. Вместе с полным ответом публикуются
+дельты последних поколений (ProcessSnapshotDiffer) для подписчиков:
+подписчик, отставший не больше чем на DELTA_HISTORY поколений, догоняет
+дельтами, иначе получает полный снимок заново.
+
+Двоичный формат (ProcessBinary.h) собирается только после enableBinary(),
+т.е. когда хотя бы один клиент его запросил; словарь строк общий.
+Так же и ответы с фильтром "system"/"user": после первого такого запроса
+каждое поколение публикует их рядом с полным ответом. Фильтр идет по
+числовой колонке uid, имена владельцев для него не нужны.
+После первого запроса с отбором (ProcessQuery.h) поколение публикует и
+неизменяемую копию таблицы: запросы читают ее из потоков сервера, пока
+следующий скан идет в рабочую таблицу.
+Запрос дескрипторов (get_fds, find_holders) так же добавляет в поколения
+копию FdInventory, просканированного по таблице поколения, но только пока
+такие запросы идут: через FD_IDLE_GENERATIONS интервалов без них скан
+останавливается и инвентарь освобождается.
+Живой скан идет через RefreshScheduler: путь и владелец простаивающих
+процессов перечитываются раз в интервал, а не каждое поколение.
+*/
+class SnapshotCache {
+public:
+    typedef std::shared_ptr<const std::string> Payload;
+    typedef std::chrono::steady_clock Clock;
+
+    static constexpr size_t DELTA_HISTORY = 8;
+    //Через сколько интервалов без запросов дескрипторов их скан прекращается
+    static constexpr int FD_IDLE_GENERATIONS = 10;
+
+    struct Published {
+        uint64_t generation = 0;
+        Payload full;                //ответ get_processes с полем "generation"
+        //deltas.back() - переход generation-1 -> generation, перед ним более ранние;
+        //nullptr - в этом поколении изменений не было
+        std::vector<Payload> deltas;
+
+        //Двоичный формат: те же данные кадрами ProcessBinary (пусто, пока формат не включен)
+        Payload binaryFull;
+        std::vector<Payload> binaryDeltas; //параллельно deltas
+        Payload binaryStrings;             //строки словаря [stringsFirst, stringCount); nullptr - новых нет
+        Payload binaryDictionary;          //весь словарь эпохи (для новых клиентов)
+        uint32_t dictionaryEpoch = 0;
+        size_t stringsFirst = 0;
+        size_t stringCount = 0;
+
+        //Ответы get_processes с фильтром (пусто, пока фильтры не запрошены)
+        Payload systemFull;
+        Payload userFull;
+        Payload binarySystemFull;
+        Payload binaryUserFull;
+
+        //Копия таблицы поколения для запросов (пусто, пока запросы не включены)
+        std::shared_ptr<const ProcessTable> table;
+        //Открытые дескрипторы процессов поколения (пусто, пока не запрошены)
+        std::shared_ptr<const FdInventory> fds;
+
+        //Полный ответ в нужном формате и с нужным фильтром; nullptr - не собран
+        const Payload& snapshot(bool binary, ProcessFilter filter) const;
+    };
+    typedef std::shared_ptr<const Published> PublishedPtr;
+
+    explicit SnapshotCache(Clock::duration interval = std::chrono::seconds(1));
+
+    SnapshotCache(const SnapshotCache&) = delete;
+    SnapshotCache& operator=(const SnapshotCache&) = delete;
+
+    //Ответ на get_processes с завершающим '\n' из последнего поколения (nullptr - снимка еще нет)
+    Payload get();
+    //Последнее поколение целиком без пересборки; binary - нужны двоичные кадры (включает формат),
+    //filter - нужен ответ с этим фильтром (включает фильтры), table - копия таблицы (включает запросы),
+    //fds - инвентарь дескрипторов (продлевает его скан).
+    //nullptr - нужного нет ни в одном поколении: пересборка заказана, ответ будет в следующем
+    PublishedPtr current(bool binary = false, ProcessFilter filter = ProcessFilter::All, bool table = false,
+                         bool fds = false);
+    //Пересобирает устаревший снимок или заказанный current(); вызывается одним потоком-публикатором
+    PublishedPtr refresh();
+    //current() ждет поколения, которого еще нет
+    bool wanted() const { return m_wanted.load(); }
+    //Последнее опубликованное поколение без пересборки (nullptr - снимка еще нет)
+    PublishedPtr latest() const;
+
+    void setInterval(Clock::duration interval);
+    Clock::duration interval() const;
+    //Когда текущий снимок устареет
+    Clock::time_point expiresAt() const;
+
+    void enableBinary() { m_binaryEnabled.store(true); }
+    void enableFilters() { m_filtersEnabled.store(true); }
+    void enableQueries() { m_queriesEnabled.store(true); }
+    void enableFds() { m_fdsRequestedAt.store(Clock::now().time_since_epoch().count()); }
+
+    //Вызывается после каждой публикации в потоке, который пересобирал снимок
+    void setListener(std::function<void()> listener);
+    //Вызывается из current(), когда нужного нет ни в одном поколении: должен разбудить публикатора
+    void setWakeup(std::function<void()> wakeup);
+
+    //Откуда брать процессы вместо живого ProcessTable::scan() (например, SnapshotReader::replayInto)
+    typedef std::function<void(ProcessTable& table)> ScanSource;
+    void setSource(ScanSource source);
+    //Интервалы и бюджет дорогих атрибутов живого скана (путь, владелец)
+    void setRefreshPolicy(const RefreshScheduler::Policy& policy);
+
+    //Сколько раз снимок пересобирался (для тестов и статистики)
+    uint64_t rebuilds() const { return m_rebuilds.load(); }
+
+private:
+    //В поколении есть все нужное запросу
+    static bool contains(const Published& published, bool binary, ProcessFilter filter, bool table, bool fds);
+    PublishedPtr rebuild();
+    void buildBinary(const Published* previous, Published& next, const std::vector<ProcessChange>& changes);
+    //Дескрипторы запрашивали не раньше FD_IDLE_GENERATIONS интервалов назад
+    bool fdsRequested() const;
+
+    std::mutex m_rebuildMutex; //таблица, diff и буферы сериализации; пересобирает один поток
+    ProcessTable m_table;
+    ScanSource m_source;             //пусто - живой скан
+    RefreshScheduler m_refresh;      //что перечитывать в живом скане
+    ProcessSnapshotDiffer m_differ;
+    JsonWriter m_writer;             //буфер сериализации переиспользуется между поколениями
+    JsonStringCache m_jsonStrings;   //экранированные имена и пути между поколениями
+    ProcessBinaryEncoder m_encoder;
+    std::unique_ptr<FdInventory> m_fds; //инкрементальный скан; поколениям публикуется копия; nullptr - не запрашивались
+    std::string m_binaryBuffer;
+
+    mutable std::mutex m_mutex; //защищает поля ниже; держится только на время копирования указателя
+    PublishedPtr m_published;
+    Clock::time_point m_builtAt;
+    Clock::duration m_interval;
+    std::function<void()> m_listener;
+    std::function<void()> m_wakeup;
+
+    std::atomic<uint64_t> m_rebuilds{0};
+    std::atomic<bool> m_binaryEnabled{false};
+    std::atomic<bool> m_filtersEnabled{false};
+    std::atomic<bool> m_queriesEnabled{false};
+    std::atomic<bool> m_wanted{false};
+    std::atomic<Clock::rep> m_fdsRequestedAt{0}; //последний запрос дескрипторов; 0 - не было
+};
@@ -0,0 +1,657 @@
+#include "SnapshotFile.h"
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+#ifdef _WIN32
+#include <fstream>
+#include <sstream>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace {
+
+const char FILE_MAGIC[8] = {'P', 'M', 'S', 'N', 'A', 'P', '0', '1'};
+const char TRAILER_MAGIC[8] = {'P', 'M', 'S', 'I', 'D', 'X', '0', '1'};
+const size_t RECORD_HEADER_SIZE = 5; //u32 длина + u8 тип
+const size_t TRAILER_SIZE = 16;      //u64 смещение INDEX + магия
+
+enum RecordType : uint8_t { RECORD_STRINGS = 1, RECORD_KEYFRAME = 2, RECORD_DELTA = 3, RECORD_INDEX = 4 };
+
+void putVarint(std::string& out, uint64_t value) {
+    while (value >= 0x80) {
+        out += static_cast<char>((value & 0x7F) | 0x80);
+        value >>= 7;
+    }
+    out += static_cast<char>(value);
+}
+
+uint64_t zigzag(int64_t value) {
+    return (static_cast<uint64_t>(value) << 1) ^ static_cast<uint64_t>(value >> 63);
+}
+
+int64_t unzigzag(uint64_t value) {
+    return static_cast<int64_t>(value >> 1) ^ -static_cast<int64_t>(value & 1);
+}
+
+void putPidDelta(std::string& out, DWORD pid, DWORD& previous) {
+    putVarint(out, zigzag(static_cast<int64_t>(pid) - static_cast<int64_t>(previous)));
+    previous = pid;
+}
+
+void putProcess(std::string& out, const RecordedProcess& process, DWORD& previous) {
+    putPidDelta(out, process.pid, previous);
+    putVarint(out, process.parentPid);
+    putVarint(out, process.startTime);
+    putVarint(out, static_cast<uint32_t>(process.uid + 1)); //UNKNOWN_UID -> 0
+    putVarint(out, process.nameId);
+    putVarint(out, process.pathId);
+}
+
+size_t beginRecord(std::string& out, uint8_t type) {
+    size_t start = out.size();
+    out.append(4, '\0');
+    out += static_cast<char>(type);
+    return start;
+}
+
+void finishRecord(std::string& out, size_t start) {
+    uint32_t length = static_cast<uint32_t>(out.size() - start - RECORD_HEADER_SIZE);
+    for (int i = 0; i < 4; ++i) {
+        out[start + static_cast<size_t>(i)] = static_cast<char>((length >> (8 * i)) & 0xFF);
+    }
+}
+
+uint64_t readLittleEndian(const unsigned char* p, size_t bytes) {
+    uint64_t value = 0;
+    for (size_t i = 0; i < bytes; ++i) {
+        value |= static_cast<uint64_t>(p[i]) << (8 * i);
+    }
+    return value;
+}
+
+//Разбор тела записи с проверкой границ
+class BodyReader {
+public:
+    BodyReader(const unsigned char* begin, const unsigned char* end) : m_pos(begin), m_end(end) {}
+
+    bool varint(uint64_t& value) {
+        value = 0;
+        for (int shift = 0; shift < 64 && m_pos < m_end; shift += 7) {
+            unsigned char byte = *m_pos++;
+            value |= static_cast<uint64_t>(byte & 0x7F) << shift;
+            if (!(byte & 0x80)) {
+                return true;
+            }
+        }
+        return false;
+    }
+    bool pidDelta(DWORD& previous) {
+        uint64_t encoded;
+        if (!varint(encoded)) {
+            return false;
+        }
+        previous = static_cast<DWORD>(static_cast<int64_t>(previous) + unzigzag(encoded));
+        return true;
+    }
+    bool process(RecordedProcess& process, DWORD& previous, size_t strings) {
+        uint64_t parentPid, startTime, uid, nameId, pathId;
+        if (!pidDelta(previous) || !varint(parentPid) || !varint(startTime) || !varint(uid) ||
+            !varint(nameId) || !varint(pathId) || nameId >= strings || pathId >= strings) {
+            return false;
+        }
+        process.pid = previous;
+        process.parentPid = static_cast<DWORD>(parentPid);
+        process.startTime = startTime;
+        process.uid = static_cast<uint32_t>(uid - 1);
+        process.nameId = static_cast<uint32_t>(nameId);
+        process.pathId = static_cast<uint32_t>(pathId);
+        return true;
+    }
+    bool bytes(size_t count, const unsigned char*& data) {
+        if (static_cast<size_t>(m_end - m_pos) < count) {
+            return false;
+        }
+        data = m_pos;
+        m_pos += count;
+        return true;
+    }
+    size_t remaining() const { return static_cast<size_t>(m_end - m_pos); }
+
+private:
+    const unsigned char* m_pos;
+    const unsigned char* m_end;
+};
+
+bool sameFields(const RecordedProcess& a, const RecordedProcess& b) {
+    return a.parentPid == b.parentPid && a.uid == b.uid && a.nameId == b.nameId && a.pathId == b.pathId;
+}
+
+} // namespace
+
+SnapshotRecorder::SnapshotRecorder() = default;
+
+SnapshotRecorder::~SnapshotRecorder() {
+    close();
+}
+
+bool SnapshotRecorder::open(const std::string& path) {
+    close();
+    m_file = std::fopen(path.c_str(), "wb");
+    if (!m_file) {
+        std::cerr << "Cannot create snapshot file " << path << std::endl;
+        return false;
+    }
+    m_strings.clear();
+    m_stringsWritten = 1; //строка 0 - пустая, в файл не пишется
+    m_tableIds.clear();
+    m_mappedTable = nullptr;
+    m_previous.clear();
+    m_index.clear();
+    m_stringOffsets.clear();
+    m_offset = 0;
+    m_buffer.assign(FILE_MAGIC, sizeof(FILE_MAGIC));
+    return flush();
+}
+
+bool SnapshotRecorder::flush() {
+    if (!m_file) {
+        return false;
+    }
+    //fflush после каждого поколения: при падении теряется не больше одного поколения
+    bool ok = std::fwrite(m_buffer.data(), 1, m_buffer.size(), m_file) == m_buffer.size() && std::fflush(m_file) == 0;
+    if (!ok) {
+        std::cerr << "Snapshot file write failed" << std::endl;
+    }
+    m_offset += m_buffer.size();
+    m_buffer.clear();
+    return ok;
+}
+
+bool SnapshotRecorder::close() {
+    if (!m_file) {
+        return false;
+    }
+    uint64_t indexOffset = m_offset;
+    size_t start = beginRecord(m_buffer, RECORD_INDEX);
+    putVarint(m_buffer, m_index.size());
+    uint64_t offset = 0;
+    uint64_t timestamp = 0;
+    for (const IndexEntry& entry : m_index) {
+        putVarint(m_buffer, entry.offset - offset);
+        putVarint(m_buffer, zigzag(static_cast<int64_t>(entry.timestampNs - timestamp)));
+        m_buffer += static_cast<char>(entry.keyframe ? 1 : 0);
+        offset = entry.offset;
+        timestamp = entry.timestampNs;
+    }
+    putVarint(m_buffer, m_stringOffsets.size());
+    offset = 0;
+    for (uint64_t stringsOffset : m_stringOffsets) {
+        putVarint(m_buffer, stringsOffset - offset);
+        offset = stringsOffset;
+    }
+    finishRecord(m_buffer, start);
+    for (int i = 0; i < 8; ++i) {
+        m_buffer += static_cast<char>((indexOffset >> (8 * i)) & 0xFF);
+    }
+    m_buffer.append(TRAILER_MAGIC, sizeof(TRAILER_MAGIC));
+    bool ok = flush();
+    ok = std::fclose(m_file) == 0 && ok;
+    m_file = nullptr;
+    return ok;
+}
+
+uint32_t SnapshotRecorder::mapString(const ProcessTable& table, StringArena::Handle handle) {
+    uint32_t& id = m_tableIds[handle];
+    if (id == UINT32_MAX) {
+        id = m_strings.intern(table.strings().get(handle));
+    }
+    return id;
+}
+
+bool SnapshotRecorder::record(const ProcessTable& table, uint64_t timestampNs) {
+    if (!m_file) {
+        return false;
+    }
+    //Номера строк файла по handle арены таблицы; пересборка арены сбрасывает соответствие
+    if (m_mappedTable != &table || m_mappedVersion != table.stringsVersion()) {
+        m_tableIds.clear();
+        m_mappedTable = &table;
+        m_mappedVersion = table.stringsVersion();
+    }
+    m_tableIds.resize(table.strings().size(), UINT32_MAX);
+
+    m_current.resize(table.size());
+    for (size_t row = 0; row < table.size(); ++row) {
+        RecordedProcess& process = m_current[row];
+        process.pid = table.pids()[row];
+        process.parentPid = table.parentPids()[row];
+        process.startTime = table.startTimes()[row];
+        process.uid = table.uids()[row];
+        process.nameId = mapString(table, table.nameIds()[row]);
+        process.pathId = mapString(table, table.pathIds()[row]);
+    }
+    auto byPid = [](const RecordedProcess& a, const RecordedProcess& b) { return a.pid < b.pid; };
+    if (!std::is_sorted(m_current.begin(), m_current.end(), byPid)) {
+        std::sort(m_current.begin(), m_current.end(), byPid);
+    }
+
+    //Новые строки - до поколения, которое на них ссылается
+    if (m_strings.size() > m_stringsWritten) {
+        m_stringOffsets.push_back(m_offset + m_buffer.size());
+        size_t start = beginRecord(m_buffer, RECORD_STRINGS);
+        putVarint(m_buffer, m_stringsWritten);
+        putVarint(m_buffer, m_strings.size() - m_stringsWritten);
+        for (size_t id = m_stringsWritten; id < m_strings.size(); ++id) {
+            const std::string& value = m_strings.get(static_cast<StringArena::Handle>(id));
+            putVarint(m_buffer, value.size());
+            m_buffer += value;
+        }
+        finishRecord(m_buffer, start);
+        m_stringsWritten = m_strings.size();
+    }
+
+    IndexEntry entry;
+    entry.offset = m_offset + m_buffer.size();
+    entry.timestampNs = timestampNs;
+    entry.keyframe = m_index.size() % m_keyframeInterval == 0;
+    uint64_t generation = m_index.size() + 1;
+    DWORD previous = 0;
+    if (entry.keyframe) {
+        size_t start = beginRecord(m_buffer, RECORD_KEYFRAME);
+        putVarint(m_buffer, generation);
+        putVarint(m_buffer, timestampNs);
+        putVarint(m_buffer, m_current.size());
+        for (const RecordedProcess& process : m_current) {
+            putProcess(m_buffer, process, previous);
+        }
+        finishRecord(m_buffer, start);
+    } else {
+        size_t start = beginRecord(m_buffer, RECORD_DELTA);
+        putVarint(m_buffer, generation);
+        putVarint(m_buffer, zigzag(static_cast<int64_t>(timestampNs - m_lastTimestamp)));
+        //Два прохода слиянием по PID: завершившиеся, затем новые и изменившиеся.
+        //Счетчик идет перед списком, поэтому список собирается отдельно
+        size_t exited = 0;
+        std::string& list = m_listBuffer;
+        list.clear();
+        size_t i = 0;
+        size_t j = 0;
+        while (i < m_previous.size()) {
+            if (j == m_current.size() || m_previous[i].pid < m_current[j].pid) {
+                putPidDelta(list, m_previous[i++].pid, previous);
+                ++exited;
+            } else if (m_current[j].pid < m_previous[i].pid) {
+                ++j;
+            } else {
+                if (m_current[j].startTime != m_previous[i].startTime) {
+                    putPidDelta(list, m_previous[i].pid, previous); //PID переиспользован
+                    ++exited;
+                }
+                ++i;
+                ++j;
+            }
+        }
+        putVarint(m_buffer, exited);
+        m_buffer += list;
+
+        list.clear();
+        size_t upserts = 0;
+        previous = 0;
+        i = 0;
+        for (const RecordedProcess& process : m_current) {
+            while (i < m_previous.size() && m_previous[i].pid < process.pid) {
+                ++i;
+            }
+            bool known = i < m_previous.size() && m_previous[i].pid == process.pid &&
+                         m_previous[i].startTime == process.startTime;
+            if (!known || !sameFields(m_previous[i], process)) {
+                putProcess(list, process, previous);
+                ++upserts;
+            }
+        }
+        putVarint(m_buffer, upserts);
+        m_buffer += list;
+        finishRecord(m_buffer, start);
+    }
+    m_index.push_back(entry);
+    m_lastTimestamp = timestampNs;
+    m_previous.swap(m_current);
+    return flush();
+}
+
+SnapshotReader::SnapshotReader() = default;
+
+SnapshotReader::~SnapshotReader() {
+    close();
+}
+
+void SnapshotReader::close() {
+#ifndef _WIN32
+    if (m_data) {
+        ::munmap(const_cast<unsigned char*>(m_data), m_size);
+    }
+#else
+    m_content.clear();
+#endif
+    m_data = nullptr;
+    m_size = 0;
+    m_indexed = false;
+    m_index.clear();
+    m_strings.clear();
+    m_rows.clear();
+    m_position = 0;
+    m_generation = 0;
+}
+
+bool SnapshotReader::map(const std::string& path) {
+#ifndef _WIN32
+    int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0) {
+        return false;
+    }
+    struct stat info;
+    void* data = MAP_FAILED;
+    if (::fstat(fd, &info) == 0 && info.st_size > 0) {
+        data = ::mmap(nullptr, static_cast<size_t>(info.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+    }
+    ::close(fd); //отображение держит файл само
+    if (data == MAP_FAILED) {
+        return false;
+    }
+    m_data = static_cast<const unsigned char*>(data);
+    m_size = static_cast<size_t>(info.st_size);
+#else
+    std::ifstream file(path, std::ios::binary);
+    if (!file) {
+        return false;
+    }
+    std::ostringstream content;
+    content << file.rdbuf();
+    m_content = content.str();
+    if (m_content.empty()) {
+        return false;
+    }
+    m_data = reinterpret_cast<const unsigned char*>(m_content.data());
+    m_size = m_content.size();
+#endif
+    return true;
+}
+
+bool SnapshotReader::open(const std::string& path) {
+    close();
+    if (!map(path)) {
+        std::cerr << "Cannot open snapshot file " << path << std::endl;
+        return false;
+    }
+    if (m_size < sizeof(FILE_MAGIC) || std::memcmp(m_data, FILE_MAGIC, sizeof(FILE_MAGIC)) != 0) {
+        std::cerr << "Not a snapshot file: " << path << std::endl;
+        close();
+        return false;
+    }
+    m_strings.emplace_back(); //строка 0 - пустая
+    m_indexed = readTrailer();
+    if (!m_indexed) {
+        //Хвоста нет (запись прервалась) или он поврежден - индекс по самим записям
+        m_index.clear();
+        m_strings.resize(1);
+        if (!scanRecords()) {
+            std::cerr << "Corrupted snapshot file: " << path << std::endl;
+            close();
+            return false;
+        }
+    }
+    m_position = m_index.size();
+    return true;
+}
+
+bool SnapshotReader::readTrailer() {
+    if (m_size < sizeof(FILE_MAGIC) + RECORD_HEADER_SIZE + TRAILER_SIZE ||
+        std::memcmp(m_data + m_size - sizeof(TRAILER_MAGIC), TRAILER_MAGIC, sizeof(TRAILER_MAGIC)) != 0) {
+        return false;
+    }
+    uint64_t indexOffset = readLittleEndian(m_data + m_size - TRAILER_SIZE, 8);
+    //Смещения из файла недоверенные: сравниваем с остатком, а не сумму - она может переполниться
+    if (indexOffset < sizeof(FILE_MAGIC) || indexOffset > m_size - TRAILER_SIZE - RECORD_HEADER_SIZE) {
+        return false;
+    }
+    const unsigned char* record = m_data + indexOffset;
+    uint64_t length = readLittleEndian(record, 4);
+    if (record[4] != RECORD_INDEX || indexOffset + RECORD_HEADER_SIZE + length != m_size - TRAILER_SIZE) {
+        return false;
+    }
+    BodyReader body(record + RECORD_HEADER_SIZE, record + RECORD_HEADER_SIZE + length);
+    uint64_t count;
+    if (!body.varint(count) || count > body.remaining()) {
+        return false;
+    }
+    m_index.resize(static_cast<size_t>(count));
+    uint64_t offset = 0;
+    uint64_t timestamp = 0;
+    for (IndexEntry& entry : m_index) {
+        uint64_t offsetDelta, timestampDelta;
+        const unsigned char* keyframe;
+        if (!body.varint(offsetDelta) || !body.varint(timestampDelta) || !body.bytes(1, keyframe)) {
+            return false;
+        }
+        if (offsetDelta > indexOffset - RECORD_HEADER_SIZE - offset) {
+            return false;
+        }
+        offset += offsetDelta;
+        timestamp += static_cast<uint64_t>(unzigzag(timestampDelta));
+        if (offset < sizeof(FILE_MAGIC)) {
+            return false;
+        }
+        entry.offset = offset;
+        entry.timestampNs = timestamp;
+        entry.keyframe = *keyframe != 0;
+    }
+    if (!m_index.empty() && !m_index.front().keyframe) {
+        return false;
+    }
+    if (!body.varint(count) || count > body.remaining()) {
+        return false;
+    }
+    offset = 0;
+    for (uint64_t i = 0; i < count; ++i) {
+        uint64_t delta;
+        if (!body.varint(delta) || delta > indexOffset - offset) {
+            return false;
+        }
+        offset += delta;
+        if (!addStrings(offset)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool SnapshotReader::scanRecords() {
+    size_t pos = sizeof(FILE_MAGIC);
+    uint64_t timestamp = 0;
+    while (pos + RECORD_HEADER_SIZE <= m_size) {
+        uint64_t length = readLittleEndian(m_data + pos, 4);
+        uint8_t type = m_data[pos + 4];
+        if (length > m_size - pos - RECORD_HEADER_SIZE) {
+            break; //недописанная запись
+        }
+        BodyReader body(m_data + pos + RECORD_HEADER_SIZE, m_data + pos + RECORD_HEADER_SIZE + length);
+        if (type == RECORD_STRINGS) {
+            if (!addStrings(pos)) {
+                return false;
+            }
+        } else if (type == RECORD_KEYFRAME || type == RECORD_DELTA) {
+            uint64_t generation, value;
+            if (!body.varint(generation) || !body.varint(value)) {
+                return false;
+            }
+            if (m_index.empty() && type != RECORD_KEYFRAME) {
+                return false;
+            }
+            timestamp = type == RECORD_KEYFRAME ? value : timestamp + static_cast<uint64_t>(unzigzag(value));
+            m_index.push_back(IndexEntry{pos, timestamp, type == RECORD_KEYFRAME});
+        } else {
+            break; //INDEX (или мусор после него)
+        }
+        pos += RECORD_HEADER_SIZE + static_cast<size_t>(length);
+    }
+    return true;
+}
+
+bool SnapshotReader::addStrings(uint64_t offset) {
+    if (m_size < RECORD_HEADER_SIZE || offset > m_size - RECORD_HEADER_SIZE || m_data[offset + 4] != RECORD_STRINGS) {
+        return false;
+    }
+    uint64_t length = readLittleEndian(m_data + offset, 4);
+    if (length > m_size - offset - RECORD_HEADER_SIZE) {
+        return false;
+    }
+    const unsigned char* begin = m_data + offset + RECORD_HEADER_SIZE;
+    BodyReader body(begin, begin + length);
+    uint64_t first, count;
+    if (!body.varint(first) || !body.varint(count) || first != m_strings.size() || count > body.remaining()) {
+        return false;
+    }
+    for (uint64_t i = 0; i < count; ++i) {
+        uint64_t size;
+        const unsigned char* data;
+        if (!body.varint(size) || !body.bytes(static_cast<size_t>(size), data)) {
+            return false;
+        }
+        m_strings.emplace_back(reinterpret_cast<const char*>(data), static_cast<size_t>(size));
+    }
+    return true;
+}
+
+bool SnapshotReader::apply(size_t index) {
+    const IndexEntry& entry = m_index[index];
+    uint64_t length = readLittleEndian(m_data + entry.offset, 4);
+    if (length > m_size - entry.offset - RECORD_HEADER_SIZE) {
+        return false;
+    }
+    uint8_t type = m_data[entry.offset + 4];
+    const unsigned char* begin = m_data + entry.offset + RECORD_HEADER_SIZE;
+    BodyReader body(begin, begin + length);
+    uint64_t generation, timestamp, count;
+    if (!body.varint(generation) || !body.varint(timestamp) || !body.varint(count) || count > body.remaining()) {
+        return false;
+    }
+    DWORD previous = 0;
+    if (type == RECORD_KEYFRAME) {
+        m_rows.resize(static_cast<size_t>(count));
+        for (RecordedProcess& process : m_rows) {
+            if (!body.process(process, previous, m_strings.size())) {
+                return false;
+            }
+        }
+    } else if (type == RECORD_DELTA) {
+        m_exited.resize(static_cast<size_t>(count));
+        for (DWORD& pid : m_exited) {
+            if (!body.pidDelta(previous)) {
+                return false;
+            }
+            pid = previous;
+        }
+        if (!body.varint(count) || count > body.remaining()) {
+            return false;
+        }
+        m_upserts.resize(static_cast<size_t>(count));
+        previous = 0;
+        for (RecordedProcess& process : m_upserts) {
+            if (!body.process(process, previous, m_strings.size())) {
+                return false;
+            }
+        }
+
+        //Слияние по PID: завершившиеся выпадают, новые и изменившиеся заменяют прежние
+        m_scratch.clear();
+        size_t exited = 0;
+        size_t upsert = 0;
+        for (const RecordedProcess& process : m_rows) {
+            while (upsert < m_upserts.size() && m_upserts[upsert].pid < process.pid) {
+                m_scratch.push_back(m_upserts[upsert++]);
+            }
+            while (exited < m_exited.size() && m_exited[exited] < process.pid) {
+                ++exited;
+            }
+            bool gone = exited < m_exited.size() && m_exited[exited] == process.pid;
+            if (upsert < m_upserts.size() && m_upserts[upsert].pid == process.pid) {
+                m_scratch.push_back(m_upserts[upsert++]);
+            } else if (!gone) {
+                m_scratch.push_back(process);
+            }
+        }
+        m_scratch.insert(m_scratch.end(), m_upserts.begin() + static_cast<long>(upsert), m_upserts.end());
+        m_rows.swap(m_scratch);
+    } else {
+        return false;
+    }
+    m_generation = generation;
+    m_position = index;
+    return true;
+}
+
+bool SnapshotReader::seek(size_t index) {
+    if (index >= m_index.size()) {
+        return false;
+    }
+    size_t keyframe = index;
+    while (!m_index[keyframe].keyframe) {
+        --keyframe; //первое поколение всегда KEYFRAME
+    }
+    //Вперед от текущего поколения, если оно между кадром и целью
+    size_t from = keyframe;
+    if (m_position < m_index.size() && m_position >= keyframe && m_position <= index) {
+        from = m_position + 1;
+        if (m_position == index) {
+            return true;
+        }
+    }
+    for (size_t i = from; i <= index; ++i) {
+        if (!apply(i)) {
+            std::cerr << "Corrupted snapshot record at offset " << m_index[i].offset << std::endl;
+            m_position = m_index.size();
+            return false;
+        }
+    }
+    return true;
+}
+
+bool SnapshotReader::seekTime(uint64_t timestampNs) {
+    auto it = std::upper_bound(m_index.begin(), m_index.end(), timestampNs,
+                               [](uint64_t value, const IndexEntry& entry) { return value < entry.timestampNs; });
+    size_t index = it == m_index.begin() ? 0 : static_cast<size_t>(it - m_index.begin()) - 1;
+    return seek(index);
+}
+
+bool SnapshotReader::next() {
+    size_t index = m_position < m_index.size() ? m_position + 1 : 0;
+    return seek(index);
+}
+
+void SnapshotReader::fill(ProcessTable& table) const {
+    table.clear();
+    ProcessRecord record;
+    for (const RecordedProcess& process : m_rows) {
+        record.pid = process.pid;
+        record.parentPid = process.parentPid;
+        record.startTime = process.startTime;
+        record.uid = process.uid;
+        record.name = m_strings[process.nameId];
+        record.path = m_strings[process.pathId];
+        table.append(record);
+    }
+    table.finishScan();
+}
+
+size_t SnapshotReader::replayInto(ProcessTable& table, bool loop) {
+    if (!next() && !(loop && seek(0)) && m_position >= m_index.size()) {
+        table.clear();
+        return 0;
+    }
+    fill(table);
+    return table.size();
+}
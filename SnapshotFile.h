@@ -0,0 +1,160 @@
+// SnapshotFile.h
+#pragma once
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "ProcessTable.h"
+#include "StringArena.h"
+
+//Процесс в записи; строки - номера общей таблицы строк файла
+struct RecordedProcess {
+    DWORD pid;
+    DWORD parentPid;
+    uint64_t startTime;
+    uint32_t uid;
+    uint32_t nameId;
+    uint32_t pathId;
+};
+
+/*
+Файл записи снимков процессов для разбора инцидентов и воспроизводимых бенчмарков.
+
+Файл только дописывается: заголовок, затем записи
+    u32 длина тела (little-endian) | u8 тип | тело
+Целые - LEB128 varint, PID в списках - разностью с предыдущим (zigzag),
+uid хранится как uid + 1 (неизвестный владелец - 0).
+    STRINGS:  first, count, count x {length, bytes} - пополнение общей таблицы строк
+    KEYFRAME: generation, timestampNs, rows, rows x {pidDelta, parentPid, startTime, uid, nameId, pathId}
+    DELTA:    generation, timestampNs - прошлый, exited, exited x {pidDelta},
+              upserts, upserts x {pidDelta, parentPid, startTime, uid, nameId, pathId}
+    INDEX:    поколения {offsetDelta, timestampDelta, keyframe} и смещения STRINGS
+После INDEX - хвост: u64 смещение INDEX и магия. Индекс пишет close();
+у файла без хвоста (запись прервалась) индекс восстанавливается проходом
+по заголовкам записей, недописанная последняя запись отбрасывается.
+
+Полный кадр пишется раз в keyframeInterval поколений, между ними - только
+отличия, поэтому поиск по файлу - ближайший KEYFRAME и не больше
+keyframeInterval дельт. Строки хранятся в файле как есть: читатель
+отображает файл в память (mmap) и отдает их без копирования.
+*/
+class SnapshotRecorder {
+public:
+    SnapshotRecorder();
+    ~SnapshotRecorder();
+
+    SnapshotRecorder(const SnapshotRecorder&) = delete;
+    SnapshotRecorder& operator=(const SnapshotRecorder&) = delete;
+
+    //Создает файл заново
+    bool open(const std::string& path);
+    //Дописывает индекс и закрывает файл
+    bool close();
+    bool isOpen() const { return m_file != nullptr; }
+
+    //Одно поколение; timestampNs - время скана (обычно system_clock, нс)
+    bool record(const ProcessTable& table, uint64_t timestampNs);
+
+    void setKeyframeInterval(size_t generations) { m_keyframeInterval = generations > 0 ? generations : 1; }
+    uint64_t generations() const { return m_index.size(); }
+    uint64_t bytesWritten() const { return m_offset; }
+
+private:
+    struct IndexEntry {
+        uint64_t offset;
+        uint64_t timestampNs;
+        bool keyframe;
+    };
+
+    uint32_t mapString(const ProcessTable& table, StringArena::Handle handle);
+    bool flush();
+
+    std::FILE* m_file = nullptr;
+    uint64_t m_offset = 0;
+    size_t m_keyframeInterval = 600;
+    std::string m_buffer;
+    std::string m_listBuffer;
+
+    StringArena m_strings;          //общая таблица строк файла
+    size_t m_stringsWritten = 0;
+    std::vector<uint32_t> m_tableIds; //handle арены таблицы -> номер строки файла
+    const ProcessTable* m_mappedTable = nullptr;
+    uint64_t m_mappedVersion = 0;
+
+    std::vector<RecordedProcess> m_previous; //прошлое поколение по возрастанию PID
+    std::vector<RecordedProcess> m_current;
+    uint64_t m_lastTimestamp = 0;
+    std::vector<IndexEntry> m_index;
+    std::vector<uint64_t> m_stringOffsets;
+};
+
+/*
+Чтение и воспроизведение записи. Файл отображается в память; состояние -
+одно поколение (строки по возрастанию PID), строки - string_view в отображение.
+Объект не потокобезопасен.
+*/
+class SnapshotReader {
+public:
+    SnapshotReader();
+    ~SnapshotReader();
+
+    SnapshotReader(const SnapshotReader&) = delete;
+    SnapshotReader& operator=(const SnapshotReader&) = delete;
+
+    bool open(const std::string& path);
+    void close();
+    bool isOpen() const { return m_data != nullptr; }
+    //Индекс взят из хвоста файла (false - восстановлен проходом)
+    bool indexed() const { return m_indexed; }
+    size_t fileSize() const { return m_size; }
+
+    size_t generations() const { return m_index.size(); }
+    uint64_t timestampNs(size_t index) const { return m_index[index].timestampNs; }
+
+    //Переход к поколению index (0..generations()-1)
+    bool seek(size_t index);
+    //Последнее поколение не позже timestampNs (первое, если все позже)
+    bool seekTime(uint64_t timestampNs);
+    //Следующее поколение; false - запись кончилась
+    bool next();
+    //Номер текущего поколения; generations() - еще ни одного
+    size_t position() const { return m_position; }
+
+    //Текущее поколение
+    size_t rows() const { return m_rows.size(); }
+    uint64_t generation() const { return m_generation; }
+    void fill(ProcessTable& table) const;
+
+    //Источник для SnapshotCache::setSource: каждое обращение - следующее поколение,
+    //после последнего - снова с начала (loop) или последнее поколение
+    size_t replayInto(ProcessTable& table, bool loop = true);
+
+private:
+    struct IndexEntry {
+        uint64_t offset;
+        uint64_t timestampNs;
+        bool keyframe;
+    };
+    bool map(const std::string& path);
+    bool readTrailer();
+    bool scanRecords();
+    bool addStrings(uint64_t offset);
+    bool apply(size_t index);
+
+    const unsigned char* m_data = nullptr;
+    size_t m_size = 0;
+#ifdef _WIN32
+    std::string m_content; //без mmap: файл читается целиком
+#endif
+    bool m_indexed = false;
+
+    std::vector<IndexEntry> m_index;
+    std::vector<std::string_view> m_strings;
+    std::vector<RecordedProcess> m_rows;
+    std::vector<RecordedProcess> m_scratch;
+    std::vector<DWORD> m_exited;            //разбор DELTA
+    std::vector<RecordedProcess> m_upserts;
+    size_t m_position = 0;
+    uint64_t m_generation = 0;
+};
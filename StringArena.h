@@ -0,0 +1,80 @@
+// StringArena.h
+#pragma once
+#include <string>
+#include <string_view>
+#include <deque>
+#include <unordered_map>
+#include <cstdint>
+
+/*
+Интернирование строк: каждая уникальная строка хранится один раз,
+снаружи вместо нее используется 32-битный handle.
+Имена и пути процессов повторяются постоянно (несколько сотен бинарников),
+поэтому после прогрева intern() ничего не аллоцирует.
+std::deque не перемещает элементы при росте - ссылки и string_view стабильны.
+*/
+class StringArena {
+public:
+    typedef uint32_t Handle;
+    static const Handle EMPTY = 0; //handle пустой строки
+
+    StringArena() {
+        clear();
+    }
+
+    StringArena(const StringArena&) = delete;
+    StringArena& operator=(const StringArena&) = delete;
+    StringArena(StringArena&&) = default;
+    StringArena& operator=(StringArena&&) = default;
+
+    Handle intern(std::string_view value) {
+        if (value.empty()) {
+            return EMPTY;
+        }
+        auto it = m_index.find(value);
+        if (it != m_index.end()) {
+            return it->second;
+        }
+        Handle handle = static_cast<Handle>(m_strings.size());
+        m_strings.emplace_back(value);
+        m_index.emplace(std::string_view(m_strings.back()), handle);
+        return handle;
+    }
+
+    //Handle уже интернированной строки без вставки; EMPTY - строки нет
+    Handle find(std::string_view value) const {
+        auto it = m_index.find(value);
+        return it != m_index.end() ? it->second : EMPTY;
+    }
+
+    const std::string& get(Handle handle) const { return m_strings[handle]; }
+    size_t size() const { return m_strings.size(); }
+
+    //Суммарный объем хранимых строк (без накладных расходов контейнеров)
+    size_t bytes() const {
+        size_t total = 0;
+        for (const auto& value : m_strings) {
+            total += value.size();
+        }
+        return total;
+    }
+
+    //Копия другой арены с теми же handle'ами (индекс строится заново - его string_view ссылаются на свои строки)
+    void assign(const StringArena& other) {
+        m_index.clear();
+        m_strings = other.m_strings;
+        for (size_t handle = 1; handle < m_strings.size(); ++handle) {
+            m_index.emplace(std::string_view(m_strings[handle]), static_cast<Handle>(handle));
+        }
+    }
+
+    void clear() {
+        m_index.clear();
+        m_strings.clear();
+        m_strings.emplace_back(); //EMPTY
+    }
+
+private:
+    std::deque<std::string> m_strings;
+    std::unordered_map<std::string_view, Handle> m_index;
+};
@@ -3,6 +3,7 @@
 #include <mutex>
 #include <condition_variable>
 #include <memory> //std::shared_ptr
+#include "Metrics.h"
 
 template<typename T>
 class ThreadSafeQueue {
@@ -10,6 +11,7 @@ class ThreadSafeQueue {
         mutable std::mutex m_mutex; 
         std::queue<T> m_queue;
         std::condition_variable m_condition;
+        MetricGauge* m_depth = nullptr; //глубина очереди в метриках (необязательно)
 /*m_mutex - как дверной замок. Прежде чем работать с очередью, поток должен "взять замок"
 Только один поток может владеть мьютексом
 mutable - позволяет изменять мьютекс в const-методах
@@ -23,11 +25,19 @@ m_condition_variable - позволяет потокам ждать пока в
         ThreadSafeQueue(const ThreadSafeQueue&) = delete;
         ThreadSafeQueue& operator=(const ThreadSafeQueue&) = delete;
 
+        //Показывать глубину очереди в метрике (одна метрика - одна очередь)
+        void setDepthGauge(MetricGauge* gauge) {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_depth = gauge;
+            m_depth->set(static_cast<int64_t>(m_queue.size()));
+        }
+
         //Добавление элемента в очередь
         void push(T value) {
             {
                 std::lock_guard<std::mutex> lock(m_mutex);
                 m_queue.push(std::move(value));
+                changeDepth(1);
             }
         m_condition.notify_one(); //уведомляем один ждущий поток
         }
@@ -46,6 +56,7 @@ m_condition_variable - позволяет потокам ждать пока в
             }
             value = std::move(m_queue.front());
             m_queue.pop();
+            changeDepth(-1);
             return true;
         }
 
@@ -58,6 +69,7 @@ m_condition_variable - позволяет потокам ждать пока в
 
             auto result = std::make_shared<T>(std::move(m_queue.front()));
             m_queue.pop();
+            changeDepth(-1);
             return result;
         }
     //Блокирующее извлеченеи когда можно ждать данные
@@ -69,6 +81,7 @@ m_condition_variable - позволяет потокам ждать пока в
 
         T value = std::move(m_queue.front());
         m_queue.pop();
+        changeDepth(-1);
         return value;
     }
 /*
@@ -85,6 +98,7 @@ m_condition.wait(lock, условие);
 
         auto result = std::make_shared<T>(std::move(m_queue.front()));
         m_queue.pop();
+        changeDepth(-1);
         return result;
     }
 
@@ -100,6 +114,14 @@ m_condition.wait(lock, условие);
         return m_queue.size();
 
     }
+
+    private:
+        //Под m_mutex
+        void changeDepth(int64_t delta) {
+            if (m_depth) {
+                m_depth->add(delta);
+            }
+        }
 };
 
 
@@ -0,0 +1,105 @@
+// Бенчмарк SHA-256: пропускная способность каждого ядра в GB/s
+// Использование: HashBench [МБ на поток] [число файлов для hashFiles]
+#include <iostream>
+#include <vector>
+#include <string>
+#include <chrono>
+#include <cstdlib>
+#include <cstdio>
+#include <fcntl.h>
+#include <unistd.h>
+#include "Sha256.h"
+#include "SecurityUtils.h"
+
+namespace {
+
+double secondsSince(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+void report(const char* kernel, const char* mode, size_t bytes, double seconds) {
+    std::printf("%-8s %-18s %8.3f GB/s\n", kernel, mode, static_cast<double>(bytes) / seconds / 1e9);
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+    size_t megabytes = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 64;
+    size_t fileCount = argc > 2 ? std::strtoul(argv[2], nullptr, 10) : 64;
+    size_t size = megabytes << 20;
+
+    std::vector<unsigned char> buffer(size);
+    for (size_t i = 0; i < size; ++i) {
+        buffer[i] = static_cast<unsigned char>(i * 131 + (i >> 9));
+    }
+
+    Sha256::Kernel original = Sha256::activeKernel();
+    std::cout << "Detected kernel: " << Sha256::kernelName(original) << std::endl;
+
+    for (auto kernel : {Sha256::Kernel::Scalar, Sha256::Kernel::ShaNi, Sha256::Kernel::Avx2}) {
+        const char* name = Sha256::kernelName(kernel);
+        if (!Sha256::isSupported(kernel)) {
+            std::printf("%-8s not supported on this CPU\n", name);
+            continue;
+        }
+        Sha256::setKernel(kernel);
+        unsigned char digest[Sha256::DIGEST_SIZE];
+
+        //Один поток данных (для avx2-x8 это скалярное ядро)
+        auto start = std::chrono::steady_clock::now();
+        Sha256::hash(buffer.data(), size, digest);
+        report(name, "single-stream", size, secondsSince(start));
+
+        //8 независимых сообщений за проход
+        const unsigned char* data[Sha256::MAX_LANES];
+        size_t sizes[Sha256::MAX_LANES];
+        unsigned char digests[Sha256::MAX_LANES][Sha256::DIGEST_SIZE];
+        for (size_t i = 0; i < Sha256::MAX_LANES; ++i) {
+            data[i] = buffer.data() + i * (size / Sha256::MAX_LANES);
+            sizes[i] = size / Sha256::MAX_LANES;
+        }
+        start = std::chrono::steady_clock::now();
+        Sha256::hashMany(data, sizes, Sha256::MAX_LANES, digests);
+        report(name, "multi-buffer x8", size, secondsSince(start));
+    }
+
+    //hashFiles по набору временных файлов (из page cache)
+    char pattern[] = "/tmp/hashbench.XXXXXX";
+    if (!::mkdtemp(pattern)) {
+        std::cerr << "mkdtemp failed" << std::endl;
+        return 1;
+    }
+    std::string root = pattern;
+    std::vector<std::string> paths;
+    size_t fileSize = size / fileCount + 17; //не кратно блоку
+    size_t totalBytes = 0;
+    for (size_t i = 0; i < fileCount; ++i) {
+        std::string path = root + "/file" + std::to_string(i);
+        int fd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        size_t length = std::min(fileSize, size);
+        if (fd < 0 || ::write(fd, buffer.data(), length) != static_cast<ssize_t>(length)) {
+            std::cerr << "Cannot write " << path << std::endl;
+            return 1;
+        }
+        ::close(fd);
+        paths.push_back(path);
+        totalBytes += length;
+    }
+
+    for (auto kernel : {Sha256::Kernel::Scalar, Sha256::Kernel::ShaNi, Sha256::Kernel::Avx2}) {
+        if (!Sha256::isSupported(kernel)) {
+            continue;
+        }
+        Sha256::setKernel(kernel);
+        auto start = std::chrono::steady_clock::now();
+        auto hashes = SecurityUtils::hashFiles(paths);
+        report(Sha256::kernelName(kernel), "hashFiles", totalBytes, secondsSince(start));
+    }
+    Sha256::setKernel(original);
+
+    for (const auto& path : paths) {
+        ::unlink(path.c_str());
+    }
+    ::rmdir(root.c_str());
+    return 0;
+}
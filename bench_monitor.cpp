@@ -0,0 +1,1267 @@
+// Набор микробенчмарков монитора с машиночитаемым результатом (JSON)
+// Использование: MonitorBench [--output файл] [--processes N] [--max-threads N] [--quick]
+// Без --output результат печатается в stdout; ход выполнения - в stderr.
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include "BenchUtils.h"
+#include "ThreadSafeQueue.h"
+#include "BoundedQueue.h"
+#include "ProcFsReader.h"
+#include "ProcessSampler.h"
+#include "ProcessTable.h"
+#include "ProcessTree.h"
+#include "RuleEngine.h"
+#include "ProcessJson.h"
+#include "ProcessBinary.h"
+#include "JsonWriter.h"
+#include "Sha256.h"
+#include "SnapshotFile.h"
+#include "HistoryStore.h"
+#include "SecureLog.h"
+#include "Metrics.h"
+#include "ProcessQuery.h"
+#include "RefreshScheduler.h"
+#include "IntegrityManifest.h"
+#include "FdInventory.h"
+
+namespace {
+
+typedef std::chrono::steady_clock Clock;
+
+uint64_t nowNs() {
+    return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+        Clock::now().time_since_epoch()).count());
+}
+
+/*
+Один результат: имя бенчмарка, параметры и метрики.
+Все значения числовые, поэтому JSON собирается без экранирования метрик.
+*/
+struct Result {
+    std::string name;
+    std::vector<std::pair<std::string, std::string>> params;
+    std::vector<std::pair<std::string, double>> metrics;
+
+    Result& param(const std::string& key, const std::string& value) {
+        params.emplace_back(key, value);
+        return *this;
+    }
+    Result& metric(const std::string& key, double value) {
+        metrics.emplace_back(key, value);
+        return *this;
+    }
+};
+
+struct Options {
+    std::string output;
+    size_t processes = 20000;
+    size_t maxThreads = 0; //0 - по числу ядер (не меньше 2)
+    bool quick = false;
+};
+
+//Элемент очереди: время постановки для измерения задержки; 0 - сигнал остановки
+struct QueueItem {
+    uint64_t pushedNs = 0;
+};
+
+/*
+Адаптеры к общему интерфейсу: ThreadSafeQueue не умеет закрываться,
+поэтому потребители останавливаются по сигнальным элементам.
+*/
+struct MutexQueueAdapter {
+    static const char* name() { return "ThreadSafeQueue"; }
+    ThreadSafeQueue<QueueItem> queue;
+
+    void push(const QueueItem& item) { queue.push(item); }
+    bool pop(QueueItem& item) {
+        item = queue.wait_and_pop();
+        return item.pushedNs != 0;
+    }
+    void stop(size_t consumers) {
+        for (size_t i = 0; i < consumers; ++i) {
+            queue.push(QueueItem());
+        }
+    }
+};
+
+struct BoundedQueueAdapter {
+    static const char* name() { return "BoundedQueue"; }
+    BoundedQueue<QueueItem> queue{4096};
+
+    void push(const QueueItem& item) { queue.push(item); }
+    bool pop(QueueItem& item) { return queue.pop(item); }
+    void stop(size_t) { queue.close(); }
+};
+
+template<typename Adapter>
+Result benchQueue(size_t producers, size_t consumers, size_t itemsPerProducer) {
+    Adapter adapter;
+    std::vector<std::vector<uint64_t>> latencies(consumers);
+    std::atomic<bool> go{false};
+    std::vector<std::thread> threads;
+
+    for (size_t c = 0; c < consumers; ++c) {
+        latencies[c].reserve(producers * itemsPerProducer / consumers + 1);
+        threads.emplace_back([&, c]() {
+            QueueItem item;
+            while (adapter.pop(item)) {
+                latencies[c].push_back(nowNs() - item.pushedNs);
+            }
+        });
+    }
+
+    std::vector<std::thread> producerThreads;
+    for (size_t p = 0; p < producers; ++p) {
+        producerThreads.emplace_back([&]() {
+            while (!go.load(std::memory_order_acquire)) {
+                std::this_thread::yield();
+            }
+            for (size_t i = 0; i < itemsPerProducer; ++i) {
+                QueueItem item;
+                item.pushedNs = nowNs();
+                adapter.push(item);
+            }
+        });
+    }
+
+    auto start = Clock::now();
+    go.store(true, std::memory_order_release);
+    for (auto& thread : producerThreads) {
+        thread.join();
+    }
+    adapter.stop(consumers);
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+
+    std::vector<uint64_t> all;
+    for (auto& part : latencies) {
+        all.insert(all.end(), part.begin(), part.end());
+    }
+
+    Result result;
+    result.name = "queue";
+    result.param("queue", Adapter::name())
+          .param("producers", std::to_string(producers))
+          .param("consumers", std::to_string(consumers))
+          .metric("items", static_cast<double>(all.size()))
+          .metric("ops_per_sec", seconds > 0 ? static_cast<double>(all.size()) / seconds : 0)
+          .metric("latency_p50_ns", static_cast<double>(bench::percentile(all, 0.50)))
+          .metric("latency_p90_ns", static_cast<double>(bench::percentile(all, 0.90)))
+          .metric("latency_p99_ns", static_cast<double>(bench::percentile(all, 0.99)))
+          .metric("latency_p999_ns", static_cast<double>(bench::percentile(all, 0.999)));
+    return result;
+}
+
+//Стоимость перечисления: сырой обход ProcFsReader и полный ProcessTable::scan
+void benchEnumeration(const std::string& source, const std::string& root, int iterations,
+                      std::vector<Result>& results) {
+    ProcFsReader reader(root);
+    if (!reader.isOpen()) {
+        std::cerr << "Cannot open " << root << std::endl;
+        return;
+    }
+
+    ProcessTable table;
+    std::vector<double> rawTimes;
+    std::vector<double> tableTimes;
+    size_t found = 0;
+    size_t checksum = 0;
+    for (int i = 0; i < iterations; ++i) {
+        auto start = Clock::now();
+        found = reader.forEachProcess([&checksum](const ProcessRecord& record) {
+            checksum += record.parentPid + record.path.size();
+        });
+        auto middle = Clock::now();
+        table.scan(reader);
+        auto end = Clock::now();
+        rawTimes.push_back(std::chrono::duration<double, std::nano>(middle - start).count());
+        tableTimes.push_back(std::chrono::duration<double, std::nano>(end - middle).count());
+    }
+    if (found == 0) {
+        return;
+    }
+
+    double perProcess = static_cast<double>(found);
+    results.push_back(Result());
+    results.back().name = "enumeration";
+    results.back().param("source", source).param("method", "ProcFsReader")
+        .metric("processes", perProcess)
+        .metric("median_ms", bench::median(rawTimes) / 1e6)
+        .metric("ns_per_process", bench::median(rawTimes) / perProcess);
+
+    results.push_back(Result());
+    results.back().name = "enumeration";
+    results.back().param("source", source).param("method", "ProcessTable::scan")
+        .metric("processes", static_cast<double>(table.size()))
+        .metric("median_ms", bench::median(tableTimes) / 1e6)
+        .metric("ns_per_process", bench::median(tableTimes) / perProcess);
+
+    if (checksum == 0) {
+        std::cerr << "Empty enumeration checksum" << std::endl;
+    }
+}
+
+/*
+Скан с расписанием (RefreshScheduler) против полного ProcessTable::scan в
+установившемся режиме: после прогрева простаивающие процессы не перечитывают
+путь и владельца. path_reads_per_scan - сколько путей читает один скан.
+*/
+void benchRefresh(const std::string& source, const std::string& root, int iterations,
+                  std::vector<Result>& results) {
+    ProcFsReader reader(root);
+    if (!reader.isOpen()) {
+        std::cerr << "Cannot open " << root << std::endl;
+        return;
+    }
+    ProcessTable table;
+    RefreshScheduler scheduler;
+    //Прогрев: все процессы успевают перейти в Idle, если они простаивают
+    for (uint32_t i = 0; i <= scheduler.policy().quietCycles; ++i) {
+        table.scan(reader, scheduler);
+    }
+    uint64_t readsBefore = scheduler.refreshes(RefreshScheduler::Attribute::Path);
+    std::vector<double> scheduledTimes;
+    std::vector<double> fullTimes;
+    for (int i = 0; i < iterations; ++i) {
+        auto start = Clock::now();
+        table.scan(reader, scheduler);
+        auto middle = Clock::now();
+        table.scan(reader);
+        auto end = Clock::now();
+        scheduledTimes.push_back(std::chrono::duration<double, std::nano>(middle - start).count());
+        fullTimes.push_back(std::chrono::duration<double, std::nano>(end - middle).count());
+    }
+    if (table.empty() || iterations == 0) {
+        return;
+    }
+    double processes = static_cast<double>(table.size());
+    double reads = static_cast<double>(scheduler.refreshes(RefreshScheduler::Attribute::Path) - readsBefore) / iterations;
+
+    results.push_back(Result());
+    results.back().name = "refresh";
+    results.back().param("source", source)
+        .metric("processes", processes)
+        .metric("idle", static_cast<double>(scheduler.tierCount(RefreshScheduler::Tier::Idle)))
+        .metric("path_reads_per_scan", reads)
+        .metric("scheduled_median_ms", bench::median(scheduledTimes) / 1e6)
+        .metric("full_median_ms", bench::median(fullTimes) / 1e6)
+        .metric("scheduled_ns_per_process", bench::median(scheduledTimes) / processes)
+        .metric("full_ns_per_process", bench::median(fullTimes) / processes);
+}
+
+/*
+Инвентарь дескрипторов по реальному /proc: инкрементальный скан (каталоги fd
+только у процессов с изменившимся числом дескрипторов) против полного
+(rescanEvery = 1 - каждый каталог каждый скан). Таблицы сокетов разбираются
+в обоих случаях. copy_median_ms - копия для публикации в поколении снимка,
+lookup_port_ns - поиск держателей порта по индексу.
+*/
+void benchFds(int iterations, std::vector<Result>& results) {
+    ProcessTable table;
+    table.scan();
+    FdInventory incremental;
+    FdInventory full;
+    full.setRescanEvery(1);
+    incremental.scan(table);
+    full.scan(table);
+    std::vector<double> incrementalTimes;
+    std::vector<double> fullTimes;
+    size_t rescanned = 0;
+    for (int i = 0; i < iterations; ++i) {
+        auto start = Clock::now();
+        incremental.scan(table);
+        auto middle = Clock::now();
+        full.scan(table);
+        auto end = Clock::now();
+        rescanned += incremental.rescanned();
+        incrementalTimes.push_back(std::chrono::duration<double, std::nano>(middle - start).count());
+        fullTimes.push_back(std::chrono::duration<double, std::nano>(end - middle).count());
+    }
+    if (iterations == 0 || incremental.processes().empty()) {
+        return;
+    }
+
+    //Порты всех известных сокетов по кругу
+    std::vector<uint16_t> ports;
+    for (const FdInventory::Process& process : incremental.processes()) {
+        for (const FdInventory::Fd& fd : process.fds) {
+            const FdInventory::Socket* socket = incremental.findSocket(fd.inode);
+            if (socket && socket->localPort != 0) {
+                ports.push_back(socket->localPort);
+            }
+        }
+    }
+    if (ports.empty()) {
+        ports.push_back(1);
+    }
+    std::vector<FdInventory::Holder> holders;
+    const size_t lookups = 1000000;
+    size_t found = 0;
+    auto start = Clock::now();
+    for (size_t i = 0; i < lookups; ++i) {
+        holders.clear();
+        found += incremental.findByPort(ports[i % ports.size()], holders);
+    }
+    double lookupNs = std::chrono::duration<double, std::nano>(Clock::now() - start).count() / lookups;
+    if (found == 0 && ports.size() > 1) {
+        std::cerr << "Port lookups found nothing" << std::endl;
+    }
+
+    //Публикация поколения: неизменяемая копия для потоков сервера
+    std::vector<double> copyTimes;
+    for (int i = 0; i < iterations; ++i) {
+        FdInventory copy;
+        auto copyStart = Clock::now();
+        copy.copyFrom(incremental);
+        copyTimes.push_back(std::chrono::duration<double, std::nano>(Clock::now() - copyStart).count());
+    }
+
+    results.push_back(Result());
+    results.back().name = "fd_inventory";
+    results.back().param("source", "procfs")
+        .metric("processes", static_cast<double>(incremental.processes().size()))
+        .metric("fds", static_cast<double>(incremental.fdCount()))
+        .metric("sockets", static_cast<double>(incremental.socketCount()))
+        .metric("rescanned_per_scan", static_cast<double>(rescanned) / iterations)
+        .metric("incremental_median_ms", bench::median(incrementalTimes) / 1e6)
+        .metric("full_median_ms", bench::median(fullTimes) / 1e6)
+        .metric("copy_median_ms", bench::median(copyTimes) / 1e6)
+        .metric("lookup_port_ns", lookupNs);
+}
+
+/*
+Сбор ресурсов: полный сэмпл CPU/RSS/потоков/io всех процессов.
+files=cached - stat/io открыты между сэмплами (в пределах лимита дескрипторов),
+files=reopen - открытие на каждый сэмпл.
+schedule=tiered - io по расписанию RefreshScheduler (в установившемся режиме - только активные процессы).
+cpu_percent_at_1hz - доля одного ядра при сэмпле раз в секунду.
+*/
+void benchSampling(const std::string& source, const std::string& root, int iterations,
+                   std::vector<Result>& results) {
+    struct Mode {
+        bool io;
+        bool cached;
+        bool tiered;
+    };
+    const Mode modes[] = {{true, true, false}, {true, false, false}, {false, true, false}, {true, true, true}};
+    for (const Mode& mode : modes) {
+        ProcessSampler sampler(root);
+        if (!sampler.isOpen()) {
+            std::cerr << "Cannot open " << root << std::endl;
+            return;
+        }
+        sampler.setCollectIo(mode.io);
+        if (!mode.cached) {
+            sampler.setOpenFileBudget(0);
+        }
+        RefreshScheduler scheduler;
+        auto sample = [&]() { return mode.tiered ? sampler.sample(scheduler) : sampler.sample(); };
+        sample(); //прогрев: дальше считаются скорости
+        std::vector<double> times;
+        size_t found = 0;
+        for (int i = 0; i < iterations; ++i) {
+            auto start = Clock::now();
+            found = sample();
+            times.push_back(std::chrono::duration<double, std::nano>(Clock::now() - start).count());
+        }
+        if (found == 0) {
+            return;
+        }
+        size_t withIo = 0;
+        for (const auto& sample : sampler.samples()) {
+            withIo += sample.hasIo ? 1 : 0;
+        }
+        double median = bench::median(times);
+        results.push_back(Result());
+        results.back().name = "sampling";
+        results.back().param("source", source).param("io", mode.io ? "true" : "false")
+            .param("files", mode.cached ? "cached" : "reopen")
+            .param("schedule", mode.tiered ? "tiered" : "every")
+            .metric("processes", static_cast<double>(found))
+            .metric("io_readable", static_cast<double>(withIo))
+            .metric("open_files", static_cast<double>(sampler.openFiles()))
+            .metric("median_ms", median / 1e6)
+            .metric("ns_per_process", median / static_cast<double>(found))
+            .metric("cpu_percent_at_1hz", median / 1e9 * 100.0);
+    }
+}
+
+/*
+Дерево процессов: сборка за O(n) и типичные запросы - поддерево, цепочка предков,
+pid -> строка. Родитель каждого процесса - случайный более ранний процесс,
+как у долгоживущих сервисов с форками.
+*/
+void benchTree(size_t processes, int iterations, std::vector<Result>& results) {
+    std::vector<DWORD> pids(processes);
+    std::vector<DWORD> parentPids(processes);
+    uint64_t seed = 88172645463325252ull;
+    for (size_t i = 0; i < processes; ++i) {
+        seed ^= seed << 13;
+        seed ^= seed >> 7;
+        seed ^= seed << 17;
+        pids[i] = static_cast<DWORD>(i + 1);
+        //Треть процессов - прямые потомки недавних родителей: глубокие цепочки
+        size_t parent = i == 0 ? 0 : (seed % 3 == 0 ? i : seed % i + 1);
+        parentPids[i] = static_cast<DWORD>(parent);
+    }
+
+    ProcessTree tree;
+    std::vector<double> buildTimes;
+    for (int i = 0; i < iterations; ++i) {
+        auto start = Clock::now();
+        tree.build(pids, parentPids);
+        buildTimes.push_back(std::chrono::duration<double, std::nano>(Clock::now() - start).count());
+    }
+
+    //Запросы по случайным процессам: поддерево целиком и путь до корня
+    const size_t queries = 10000;
+    std::vector<ProcessTree::Row> chain;
+    size_t visited = 0;
+    size_t checksum = 0;
+    size_t chainLength = 0;
+    auto start = Clock::now();
+    for (size_t q = 0; q < queries; ++q) {
+        size_t row = tree.findRow(pids[(q * 7919) % processes]);
+        ProcessTree::Range subtree = tree.subtree(row);
+        for (ProcessTree::Row member : subtree) {
+            checksum += member;
+        }
+        visited += subtree.size();
+        tree.ancestors(row, chain);
+        chainLength += chain.size();
+    }
+    double queryNs = std::chrono::duration<double, std::nano>(Clock::now() - start).count() / static_cast<double>(queries);
+
+    size_t maxDepth = 0;
+    for (size_t row = 0; row < tree.size(); ++row) {
+        maxDepth = std::max<size_t>(maxDepth, tree.depth(row));
+    }
+    results.push_back(Result());
+    results.back().name = "process_tree";
+    results.back().param("shape", "random_forks")
+        .metric("processes", static_cast<double>(processes))
+        .metric("build_ms", bench::median(buildTimes) / 1e6)
+        .metric("build_ns_per_process", bench::median(buildTimes) / static_cast<double>(processes))
+        .metric("query_ns", queryNs)
+        .metric("avg_subtree_size", static_cast<double>(visited) / static_cast<double>(queries))
+        .metric("avg_ancestry", static_cast<double>(chainLength) / static_cast<double>(queries))
+        .metric("max_depth", static_cast<double>(maxDepth));
+    if (checksum == 0) {
+        std::cerr << "Empty tree checksum" << std::endl;
+    }
+}
+
+/*
+Запись снимков: processes процессов, каждое поколение churnPercent из них
+заменяются новыми (новый PID), у части меняется владелец. Размер файла
+на поколение и пересчет на сутки при скане раз в секунду; чтение -
+открытие, последовательный проход и произвольный поиск.
+*/
+void benchRecording(const std::string& shape, size_t processes, size_t generations, double churnPercent,
+                    std::vector<Result>& results) {
+    char pattern[] = "/tmp/recbench.XXXXXX";
+    if (!::mkdtemp(pattern)) {
+        std::cerr << "Cannot create temp dir for recording" << std::endl;
+        return;
+    }
+    std::string dir = pattern;
+    std::string file = dir + "/bench.pms";
+
+    std::vector<ProcessRecord> live(processes);
+    std::vector<std::string> names(processes);
+    std::vector<std::string> paths(processes);
+    DWORD nextPid = 1;
+    for (size_t i = 0; i < processes; ++i) {
+        names[i] = "worker" + std::to_string(i % 300);
+        paths[i] = "/usr/lib/app" + std::to_string(i % 40) + "/" + names[i];
+        live[i].pid = nextPid++;
+        live[i].parentPid = i == 0 ? 0 : live[i / 8].pid;
+        live[i].startTime = 1000 + i;
+        live[i].uid = i % 3 == 0 ? 0 : 1000 + static_cast<uint32_t>(i % 7);
+    }
+    size_t churn = std::max<size_t>(1, static_cast<size_t>(static_cast<double>(processes) * churnPercent / 100.0));
+    uint64_t seed = 88172645463325252ull;
+
+    SnapshotRecorder recorder;
+    recorder.setKeyframeInterval(600);
+    if (!recorder.open(file)) {
+        bench::removeTree(dir);
+        return;
+    }
+    ProcessTable table;
+    std::vector<double> recordTimes;
+    for (size_t generation = 0; generation < generations; ++generation) {
+        for (size_t c = 0; generation > 0 && c < churn; ++c) {
+            seed ^= seed << 13;
+            seed ^= seed >> 7;
+            seed ^= seed << 17;
+            size_t i = 1 + seed % (processes - 1);
+            live[i].pid = nextPid++;
+            live[i].startTime = 1000 + generation * 100 + c;
+            live[i].uid = c % 10 == 0 ? 1000 + static_cast<uint32_t>(generation % 5) : live[i].uid;
+        }
+        //Таблица строится как после скана: строки заново по возрастанию PID
+        table.clear();
+        for (size_t i = 0; i < processes; ++i) {
+            live[i].name = names[i];
+            live[i].path = paths[i];
+            table.append(live[i]);
+        }
+        table.finishScan();
+        auto start = Clock::now();
+        recorder.record(table, 1000000000ull * (generation + 1));
+        recordTimes.push_back(std::chrono::duration<double, std::micro>(Clock::now() - start).count());
+    }
+    recorder.close();
+    double bytes = static_cast<double>(recorder.bytesWritten());
+
+    SnapshotReader reader;
+    auto openStart = Clock::now();
+    bool opened = reader.open(file);
+    double openMs = std::chrono::duration<double, std::milli>(Clock::now() - openStart).count();
+    ProcessTable replayed;
+    auto passStart = Clock::now();
+    size_t rows = 0;
+    while (opened && reader.next()) {
+        reader.fill(replayed);
+        rows += replayed.size();
+    }
+    double passMs = std::chrono::duration<double, std::milli>(Clock::now() - passStart).count();
+    const size_t seeks = 50;
+    auto seekStart = Clock::now();
+    for (size_t s = 0; opened && s < seeks; ++s) {
+        reader.seek((s * 7919) % generations);
+    }
+    double seekMs = std::chrono::duration<double, std::milli>(Clock::now() - seekStart).count() / static_cast<double>(seeks);
+    reader.close();
+    bench::removeTree(dir);
+
+    double perGeneration = bytes / static_cast<double>(generations);
+    results.push_back(Result());
+    results.back().name = "snapshot_recording";
+    results.back().param("shape", shape)
+        .metric("processes", static_cast<double>(processes))
+        .metric("generations", static_cast<double>(generations))
+        .metric("churn_percent", churnPercent)
+        .metric("record_us", bench::median(recordTimes))
+        .metric("file_bytes", bytes)
+        .metric("bytes_per_generation", perGeneration)
+        .metric("day_mb_at_1hz", perGeneration * 86400.0 / 1e6)
+        .metric("open_ms", openMs)
+        .metric("next_fill_ms", passMs / static_cast<double>(generations))
+        .metric("seek_ms", seekMs);
+    if (rows != processes * generations) {
+        std::cerr << "Recording replay mismatch: " << rows << " rows" << std::endl;
+    }
+}
+
+/*
+История: processes процессов, сэмпл раз в секунду. Время record() на сэмпл
+(с переходами минутных и десятиминутных сверток), запрос часа истории
+и память: кольца выделяются сразу на сутки, поэтому memory_mb уже итоговая.
+*/
+void benchHistory(size_t processes, uint32_t seconds, std::vector<Result>& results) {
+    HistoryStore history;
+    std::vector<HistoryInput> inputs(processes);
+    for (size_t i = 0; i < processes; ++i) {
+        inputs[i].pid = static_cast<DWORD>(i + 1);
+        inputs[i].startTime = 1000 + i;
+        inputs[i].threads = 1 + static_cast<uint32_t>(i % 16);
+    }
+    const uint32_t start = 1700000000;
+    std::vector<double> recordTimes;
+    for (uint32_t t = 0; t < seconds; ++t) {
+        for (size_t i = 0; i < processes; ++i) {
+            inputs[i].cpuPercent = static_cast<double>((i + t) % 100);
+            inputs[i].rssBytes = (i % 1000 + t) * 4096ull;
+            inputs[i].readBytesPerSec = static_cast<double>((i * 7919 + t) % 100000);
+        }
+        auto begin = Clock::now();
+        history.record(start + t, inputs);
+        recordTimes.push_back(std::chrono::duration<double, std::micro>(Clock::now() - begin).count());
+    }
+
+    const size_t queries = 1000;
+    HistoryResult result;
+    size_t points = 0;
+    auto begin = Clock::now();
+    for (size_t q = 0; q < queries; ++q) {
+        history.query(static_cast<DWORD>(1 + (q * 7919) % processes), 0, start + seconds - 3600, start + seconds, 0, result);
+        points += result.samples.size();
+    }
+    double queryUs = std::chrono::duration<double, std::micro>(Clock::now() - begin).count() / static_cast<double>(queries);
+
+    results.push_back(Result());
+    results.back().name = "history_store";
+    results.back().param("tiers", "1s x300, 60s x360, 600s x144")
+        .metric("processes", static_cast<double>(processes))
+        .metric("seconds", seconds)
+        .metric("record_us", bench::median(recordTimes))
+        .metric("record_ns_per_process", bench::median(recordTimes) * 1000.0 / static_cast<double>(processes))
+        .metric("query_hour_us", queryUs)
+        .metric("query_points", static_cast<double>(points) / static_cast<double>(queries))
+        .metric("bytes_per_process", static_cast<double>(history.bytesPerProcess()))
+        .metric("memory_mb", static_cast<double>(history.memoryBytes()) / 1e6)
+        .metric("rejected", static_cast<double>(history.rejected()));
+}
+
+/*
+Журнал безопасности: threads потоков пишут по messages событий подряд.
+log_ns - стоимость вызова в потоке (без ожидания диска), drain_ms - сколько
+после этого поток сброса дописывает хвост и синхронизирует файл.
+*/
+void benchSecureLog(size_t threads, size_t messages, std::vector<Result>& results) {
+    char pattern[] = "/tmp/logbench.XXXXXX";
+    if (!::mkdtemp(pattern)) {
+        std::cerr << "Cannot create temp dir for secure log" << std::endl;
+        return;
+    }
+    std::string dir = pattern;
+    SecureLog log;
+    log.setThreadBuffer(4u << 20);
+    if (!log.open(dir + "/security.log")) {
+        bench::removeTree(dir);
+        return;
+    }
+    std::vector<double> perCall(threads);
+    std::vector<std::thread> writers;
+    auto start = Clock::now();
+    for (size_t t = 0; t < threads; ++t) {
+        writers.emplace_back([&log, &perCall, t, messages]() {
+            //Сообщения готовятся заранее: измеряется только log()
+            std::vector<std::string> prepared(64);
+            for (size_t i = 0; i < prepared.size(); ++i) {
+                prepared[i] = "spawn pid=" + std::to_string(1000 + i) + " parent=1 name=worker";
+            }
+            auto begin = Clock::now();
+            for (size_t i = 0; i < messages; ++i) {
+                log.log(prepared[i & 63]);
+            }
+            perCall[t] = std::chrono::duration<double, std::nano>(Clock::now() - begin).count() / static_cast<double>(messages);
+        });
+    }
+    for (auto& writer : writers) {
+        writer.join();
+    }
+    double writeMs = std::chrono::duration<double, std::milli>(Clock::now() - start).count();
+    auto drainStart = Clock::now();
+    log.flush();
+    double drainMs = std::chrono::duration<double, std::milli>(Clock::now() - drainStart).count();
+    double total = static_cast<double>(threads * messages);
+
+    results.push_back(Result());
+    results.back().name = "secure_log";
+    results.back().param("threads", std::to_string(threads))
+        .metric("messages", total)
+        .metric("log_ns", bench::median(perCall))
+        .metric("producer_mps", total / writeMs / 1000.0)
+        .metric("drain_ms", drainMs)
+        .metric("end_to_end_mps", static_cast<double>(log.written()) / (writeMs + drainMs) / 1000.0)
+        .metric("dropped", static_cast<double>(log.dropped()))
+        .metric("syncs", static_cast<double>(log.syncs()));
+    log.close();
+    bench::removeTree(dir);
+}
+
+/*
+Запросы с отбором на синтетической таблице processes процессов с метриками:
+top-10 по CPU (nth_element) против полной сортировки того же запроса без limit,
+условие с шаблоном имени и порогом, ответ из кеша того же поколения.
+*/
+void benchQuery(size_t processes, int iterations, std::vector<Result>& results) {
+    ProcessTable table;
+    std::vector<HistoryInput> inputs;
+    for (size_t i = 0; i < processes; ++i) {
+        ProcessRecord record;
+        record.pid = static_cast<DWORD>(100 + i);
+        record.parentPid = static_cast<DWORD>(100 + i / 16);
+        record.startTime = 1000 + i;
+        record.uid = i % 3 == 0 ? 0 : 1000;
+        std::string name = "proc-" + std::to_string(i % 300);
+        std::string path = "/usr/lib/app/" + name;
+        record.name = name;
+        record.path = path;
+        table.append(record);
+        HistoryInput input;
+        input.pid = record.pid;
+        input.startTime = record.startTime;
+        input.cpuPercent = static_cast<double>((i * 7919) % 10007) / 100.0;
+        input.rssBytes = static_cast<uint64_t>((i * 104729) % 2048) << 20;
+        input.threads = static_cast<uint32_t>(i % 64 + 1);
+        inputs.push_back(input);
+    }
+    table.finishScan();
+    HistoryStore history;
+    history.record(1000, inputs);
+    std::vector<HistorySample> metrics;
+    history.latestSamples(table.pids(), table.startTimes(), metrics);
+
+    auto compile = [](const std::string& text, ProcessQuery& query) {
+        ProtocolRequest request;
+        std::string error;
+        return ProcessJson::parseRequest(text, request) && query.compile(request, error);
+    };
+    ProcessQuery top;
+    ProcessQuery full;
+    ProcessQuery filtered;
+    if (!compile("{\"command\":\"get_processes\",\"sort_by\":\"cpu\",\"limit\":10,\"fields\":\"pid,name,cpu\"}", top) ||
+        !compile("{\"command\":\"get_processes\",\"sort_by\":\"cpu\",\"fields\":\"pid,name,cpu\"}", full) ||
+        !compile("{\"command\":\"get_processes\",\"where\":\"name=proc-1* and rss>=1G and uid=1000\",\"sort_by\":\"rss\",\"limit\":100}", filtered)) {
+        std::cerr << "Query benchmark: compile failed" << std::endl;
+        return;
+    }
+
+    std::vector<uint32_t> rows;
+    size_t matched = 0;
+    auto measure = [&](const ProcessQuery& query) {
+        std::vector<double> times;
+        for (int i = 0; i < iterations; ++i) {
+            auto begin = Clock::now();
+            query.run(table, &metrics, rows, matched);
+            times.push_back(std::chrono::duration<double, std::milli>(Clock::now() - begin).count());
+        }
+        return bench::median(times);
+    };
+    double topMs = measure(top);
+    double fullMs = measure(full);
+    double filteredMs = measure(filtered);
+    size_t filteredMatched = matched;
+
+    //Первый запрос поколения выполняется, повторы берутся из кеша
+    QueryCache cache;
+    auto begin = Clock::now();
+    cache.get(top, table, 1, &history);
+    double missUs = std::chrono::duration<double, std::micro>(Clock::now() - begin).count();
+    const int repeats = 10000;
+    begin = Clock::now();
+    for (int i = 0; i < repeats; ++i) {
+        cache.get(top, table, 1, &history);
+    }
+    double hitNs = std::chrono::duration<double, std::nano>(Clock::now() - begin).count() / repeats;
+
+    results.push_back(Result());
+    results.back().name = "query";
+    results.back().param("source", "synthetic")
+        .metric("processes", static_cast<double>(processes))
+        .metric("top10_cpu_ms", topMs)
+        .metric("full_sort_cpu_ms", fullMs)
+        .metric("filtered_ms", filteredMs)
+        .metric("filtered_matched", static_cast<double>(filteredMatched))
+        .metric("cache_miss_us", missUs)
+        .metric("cache_hit_ns", hitNs);
+}
+
+/*
+Манифест эталонных хешей: сборка совершенного хеша, открытие (только заголовок,
+файл отображается в память) и поиск пути - попадание и путь не из манифеста.
+*/
+void benchManifest(size_t entries, std::vector<Result>& results) {
+    const std::string file = "bench_manifest.bin";
+    ManifestCompiler compiler;
+    std::string digest(64, 'a');
+    std::vector<std::string> paths;
+    paths.reserve(entries);
+    for (size_t i = 0; i < entries; ++i) {
+        paths.push_back("/usr/lib/package-" + std::to_string(i % 5000) + "/bin/tool-" + std::to_string(i));
+        compiler.add(paths.back(), digest);
+    }
+    auto begin = Clock::now();
+    if (!compiler.write(file)) {
+        return;
+    }
+    double compileMs = std::chrono::duration<double, std::milli>(Clock::now() - begin).count();
+
+    IntegrityManifest manifest;
+    begin = Clock::now();
+    bool opened = manifest.open(file);
+    double openUs = std::chrono::duration<double, std::micro>(Clock::now() - begin).count();
+    if (!opened) {
+        std::remove(file.c_str());
+        return;
+    }
+
+    //Пути в случайном порядке: промахи кеша как у реальной проверки процессов
+    std::vector<size_t> order(entries);
+    for (size_t i = 0; i < entries; ++i) {
+        order[i] = (i * 2654435761u) % entries;
+    }
+    //Первый проход платит за подкачку страниц отображения, второй - сам поиск
+    size_t found = 0;
+    double passNs[2];
+    for (double& ns : passNs) {
+        found = 0;
+        begin = Clock::now();
+        for (size_t i : order) {
+            found += manifest.find(paths[i]) ? 1 : 0;
+        }
+        ns = std::chrono::duration<double, std::nano>(Clock::now() - begin).count() / static_cast<double>(entries);
+    }
+    for (std::string& path : paths) {
+        path[5] = 'X'; //"/usr/Xib/..." - в манифесте нет
+    }
+    begin = Clock::now();
+    for (size_t i : order) {
+        found += manifest.find(paths[i]) ? 1 : 0;
+    }
+    double missNs = std::chrono::duration<double, std::nano>(Clock::now() - begin).count() / static_cast<double>(entries);
+    if (found != entries) {
+        std::cerr << "Manifest lookups: " << found << " of " << entries << " found" << std::endl;
+    }
+
+    struct stat info;
+    double bytes = ::stat(file.c_str(), &info) == 0 ? static_cast<double>(info.st_size) : 0;
+    manifest.close();
+    std::remove(file.c_str());
+
+    results.push_back(Result());
+    results.back().name = "manifest";
+    results.back().param("source", "synthetic")
+        .metric("entries", static_cast<double>(entries))
+        .metric("file_bytes", bytes)
+        .metric("compile_ms", compileMs)
+        .metric("open_us", openUs)
+        .metric("first_pass_ns", passNs[0])
+        .metric("lookup_hit_ns", passNs[1])
+        .metric("lookup_miss_ns", missNs);
+}
+
+/*
+Метрики: цена add() счетчика и observe() гистограммы в потоке (threads потоков
+пишут одну метрику одновременно - ячейки свои, общей строки кеша нет),
+MetricTimer (два чтения steady_clock) и чтение всех метрик в JSON и Prometheus.
+*/
+void benchMetrics(size_t threads, size_t operations, std::vector<Result>& results) {
+    static MetricCounter counter("bench_counter_total", "MonitorBench counter");
+    static MetricHistogram histogram("bench_latency_seconds", "MonitorBench histogram");
+
+    std::vector<double> addNs(threads);
+    std::vector<double> observeNs(threads);
+    std::vector<double> timerNs(threads);
+    std::vector<std::thread> workers;
+    for (size_t t = 0; t < threads; ++t) {
+        workers.emplace_back([&, t]() {
+            auto begin = Clock::now();
+            for (size_t i = 0; i < operations; ++i) {
+                counter.add();
+            }
+            addNs[t] = std::chrono::duration<double, std::nano>(Clock::now() - begin).count() / static_cast<double>(operations);
+            begin = Clock::now();
+            for (size_t i = 0; i < operations; ++i) {
+                histogram.observe(i * 37);
+            }
+            observeNs[t] = std::chrono::duration<double, std::nano>(Clock::now() - begin).count() / static_cast<double>(operations);
+            begin = Clock::now();
+            for (size_t i = 0; i < operations; ++i) {
+                MetricTimer timer(histogram);
+            }
+            timerNs[t] = std::chrono::duration<double, std::nano>(Clock::now() - begin).count() / static_cast<double>(operations);
+        });
+    }
+    for (auto& worker : workers) {
+        worker.join();
+    }
+
+    std::vector<double> jsonUs;
+    std::vector<double> prometheusUs;
+    for (int i = 0; i < 20; ++i) {
+        JsonWriter json;
+        auto begin = Clock::now();
+        Metrics::writeJson(json);
+        jsonUs.push_back(std::chrono::duration<double, std::micro>(Clock::now() - begin).count());
+        std::string text;
+        begin = Clock::now();
+        Metrics::writePrometheus(text);
+        prometheusUs.push_back(std::chrono::duration<double, std::micro>(Clock::now() - begin).count());
+    }
+
+    results.push_back(Result());
+    results.back().name = "metrics";
+    results.back().param("threads", std::to_string(threads))
+        .param("enabled", Metrics::enabled() ? "true" : "false")
+        .metric("counter_add_ns", bench::median(addNs))
+        .metric("histogram_observe_ns", bench::median(observeNs))
+        .metric("timer_ns", bench::median(timerNs))
+        .metric("read_json_us", bench::median(jsonUs))
+        .metric("read_prometheus_us", bench::median(prometheusUs));
+}
+
+/*
+Правила: тысячи шаблонов против снимка. Сравнение: DFA на строку против
+наивного поиска каждого шаблона (на выборке строк - целиком он слишком долгий)
+и evaluate() со свертыванием одинаковых имен/путей.
+*/
+void benchRules(const ProcessTable& table, size_t patterns, int iterations, std::vector<Result>& results) {
+    if (table.empty()) {
+        return;
+    }
+    std::string text;
+    std::vector<std::string> needles;
+    uint64_t seed = 88172645463325252ull;
+    for (size_t i = 0; i < patterns; ++i) {
+        std::string pattern;
+        seed ^= seed << 13;
+        seed ^= seed >> 7;
+        seed ^= seed << 17;
+        size_t length = 6 + seed % 7;
+        for (size_t j = 0; j < length; ++j) {
+            pattern.push_back(static_cast<char>('a' + (seed >> (j * 4)) % 26));
+        }
+        //Несколько правил реально срабатывают: на имена из снимка
+        if (i % 500 == 0) {
+            pattern = table.strings().get(table.nameIds()[(i * 7919) % table.size()]);
+        }
+        text += (i % 3 == 0 ? "name r" : "any r") + std::to_string(i) + " " + pattern + "\n";
+        needles.push_back(pattern);
+    }
+
+    std::vector<double> compileTimes;
+    std::shared_ptr<const RuleSet> rules;
+    for (int i = 0; i < iterations; ++i) {
+        auto start = Clock::now();
+        rules = RuleSet::compile(text);
+        compileTimes.push_back(std::chrono::duration<double, std::nano>(Clock::now() - start).count());
+    }
+    if (!rules) {
+        std::cerr << "Rule compilation failed" << std::endl;
+        return;
+    }
+
+    std::vector<RuleMatch> matches;
+    std::vector<double> evaluateTimes;
+    for (int i = 0; i < iterations; ++i) {
+        auto start = Clock::now();
+        rules->evaluate(table, matches);
+        evaluateTimes.push_back(std::chrono::duration<double, std::nano>(Clock::now() - start).count());
+    }
+
+    //Без свертывания: каждая строка таблицы через автомат
+    std::vector<uint32_t> found;
+    auto start = Clock::now();
+    for (size_t row = 0; row < table.size(); ++row) {
+        found.clear();
+        rules->match(RuleField::Path, table.strings().get(table.pathIds()[row]), found);
+    }
+    double dfaNs = std::chrono::duration<double, std::nano>(Clock::now() - start).count() / static_cast<double>(table.size());
+
+    const size_t sample = std::min<size_t>(table.size(), 200);
+    size_t naiveHits = 0;
+    start = Clock::now();
+    for (size_t row = 0; row < sample; ++row) {
+        const std::string& path = table.strings().get(table.pathIds()[row]);
+        for (const std::string& needle : needles) {
+            naiveHits += path.find(needle) != std::string::npos;
+        }
+    }
+    double naiveNs = std::chrono::duration<double, std::nano>(Clock::now() - start).count() / static_cast<double>(sample);
+
+    results.push_back(Result());
+    results.back().name = "rule_engine";
+    results.back().param("source", "synthetic")
+        .metric("patterns", static_cast<double>(patterns))
+        .metric("processes", static_cast<double>(table.size()))
+        .metric("states", static_cast<double>(rules->states()))
+        .metric("table_kb", static_cast<double>(rules->tableBytes()) / 1024.0)
+        .metric("compile_ms", bench::median(compileTimes) / 1e6)
+        .metric("evaluate_ms", bench::median(evaluateTimes) / 1e6)
+        .metric("evaluate_ns_per_process", bench::median(evaluateTimes) / static_cast<double>(table.size()))
+        .metric("dfa_ns_per_string", dfaNs)
+        .metric("naive_ns_per_string", naiveNs)
+        .metric("matches", static_cast<double>(matches.size()));
+    if (naiveHits > sample * patterns) {
+        std::cerr << "Impossible naive hit count" << std::endl;
+    }
+}
+
+//Пропускная способность SHA-256: поток и многобуферный режим для каждого ядра
+void benchHash(bool quick, std::vector<Result>& results) {
+    const size_t bufferSize = quick ? (8u << 20) : (64u << 20);
+    std::vector<unsigned char> data(bufferSize);
+    for (size_t i = 0; i < data.size(); ++i) {
+        data[i] = static_cast<unsigned char>(i * 131 + 7);
+    }
+
+    Sha256::Kernel original = Sha256::activeKernel();
+    const Sha256::Kernel kernels[] = {Sha256::Kernel::Scalar, Sha256::Kernel::ShaNi, Sha256::Kernel::Avx2};
+    for (Sha256::Kernel kernel : kernels) {
+        if (!Sha256::isSupported(kernel)) {
+            continue;
+        }
+        Sha256::setKernel(kernel);
+        unsigned char digest[Sha256::DIGEST_SIZE];
+
+        //Скалярное ядро медленное - хешируем меньший объем
+        size_t size = kernel == Sha256::Kernel::Scalar ? bufferSize / 8 : bufferSize;
+        auto start = Clock::now();
+        Sha256::hash(data.data(), size, digest);
+        double single = std::chrono::duration<double>(Clock::now() - start).count();
+
+        //MAX_LANES сообщений одинаковой длины
+        size_t laneSize = size / Sha256::MAX_LANES;
+        const unsigned char* inputs[Sha256::MAX_LANES];
+        size_t sizes[Sha256::MAX_LANES];
+        unsigned char digests[Sha256::MAX_LANES][Sha256::DIGEST_SIZE];
+        for (size_t lane = 0; lane < Sha256::MAX_LANES; ++lane) {
+            inputs[lane] = data.data() + lane * laneSize;
+            sizes[lane] = laneSize;
+        }
+        start = Clock::now();
+        Sha256::hashMany(inputs, sizes, Sha256::MAX_LANES, digests);
+        double many = std::chrono::duration<double>(Clock::now() - start).count();
+
+        results.push_back(Result());
+        results.back().name = "hash";
+        results.back().param("kernel", Sha256::kernelName(kernel))
+            .metric("bytes", static_cast<double>(size))
+            .metric("single_gb_per_sec", single > 0 ? static_cast<double>(size) / single / 1e9 : 0)
+            .metric("multi_gb_per_sec", many > 0 ? static_cast<double>(laneSize * Sha256::MAX_LANES) / many / 1e9 : 0);
+    }
+    Sha256::setKernel(original);
+}
+
+//Стоимость сериализации снимка: JSON в новую строку, JSON в переиспользуемый буфер, двоичные кадры
+void benchSerialization(const ProcessTable& table, int iterations, std::vector<Result>& results) {
+    if (table.empty()) {
+        return;
+    }
+
+    auto measure = [&](const char* format, size_t extraBytes, const std::function<size_t()>& serialize) {
+        std::vector<double> times;
+        size_t bytes = 0;
+        serialize(); //прогрев буферов
+        for (int i = 0; i < iterations; ++i) {
+            auto start = Clock::now();
+            bytes = serialize();
+            auto end = Clock::now();
+            times.push_back(std::chrono::duration<double, std::nano>(end - start).count());
+        }
+        double median = bench::median(times);
+        results.push_back(Result());
+        results.back().name = "serialization";
+        results.back().param("format", format)
+            .metric("processes", static_cast<double>(table.size()))
+            .metric("bytes", static_cast<double>(bytes))
+            .metric("dictionary_bytes", static_cast<double>(extraBytes))
+            .metric("median_ms", median / 1e6)
+            .metric("ns_per_process", median / static_cast<double>(table.size()))
+            .metric("mb_per_sec", median > 0 ? static_cast<double>(bytes) / median * 1e3 : 0);
+    };
+
+    measure("json", 0, [&table]() {
+        return ProcessJson::serializeProcesses(table).size();
+    });
+
+    JsonWriter writer;
+    measure("json_writer", 0, [&table, &writer]() {
+        writer.clear();
+        ProcessJson::writeProcesses(writer, table);
+        return writer.size();
+    });
+
+    //Как в SnapshotCache: экранированные строки живут между поколениями
+    JsonStringCache strings;
+    measure("json_writer_cached", 0, [&table, &writer, &strings]() {
+        writer.clear();
+        ProcessJson::writeProcesses(writer, table, 0, strings);
+        return writer.size();
+    });
+
+    //Словарь строк передается клиенту один раз, поэтому считается отдельно
+    ProcessBinaryEncoder encoder;
+    encoder.mapTable(table);
+    std::string dictionary;
+    encoder.writeStrings(dictionary, 0);
+    std::string frame;
+    measure("binary", dictionary.size(), [&table, &encoder, &frame]() {
+        frame.clear();
+        encoder.mapTable(table);
+        encoder.writeSnapshot(frame, table, 1);
+        return frame.size();
+    });
+}
+
+std::string toJson(const Options& options, const std::vector<Result>& results) {
+    std::ostringstream out;
+    out.precision(6);
+    out << "{\"benchmark\":\"MonitorBench\",\"quick\":" << (options.quick ? "true" : "false")
+        << ",\"hardware_concurrency\":" << std::thread::hardware_concurrency()
+        << ",\"max_threads\":" << options.maxThreads
+        << ",\"results\":[";
+    for (size_t i = 0; i < results.size(); ++i) {
+        const Result& result = results[i];
+        std::string name;
+        ProcessJson::appendString(name, result.name);
+        out << (i ? "," : "") << "\n {\"name\":" << name << ",\"params\":{";
+        for (size_t p = 0; p < result.params.size(); ++p) {
+            std::string key;
+            std::string value;
+            ProcessJson::appendString(key, result.params[p].first);
+            ProcessJson::appendString(value, result.params[p].second);
+            out << (p ? "," : "") << key << ":" << value;
+        }
+        out << "},\"metrics\":{";
+        for (size_t m = 0; m < result.metrics.size(); ++m) {
+            std::string key;
+            ProcessJson::appendString(key, result.metrics[m].first);
+            out << (m ? "," : "") << key << ":" << std::fixed << result.metrics[m].second;
+        }
+        out << "}}";
+    }
+    out << "\n]}\n";
+    return out.str();
+}
+
+//Число потоков для сравнения масштабирования: 1, 2, 3, 4, 6, 9, 13... (шаг x1.5, не только
+//степени двойки) и сам maxThreads
+std::vector<size_t> threadCounts(size_t maxThreads) {
+    std::vector<size_t> counts;
+    for (size_t threads = 1; threads < maxThreads; threads = std::max(threads + 1, threads * 3 / 2)) {
+        counts.push_back(threads);
+    }
+    counts.push_back(maxThreads);
+    return counts;
+}
+
+bool parseOptions(int argc, char* argv[], Options& options) {
+    for (int i = 1; i < argc; ++i) {
+        if (std::strcmp(argv[i], "--output") == 0 && i + 1 < argc) {
+            options.output = argv[++i];
+        } else if (std::strcmp(argv[i], "--processes") == 0 && i + 1 < argc) {
+            options.processes = std::strtoul(argv[++i], nullptr, 10);
+        } else if (std::strcmp(argv[i], "--max-threads") == 0 && i + 1 < argc) {
+            options.maxThreads = std::strtoul(argv[++i], nullptr, 10);
+        } else if (std::strcmp(argv[i], "--quick") == 0) {
+            options.quick = true;
+        } else {
+            std::cerr << "Usage: " << argv[0] << " [--output file] [--processes N] [--max-threads N] [--quick]" << std::endl;
+            return false;
+        }
+    }
+    return true;
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+    Options options;
+    if (!parseOptions(argc, argv, options)) {
+        return 1;
+    }
+    if (options.quick) {
+        options.processes = std::min<size_t>(options.processes, 2000);
+    }
+    int iterations = options.quick ? 3 : 10;
+    std::vector<Result> results;
+
+    //1. Очереди: сочетания 1..N производителей и потребителей, N - по числу ядер
+    std::cerr << "Queue benchmarks..." << std::endl;
+    if (options.maxThreads == 0) {
+        options.maxThreads = std::max<size_t>(2, std::thread::hardware_concurrency());
+    }
+    std::vector<size_t> threads = threadCounts(options.maxThreads);
+    size_t items = options.quick ? 20000 : 200000;
+    for (size_t producers : threads) {
+        for (size_t consumers : threads) {
+            results.push_back(benchQueue<MutexQueueAdapter>(producers, consumers, items / producers));
+            results.push_back(benchQueue<BoundedQueueAdapter>(producers, consumers, items / producers));
+        }
+    }
+
+    //2. Перечисление: синтетический /proc фиксированного размера и реальный /proc; скан с расписанием
+    std::cerr << "Enumeration benchmarks (" << options.processes << " synthetic processes)..." << std::endl;
+    std::string root = bench::makeFakeProc(options.processes);
+    ProcessTable table;
+    if (root.empty()) {
+        std::cerr << "Cannot build synthetic /proc" << std::endl;
+    } else {
+        benchEnumeration("synthetic", root, iterations, results);
+        ProcFsReader reader(root);
+        table.scan(reader);
+    }
+    benchEnumeration("procfs", "/proc", iterations, results);
+    if (!root.empty()) {
+        benchRefresh("synthetic", root, iterations, results);
+    }
+    benchRefresh("procfs", "/proc", iterations, results);
+    if (!root.empty()) {
+        benchSampling("synthetic", root, iterations, results);
+    }
+    benchSampling("procfs", "/proc", iterations * 10, results);
+
+    //3. Хеширование
+    std::cerr << "Hash benchmarks..." << std::endl;
+    benchHash(options.quick, results);
+
+    //4. Дерево процессов на 50k процессов
+    std::cerr << "Process tree benchmarks..." << std::endl;
+    benchTree(options.quick ? 2000 : 50000, iterations, results);
+
+    //5. Сериализация снимка синтетического /proc
+    std::cerr << "Serialization benchmarks..." << std::endl;
+    benchSerialization(table, iterations, results);
+
+    //6. Правила подозрительных процессов по тому же снимку
+    std::cerr << "Rule engine benchmarks..." << std::endl;
+    benchRules(table, options.quick ? 500 : 5000, iterations, results);
+
+    //7. Запись и воспроизведение снимков: занятый хост и 100k процессов
+    std::cerr << "Snapshot recording benchmarks..." << std::endl;
+    benchRecording("busy_host", 2000, options.quick ? 300 : 3600, 1.0, results);
+    benchRecording("synthetic", options.quick ? 10000 : 100000, options.quick ? 30 : 120, 1.0, results);
+
+    //8. История ресурсов: 20k процессов
+    std::cerr << "History store benchmarks..." << std::endl;
+    benchHistory(options.quick ? 2000 : 20000, options.quick ? 1200 : 3700, results);
+
+    //9. Журнал безопасности: один поток и несколько пишущих
+    std::cerr << "Secure log benchmarks..." << std::endl;
+    for (size_t writers : threads) {
+        benchSecureLog(writers, options.quick ? 20000 : 200000, results);
+    }
+
+    //10. Запросы с отбором и top-K на 50k процессов
+    std::cerr << "Query benchmarks..." << std::endl;
+    benchQuery(options.quick ? 10000 : 50000, iterations, results);
+
+    //11. Метрики монитора: цена записи в потоке и чтения
+    std::cerr << "Metrics benchmarks..." << std::endl;
+    for (size_t writers : threads) {
+        benchMetrics(writers, options.quick ? 1000000 : 10000000, results);
+    }
+
+    //12. Манифест эталонных хешей: сборка, открытие, поиск
+    std::cerr << "Integrity manifest benchmarks..." << std::endl;
+    benchManifest(options.quick ? 100000 : 500000, results);
+
+    //13. Открытые файлы и сокеты: инкрементальный и полный скан реального /proc
+    std::cerr << "Fd inventory benchmarks..." << std::endl;
+    benchFds(iterations, results);
+
+    if (!root.empty()) {
+        bench::removeTree(root);
+    }
+
+    std::string json = toJson(options, results);
+    if (options.output.empty()) {
+        std::cout << json;
+    } else {
+        std::ofstream file(options.output);
+        if (!file) {
+            std::cerr << "Cannot write " << options.output << std::endl;
+            return 1;
+        }
+        file << json;
+        std::cerr << "Results written to " << options.output << std::endl;
+    }
+    return 0;
+}
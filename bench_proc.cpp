@@ -0,0 +1,115 @@
+// Бенчмарк перечисления процессов через /proc
+// Использование: ProcBench [число процессов] [итерации] [корень /proc]
+// Без третьего аргумента строится синтетическое дерево /proc во временном каталоге.
+#include <iostream>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <cstdlib>
+#include <new>
+#include <atomic>
+#include "BenchUtils.h"
+#include "ProcFsReader.h"
+#include "ProcessInfo.h"
+#include "ProcessSnapshotDiffer.h"
+#include "ProcessTable.h"
+
+//Счетчик аллокаций: проверяем, что ProcessTable::scan после прогрева не аллоцирует
+static std::atomic<size_t> g_allocations{0};
+
+void* operator new(size_t size) {
+    g_allocations.fetch_add(1, std::memory_order_relaxed);
+    if (void* p = std::malloc(size)) {
+        return p;
+    }
+    throw std::bad_alloc();
+}
+
+void operator delete(void* p) noexcept {
+    std::free(p);
+}
+
+void operator delete(void* p, size_t) noexcept {
+    std::free(p);
+}
+
+int main(int argc, char* argv[]) {
+    size_t count = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 20000;
+    int iterations = argc > 2 ? std::atoi(argv[2]) : 20;
+    std::string root;
+    bool synthetic = argc <= 3;
+
+    if (synthetic) {
+        std::cout << "Building synthetic /proc with " << count << " processes" << std::endl;
+        root = bench::makeFakeProc(count);
+        if (root.empty()) {
+            std::cerr << "Cannot build synthetic /proc" << std::endl;
+            return 1;
+        }
+    } else {
+        root = argv[3];
+    }
+
+    ProcFsReader reader(root);
+    if (!reader.isOpen()) {
+        std::cerr << "Cannot open " << root << std::endl;
+        return 1;
+    }
+
+    std::vector<double> rawTimes;
+    std::vector<double> infoTimes;
+    std::vector<double> diffTimes;
+    std::vector<double> tableTimes;
+    ProcessSnapshotDiffer differ;
+    ProcessTable table;
+    size_t changes = 0;
+    size_t tableAllocations = 0;
+    size_t found = 0;
+    size_t checksum = 0;
+
+    for (int i = 0; i < iterations; ++i) {
+        //Сырой обход: только чтение записей
+        auto start = std::chrono::steady_clock::now();
+        found = reader.forEachProcess([&checksum](const ProcessRecord& record) {
+            checksum += record.parentPid + record.path.size();
+        });
+        auto middle = std::chrono::steady_clock::now();
+        //Полный снимок через публичный API
+        auto processes = ProcessInfo::getRunningProcesses(reader);
+        auto end = std::chrono::steady_clock::now();
+        //Инкрементальный diff: после первого скана изменений нет
+        changes = differ.update(reader).size();
+        auto diffEnd = std::chrono::steady_clock::now();
+        //Struct-of-arrays таблица с интернированными строками
+        size_t allocationsBefore = g_allocations.load();
+        table.scan(reader);
+        auto tableEnd = std::chrono::steady_clock::now();
+        tableAllocations = g_allocations.load() - allocationsBefore;
+
+        rawTimes.push_back(std::chrono::duration<double, std::milli>(middle - start).count());
+        infoTimes.push_back(std::chrono::duration<double, std::milli>(end - middle).count());
+        diffTimes.push_back(std::chrono::duration<double, std::milli>(diffEnd - end).count());
+        tableTimes.push_back(std::chrono::duration<double, std::milli>(tableEnd - diffEnd).count());
+        checksum += processes.size();
+    }
+
+    double raw = bench::median(rawTimes);
+    double info = bench::median(infoTimes);
+    double diff = bench::median(diffTimes);
+    double tableTime = bench::median(tableTimes);
+    std::cout << "Processes: " << found << " (checksum " << checksum << ")" << std::endl;
+    std::cout << "ProcFsReader scan:           " << raw << " ms median, "
+              << (found ? raw * 1e6 / static_cast<double>(found) : 0) << " ns/process" << std::endl;
+    std::cout << "getRunningProcesses(reader): " << info << " ms median, "
+              << (found ? info * 1e6 / static_cast<double>(found) : 0) << " ns/process" << std::endl;
+    std::cout << "ProcessSnapshotDiffer:       " << diff << " ms median, "
+              << changes << " changes in last scan" << std::endl;
+    std::cout << "ProcessTable::scan:          " << tableTime << " ms median, "
+              << tableAllocations << " allocations in last scan, "
+              << table.strings().size() << " interned strings" << std::endl;
+
+    if (synthetic) {
+        bench::removeTree(root);
+    }
+    return 0;
+}
@@ -0,0 +1,214 @@
+// Генератор нагрузки для NetworkServer через loopback
+// Использование: LoadGen [--port 8080] [--connections 100] [--threads N] [--seconds 5] [--filter all]
+// Каждое соединение работает по замкнутому циклу: запрос -> полный ответ -> следующий запрос.
+#include <iostream>
+#include <string>
+#include <vector>
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <cerrno>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include "BenchUtils.h"
+
+namespace {
+
+typedef std::chrono::steady_clock Clock;
+
+struct Options {
+    std::string host = "127.0.0.1";
+    int port = 8080;
+    size_t connections = 100;
+    size_t threads = 0;
+    double seconds = 5;
+    std::string filter = "all";
+};
+
+struct Client {
+    int fd = -1;
+    size_t sent = 0;          //сколько байт запроса уже отправлено
+    Clock::time_point started;
+};
+
+struct WorkerStats {
+    std::vector<uint64_t> latenciesNs;
+    uint64_t bytes = 0;
+    size_t errors = 0;
+};
+
+int connectTo(const Options& options) {
+    int fd = ::socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd < 0) {
+        return -1;
+    }
+    sockaddr_in address;
+    std::memset(&address, 0, sizeof(address));
+    address.sin_family = AF_INET;
+    address.sin_port = htons(static_cast<uint16_t>(options.port));
+    if (::inet_pton(AF_INET, options.host.c_str(), &address.sin_addr) != 1 ||
+        ::connect(fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0) {
+        ::close(fd);
+        return -1;
+    }
+    int enable = 1;
+    ::setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &enable, sizeof(enable));
+    //Соединение уже установлено - дальше работаем без блокировок
+    int flags = ::fcntl(fd, F_GETFL, 0);
+    ::fcntl(fd, F_SETFL, flags | O_NONBLOCK);
+    return fd;
+}
+
+bool sendRequest(Client& client, const std::string& request) {
+    while (client.sent < request.size()) {
+        ssize_t sent = ::send(client.fd, request.data() + client.sent, request.size() - client.sent, MSG_NOSIGNAL);
+        if (sent < 0) {
+            return errno == EAGAIN || errno == EWOULDBLOCK;
+        }
+        client.sent += static_cast<size_t>(sent);
+    }
+    return true;
+}
+
+void worker(const Options& options, size_t connections, Clock::time_point deadline, WorkerStats& stats) {
+    const std::string request = "{\"command\":\"get_processes\",\"filter\":\"" + options.filter + "\"}\n";
+    int epollFd = ::epoll_create1(EPOLL_CLOEXEC);
+    std::vector<Client> clients(connections);
+    for (size_t i = 0; i < connections; ++i) {
+        clients[i].fd = connectTo(options);
+        if (clients[i].fd < 0) {
+            ++stats.errors;
+            continue;
+        }
+        epoll_event event;
+        std::memset(&event, 0, sizeof(event));
+        event.events = EPOLLIN | EPOLLOUT | EPOLLET;
+        event.data.u64 = i;
+        ::epoll_ctl(epollFd, EPOLL_CTL_ADD, clients[i].fd, &event);
+        clients[i].started = Clock::now();
+        sendRequest(clients[i], request);
+    }
+
+    std::vector<char> buffer(1 << 16);
+    epoll_event events[256];
+    while (Clock::now() < deadline) {
+        int count = ::epoll_wait(epollFd, events, 256, 100);
+        for (int e = 0; e < count; ++e) {
+            Client& client = clients[events[e].data.u64];
+            if (client.fd < 0) {
+                continue;
+            }
+            if (!sendRequest(client, request)) {
+                ++stats.errors;
+                ::close(client.fd);
+                client.fd = -1;
+                continue;
+            }
+            for (;;) {
+                ssize_t got = ::recv(client.fd, buffer.data(), buffer.size(), 0);
+                if (got <= 0) {
+                    if (got < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+                        break;
+                    }
+                    ++stats.errors;
+                    ::close(client.fd);
+                    client.fd = -1;
+                    break;
+                }
+                stats.bytes += static_cast<uint64_t>(got);
+                //Ответ заканчивается '\n'; сервер отвечает строго по одному ответу на запрос
+                if (buffer[static_cast<size_t>(got) - 1] == '\n') {
+                    Clock::time_point now = Clock::now();
+                    stats.latenciesNs.push_back(static_cast<uint64_t>(
+                        std::chrono::duration_cast<std::chrono::nanoseconds>(now - client.started).count()));
+                    client.started = now;
+                    client.sent = 0;
+                    if (!sendRequest(client, request)) {
+                        ++stats.errors;
+                        ::close(client.fd);
+                        client.fd = -1;
+                        break;
+                    }
+                }
+            }
+        }
+    }
+
+    for (auto& client : clients) {
+        if (client.fd >= 0) ::close(client.fd);
+    }
+    ::close(epollFd);
+}
+
+bool parseOptions(int argc, char* argv[], Options& options) {
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        bool hasValue = i + 1 < argc;
+        if (arg == "--host" && hasValue) options.host = argv[++i];
+        else if (arg == "--port" && hasValue) options.port = std::atoi(argv[++i]);
+        else if (arg == "--connections" && hasValue) options.connections = std::strtoul(argv[++i], nullptr, 10);
+        else if (arg == "--threads" && hasValue) options.threads = std::strtoul(argv[++i], nullptr, 10);
+        else if (arg == "--seconds" && hasValue) options.seconds = std::atof(argv[++i]);
+        else if (arg == "--filter" && hasValue) options.filter = argv[++i];
+        else {
+            std::cerr << "Usage: " << argv[0] << " [--host 127.0.0.1] [--port 8080] [--connections 100]"
+                      << " [--threads N] [--seconds 5] [--filter all]" << std::endl;
+            return false;
+        }
+    }
+    return options.connections > 0;
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+    Options options;
+    if (!parseOptions(argc, argv, options)) {
+        return 1;
+    }
+    if (options.threads == 0) {
+        options.threads = std::max(1u, std::thread::hardware_concurrency());
+    }
+    options.threads = std::min(options.threads, options.connections);
+
+    std::cout << "Load: " << options.connections << " connections, " << options.threads
+              << " threads, " << options.seconds << " s against " << options.host << ":" << options.port << std::endl;
+
+    auto start = Clock::now();
+    auto deadline = start + std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(options.seconds));
+    std::vector<WorkerStats> stats(options.threads);
+    std::vector<std::thread> threads;
+    for (size_t t = 0; t < options.threads; ++t) {
+        //Соединения делятся между потоками поровну, остаток - первым потокам
+        size_t share = options.connections / options.threads + (t < options.connections % options.threads ? 1 : 0);
+        threads.emplace_back(worker, std::cref(options), share, deadline, std::ref(stats[t]));
+    }
+    for (auto& thread : threads) {
+        thread.join();
+    }
+    double elapsed = std::chrono::duration<double>(Clock::now() - start).count();
+
+    std::vector<uint64_t> latencies;
+    uint64_t bytes = 0;
+    size_t errors = 0;
+    for (auto& part : stats) {
+        latencies.insert(latencies.end(), part.latenciesNs.begin(), part.latenciesNs.end());
+        bytes += part.bytes;
+        errors += part.errors;
+    }
+
+    std::cout << "Requests:   " << latencies.size() << " (" << errors << " errors)" << std::endl;
+    std::cout << "Throughput: " << static_cast<double>(latencies.size()) / elapsed << " req/s, "
+              << static_cast<double>(bytes) / elapsed / 1e6 << " MB/s" << std::endl;
+    std::cout << "Latency:    p50 " << static_cast<double>(bench::percentile(latencies, 0.50)) / 1e3
+              << " us, p99 " << static_cast<double>(bench::percentile(latencies, 0.99)) / 1e3
+              << " us, p999 " << static_cast<double>(bench::percentile(latencies, 0.999)) / 1e3 << " us" << std::endl;
+    return errors == 0 ? 0 : 1;
+}
